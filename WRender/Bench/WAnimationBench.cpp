@@ -0,0 +1,217 @@
+#include "WBench.h"
+#include "../Utils/WAnimation.h"
+#include "../Utils/WInstanceStore.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	// Translation, rotation and scale tracks for every object with irregular key times, half of
+	// them cubic and half looping
+	WAnimationSet makeTracks(UINT32 objects, UINT32 keysPerTrack)
+	{
+		std::mt19937 rng(16);
+		std::uniform_real_distribution<float> step(0.1f, 1.0f);
+		std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+		WAnimationSet animations;
+		std::vector<float> times;
+		std::vector<DirectX::XMFLOAT3> values;
+		for (UINT32 o = 0; o < objects; o++)
+			for (UINT32 target = ANIMATION_TRANSLATION; target <= ANIMATION_SCALE; target++)
+			{
+				// Some tracks are a single held key
+				const UINT32 keys = (o + target) % 17 == 0 ? 1 : keysPerTrack;
+				times.assign(1, step(rng));
+				values.assign(1, DirectX::XMFLOAT3(value(rng), value(rng), value(rng)));
+				for (UINT32 k = 1; k < keys; k++)
+				{
+					times.push_back(times.back() + step(rng));
+					values.push_back(DirectX::XMFLOAT3(value(rng), value(rng), value(rng)));
+				}
+				animations.addChannel(o, static_cast<WANIMATION_TARGET>(target),
+					(o + target) % 2 ? INTERPOLATION_CUBIC : INTERPOLATION_LINEAR, o % 3 != 0, times, values);
+			}
+		return animations;
+	}
+
+	WInstanceStore makeStore(size_t objects)
+	{
+		WInstanceStore store;
+		store.transforms.resize(objects);
+		store.translations.resize(objects);
+		store.rotations.resize(objects);
+		store.scalings.resize(objects);
+		store.dirty.assign(objects, 0);
+		return store;
+	}
+
+	// Textbook evaluation of one channel in double: binary search for the segment, lerp or a
+	// Catmull-Rom Hermite segment whose tangents are clamped at the ends
+	void referenceSample(const WAnimationSet& animations, size_t c, float time, double* result)
+	{
+		const UINT32 first = animations.firstKeys[c];
+		const UINT32 last = first + animations.keyCounts[c] - 1;
+		const float* times = animations.keyTimes.data();
+		const DirectX::XMFLOAT3* values = animations.keyValues.data();
+		auto load = [&](UINT32 k, double* p) { p[0] = values[k].x; p[1] = values[k].y; p[2] = values[k].z; };
+		if (last == first || times[last] <= times[first])
+		{
+			load(last, result);
+			return;
+		}
+		// Wrapped in float like evaluateAnimations, a double wrap differs by the rounding of the
+		// time itself times the slope of the track
+		float wrapped = time;
+		if (animations.loops[c] && (wrapped < times[first] || wrapped > times[last]))
+		{
+			const float length = times[last] - times[first];
+			wrapped -= times[first];
+			wrapped = times[first] + (wrapped - std::floor(wrapped / length) * length);
+		}
+		const double t = (std::min)((std::max)(wrapped, times[first]), times[last]);
+
+		UINT32 k1 = static_cast<UINT32>(std::upper_bound(times + first, times + last + 1, float(t)) - times) - 1;
+		k1 = (std::min)(k1, last - 1);
+		const UINT32 k2 = k1 + 1;
+		const UINT32 k0 = k1 > first ? k1 - 1 : k1;
+		const UINT32 k3 = k2 < last ? k2 + 1 : k2;
+		const double dt = double(times[k2]) - times[k1];
+		const double u = (t - times[k1]) / dt;
+		double p0[3], p1[3], p2[3], p3[3];
+		load(k0, p0); load(k1, p1); load(k2, p2); load(k3, p3);
+		for (int i = 0; i < 3; i++)
+		{
+			if (animations.interpolations[c] != INTERPOLATION_CUBIC)
+			{
+				result[i] = p1[i] + (p2[i] - p1[i]) * u;
+				continue;
+			}
+			const double m1 = (p2[i] - p0[i]) / (double(times[k2]) - times[k0]) * dt;
+			const double m2 = (p3[i] - p1[i]) / (double(times[k3]) - times[k1]) * dt;
+			result[i] = (2 * u * u * u - 3 * u * u + 1) * p1[i] + (u * u * u - 2 * u * u + u) * m1 +
+				(-2 * u * u * u + 3 * u * u) * p2[i] + (u * u * u - u * u) * m2;
+		}
+	}
+
+	const DirectX::XMFLOAT3& storeValue(const WInstanceStore& store, const WAnimationSet& animations, size_t c)
+	{
+		const std::vector<DirectX::XMFLOAT3>* targets[] = { &store.translations, &store.rotations, &store.scalings };
+		return (*targets[animations.targets[c]])[animations.objIdx[c]];
+	}
+
+	// Largest difference between the batched samples in "store" and the reference
+	double maxSampleError(const WInstanceStore& store, const WAnimationSet& animations, float time)
+	{
+		double maxError = 0.0;
+		for (size_t c = 0; c < animations.size(); c++)
+		{
+			double reference[3];
+			referenceSample(animations, c, time, reference);
+			const auto& v = storeValue(store, animations, c);
+			const double sample[3] = { v.x, v.y, v.z };
+			for (int i = 0; i < 3; i++)
+				maxError = (std::max)(maxError, std::fabs(sample[i] - reference[i]));
+		}
+		return maxError;
+	}
+}
+
+void benchAnimation(WBenchContext& ctx)
+{
+	const UINT32 objects = static_cast<UINT32>(ctx.size(100000, 5000));
+	WAnimationSet animations = makeTracks(objects, 16);
+	WInstanceStore store = makeStore(objects);
+	const int frames = static_cast<int>(ctx.size(120, 20));
+	const float frameTime = 1.0f / 60.0f;
+
+	// Playback at 60 Hz, the cursors mostly stay on their segment
+	float time = 0.0f;
+	double seconds = benchSeconds([&] {
+		for (int frame = 0; frame < frames; frame++, time += frameTime)
+			evaluateAnimations(animations, time, store, 3);
+	});
+	ctx.report("evaluateAnimations", animations.size() * frames / seconds * 1e-6, "M channels/s");
+	std::vector<double> scratch(3);
+	seconds = benchSeconds([&] {
+		for (int frame = 0; frame < frames; frame++)
+			for (size_t c = 0; c < animations.size(); c++)
+				referenceSample(animations, c, frame * frameTime, scratch.data());
+	});
+	ctx.report("binary search reference", animations.size() * frames / seconds * 1e-6, "M channels/s");
+
+	// Forward playback, random jumps (backwards resets the cursors), and times before the first
+	// and after the last key
+	std::mt19937 rng(61);
+	std::uniform_real_distribution<float> anyTime(-5.0f, 40.0f);
+	double maxError = 0.0;
+	for (int frame = 0; frame < 200; frame++)
+	{
+		const float t = frame < 100 ? frame * frameTime : anyTime(rng);
+		evaluateAnimations(animations, t, store, 3);
+		maxError = (std::max)(maxError, maxSampleError(store, animations, t));
+	}
+	ctx.report("max error against the reference", maxError, "");
+	ctx.check(maxError < 1e-4, "batched samples match the binary search reference");
+
+	// Keys are hit exactly by both interpolations, each time samples every channel so a few
+	// hundred are checked
+	bool exactKeys = true;
+	for (size_t c = 0; c < animations.size(); c += (std::max)(animations.size() / 300, size_t(1)))
+	{
+		const UINT32 key = animations.firstKeys[c] + (animations.keyCounts[c] - 1) / 2;
+		evaluateAnimations(animations, animations.keyTimes[key], store, 3);
+		const auto& v = storeValue(store, animations, c);
+		const auto& k = animations.keyValues[key];
+		exactKeys &= v.x == k.x && v.y == k.y && v.z == k.z;
+	}
+	ctx.check(exactKeys, "samples at key times are the keys");
+
+	// Non-looping tracks hold their last key
+	bool held = true;
+	evaluateAnimations(animations, 1000.0f, store, 3);
+	for (size_t c = 0; c < animations.size(); c++)
+	{
+		if (animations.loops[c])
+			continue;
+		const auto& v = storeValue(store, animations, c);
+		const auto& k = animations.keyValues[animations.firstKeys[c] + animations.keyCounts[c] - 1];
+		held &= v.x == k.x && v.y == k.y && v.z == k.z;
+	}
+	ctx.check(held, "tracks without loop hold their last key");
+
+	// Looping tracks of one length repeat, and times before the first key wrap as well
+	WAnimationSet loopTracks;
+	const std::vector<float> loopTimes = { 1.0f, 2.0f, 3.5f, 4.0f };
+	const std::vector<DirectX::XMFLOAT3> loopValues = { { 0, 0, 0 }, { 1, 2, 3 }, { -4, 0, 1 }, { 2, 2, 2 } };
+	loopTracks.addChannel(0, ANIMATION_TRANSLATION, INTERPOLATION_LINEAR, true, loopTimes, loopValues);
+	loopTracks.addChannel(0, ANIMATION_ROTATION, INTERPOLATION_CUBIC, true, loopTimes, loopValues);
+	WInstanceStore loopStore = makeStore(1);
+	bool looped = true;
+	for (float t : { 1.3f, 2.9f, 3.75f })
+	{
+		evaluateAnimations(loopTracks, t, loopStore, 3);
+		const DirectX::XMFLOAT3 translation = loopStore.translations[0], rotation = loopStore.rotations[0];
+		for (float cycles : { -2.0f, 1.0f, 5.0f })
+		{
+			evaluateAnimations(loopTracks, t + 3.0f * cycles, loopStore, 3);
+			const auto& a = loopStore.translations[0];
+			const auto& b = loopStore.rotations[0];
+			looped &= std::fabs(a.x - translation.x) + std::fabs(a.y - translation.y) + std::fabs(a.z - translation.z) < 1e-4f &&
+				std::fabs(b.x - rotation.x) + std::fabs(b.y - rotation.y) + std::fabs(b.z - rotation.z) < 1e-4f;
+		}
+	}
+	ctx.check(looped, "looping tracks repeat after their length");
+
+	// Only instances whose TRS changed are flagged
+	std::fill(store.dirty.begin(), store.dirty.end(), static_cast<UINT8>(0));
+	size_t flagged = evaluateAnimations(animations, 1000.0f, store, 3);
+	ctx.check(flagged == 0, "an unchanged sample flags nothing");
+	flagged = evaluateAnimations(animations, 1.234f, store, 3);
+	size_t dirtyCount = 0;
+	for (UINT8 d : store.dirty)
+		dirtyCount += (d & INSTANCE_DIRTY_TRANSFORM) ? 1 : 0;
+	ctx.check(flagged == dirtyCount && flagged > 0 && flagged <= animations.animatedObjectCount(),
+		"moved instances are flagged once each");
+}
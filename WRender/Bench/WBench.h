@@ -0,0 +1,64 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+// Console harness for the scene pipeline and the CPU acceleration structures.
+// Every case times its module on generated input and checks the invariants the
+// optimized path has to keep against a plain reference implementation.
+// Usage: WBench [--quick] [case ...], the exit code is non-zero when a check failed.
+
+class WBenchContext
+{
+public:
+	explicit WBenchContext(bool quick) : mQuick(quick) {}
+
+	// Small inputs so the checks finish in seconds, timings are not meaningful then
+	bool quick() const { return mQuick; }
+	size_t size(size_t full, size_t quick) const { return mQuick ? quick : full; }
+
+	void check(bool condition, const std::string& what);
+	// One result line, "<name>: <value> <unit>"
+	void report(const std::string& name, double value, const std::string& unit);
+	size_t failures() const { return mFailures; }
+
+	// Scratch file in the temp directory for cases that need input on disk
+	std::string tempPath(const std::string& name) const;
+private:
+	bool mQuick;
+	size_t mFailures = 0;
+};
+
+// Best wall time of "repeats" runs of "fn", in seconds
+template<typename Fn>
+double benchSeconds(Fn&& fn, int repeats = 3)
+{
+	double best = 1e30;
+	for (int i = 0; i < repeats; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		best = (std::min)(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+void benchObjReader(WBenchContext& ctx);
+void benchBinnedBvh(WBenchContext& ctx);
+void benchSpatialSplits(WBenchContext& ctx);
+void benchWideBvh(WBenchContext& ctx);
+void benchCompressedBvh(WBenchContext& ctx);
+void benchGeometryPages(WBenchContext& ctx);
+void benchVertexCodec(WBenchContext& ctx);
+void benchTransformBatch(WBenchContext& ctx);
+void benchInstanceTable(WBenchContext& ctx);
+void benchMeshSimplifier(WBenchContext& ctx);
+void benchSceneRegistry(WBenchContext& ctx);
+void benchInstanceStore(WBenchContext& ctx);
+void benchTransformHierarchy(WBenchContext& ctx);
+void benchAnimation(WBenchContext& ctx);
+void benchXmlReader(WBenchContext& ctx);
+void benchMeshCleanup(WBenchContext& ctx);
+void benchMaterialIds(WBenchContext& ctx);
+void benchSubScenes(WBenchContext& ctx);
@@ -0,0 +1,91 @@
+#include "WBench.h"
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <cstring>
+
+// Defaults of WRenderItem refer to it, MainApp defines it for the renderer
+extern const int gNumFrameResources = 3;
+
+void WBenchContext::check(bool condition, const std::string& what)
+{
+	if (condition)
+		return;
+	mFailures++;
+	std::cout << "  FAILED: " << what << std::endl;
+}
+
+void WBenchContext::report(const std::string& name, double value, const std::string& unit)
+{
+	std::cout << "  " << name << ": " << value << " " << unit << std::endl;
+}
+
+std::string WBenchContext::tempPath(const std::string& name) const
+{
+	return (std::filesystem::temp_directory_path() / ("WBench_" + name)).string();
+}
+
+namespace
+{
+	struct WBenchCase
+	{
+		const char* name;
+		void (*run)(WBenchContext& ctx);
+	};
+
+	const WBenchCase gCases[] = {
+		{ "obj", benchObjReader },
+		{ "bvh", benchBinnedBvh },
+		{ "sbvh", benchSpatialSplits },
+		{ "bvh8", benchWideBvh },
+		{ "bvh8c", benchCompressedBvh },
+		{ "pages", benchGeometryPages },
+		{ "codec", benchVertexCodec },
+		{ "transforms", benchTransformBatch },
+		{ "instances", benchInstanceTable },
+		{ "lod", benchMeshSimplifier },
+		{ "registry", benchSceneRegistry },
+		{ "store", benchInstanceStore },
+		{ "hierarchy", benchTransformHierarchy },
+		{ "animation", benchAnimation },
+		{ "xml", benchXmlReader },
+		{ "cleanup", benchMeshCleanup },
+		{ "materials", benchMaterialIds },
+		{ "subscenes", benchSubScenes },
+	};
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = false;
+	std::vector<std::string> selected;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quick") == 0)
+			quick = true;
+		else
+			selected.push_back(argv[i]);
+	}
+
+	WBenchContext ctx(quick);
+	size_t ran = 0;
+	for (const auto& c : gCases)
+	{
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), c.name) == selected.end())
+			continue;
+		std::cout << "[" << c.name << "]" << std::endl;
+		size_t failuresBefore = ctx.failures();
+		c.run(ctx);
+		std::cout << (ctx.failures() == failuresBefore ? "  ok" : "  failed") << std::endl;
+		ran++;
+	}
+	if (ran == 0)
+	{
+		std::cout << "Unknown case, available:";
+		for (const auto& c : gCases)
+			std::cout << " " << c.name;
+		std::cout << std::endl;
+		return 2;
+	}
+	return ctx.failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,532 @@
+#include "WBench.h"
+#include "../Utils/WBvh8.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace
+{
+	struct BenchMesh
+	{
+		std::vector<float> vertices;
+		std::vector<UINT32> indices;
+
+		WBvhMesh view() const { return { vertices.data(), vertices.size() / 3, indices.data(), indices.size() / 3 }; }
+		size_t triangleCount() const { return indices.size() / 3; }
+	};
+
+	void addQuad(BenchMesh& mesh, const float corner[3], const float a[3], const float b[3])
+	{
+		const UINT32 base = static_cast<UINT32>(mesh.vertices.size() / 3);
+		for (int k = 0; k < 4; k++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+				mesh.vertices.push_back(corner[axis] + ((k == 1 || k == 2) ? a[axis] : 0.0f) + (k >= 2 ? b[axis] : 0.0f));
+		}
+		mesh.indices.insert(mesh.indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+	}
+
+	// Grid of rooms: floors and walls of long, thin triangles around small clutter quads, and
+	// a tessellated sphere per room row. Coordinates start at 0, so node bounds and ray
+	// origins on the planes x, y, z = 0 are common.
+	BenchMesh roomsMesh(int rooms, int clutter, int sphereRings)
+	{
+		BenchMesh mesh;
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (int x = 0; x < rooms; x++)
+		{
+			for (int z = 0; z < rooms; z++)
+			{
+				for (int floor = 0; floor < 3; floor++)
+				{
+					const float corner[3] = { x * 10.0f, floor * 3.0f, z * 10.0f };
+					const float alongX[3] = { 10.0f, 0.0f, 0.0f }, alongZ[3] = { 0.0f, 0.0f, 10.0f }, up[3] = { 0.0f, 3.0f, 0.0f };
+					addQuad(mesh, corner, alongX, alongZ);
+					addQuad(mesh, corner, alongX, up);
+					addQuad(mesh, corner, alongZ, up);
+				}
+				for (int c = 0; c < clutter; c++)
+				{
+					const float size = 0.05f + 0.2f * unit(rng);
+					const float corner[3] = { x * 10.0f + unit(rng) * 10.0f, unit(rng) * 9.0f, z * 10.0f + unit(rng) * 10.0f };
+					const float a[3] = { size, 0.0f, 0.0f }, b[3] = { 0.0f, size, 0.0f };
+					addQuad(mesh, corner, a, b);
+				}
+			}
+		}
+		const int segments = 2 * sphereRings;
+		for (int row = 0; row < rooms; row++)
+		{
+			const float center[3] = { row * 10.0f + 5.0f, 4.5f, rooms * 5.0f };
+			const UINT32 base = static_cast<UINT32>(mesh.vertices.size() / 3);
+			for (int a = 0; a <= sphereRings; a++)
+			{
+				for (int b = 0; b <= segments; b++)
+				{
+					const float theta = 3.14159265f * a / sphereRings, phi = 6.2831853f * b / segments;
+					const float radius = 2.0f + 0.1f * sinf(7.0f * theta) * cosf(9.0f * phi);
+					mesh.vertices.push_back(center[0] + radius * sinf(theta) * cosf(phi));
+					mesh.vertices.push_back(center[1] + radius * cosf(theta));
+					mesh.vertices.push_back(center[2] + radius * sinf(theta) * sinf(phi));
+				}
+			}
+			for (int a = 0; a < sphereRings; a++)
+			{
+				for (int b = 0; b < segments; b++)
+				{
+					const UINT32 p = base + a * (segments + 1) + b, q = p + segments + 1;
+					mesh.indices.insert(mesh.indices.end(), { p, q, p + 1, p + 1, q, q + 1 });
+				}
+			}
+		}
+		return mesh;
+	}
+
+	// Small random triangles in a cube, the case the binned SAH is tuned for
+	BenchMesh soupMesh(size_t triangles, unsigned seed)
+	{
+		BenchMesh mesh;
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(0.0f, 100.0f), offset(-1.0f, 1.0f);
+		for (size_t t = 0; t < triangles; t++)
+		{
+			const float center[3] = { position(rng), position(rng), position(rng) };
+			for (int k = 0; k < 3; k++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+					mesh.vertices.push_back(center[axis] + offset(rng));
+				mesh.indices.push_back(static_cast<UINT32>(3 * t + k));
+			}
+		}
+		return mesh;
+	}
+
+	// Long, thin triangles spanning the scene, where object splits overlap the most
+	BenchMesh sliverMesh(size_t triangles, unsigned seed)
+	{
+		BenchMesh mesh;
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(0.0f, 100.0f);
+		for (size_t t = 0; t < triangles; t++)
+		{
+			const float a[3] = { position(rng), position(rng), position(rng) };
+			const float b[3] = { position(rng), position(rng), position(rng) };
+			mesh.vertices.insert(mesh.vertices.end(), { a[0], a[1], a[2], b[0], b[1], b[2], b[0] + 0.3f, b[1] + 0.1f, b[2] });
+			mesh.indices.insert(mesh.indices.end(), { static_cast<UINT32>(3 * t), static_cast<UINT32>(3 * t + 1), static_cast<UINT32>(3 * t + 2) });
+		}
+		return mesh;
+	}
+
+	// Around the y axis, walls that are no longer axis aligned get large, overlapping boxes
+	BenchMesh rotatedMesh(BenchMesh mesh, float angle)
+	{
+		const float c = cosf(angle), s = sinf(angle);
+		for (size_t k = 0; k < mesh.vertices.size(); k += 3)
+		{
+			const float x = mesh.vertices[k], z = mesh.vertices[k + 2];
+			mesh.vertices[k] = c * x - s * z;
+			mesh.vertices[k + 2] = s * x + c * z;
+		}
+		return mesh;
+	}
+
+	WRay makeRay(float ox, float oy, float oz, float dx, float dy, float dz)
+	{
+		WRay ray;
+		const float length = sqrtf(dx * dx + dy * dy + dz * dz);
+		ray.origin = { ox, oy, oz };
+		ray.direction = { dx / length, dy / length, dz / length };
+		return ray;
+	}
+
+	// Rays through the scene box in random directions, half of them shortened to test
+	// the tMax clipping of the traversal
+	std::vector<WRay> randomRays(const BenchMesh& mesh, size_t count, unsigned seed)
+	{
+		float lower[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, upper[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			lower[i % 3] = (std::min)(lower[i % 3], mesh.vertices[i]);
+			upper[i % 3] = (std::max)(upper[i % 3], mesh.vertices[i]);
+		}
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f), signedUnit(-1.0f, 1.0f);
+		std::vector<WRay> rays;
+		for (size_t i = 0; i < count; i++)
+		{
+			WRay ray = makeRay(lower[0] + unit(rng) * (upper[0] - lower[0]), lower[1] + unit(rng) * (upper[1] - lower[1]),
+				lower[2] + unit(rng) * (upper[2] - lower[2]), signedUnit(rng), signedUnit(rng), signedUnit(rng));
+			if (i % 2)
+				ray.tMax = unit(rng) * 20.0f;
+			rays.push_back(ray);
+		}
+		return rays;
+	}
+
+	// Directions along the axes, with +-0 components, from origins on the room grid where
+	// bounds and origin coordinates coincide, and from origins in between
+	std::vector<WRay> axisParallelRays(int rooms, size_t count, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<WRay> rays;
+		for (size_t i = 0; i < count; i++)
+		{
+			float origin[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const float extent = axis == 1 ? 9.0f : rooms * 10.0f;
+				origin[axis] = (i % 3 == 0) ? 0.0f : (i % 3 == 1) ? std::floor(unit(rng) * extent) : unit(rng) * extent;
+			}
+			float direction[3] = { (i & 8) ? -0.0f : 0.0f, (i & 16) ? -0.0f : 0.0f, (i & 32) ? -0.0f : 0.0f };
+			direction[(i / 3) % 3] = (i & 4) ? -1.0f : 1.0f;
+			WRay ray;
+			ray.origin = { origin[0], origin[1], origin[2] };
+			ray.direction = { direction[0], direction[1], direction[2] };
+			rays.push_back(ray);
+		}
+		return rays;
+	}
+
+	// Every triangle, the reference for the trees
+	bool bruteForceIntersect(const WBvhMesh& mesh, const WRay& ray, WRayHit& hit)
+	{
+		bool found = false;
+		WRay clipped = ray;
+		for (UINT32 triangle = 0; triangle < mesh.triangleCount; triangle++)
+		{
+			const UINT32* corner = &mesh.indices[3 * static_cast<size_t>(triangle)];
+			float t, u, v;
+			if (!intersectTriangle(clipped, &mesh.vertices[3 * static_cast<size_t>(corner[0])],
+				&mesh.vertices[3 * static_cast<size_t>(corner[1])], &mesh.vertices[3 * static_cast<size_t>(corner[2])], t, u, v))
+				continue;
+			clipped.tMax = t;
+			hit.t = t;
+			hit.triangle = triangle;
+			hit.u = u;
+			hit.v = v;
+			found = true;
+		}
+		return found;
+	}
+
+	// Triangles sharing an edge may both report the closest distance, so hits are compared
+	// by distance
+	bool sameHit(bool found, const WRayHit& hit, bool expectedFound, const WRayHit& expected)
+	{
+		if (found != expectedFound)
+			return false;
+		return !found || std::fabs(hit.t - expected.t) <= 1e-5f * (std::max)(1.0f, expected.t);
+	}
+
+	// Rays whose result differs from the reference in closest hit or occlusion
+	template<typename Bvh>
+	size_t countMismatches(const Bvh& bvh, const std::vector<WRay>& rays, const std::vector<WRayHit>& expected)
+	{
+		size_t mismatches = 0;
+		for (size_t k = 0; k < rays.size(); k++)
+		{
+			WRayHit hit;
+			bool found = bvh.intersect(rays[k], hit);
+			if (!sameHit(found, hit, expected[k].hit(), expected[k]) || bvh.occluded(rays[k]) != expected[k].hit())
+				mismatches++;
+		}
+		return mismatches;
+	}
+
+	template<typename Bvh>
+	double megaRaysPerSecond(const Bvh& bvh, const std::vector<WRay>& rays)
+	{
+		size_t hits = 0;
+		double seconds = benchSeconds([&]() {
+			for (const auto& ray : rays)
+			{
+				WRayHit hit;
+				hits += bvh.intersect(ray, hit) ? 1 : 0;
+			}
+		});
+		return hits > 0 ? rays.size() / seconds * 1e-6 : 0.0;
+	}
+
+	// Every triangle in exactly one leaf (more than one with spatial splits), and every box
+	// containing the boxes below it and the triangles of its leaves
+	bool validTree(const WBvh& bvh)
+	{
+		const auto& nodes = bvh.nodes();
+		const auto& triangles = bvh.triangles();
+		const WBvhMesh& mesh = bvh.mesh();
+		std::vector<UINT32> references(mesh.triangleCount, 0);
+		for (UINT32 triangle : triangles)
+		{
+			if (triangle >= mesh.triangleCount)
+				return false;
+			references[triangle]++;
+		}
+		for (UINT32 count : references)
+		{
+			if (count == 0 || (count > 1 && bvh.stats().spatialSplits == 0))
+				return false;
+		}
+		auto inside = [](const WBvhNode& outer, const float* lower, const float* upper) {
+			return outer.boundsMin.x <= lower[0] && outer.boundsMin.y <= lower[1] && outer.boundsMin.z <= lower[2] &&
+				outer.boundsMax.x >= upper[0] && outer.boundsMax.y >= upper[1] && outer.boundsMax.z >= upper[2];
+		};
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const WBvhNode& node = nodes[i];
+			if (!node.isLeaf())
+			{
+				const WBvhNode& left = nodes[i + 1];
+				const WBvhNode& right = nodes[node.firstOrRight];
+				if (!inside(node, &left.boundsMin.x, &left.boundsMax.x) || !inside(node, &right.boundsMin.x, &right.boundsMax.x))
+					return false;
+				continue;
+			}
+			// Spatial splits clip the triangles to the leaf, only the clipped part is inside
+			if (bvh.stats().spatialSplits > 0)
+				continue;
+			for (UINT32 k = 0; k < node.count; k++)
+			{
+				const UINT32* corner = &mesh.indices[3 * static_cast<size_t>(triangles[node.firstOrRight + k])];
+				for (int c = 0; c < 3; c++)
+				{
+					const float* vertex = &mesh.vertices[3 * static_cast<size_t>(corner[c])];
+					if (!inside(node, vertex, vertex))
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Walks both trees together: the decoded child boxes must contain the exact ones, and the
+	// leaves must hold the same triangles
+	bool compressedContainsWide(const WBvh8& wide, const WBvh8Compressed& compressed)
+	{
+		std::vector<std::pair<UINT32, UINT32>> pending = { { 0u, 0u } };
+		while (!pending.empty())
+		{
+			const WBvh8Node& node = wide.nodes()[pending.back().first];
+			const WBvh8CompressedNode& packed = compressed.nodes()[pending.back().second];
+			pending.pop_back();
+			UINT32 nextChild = packed.childBase, nextTriangle = packed.triangleBase;
+			for (UINT32 i = 0; i < WBvh8::Width; i++)
+			{
+				if (node.child[i] == WBvh8::EmptySlot)
+				{
+					if ((packed.innerMask & (1u << i)) || packed.leafCount[i] != 0)
+						return false;
+					continue;
+				}
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const float step = ldexpf(1.0f, packed.exponent[axis]);
+					if (packed.origin[axis] + packed.lower[axis][i] * step > node.bounds[2 * axis][i] ||
+						packed.origin[axis] + packed.upper[axis][i] * step < node.bounds[2 * axis + 1][i])
+						return false;
+				}
+				if (node.count[i] == 0)
+				{
+					if (!(packed.innerMask & (1u << i)))
+						return false;
+					pending.push_back({ node.child[i], nextChild++ });
+					continue;
+				}
+				if (packed.leafCount[i] != node.count[i] ||
+					!std::equal(&wide.triangles()[node.child[i]], &wide.triangles()[node.child[i]] + node.count[i], &compressed.triangles()[nextTriangle]))
+					return false;
+				nextTriangle += node.count[i];
+			}
+		}
+		return true;
+	}
+
+	std::vector<WSIMD_PATH> supportedPaths()
+	{
+		std::vector<WSIMD_PATH> paths = { SIMD_PATH_SCALAR, SIMD_PATH_SSE };
+		if (cpuSupportsAvx2())
+			paths.push_back(SIMD_PATH_AVX2);
+		return paths;
+	}
+}
+
+void benchWideBvh(WBenchContext& ctx)
+{
+	const int rooms = static_cast<int>(ctx.size(24, 4));
+	BenchMesh mesh = roomsMesh(rooms, 40, static_cast<int>(ctx.size(100, 12)));
+	const WBvhMesh view = mesh.view();
+	WBvh bvh;
+	bvh.build(view);
+	WBvh8 wide;
+	wide.build(bvh);
+	ctx.report("triangles", static_cast<double>(mesh.triangleCount()), "");
+	ctx.report("children per node", wide.stats().averageChildren, "");
+
+	const std::vector<WRay> rays = randomRays(mesh, ctx.size(4000, 1000), 3);
+	const std::vector<WRay> axisRays = axisParallelRays(rooms, ctx.size(4000, 1000), 4);
+	std::vector<WRayHit> expected(rays.size()), axisExpected(axisRays.size());
+	for (size_t k = 0; k < rays.size(); k++)
+		bruteForceIntersect(view, rays[k], expected[k]);
+	for (size_t k = 0; k < axisRays.size(); k++)
+		bruteForceIntersect(view, axisRays[k], axisExpected[k]);
+
+	ctx.check(countMismatches(bvh, rays, expected) == 0, "binary BVH matches brute force");
+	for (WSIMD_PATH path : supportedPaths())
+	{
+		wide.setPath(path);
+		const std::string name = simdPathName(path);
+		ctx.check(countMismatches(wide, rays, expected) == 0, name + " wide BVH matches brute force");
+		ctx.check(countMismatches(wide, axisRays, axisExpected) == 0, name + " wide BVH matches brute force on axis parallel rays");
+	}
+
+	const std::vector<WRay> timedRays = randomRays(mesh, ctx.size(400000, 20000), 5);
+	ctx.report("binary", megaRaysPerSecond(bvh, timedRays), "Mrays/s");
+	for (WSIMD_PATH path : supportedPaths())
+	{
+		wide.setPath(path);
+		ctx.report(std::string("wide ") + simdPathName(path), megaRaysPerSecond(wide, timedRays), "Mrays/s");
+	}
+}
+
+void benchBinnedBvh(WBenchContext& ctx)
+{
+	const BenchMesh meshes[] = { soupMesh(ctx.size(1000000, 20000), 1), roomsMesh(static_cast<int>(ctx.size(24, 4)), 40, static_cast<int>(ctx.size(100, 12))) };
+	const char* names[] = { "soup", "rooms" };
+	for (int m = 0; m < 2; m++)
+	{
+		const WBvhMesh view = meshes[m].view();
+		ctx.report(std::string(names[m]) + " triangles", static_cast<double>(view.triangleCount), "");
+		for (UINT32 bins : { 8u, 16u, 32u })
+		{
+			WBvhBuildOptions options;
+			options.binCount = bins;
+			WBvh bvh;
+			bvh.build(view, options);
+			const std::string name = std::string(names[m]) + " " + std::to_string(bins) + " bins";
+			ctx.report(name + " build", bvh.stats().mtrisPerSecond(), "Mtris/s");
+			ctx.report(name + " SAH cost", bvh.stats().sahCost, "");
+			ctx.check(validTree(bvh), name + " tree holds every triangle once inside its boxes");
+		}
+
+		// One task for the whole tree, the speedup of the parallel build
+		WBvhBuildOptions serial;
+		serial.parallelThreshold = ~0u;
+		WBvh serialBvh, bvh;
+		serialBvh.build(view, serial);
+		bvh.build(view);
+		ctx.report(std::string(names[m]) + " parallel build speedup", serialBvh.stats().buildSeconds / bvh.stats().buildSeconds, "x");
+		ctx.check(serialBvh.stats().sahCost == bvh.stats().sahCost, std::string(names[m]) + " parallel build gives the serial tree");
+
+		const std::vector<WRay> rays = randomRays(meshes[m], ctx.size(1000, 300), 7);
+		std::vector<WRayHit> expected(rays.size());
+		for (size_t k = 0; k < rays.size(); k++)
+			bruteForceIntersect(view, rays[k], expected[k]);
+		ctx.check(countMismatches(bvh, rays, expected) == 0, std::string(names[m]) + " BVH matches brute force");
+		ctx.report(std::string(names[m]) + " closest hit", megaRaysPerSecond(bvh, randomRays(meshes[m], ctx.size(200000, 20000), 8)), "Mrays/s");
+	}
+
+	// Scene buffers with a mesh, a deduplicated copy and an LOD level in a second slice
+	const BenchMesh& mesh = meshes[1];
+	std::vector<float> vertexBuffer = mesh.vertices;
+	std::vector<UINT32> indexBuffer = mesh.indices;
+	vertexBuffer.insert(vertexBuffer.end(), mesh.vertices.begin(), mesh.vertices.end());
+	indexBuffer.insert(indexBuffer.end(), mesh.indices.begin(), mesh.indices.begin() + mesh.indices.size() / 2);
+	WGeometryRecord record;
+	record.vertexCount = static_cast<UINT32>(mesh.vertices.size() / 3);
+	record.indexCount = static_cast<UINT32>(mesh.indices.size());
+	WGeometryRecord lod = record;
+	lod.vertexOffsetInBytes = mesh.vertices.size() * sizeof(float);
+	lod.indexOffsetInBytes = mesh.indices.size() * sizeof(UINT32);
+	lod.indexCount = static_cast<UINT32>(mesh.indices.size() / 2);
+	const std::map<std::string, WGeometryRecord> geometryMap = { { "rooms.obj", record }, { "copy.obj", record }, { "rooms.obj|lod1", lod } };
+	WGeometryBvhSet set;
+	buildGeometryBvhs(geometryMap, { "rooms.obj", "copy.obj", "rooms.obj|lod1" }, WBufferView<float>(vertexBuffer), WBufferView<UINT32>(indexBuffer), set);
+	ctx.check(set.bvhs.size() == 2 && set.find("rooms.obj") == set.find("copy.obj"), "geometries sharing a slice share the BVH");
+	ctx.check(set.find("rooms.obj|lod1") && set.find("rooms.obj|lod1")->stats().triangles == lod.indexCount / 3, "listed LOD levels get a BVH");
+}
+
+void benchSpatialSplits(WBenchContext& ctx)
+{
+	const BenchMesh meshes[] = { sliverMesh(ctx.size(20000, 3000), 7), rotatedMesh(roomsMesh(static_cast<int>(ctx.size(24, 4)), 40, 12), 0.3f) };
+	const char* names[] = { "slivers", "rotated rooms" };
+	// Every sliver ray passes through most of the scene
+	const size_t timedRayCounts[] = { ctx.size(5000, 1000), ctx.size(200000, 20000) };
+	for (int m = 0; m < 2; m++)
+	{
+		const WBvhMesh view = meshes[m].view();
+		WBvhBuildOptions options;
+		WBvh objectBvh, spatialBvh;
+		objectBvh.build(view, options);
+		options.spatialSplits = true;
+		spatialBvh.build(view, options);
+
+		const std::string name = names[m];
+		const WBvhStats& object = objectBvh.stats();
+		const WBvhStats& spatial = spatialBvh.stats();
+		ctx.report(name + " triangles", static_cast<double>(view.triangleCount), "");
+		ctx.report(name + " SAH cost object / spatial", object.sahCost / spatial.sahCost, "x");
+		ctx.report(name + " overlap object", object.overlap, "");
+		ctx.report(name + " overlap spatial", spatial.overlap, "");
+		ctx.report(name + " spatial splits", static_cast<double>(spatial.spatialSplits), "");
+		ctx.report(name + " duplicated references", static_cast<double>(spatial.duplicatedReferences()) / spatial.triangles, "per triangle");
+		ctx.report(name + " build time spatial / object", spatial.buildSeconds / object.buildSeconds, "x");
+		ctx.check(spatial.spatialSplits > 0, name + " spatial splits are taken");
+		ctx.check(spatial.sahCost <= object.sahCost, name + " spatial splits lower the SAH cost");
+		ctx.check(spatial.references <= static_cast<size_t>(spatial.triangles * (1.0 + options.maxDuplication)) + 1,
+			name + " duplication stays within maxDuplication");
+		ctx.check(validTree(spatialBvh), name + " SBVH references every triangle inside nested boxes");
+
+		const std::vector<WRay> rays = randomRays(meshes[m], ctx.size(1000, 300), 11);
+		std::vector<WRayHit> expected(rays.size());
+		for (size_t k = 0; k < rays.size(); k++)
+			bruteForceIntersect(view, rays[k], expected[k]);
+		ctx.check(countMismatches(spatialBvh, rays, expected) == 0, name + " SBVH matches brute force");
+
+		const std::vector<WRay> timedRays = randomRays(meshes[m], timedRayCounts[m], 12);
+		ctx.report(name + " object closest hit", megaRaysPerSecond(objectBvh, timedRays), "Mrays/s");
+		ctx.report(name + " spatial closest hit", megaRaysPerSecond(spatialBvh, timedRays), "Mrays/s");
+	}
+}
+
+void benchCompressedBvh(WBenchContext& ctx)
+{
+	const int rooms = static_cast<int>(ctx.size(24, 4));
+	BenchMesh mesh = roomsMesh(rooms, 40, static_cast<int>(ctx.size(100, 12)));
+	const WBvhMesh view = mesh.view();
+	WBvh bvh;
+	bvh.build(view);
+	WBvh8 wide;
+	wide.build(bvh);
+	WBvh8Compressed compressed;
+	ctx.check(compressed.build(wide), "compressed build succeeds");
+	ctx.check(compressedContainsWide(wide, compressed), "decoded boxes contain the exact ones, leaves keep their triangles");
+	ctx.report("wide", wide.memoryBytes() / (1024.0 * 1024.0), "MB");
+	ctx.report("compressed", compressed.memoryBytes() / (1024.0 * 1024.0), "MB");
+	ctx.check(compressed.memoryBytes() * 2 < wide.memoryBytes(), "compressed nodes take less than half the memory");
+
+	const std::vector<WRay> rays = randomRays(mesh, ctx.size(4000, 1000), 13);
+	const std::vector<WRay> axisRays = axisParallelRays(rooms, ctx.size(4000, 1000), 14);
+	std::vector<WRayHit> expected(rays.size()), axisExpected(axisRays.size());
+	for (size_t k = 0; k < rays.size(); k++)
+		wide.intersect(rays[k], expected[k]);
+	for (size_t k = 0; k < axisRays.size(); k++)
+		wide.intersect(axisRays[k], axisExpected[k]);
+	for (WSIMD_PATH path : supportedPaths())
+	{
+		compressed.setPath(path);
+		const std::string name = simdPathName(path);
+		ctx.check(countMismatches(compressed, rays, expected) == 0, name + " compressed BVH hits what the wide BVH hits");
+		ctx.check(countMismatches(compressed, axisRays, axisExpected) == 0, name + " compressed BVH hits what the wide BVH hits on axis parallel rays");
+	}
+
+	const std::vector<WRay> timedRays = randomRays(mesh, ctx.size(400000, 20000), 15);
+	for (WSIMD_PATH path : supportedPaths())
+	{
+		wide.setPath(path);
+		compressed.setPath(path);
+		ctx.report(std::string("wide ") + simdPathName(path), megaRaysPerSecond(wide, timedRays), "Mrays/s");
+		ctx.report(std::string("compressed ") + simdPathName(path), megaRaysPerSecond(compressed, timedRays), "Mrays/s");
+	}
+}
@@ -0,0 +1,257 @@
+#include "WBench.h"
+#include "../Utils/WGeometryPageStore.h"
+#include "../Utils/WSceneDescParser.h"
+#include <vector>
+#include <random>
+#include <fstream>
+#include <filesystem>
+
+namespace
+{
+	// Word i of the section, so any read can be checked without a copy of the section
+	inline UINT32 pageWord(UINT64 i)
+	{
+		return static_cast<UINT32>(i * 2654435761ull) ^ static_cast<UINT32>(i >> 32);
+	}
+
+	bool writePagedCache(const std::string& filename, UINT64 words)
+	{
+		std::vector<UINT32> section(static_cast<size_t>(words));
+		for (UINT64 i = 0; i < words; i++)
+			section[static_cast<size_t>(i)] = pageWord(i);
+		WSceneCacheWriter writer;
+		writer.addSection(CACHE_VERTEX_BUFFER, section);
+		return writer.Write(filename, 0);
+	}
+
+	bool sameWords(const std::vector<UINT32>& words, UINT64 first)
+	{
+		for (size_t i = 0; i < words.size(); i++)
+			if (words[i] != pageWord(first + i))
+				return false;
+		return true;
+	}
+
+	// One object per OBJ, each a grid with normals and texcoords one quad wider than the last
+	void writePagedScene(const std::string& sceneName, const std::vector<std::string>& objNames, size_t quads)
+	{
+		std::ofstream scene(sceneName, std::ios::binary);
+		scene << "<scene>\n";
+		for (size_t m = 0; m < objNames.size(); m++)
+		{
+			const size_t n = quads + m;
+			std::ofstream obj(objNames[m], std::ios::binary);
+			for (size_t z = 0; z <= n; z++)
+				for (size_t x = 0; x <= n; x++)
+					obj << "v " << x << " " << (x * z + m) % 7 << " " << z << "\nvn 0 1 0\nvt " << x / float(n) << " "
+						<< z / float(n) << "\n";
+			for (size_t z = 0; z < n; z++)
+				for (size_t x = 0; x < n; x++)
+				{
+					const size_t a = z * (n + 1) + x + 1, b = a + 1, c = a + n + 1, d = c + 1;
+					obj << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << b << "/" << b << "/" << b
+						<< "\nf " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+				}
+			scene << "\t<object name=\"paged_" << m << "\">\n\t\t<Material name=\"paged_" << m << "\">\n\t\t</Material>\n"
+				"\t\t<Mesh>\n\t\t\t<geometry>" << objNames[m] << "</geometry>\n\t\t</Mesh>\n\t</object>\n";
+		}
+		scene << "</scene>\n";
+	}
+
+	struct GeometrySection
+	{
+		UINT32 id;
+		const char* data;
+		UINT64 bytes;
+	};
+
+	template<typename T>
+	GeometrySection geometrySection(UINT32 id, const WBufferView<T>& view)
+	{
+		return { id, reinterpret_cast<const char*>(view.data()), view.size() * sizeof(T) };
+	}
+
+	std::vector<GeometrySection> geometrySections(const WSceneDescParser& parser)
+	{
+		return {
+			geometrySection(CACHE_VERTEX_BUFFER, parser.getVertexBuffer()),
+			geometrySection(CACHE_NORMAL_BUFFER, parser.getNormalBuffer()),
+			geometrySection(CACHE_TEXCOORD_BUFFER, parser.getTexCoordBuffer()),
+			geometrySection(CACHE_PACKED_NORMAL_BUFFER, parser.getPackedNormalBuffer()),
+			geometrySection(CACHE_PACKED_TEXCOORD_BUFFER, parser.getPackedTexCoordBuffer()),
+			geometrySection(CACHE_VERTEX_ATTRIBUTE_BUFFER, parser.getVertexAttributeBuffer()),
+			geometrySection(CACHE_PACKED_VERTEX_ATTRIBUTE_BUFFER, parser.getPackedVertexAttributeBuffer()),
+			geometrySection(CACHE_INDEX_BUFFER, parser.getIndexBuffer()),
+			geometrySection(CACHE_NORMAL_INDEX_BUFFER, parser.getNormalIndexBuffer()),
+			geometrySection(CACHE_TEXCOORD_INDEX_BUFFER, parser.getTexCoordIndexBuffer()),
+			geometrySection(CACHE_MATERIAL_ID_BUFFER, parser.getMaterialIdBuffer())
+		};
+	}
+
+	// The paged parser's cache holds exactly the buffers an in-memory load builds
+	bool samePagedGeometry(const WSceneDescParser& reference, WSceneDescParser& paged)
+	{
+		if (!paged.isGeometryPaged() || paged.getGeometryMap().size() != reference.getGeometryMap().size())
+			return false;
+		for (const auto& gItem : reference.getGeometryMap())
+		{
+			const auto& g = paged.getGeometryMap().at(gItem.first);
+			if (g.vertexOffsetInBytes != gItem.second.vertexOffsetInBytes || g.indexOffsetInBytes != gItem.second.indexOffsetInBytes ||
+				g.normalOffsetInBytes != gItem.second.normalOffsetInBytes || g.texCoordOffsetInBytes != gItem.second.texCoordOffsetInBytes)
+				return false;
+		}
+		auto& pages = paged.getGeometryPages();
+		std::vector<char> bytes;
+		for (const GeometrySection& section : geometrySections(reference))
+		{
+			bytes.resize(static_cast<size_t>(section.bytes));
+			if (pages.sectionSize(section.id) != section.bytes ||
+				(section.bytes > 0 && (!pages.read(section.id, 0, bytes.data(), section.bytes) ||
+					memcmp(bytes.data(), section.data, bytes.size()) != 0)))
+				return false;
+		}
+		return true;
+	}
+
+	// A cache miss with paging streams the geometry into the cache in batches of the budget,
+	// a second load pages it from there. Welded and quantized, then separate float streams.
+	void checkStreamedCache(WBenchContext& ctx)
+	{
+		const UINT64 budget = 256 * 1024;
+		const std::string sceneName = ctx.tempPath("paged_scene.xml");
+		std::vector<std::string> objNames;
+		for (size_t m = 0; m < ctx.size(24, 12); m++)
+			objNames.push_back(ctx.tempPath("paged_" + std::to_string(m) + ".obj"));
+		writePagedScene(sceneName, objNames, 40);
+		for (bool welded : { true, false })
+		{
+			const std::string name = welded ? "welded" : "unwelded";
+			auto configure = [&](WSceneDescParser& parser) {
+				parser.setWeldVertices(welded);
+				parser.setQuantizeAttributes(welded);
+			};
+			WSceneDescParser reference;
+			configure(reference);
+			reference.setUseSceneCache(false);
+			ctx.check(reference.Parse(sceneName.c_str()), name + " scene parses in memory");
+			const UINT64 geometryBytes = reference.memoryBytes();
+
+			std::error_code ec;
+			std::filesystem::remove(sceneName + ".wcache", ec);
+			WSceneDescParser streamed;
+			configure(streamed);
+			streamed.setPagedGeometry(budget);
+			ctx.check(streamed.Parse(sceneName.c_str()) && !streamed.isLoadedFromCache(), name + " scene misses the cache");
+			ctx.check(geometryBytes > 4 * budget && samePagedGeometry(reference, streamed),
+				name + ": geometry streamed into the cache matches the in-memory buffers");
+			ctx.check(streamed.memoryBytes() <= budget, name + ": the streamed scene stays within the budget");
+
+			WSceneDescParser cached;
+			configure(cached);
+			cached.setPagedGeometry(budget);
+			ctx.check(cached.Parse(sceneName.c_str()) && cached.isLoadedFromCache() && samePagedGeometry(reference, cached),
+				name + ": the streamed cache loads and pages back");
+			std::filesystem::remove(sceneName + ".wcache", ec);
+		}
+		std::error_code ec;
+		for (const std::string& file : objNames)
+			std::filesystem::remove(file, ec);
+		std::filesystem::remove(sceneName, ec);
+	}
+}
+
+void benchGeometryPages(WBenchContext& ctx)
+{
+	// A scene eight times the resident budget
+	const UINT64 budget = ctx.size(32, 2) * 1024 * 1024;
+	const UINT64 words = 8 * budget / sizeof(UINT32);
+	const UINT64 sectionBytes = words * sizeof(UINT32);
+	const std::string filename = ctx.tempPath("pages.wcache");
+	if (!writePagedCache(filename, words))
+	{
+		ctx.check(false, "write " + filename);
+		return;
+	}
+
+	WGeometryPageStore pages;
+	ctx.check(pages.Open(filename, budget), "open " + filename);
+	ctx.check(pages.sectionSize(CACHE_VERTEX_BUFFER) == sectionBytes, "section size");
+	ctx.check(pages.stats().capacityPages == budget / WGeometryPageStore::PageSize, "capacity is the budget");
+
+	// Upload order: the whole section in staging-buffer sized chunks, every page faults once
+	const UINT64 chunkWords = 3 * WGeometryPageStore::PageSize / sizeof(UINT32) / 2;
+	std::vector<UINT32> chunk;
+	bool sequentialOk = true;
+	UINT64 maxResident = 0;
+	double seconds = benchSeconds([&] {
+		pages.resetStats();
+		for (UINT64 first = 0; first < words; first += chunkWords)
+		{
+			const size_t count = static_cast<size_t>((std::min)(chunkWords, words - first));
+			sequentialOk &= pages.read(CACHE_VERTEX_BUFFER, first * sizeof(UINT32), count, chunk) && sameWords(chunk, first);
+			maxResident = (std::max)(maxResident, pages.residentBytes());
+		}
+	});
+	ctx.check(sequentialOk, "sequential reads return the section");
+	ctx.check(maxResident <= budget, "sequential reads stay within the budget");
+	ctx.check(pages.stats().bytesStreamed <= sectionBytes + 2 * WGeometryPageStore::PageSize,
+		"sequential reads stream every page once");
+	ctx.report("sequential", sectionBytes / (1024.0 * 1024.0) / seconds, "MB/s");
+
+	// Mesh-sized reads all over the section, mostly faults since the set holds an eighth of it
+	std::mt19937_64 rng(19);
+	const UINT64 maxMeshWords = 64 * 1024;
+	bool randomOk = true;
+	maxResident = 0;
+	pages.resetStats();
+	UINT64 randomBytes = 0;
+	seconds = benchSeconds([&] {
+		for (size_t i = 0; i < ctx.size(4000, 400); i++)
+		{
+			const UINT64 count = 1 + rng() % maxMeshWords;
+			const UINT64 first = rng() % (words - count);
+			randomOk &= pages.read(CACHE_VERTEX_BUFFER, first * sizeof(UINT32), static_cast<size_t>(count), chunk) &&
+				sameWords(chunk, first);
+			maxResident = (std::max)(maxResident, pages.residentBytes());
+			randomBytes += count * sizeof(UINT32);
+		}
+	}, 1);
+	ctx.check(randomOk, "random reads return the section");
+	ctx.check(maxResident <= budget, "random reads stay within the budget");
+	ctx.report("random", randomBytes / (1024.0 * 1024.0) / seconds, "MB/s");
+	ctx.report("random fault rate", pages.stats().faultRate() * 100.0, "%");
+	ctx.report("random evictions", static_cast<double>(pages.stats().evictions), "pages");
+
+	// Hot set smaller than the budget: once warm every access hits. The first pass may still
+	// evict hot pages it hit before the clock cleared their reference bits.
+	const UINT64 hotWords = budget / 2 / sizeof(UINT32);
+	for (int pass = 0; pass < 2; pass++)
+		pages.read(CACHE_VERTEX_BUFFER, 0, static_cast<size_t>(hotWords), chunk);
+	pages.resetStats();
+	bool hotOk = true;
+	for (int pass = 0; pass < 4; pass++)
+		hotOk &= pages.read(CACHE_VERTEX_BUFFER, 0, static_cast<size_t>(hotWords), chunk) && sameWords(chunk, 0);
+	ctx.check(hotOk, "hot set reads return the section");
+	ctx.check(pages.stats().faults == 0, "a hot set within the budget stays resident");
+
+	// Pinned pages are never evicted, a full set of pins makes the next fault fail cleanly
+	const UINT64 capacity = pages.stats().capacityPages;
+	bool pinned = true;
+	for (UINT64 page = 0; page < capacity; page++)
+		pinned &= pages.pin(page) != nullptr;
+	ctx.check(pinned, "pin as many pages as the budget holds");
+	ctx.check(pages.pin(capacity) == nullptr, "no frame when every page is pinned");
+	pages.unpin(0);
+	ctx.check(pages.pin(capacity) != nullptr, "an unpinned page is recycled");
+	pages.unpin(capacity);
+	for (UINT64 page = 1; page < capacity; page++)
+		pages.unpin(page);
+
+	ctx.check(!pages.read(CACHE_VERTEX_BUFFER, sectionBytes - 4, chunk.data(), 8), "reads past the section fail");
+	ctx.check(!pages.read(CACHE_NORMAL_BUFFER, 0, chunk.data(), 4), "reads of a missing section fail");
+	pages.Close();
+	std::error_code ec;
+	std::filesystem::remove(filename, ec);
+
+	checkStreamedCache(ctx);
+}
@@ -0,0 +1,227 @@
+#include "WBench.h"
+#include "../Utils/WInstanceStore.h"
+#include "../Utils/WSceneDescParser.h"
+#include <vector>
+#include <map>
+#include <random>
+#include <cstring>
+
+namespace
+{
+	const int BenchFrameCount = 3;
+
+	// Per-instance record before the store: the parsed item carried its transform, indices and
+	// dirty count, so every walk strided over the names and LOD policy as well
+	struct AosInstance
+	{
+		WRenderItem record;
+		DirectX::XMFLOAT3X4 transform;
+		UINT32 matIdx = 0;
+		UINT32 geometryIdx = 0;
+		int numFramesDirty = 0;
+	};
+
+	// A tenth of the instances are render items at the hierarchy roots, the rest four instance batches
+	struct BenchScene
+	{
+		WSceneRegistry<WRenderItem> renderItems;
+		WTransformHierarchy hierarchy;
+		WInstanceTable instanceTable;
+		std::map<std::string, WGeometryRecord> geometryMap;
+	};
+
+	void makeScene(size_t count, BenchScene& scene)
+	{
+		const char* meshes[] = { "rock.obj", "tree.obj", "grass.obj", "house.obj" };
+		for (UINT32 g = 0; g < 4; g++)
+		{
+			WGeometryRecord record;
+			record.vertexOffsetInBytes = 1000 * g;
+			record.indexCount = 300 * (g + 1);
+			scene.geometryMap[meshes[g]] = record;
+			record.indexCount /= 2;
+			scene.geometryMap[lodGeometryName(meshes[g], 1)] = record;
+		}
+
+		std::mt19937 rng(13);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		const size_t itemCount = count / 10;
+		std::map<std::string, WRenderItem> items;
+		for (size_t i = 0; i < itemCount; i++)
+		{
+			WRenderItem r;
+			r.objName = "object_" + std::to_string(i);
+			r.objIdx = static_cast<UINT>(i);
+			r.matIdx = static_cast<UINT>(i % 7);
+			r.geometryName = meshes[i % 4];
+			r.lodSelected = i % 3 == 0 ? 1 : 0;
+			r.translation = DirectX::XMFLOAT3(position(rng), position(rng), position(rng));
+			r.transform = DirectX::XMMatrixTranslation(r.translation.x, r.translation.y, r.translation.z);
+			r.transformNode = scene.hierarchy.addNode(-1, r.objIdx, r.objName, r.transform);
+			scene.hierarchy.closeNode(r.transformNode);
+			items[r.objName] = r;
+		}
+		scene.hierarchy.update();
+		scene.renderItems.assign(items, [](const WRenderItem& r) { return r.objIdx; });
+
+		const size_t instanceCount = count - itemCount;
+		std::vector<float> values;
+		for (UINT32 b = 0; b < 4; b++)
+		{
+			WInstanceBatch batch;
+			batch.geometryName = meshes[b];
+			batch.matIdx = 7 + b;
+			batch.first = static_cast<UINT32>(scene.instanceTable.size());
+			batch.count = static_cast<UINT32>(b < 3 ? instanceCount / 4 : instanceCount - 3 * (instanceCount / 4));
+			values.clear();
+			for (UINT32 i = 0; i < batch.count; i++)
+				values.insert(values.end(), { position(rng), position(rng), position(rng), 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f });
+			scene.instanceTable.batches.push_back(batch);
+			appendInstances(scene.instanceTable, b, values.data(), batch.count, INSTANCE_FORMAT_TRS);
+		}
+	}
+
+	bool storeMatchesScene(const WInstanceStore& store, const BenchScene& scene)
+	{
+		const size_t items = scene.renderItems.size();
+		if (store.size() != items + scene.instanceTable.size() || store.editableCount() != items ||
+			store.matIdx.size() != store.size() || store.geometryIdx.size() != store.size() || store.dirty.size() != store.size())
+			return false;
+		for (size_t i = 0; i < items; i++)
+		{
+			const auto& r = scene.renderItems[i];
+			if (memcmp(&store.transforms[i], &scene.hierarchy.worlds[r.transformNode], sizeof(DirectX::XMFLOAT3X4)) != 0 ||
+				store.matIdx[i] != r.matIdx || store.transformNodes[i] != r.transformNode ||
+				store.geometryNames[store.geometryIdx[i]] != lodGeometryName(r.geometryName, r.lodSelected))
+				return false;
+		}
+		for (const auto& batch : scene.instanceTable.batches)
+			for (UINT32 k = 0; k < batch.count; k++)
+			{
+				const size_t i = items + batch.first + k;
+				if (memcmp(&store.transforms[i], &scene.instanceTable.transforms[batch.first + k], sizeof(DirectX::XMFLOAT3X4)) != 0 ||
+					store.matIdx[i] != batch.matIdx || store.geometryNames[store.geometryIdx[i]] != batch.geometryName)
+					return false;
+			}
+		for (size_t g = 0; g < store.geometries.size(); g++)
+			if (memcmp(&store.geometries[g], &scene.geometryMap.at(store.geometryNames[g]), sizeof(WGeometryRecord)) != 0)
+				return false;
+		for (UINT8 d : store.dirty)
+			if (d != BenchFrameCount)
+				return false;
+		return true;
+	}
+
+	// The UpdateObjectCBs part that depends on the layout: find the dirty instances, gather
+	// what their constants need and count the frame down
+	struct DirtyGather
+	{
+		std::vector<UINT32> indices;
+		std::vector<DirectX::XMFLOAT3X4> transforms;
+		std::vector<UINT32> matIdx;
+		std::vector<UINT32> geometryIdx;
+
+		void clear()
+		{
+			indices.clear();
+			transforms.clear();
+			matIdx.clear();
+			geometryIdx.clear();
+		}
+		bool operator==(const DirtyGather& rhs) const
+		{
+			return indices == rhs.indices && matIdx == rhs.matIdx && geometryIdx == rhs.geometryIdx &&
+				memcmp(transforms.data(), rhs.transforms.data(), transforms.size() * sizeof(DirectX::XMFLOAT3X4)) == 0;
+		}
+	};
+
+	void gatherStore(WInstanceStore& store, DirtyGather& gather)
+	{
+		gather.clear();
+		for (UINT32 i = 0; i < store.size(); i++)
+		{
+			if (store.dirty[i] == 0)
+				continue;
+			gather.indices.push_back(i);
+			gather.transforms.push_back(store.transforms[i]);
+			gather.matIdx.push_back(store.matIdx[i]);
+			gather.geometryIdx.push_back(store.geometryIdx[i]);
+			--store.dirty[i];
+		}
+	}
+
+	void gatherAos(std::vector<AosInstance>& instances, DirtyGather& gather)
+	{
+		gather.clear();
+		for (UINT32 i = 0; i < instances.size(); i++)
+		{
+			auto& instance = instances[i];
+			if (instance.numFramesDirty == 0)
+				continue;
+			gather.indices.push_back(i);
+			gather.transforms.push_back(instance.transform);
+			gather.matIdx.push_back(instance.matIdx);
+			gather.geometryIdx.push_back(instance.geometryIdx);
+			--instance.numFramesDirty;
+		}
+	}
+}
+
+void benchInstanceStore(WBenchContext& ctx)
+{
+	ctx.report("store", static_cast<double>(WInstanceStore::bytesPerInstance()), "B/instance");
+	ctx.report("store render item", static_cast<double>(WInstanceStore::bytesPerEditableInstance()), "B/instance");
+	ctx.report("array of records", static_cast<double>(sizeof(AosInstance)), "B/instance");
+
+	const std::vector<size_t> counts = ctx.quick() ? std::vector<size_t>{ 10000, 100000 } :
+		std::vector<size_t>{ 10000, 100000, 1000000 };
+	const int frames = static_cast<int>(ctx.size(50, 5));
+	for (size_t count : counts)
+	{
+		const std::string suffix = " " + std::to_string(count);
+		BenchScene scene;
+		makeScene(count, scene);
+		WInstanceStore store;
+		double seconds = benchSeconds([&] {
+			buildInstanceStore(scene.renderItems, scene.hierarchy, scene.instanceTable, scene.geometryMap,
+				BenchFrameCount, store);
+		});
+		ctx.report("build" + suffix, seconds * 1e3, "ms");
+		ctx.check(storeMatchesScene(store, scene), "store matches the items, hierarchy and instance table" + suffix);
+		ctx.report("store" + suffix, store.memoryBytes() / 1024.0, "KB");
+
+		std::vector<AosInstance> instances(store.size());
+		for (size_t i = 0; i < store.size(); i++)
+		{
+			if (i < scene.renderItems.size())
+				instances[i].record = scene.renderItems[i];
+			instances[i].transform = store.transforms[i];
+			instances[i].matIdx = store.matIdx[i];
+			instances[i].geometryIdx = store.geometryIdx[i];
+		}
+
+		// Frames of a settled scene with 1% of the instances moved, the same ones in both layouts
+		std::fill(store.dirty.begin(), store.dirty.end(), static_cast<UINT8>(0));
+		std::mt19937 rng(31);
+		std::vector<UINT32> moved(count / 100);
+		for (auto& i : moved)
+			i = static_cast<UINT32>(rng() % count);
+		DirtyGather storeGather, aosGather;
+		bool same = true;
+		double storeSeconds = 0.0, aosSeconds = 0.0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (UINT32 i : moved)
+			{
+				store.markDirty(i, 1);
+				instances[i].numFramesDirty = 1;
+			}
+			storeSeconds += benchSeconds([&] { gatherStore(store, storeGather); }, 1);
+			aosSeconds += benchSeconds([&] { gatherAos(instances, aosGather); }, 1);
+			same &= storeGather == aosGather;
+		}
+		ctx.report("dirty frame store" + suffix, storeSeconds / frames * 1e6, "us");
+		ctx.report("dirty frame array of records" + suffix, aosSeconds / frames * 1e6, "us");
+		ctx.check(same, "both layouts gather the same dirty instances" + suffix);
+	}
+}
@@ -0,0 +1,163 @@
+#include "WBench.h"
+#include "../Utils/WSceneDescParser.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <charconv>
+#include <fstream>
+#include <filesystem>
+#include <memory>
+#include <cstring>
+
+namespace
+{
+	// 9 TRS or 12 matrix floats per instance
+	std::vector<float> randomInstanceValues(size_t count, WINSTANCE_FORMAT format, UINT32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+		std::uniform_real_distribution<float> scale(0.25f, 4.0f);
+		std::vector<float> values;
+		values.reserve(count * instanceFormatStride(format));
+		for (size_t i = 0; i < count; i++)
+		{
+			if (format == INSTANCE_FORMAT_TRS)
+			{
+				for (int c = 0; c < 3; c++)
+					values.push_back(position(rng));
+				for (int c = 0; c < 3; c++)
+					values.push_back(angle(rng));
+				for (int c = 0; c < 3; c++)
+					values.push_back(scale(rng));
+			}
+			else
+			{
+				for (int c = 0; c < 12; c++)
+					values.push_back(c % 4 == 3 ? position(rng) : scale(rng));
+			}
+		}
+		return values;
+	}
+
+	// Inline values are written with the shortest text that reads back as the same float
+	bool writeInstanceScene(const std::string& filename, const std::vector<float>& values, WINSTANCE_FORMAT format,
+		const std::string& sidecarName)
+	{
+		std::ofstream scene(filename, std::ios::binary);
+		scene << "<scene>\n<Material name=\"bench\"/>\n<instances mesh=\"bench.obj\" material=\"bench\"";
+		scene << (format == INSTANCE_FORMAT_TRS ? " format=\"trs\"" : " format=\"matrix\"");
+		if (!sidecarName.empty())
+		{
+			scene << " file=\"" << sidecarName << "\"/>\n</scene>\n";
+			std::ofstream sidecar(sidecarName, std::ios::binary);
+			sidecar.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+			return sidecar.good() && scene.good();
+		}
+		scene << ">\n";
+		const UINT32 stride = instanceFormatStride(format);
+		std::string line;
+		char number[32];
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			auto result = std::to_chars(number, number + sizeof(number), values[i]);
+			line.append(number, result.ptr);
+			line += (i + 1) % stride == 0 ? '\n' : ' ';
+			if (line.size() > 64 * 1024)
+			{
+				scene << line;
+				line.clear();
+			}
+		}
+		scene << line << "</instances>\n</scene>\n";
+		return scene.good();
+	}
+
+	bool sameTable(const WInstanceTable& a, const WInstanceTable& b)
+	{
+		return a.size() == b.size() && a.batchIds == b.batchIds &&
+			memcmp(a.transforms.data(), b.transforms.data(), a.size() * sizeof(DirectX::XMFLOAT3X4)) == 0;
+	}
+
+	// Largest entry difference of the instance transforms against composeTRS, relative to the
+	// largest entry of each reference matrix
+	double maxComposeError(const WInstanceTable& table, const std::vector<float>& values)
+	{
+		double maxError = 0.0;
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			const float* v = &values[9 * i];
+			DirectX::XMFLOAT3X4 reference;
+			DirectX::XMStoreFloat3x4(&reference, composeTRS(DirectX::XMFLOAT3(v[0], v[1], v[2]),
+				DirectX::XMFLOAT3(v[3], v[4], v[5]), DirectX::XMFLOAT3(v[6], v[7], v[8])));
+			double diff = 0.0, scale = 0.0;
+			for (int r = 0; r < 3; r++)
+				for (int c = 0; c < 4; c++)
+				{
+					diff = (std::max)(diff, std::fabs(double(table.transforms[i].m[r][c]) - reference.m[r][c]));
+					scale = (std::max)(scale, std::fabs(double(reference.m[r][c])));
+				}
+			maxError = (std::max)(maxError, diff / scale);
+		}
+		return maxError;
+	}
+}
+
+void benchInstanceTable(WBenchContext& ctx)
+{
+	// The <instances> walk needs no geometry, ParseDescription skips loading the OBJ files
+	const std::vector<size_t> counts = ctx.quick() ? std::vector<size_t>{ 1000, 10000 } :
+		std::vector<size_t>{ 10000, 100000, 1000000 };
+	const std::string sceneName = ctx.tempPath("instances.xml");
+	const std::string sidecarName = ctx.tempPath("instances.bin");
+	for (size_t count : counts)
+	{
+		const std::string suffix = " " + std::to_string(count);
+		const std::vector<float> trs = randomInstanceValues(count, INSTANCE_FORMAT_TRS, 8);
+		const std::vector<float> matrices = randomInstanceValues(count, INSTANCE_FORMAT_MATRIX, 8);
+		WInstanceTable inlineTable;
+		struct Variant { const char* name; const std::vector<float>* values; WINSTANCE_FORMAT format; bool sidecar; };
+		const Variant variants[] = {
+			{ "inline trs", &trs, INSTANCE_FORMAT_TRS, false },
+			{ "sidecar trs", &trs, INSTANCE_FORMAT_TRS, true },
+			{ "inline matrix", &matrices, INSTANCE_FORMAT_MATRIX, false },
+			{ "sidecar matrix", &matrices, INSTANCE_FORMAT_MATRIX, true },
+		};
+		for (const Variant& variant : variants)
+		{
+			const std::string name = variant.name + suffix;
+			if (!writeInstanceScene(sceneName, *variant.values, variant.format, variant.sidecar ? sidecarName : ""))
+			{
+				ctx.check(false, "write " + sceneName);
+				return;
+			}
+			bool parsed = true;
+			std::unique_ptr<WSceneDescParser> parser;
+			double seconds = benchSeconds([&] {
+				parser = std::make_unique<WSceneDescParser>();
+				parsed &= parser->ParseDescription(sceneName.c_str());
+			});
+			const WInstanceTable& table = parser->getInstanceTable();
+			ctx.check(parsed && table.size() == count && table.batches.size() == 1, name + " parses every instance");
+			if (table.size() != count)
+				continue;
+			ctx.report(name, count / seconds * 1e-6, "M instances/s");
+			ctx.report(name + " table", static_cast<double>(table.memoryBytes()) / count, "B/instance");
+
+			if (variant.format == INSTANCE_FORMAT_MATRIX)
+				ctx.check(memcmp(table.transforms.data(), matrices.data(), count * sizeof(DirectX::XMFLOAT3X4)) == 0,
+					name + " keeps the matrices exactly");
+			else if (!variant.sidecar)
+				ctx.check(maxComposeError(table, trs) < 1e-5, name + " matches composeTRS");
+			// Shortest round trip text, inline and sidecar tables are bit identical
+			if (!variant.sidecar)
+				inlineTable = table;
+			else
+				ctx.check(sameTable(table, inlineTable), name + " matches the inline table");
+		}
+	}
+	ctx.report("WRenderItem per instance", static_cast<double>(sizeof(WRenderItem)), "B/instance");
+	std::error_code ec;
+	std::filesystem::remove(sceneName, ec);
+	std::filesystem::remove(sidecarName, ec);
+}
@@ -0,0 +1,168 @@
+#include "WBench.h"
+#include "../Utils/WSceneDescParser.h"
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <memory>
+
+namespace
+{
+	std::string materialName(size_t m)
+	{
+		return "material_" + std::to_string(m);
+	}
+
+	// "rows" rows of "quads" quads from z = "firstRow" on, no two rows share a vertex. With
+	// "usemtl" names, row i switches to usemtl[i] first.
+	std::string materialRows(size_t firstRow, size_t rows, size_t quads, const std::vector<std::string>& usemtl)
+	{
+		std::string obj;
+		size_t vertex = 1;
+		for (size_t row = 0; row < rows; row++)
+		{
+			if (!usemtl.empty())
+				obj += "usemtl " + usemtl[row] + "\n";
+			const std::string z = std::to_string(firstRow + row);
+			for (size_t x = 0; x <= quads; x++)
+				obj += "v " + std::to_string(x) + " 0 " + z + "\nv " + std::to_string(x) + " 0 " + z + ".5\n";
+			for (size_t x = 0; x < quads; x++, vertex += 2)
+			{
+				const std::string a = std::to_string(vertex), b = std::to_string(vertex + 1);
+				const std::string c = std::to_string(vertex + 2), d = std::to_string(vertex + 3);
+				obj += "f " + a + " " + b + " " + c + "\nf " + c + " " + b + " " + d + "\n";
+			}
+			vertex += 2;
+		}
+		return obj;
+	}
+
+	std::string materialElement(size_t m)
+	{
+		return "\t\t<Material name=\"" + materialName(m) + "\">\n\t\t\t<albedo>" + std::to_string((m % 10) / 10.0) +
+			",0.5,0.5,1</albedo>\n\t\t</Material>\n";
+	}
+
+	std::string objectElement(const std::string& name, const std::string& material, const std::string& geometry)
+	{
+		return "\t<object name=\"" + name + "\">\n" + material + "\t\t<Mesh>\n\t\t\t<geometry>" + geometry +
+			"</geometry>\n\t\t</Mesh>\n\t</object>\n";
+	}
+
+	// One OBJ switching between "materials" declared at the top level of the scene, and a last row
+	// using a material the scene does not declare, which falls back to the object's own material
+	void writeMergedScene(const std::string& sceneName, const std::string& objName, size_t materials, size_t quads)
+	{
+		std::vector<std::string> usemtl;
+		for (size_t m = 0; m < materials; m++)
+			usemtl.push_back(materialName(m));
+		usemtl.push_back("undeclared");
+		std::ofstream(objName, std::ios::binary) << materialRows(0, materials + 1, quads, usemtl);
+		std::ofstream scene(sceneName, std::ios::binary);
+		scene << "<scene>\n";
+		for (size_t m = 0; m < materials; m++)
+			scene << materialElement(m);
+		scene << objectElement("merged", "\t\t<Material name=\"object\">\n\t\t\t<albedo>1,1,1,1</albedo>\n\t\t</Material>\n",
+			objName) << "</scene>\n";
+	}
+
+	// The same rows as one OBJ and one object per material
+	void writeSplitScene(const std::string& sceneName, const std::vector<std::string>& objNames, size_t quads)
+	{
+		std::ofstream scene(sceneName, std::ios::binary);
+		scene << "<scene>\n";
+		for (size_t m = 0; m < objNames.size(); m++)
+		{
+			std::ofstream(objNames[m], std::ios::binary) << materialRows(m, 1, quads, {});
+			scene << objectElement("split_" + std::to_string(m), materialElement(m), objNames[m]);
+		}
+		scene << "</scene>\n";
+	}
+
+	// Loads the scene "repeats" times and reports what the renderer would build from it
+	std::unique_ptr<WSceneDescParser> loadScene(WBenchContext& ctx, const std::string& name, const std::string& sceneName)
+	{
+		std::unique_ptr<WSceneDescParser> parser;
+		bool parsed = true;
+		double seconds = benchSeconds([&] {
+			parser = std::make_unique<WSceneDescParser>();
+			parser->setUseSceneCache(false);
+			parsed &= parser->Parse(sceneName.c_str());
+		});
+		ctx.check(parsed, name + " scene parses");
+		ctx.report(name + " instances", static_cast<double>(parser->getRenderItems().size()), "");
+		ctx.report(name + " BLASes", static_cast<double>(parser->getGeometryMap().size()), "");
+		ctx.report(name + " load", seconds * 1e3, "ms");
+		return parser;
+	}
+
+	// The lookup of LoadMaterialIdx in HitCommon.hlsl
+	UINT32 loadMaterialIdx(const WBufferView<UINT32>& ids, UINT32 bits, INT64 offset, UINT32 triangle, UINT32 objectMaterial)
+	{
+		const UINT32 idsPerWord = 32 / bits;
+		const UINT64 id = static_cast<UINT64>(offset) + triangle;
+		const UINT32 mask = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+		const UINT32 matIdx = (ids[static_cast<size_t>(id / idsPerWord)] >> ((id % idsPerWord) * bits)) & mask;
+		return matIdx == mask ? objectMaterial : matIdx;
+	}
+
+	// Every triangle of the merged geometry resolves to its row's material, the undeclared row
+	// to the object's
+	void checkMergedIds(WBenchContext& ctx, const std::string& name, WSceneDescParser& parser, const std::string& objName,
+		size_t materials, size_t quads, UINT32 expectedBits)
+	{
+		auto& materialItems = parser.getMaterialItems();
+		const UINT32 bits = parser.getMaterialIdBits();
+		ctx.check(materialItems.size() == materials + 1 && bits == expectedBits,
+			name + " packs " + std::to_string(materials) + " materials into " + std::to_string(expectedBits) + "-bit ids");
+		const WGeometryRecord& geometry = parser.getGeometryMap().at(objName);
+		const UINT32 objectMaterial = materialItems.at("object").MatIdx;
+		const auto ids = parser.getMaterialIdBuffer();
+		const size_t trianglesPerRow = 2 * quads;
+		bool mapped = geometry.materialIdOffset >= 0 && geometry.indexCount == 3 * (materials + 1) * trianglesPerRow &&
+			ids.size() == (geometry.indexCount / 3 + 32 / bits - 1) / (32 / bits);
+		for (UINT32 t = 0; mapped && t < geometry.indexCount / 3; t++)
+		{
+			const size_t row = t / trianglesPerRow;
+			const UINT32 expected = row < materials ? materialItems.at(materialName(row)).MatIdx : objectMaterial;
+			mapped = loadMaterialIdx(ids, bits, geometry.materialIdOffset, t, objectMaterial) == expected;
+		}
+		ctx.check(mapped, name + " triangles map to their usemtl material");
+	}
+}
+
+void benchMaterialIds(WBenchContext& ctx)
+{
+	const size_t materials = 500;
+	const size_t quads = ctx.size(100, 4);
+	const std::string mergedScene = ctx.tempPath("materials_merged.xml"), mergedObj = ctx.tempPath("materials_merged.obj");
+	const std::string splitScene = ctx.tempPath("materials_split.xml");
+	std::vector<std::string> splitObjs;
+	for (size_t m = 0; m < materials; m++)
+		splitObjs.push_back(ctx.tempPath("materials_split_" + std::to_string(m) + ".obj"));
+	writeMergedScene(mergedScene, mergedObj, materials, quads);
+	writeSplitScene(splitScene, splitObjs, quads);
+
+	auto split = loadScene(ctx, "split", splitScene);
+	auto merged = loadScene(ctx, "merged", mergedScene);
+	ctx.check(split->getRenderItems().size() == materials && split->getGeometryMap().size() == materials,
+		"split: one instance and BLAS per material");
+	ctx.check(merged->getRenderItems().size() == 1 && merged->getGeometryMap().size() == 1,
+		"merged: one instance and BLAS for all materials");
+	bool splitMaterials = split->getMaterialIdBuffer().empty();
+	for (const auto& ritem : split->getRenderItems())
+		splitMaterials &= ritem.second.matIdx == split->getMaterialItems().at(ritem.second.materialName).MatIdx;
+	ctx.check(splitMaterials, "split objects keep their own material and no ids");
+	checkMergedIds(ctx, "merged", *merged, mergedObj, materials, quads, 16);
+
+	// Below 255 materials the ids pack four to a word
+	const size_t fewMaterials = 100;
+	writeMergedScene(mergedScene, mergedObj, fewMaterials, quads);
+	auto few = loadScene(ctx, "merged " + std::to_string(fewMaterials), mergedScene);
+	checkMergedIds(ctx, "merged " + std::to_string(fewMaterials), *few, mergedObj, fewMaterials, quads, 8);
+
+	std::error_code ec;
+	for (const std::string& file : splitObjs)
+		std::filesystem::remove(file, ec);
+	for (const std::string& file : { mergedScene, mergedObj, splitScene })
+		std::filesystem::remove(file, ec);
+}
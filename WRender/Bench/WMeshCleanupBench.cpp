@@ -0,0 +1,227 @@
+#include "WBench.h"
+#include "../Utils/WMeshOptimizer.h"
+#include <vector>
+#include <random>
+#include <array>
+#include <set>
+
+namespace
+{
+	// One triangle by value: corner positions, a flat normal, corner texcoords and its material
+	struct CleanupTriangle
+	{
+		std::array<float, 9> positions;
+		std::array<float, 3> normal;
+		std::array<float, 6> texCoords;
+		UINT32 material = 0;
+		// The corners share one position index instead of having their own copies
+		bool sharedCorner = false;
+
+		bool operator==(const CleanupTriangle& rhs) const
+		{
+			return positions == rhs.positions && normal == rhs.normal && texCoords == rhs.texCoords && material == rhs.material;
+		}
+	};
+
+	CleanupTriangle rotated(const CleanupTriangle& t, int by)
+	{
+		CleanupTriangle r = t;
+		for (int k = 0; k < 3; k++)
+			for (int c = 0; c < 3; c++)
+				r.positions[3 * k + c] = t.positions[3 * ((k + by) % 3) + c];
+		return r;
+	}
+
+	// Defects of STL and CAD exports mixed into a plate of "quads" x "quads" quads: duplicated
+	// faces (in any rotation, with their own vertex copies), faces with a repeated corner,
+	// corners at the same position, zero-area slivers, and attributes nothing references.
+	// Reversed copies are valid faces. "kept" receives the triangles cleanup has to keep.
+	struct CleanupMesh
+	{
+		WMeshData mesh;
+		std::vector<CleanupTriangle> kept;
+		size_t degenerate = 0;
+		size_t duplicates = 0;
+		size_t reversed = 0;
+	};
+
+	CleanupMesh makeCleanupMesh(UINT32 quads)
+	{
+		std::mt19937 rng(20);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<CleanupTriangle> triangles;
+		CleanupMesh result;
+		auto plateTriangle = [&](float x0, float z0, float x1, float z1, float x2, float z2) {
+			CleanupTriangle t;
+			t.positions = { x0, 0.0f, z0, x1, 0.0f, z1, x2, 0.0f, z2 };
+			t.normal = { 0.0f, 1.0f, 0.0f };
+			t.texCoords = { unit(rng), unit(rng), unit(rng), unit(rng), unit(rng), unit(rng) };
+			t.material = static_cast<UINT32>(rng() % 3);
+			return t;
+		};
+		for (UINT32 z = 0; z < quads; z++)
+			for (UINT32 x = 0; x < quads; x++)
+			{
+				const float x0 = float(x), x1 = float(x + 1), z0 = float(z), z1 = float(z + 1);
+				for (const CleanupTriangle& t : { plateTriangle(x0, z0, x0, z1, x1, z0), plateTriangle(x1, z0, x0, z1, x1, z1) })
+				{
+					triangles.push_back(t);
+					result.kept.push_back(t);
+					switch (rng() % 16)
+					{
+					case 0:
+						// A copy of an earlier face, its attributes do not matter
+						{
+							CleanupTriangle copy = rotated(result.kept[rng() % result.kept.size()], static_cast<int>(rng() % 3));
+							copy.texCoords[0] += 1.0f;
+							copy.material = (copy.material + 1) % 3;
+							triangles.push_back(copy);
+							result.duplicates++;
+						}
+						break;
+					case 1:
+						{
+							CleanupTriangle back = t;
+							for (int c = 0; c < 3; c++)
+								std::swap(back.positions[3 + c], back.positions[6 + c]);
+							back.normal[1] = -1.0f;
+							triangles.push_back(back);
+							result.kept.push_back(back);
+							result.reversed++;
+						}
+						break;
+					case 2:
+						{
+							CleanupTriangle shared = t;
+							shared.sharedCorner = true;
+							triangles.push_back(shared);
+							result.degenerate++;
+						}
+						break;
+					case 3:
+						{
+							CleanupTriangle collapsed = t;
+							for (int c = 0; c < 3; c++)
+								collapsed.positions[6 + c] = collapsed.positions[3 + c];
+							triangles.push_back(collapsed);
+							result.degenerate++;
+						}
+						break;
+					case 4:
+						{
+							// The third corner on the midpoint of the first edge
+							CleanupTriangle sliver = t;
+							for (int c = 0; c < 3; c++)
+								sliver.positions[6 + c] = 0.5f * (sliver.positions[c] + sliver.positions[3 + c]);
+							triangles.push_back(sliver);
+							result.degenerate++;
+						}
+						break;
+					}
+				}
+			}
+
+		WMeshData& mesh = result.mesh;
+		mesh.materialNames = { "steel", "rubber", "glass" };
+		for (const CleanupTriangle& t : triangles)
+		{
+			const UINT32 position = static_cast<UINT32>(mesh.vertices.size() / 3);
+			const INT32 normal = static_cast<INT32>(mesh.normals.size() / 3);
+			const INT32 texCoord = static_cast<INT32>(mesh.texCoords.size() / 2);
+			if (t.sharedCorner)
+				mesh.vertices.insert(mesh.vertices.end(), t.positions.begin(), t.positions.begin() + 3);
+			else
+				mesh.vertices.insert(mesh.vertices.end(), t.positions.begin(), t.positions.end());
+			mesh.normals.insert(mesh.normals.end(), t.normal.begin(), t.normal.end());
+			mesh.texCoords.insert(mesh.texCoords.end(), t.texCoords.begin(), t.texCoords.end());
+			for (UINT32 k = 0; k < 3; k++)
+			{
+				mesh.indices.push_back(t.sharedCorner ? position : position + k);
+				mesh.normalIndices.push_back(normal);
+				mesh.texCoordIndices.push_back(texCoord + static_cast<INT32>(k));
+			}
+			mesh.materialIds.push_back(t.material);
+		}
+		// Leftovers of deleted faces
+		for (int i = 0; i < 100; i++)
+		{
+			mesh.vertices.insert(mesh.vertices.end(), { unit(rng), 5.0f, unit(rng) });
+			mesh.normals.insert(mesh.normals.end(), { 1.0f, 0.0f, 0.0f });
+			mesh.texCoords.insert(mesh.texCoords.end(), { unit(rng), unit(rng) });
+		}
+		return result;
+	}
+
+	std::vector<CleanupTriangle> meshTriangles(const WMeshData& mesh)
+	{
+		std::vector<CleanupTriangle> triangles(mesh.indices.size() / 3);
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				for (size_t c = 0; c < 3; c++)
+					triangles[t].positions[3 * k + c] = mesh.vertices[3 * static_cast<size_t>(mesh.indices[3 * t + k]) + c];
+				for (size_t c = 0; c < 2; c++)
+					triangles[t].texCoords[2 * k + c] = mesh.texCoords[2 * static_cast<size_t>(mesh.texCoordIndices[3 * t + k]) + c];
+			}
+			for (size_t c = 0; c < 3; c++)
+				triangles[t].normal[c] = mesh.normals[3 * static_cast<size_t>(mesh.normalIndices[3 * t]) + c];
+			triangles[t].material = mesh.materialIds[t];
+		}
+		return triangles;
+	}
+
+	// Attributes the index stream does not reference
+	template<typename IndexT>
+	size_t unreferenced(const std::vector<IndexT>& indices, size_t count)
+	{
+		std::set<IndexT> used(indices.begin(), indices.end());
+		return count - used.size();
+	}
+}
+
+void benchMeshCleanup(WBenchContext& ctx)
+{
+	const UINT32 quads = static_cast<UINT32>(ctx.size(300, 60));
+	const CleanupMesh source = makeCleanupMesh(quads);
+	const WMeshData& input = source.mesh;
+	const size_t verticesUnused = unreferenced(input.indices, input.vertices.size() / 3);
+	ctx.report("triangles", static_cast<double>(input.indices.size() / 3), "");
+
+	WMeshData mesh;
+	WCleanupStats stats;
+	// Each run cleans a fresh copy, the copy is part of the time
+	double seconds = benchSeconds([&] {
+		mesh = input;
+		stats = cleanupMesh(mesh);
+	});
+	ctx.report("cleanupMesh", stats.trianglesBefore / seconds * 1e-6, "M triangles/s");
+	ctx.report("removed triangles", static_cast<double>(stats.degenerateTriangles + stats.duplicateTriangles), "");
+	ctx.report("removed vertices", static_cast<double>(stats.verticesRemoved), "");
+	ctx.report("before", stats.bytesBefore / 1024.0, "KB");
+	ctx.report("after", stats.bytesAfter / 1024.0, "KB");
+
+	ctx.check(stats.trianglesBefore == input.indices.size() / 3 && stats.degenerateTriangles == source.degenerate &&
+		stats.duplicateTriangles == source.duplicates, "exactly the injected degenerate and duplicate faces are removed");
+	ctx.check(meshTriangles(mesh) == source.kept, "kept faces stay in order with their attributes and materials");
+	ctx.check(source.reversed > 0 && mesh.indices.size() / 3 == source.kept.size(), "reversed copies are kept");
+	ctx.check(stats.verticesRemoved == input.vertices.size() / 3 - mesh.vertices.size() / 3 &&
+		stats.normalsRemoved == input.normals.size() / 3 - mesh.normals.size() / 3 &&
+		stats.texCoordsRemoved == input.texCoords.size() / 2 - mesh.texCoords.size() / 2 &&
+		stats.verticesRemoved > verticesUnused, "removed attribute counts match the arrays");
+	ctx.check(unreferenced(mesh.indices, mesh.vertices.size() / 3) == 0 &&
+		unreferenced(mesh.normalIndices, mesh.normals.size() / 3) == 0 &&
+		unreferenced(mesh.texCoordIndices, mesh.texCoords.size() / 2) == 0, "every kept attribute is referenced");
+	ctx.check(stats.changed() && stats.bytesAfter < stats.bytesBefore, "the report shows the saving");
+
+	// Welding sees fewer vertices once the copies of removed faces are gone
+	WMeshData weldedSource = input, weldedClean = mesh;
+	const WWeldStats weldSource = weldMeshVertices(weldedSource);
+	const WWeldStats weldClean = weldMeshVertices(weldedClean);
+	ctx.report("welded vertices before", static_cast<double>(weldSource.vertexCountAfter), "");
+	ctx.report("welded vertices after", static_cast<double>(weldClean.vertexCountAfter), "");
+	ctx.check(weldClean.vertexCountAfter < weldSource.vertexCountAfter, "cleanup shrinks the welded mesh");
+
+	const WMeshData cleaned = mesh;
+	ctx.check(!cleanupMesh(mesh).changed() && meshTriangles(mesh) == meshTriangles(cleaned), "a second pass changes nothing");
+}
@@ -0,0 +1,216 @@
+#include "WBench.h"
+#include "../Utils/WMeshSimplifier.h"
+#include <vector>
+#include <unordered_map>
+#include <set>
+#include <tuple>
+#include <cmath>
+
+namespace
+{
+	const float BenchPi = 3.14159265358979f;
+
+	// Closed unit sphere of rings x segments quads with fans at the poles, normals follow the positions
+	WMeshData sphereMesh(UINT32 rings, UINT32 segments)
+	{
+		WMeshData mesh;
+		auto addVertex = [&](float x, float y, float z) {
+			mesh.vertices.insert(mesh.vertices.end(), { x, y, z });
+			mesh.normals.insert(mesh.normals.end(), { x, y, z });
+		};
+		addVertex(0.0f, 1.0f, 0.0f);
+		for (UINT32 r = 1; r < rings; r++)
+		{
+			float theta = BenchPi * r / rings;
+			for (UINT32 s = 0; s < segments; s++)
+			{
+				float phi = 2.0f * BenchPi * s / segments;
+				addVertex(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			}
+		}
+		addVertex(0.0f, -1.0f, 0.0f);
+		const UINT32 south = static_cast<UINT32>(mesh.vertices.size() / 3 - 1);
+		auto ringVertex = [&](UINT32 r, UINT32 s) { return 1 + (r - 1) * segments + s % segments; };
+		auto addTriangle = [&](UINT32 a, UINT32 b, UINT32 c) { mesh.indices.insert(mesh.indices.end(), { a, b, c }); };
+		for (UINT32 s = 0; s < segments; s++)
+		{
+			addTriangle(0, ringVertex(1, s + 1), ringVertex(1, s));
+			for (UINT32 r = 1; r + 1 < rings; r++)
+			{
+				addTriangle(ringVertex(r, s), ringVertex(r, s + 1), ringVertex(r + 1, s));
+				addTriangle(ringVertex(r, s + 1), ringVertex(r + 1, s + 1), ringVertex(r + 1, s));
+			}
+			addTriangle(south, ringVertex(rings - 1, s), ringVertex(rings - 1, s + 1));
+		}
+		mesh.normalIndices.assign(mesh.indices.begin(), mesh.indices.end());
+		return mesh;
+	}
+
+	// Flat n x n grid in the z = 0 plane facing +z, with an open boundary
+	WMeshData gridMesh(UINT32 n)
+	{
+		WMeshData mesh;
+		for (UINT32 y = 0; y <= n; y++)
+			for (UINT32 x = 0; x <= n; x++)
+			{
+				mesh.vertices.insert(mesh.vertices.end(), { float(x) / n, float(y) / n, 0.0f });
+				mesh.normals.insert(mesh.normals.end(), { 0.0f, 0.0f, 1.0f });
+			}
+		for (UINT32 y = 0; y < n; y++)
+			for (UINT32 x = 0; x < n; x++)
+			{
+				UINT32 v = y * (n + 1) + x;
+				mesh.indices.insert(mesh.indices.end(), { v, v + 1, v + n + 1, v + 1, v + n + 2, v + n + 1 });
+			}
+		mesh.normalIndices.assign(mesh.indices.begin(), mesh.indices.end());
+		return mesh;
+	}
+
+	void corner(const WMeshData& mesh, size_t i, double* p)
+	{
+		for (int c = 0; c < 3; c++)
+			p[c] = mesh.vertices[3 * mesh.indices[i] + c];
+	}
+
+	// Signed z of the triangle normal times twice the area
+	double normalZ(const double* a, const double* b, const double* c)
+	{
+		return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+	}
+
+	// No degenerate triangles, every edge shared by at most two triangles and by exactly two on a closed surface
+	bool isManifold(const WMeshData& mesh, bool closed)
+	{
+		std::unordered_map<UINT64, UINT32> edges;
+		for (size_t t = 0; t < mesh.indices.size() / 3; t++)
+		{
+			const UINT32* tri = &mesh.indices[3 * t];
+			if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+				return false;
+			for (int k = 0; k < 3; k++)
+			{
+				UINT32 a = tri[k], b = tri[(k + 1) % 3];
+				edges[a < b ? (UINT64(a) << 32) | b : (UINT64(b) << 32) | a]++;
+			}
+		}
+		for (const auto& edge : edges)
+			if (edge.second > 2 || (closed && edge.second != 2))
+				return false;
+		return true;
+	}
+
+	// Endpoint collapses never create positions
+	bool keepsSourcePositions(const WMeshData& source, const WMeshData& lod)
+	{
+		std::set<std::tuple<float, float, float>> positions;
+		for (size_t v = 0; v < source.vertices.size(); v += 3)
+			positions.emplace(source.vertices[v], source.vertices[v + 1], source.vertices[v + 2]);
+		for (size_t v = 0; v < lod.vertices.size(); v += 3)
+			if (!positions.count(std::make_tuple(lod.vertices[v], lod.vertices[v + 1], lod.vertices[v + 2])))
+				return false;
+		return true;
+	}
+
+	// Largest distance of the LOD surface from the unit sphere, sampled on a barycentric grid
+	double sphereDeviation(const WMeshData& lod)
+	{
+		const int steps = 4;
+		double deviation = 0.0;
+		for (size_t t = 0; t < lod.indices.size(); t += 3)
+		{
+			double p[3][3];
+			for (int k = 0; k < 3; k++)
+				corner(lod, t + k, p[k]);
+			for (int i = 0; i <= steps; i++)
+				for (int j = 0; i + j <= steps; j++)
+				{
+					double u = double(i) / steps, v = double(j) / steps, w = 1.0 - u - v;
+					double x = u * p[0][0] + v * p[1][0] + w * p[2][0];
+					double y = u * p[0][1] + v * p[1][1] + w * p[2][1];
+					double z = u * p[0][2] + v * p[1][2] + w * p[2][2];
+					deviation = (std::max)(deviation, std::fabs(1.0 - std::sqrt(x * x + y * y + z * z)));
+				}
+		}
+		return deviation;
+	}
+
+	// LOD chain as WSceneDescParser builds it: every level from the source, halving the triangles
+	std::vector<WSimplifyStats> simplifyLevels(WBenchContext& ctx, const std::string& name, const WMeshData& mesh,
+		UINT32 levels, std::vector<WMeshData>& lods)
+	{
+		std::vector<WSimplifyStats> allStats;
+		const size_t triangles = mesh.indices.size() / 3;
+		for (UINT32 level = 1; level <= levels; level++)
+		{
+			const size_t target = static_cast<size_t>(triangles * std::pow(0.5, level));
+			WMeshData lod;
+			WSimplifyStats stats;
+			double seconds = benchSeconds([&] { stats = simplifyMesh(mesh, target, lod); }, 1);
+			const std::string levelName = name + " lod" + std::to_string(level);
+			ctx.report(levelName, triangles / seconds * 1e-6, "M tris/s");
+			ctx.report(levelName + " triangles", static_cast<double>(stats.trianglesAfter), "");
+			ctx.report(levelName + " quadric error", stats.maxError, "of the diagonal");
+			ctx.check(stats.trianglesAfter <= target && stats.trianglesAfter == lod.indices.size() / 3,
+				levelName + " reaches its target");
+			allStats.push_back(stats);
+			lods.push_back(std::move(lod));
+		}
+		return allStats;
+	}
+}
+
+void benchMeshSimplifier(WBenchContext& ctx)
+{
+	const UINT32 levels = 5;
+	const UINT32 rings = static_cast<UINT32>(ctx.size(512, 64));
+	const WMeshData sphere = sphereMesh(rings, 2 * rings);
+	std::vector<WMeshData> sphereLods;
+	const std::vector<WSimplifyStats> sphereStats = simplifyLevels(ctx, "sphere", sphere, levels, sphereLods);
+	// Lower targets continue the same collapse order, so the error only grows
+	bool monotonic = true, closed = true, sourcePositions = true, withinBound = true;
+	const double diagonal = 2.0 * std::sqrt(3.0);
+	// The source itself sags between its vertices by up to its tessellation error
+	const double sourceDeviation = sphereDeviation(sphere) / diagonal;
+	for (size_t level = 0; level < sphereLods.size(); level++)
+	{
+		if (level > 0)
+			monotonic &= sphereStats[level].maxError >= sphereStats[level - 1].maxError &&
+				sphereStats[level].trianglesAfter < sphereStats[level - 1].trianglesAfter;
+		closed &= isManifold(sphereLods[level], true);
+		sourcePositions &= keepsSourcePositions(sphere, sphereLods[level]);
+		const double deviation = sphereDeviation(sphereLods[level]) / diagonal;
+		ctx.report("sphere lod" + std::to_string(level + 1) + " surface error", deviation, "of the diagonal");
+		withinBound &= deviation <= sphereStats[level].maxError + sourceDeviation;
+	}
+	ctx.check(monotonic, "sphere error grows and triangles shrink with every level");
+	ctx.check(closed, "sphere levels stay closed and manifold");
+	ctx.check(sourcePositions, "sphere levels only use source positions");
+	ctx.check(withinBound, "sphere surface error within the reported quadric error");
+
+	// A flat grid simplifies without error, its boundary and area stay exactly in place
+	const UINT32 n = static_cast<UINT32>(ctx.size(400, 60));
+	const WMeshData grid = gridMesh(n);
+	std::vector<WMeshData> gridLods;
+	const std::vector<WSimplifyStats> gridStats = simplifyLevels(ctx, "grid", grid, levels, gridLods);
+	bool flat = true, area = true, facing = true, manifold = true;
+	for (size_t level = 0; level < gridLods.size(); level++)
+	{
+		flat &= gridStats[level].maxError < 1e-6;
+		manifold &= isManifold(gridLods[level], false);
+		double sum = 0.0;
+		for (size_t t = 0; t < gridLods[level].indices.size(); t += 3)
+		{
+			double p[3][3];
+			for (int k = 0; k < 3; k++)
+				corner(gridLods[level], t + k, p[k]);
+			double z = normalZ(p[0], p[1], p[2]);
+			facing &= z > 0.0;
+			sum += 0.5 * z;
+		}
+		area &= std::fabs(sum - 1.0) < 1e-5;
+	}
+	ctx.check(flat, "grid levels have no quadric error");
+	ctx.check(area, "grid levels keep the area and boundary");
+	ctx.check(facing, "grid levels flip no triangle");
+	ctx.check(manifold, "grid levels stay manifold");
+}
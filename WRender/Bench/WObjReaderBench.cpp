@@ -0,0 +1,126 @@
+#include "WBench.h"
+#include "../Utils/WObjReader.h"
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
+
+namespace
+{
+	// Height field grid of side x side vertices. Rows alternate between the three face
+	// forms and the last rows use relative indices, so every path of both readers is hit.
+	void writeGridObj(const std::string& filename, UINT side)
+	{
+		std::string text;
+		char line[160];
+		text += "# WBench grid\nmtllib grid.mtl\no grid\n";
+		for (UINT y = 0; y < side; y++)
+		{
+			for (UINT x = 0; x < side; x++)
+			{
+				float h = 0.25f * sinf(x * 0.37f) * cosf(y * 0.21f);
+				snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\nvt %.6f %.6f\n",
+					x * 0.01f, h, y * 0.01f, -h, 1.0f, 0.5f * h, x / float(side), y / float(side));
+				text += line;
+			}
+		}
+		text += "g grid\n";
+		const UINT relativeRows = 2;
+		for (UINT y = 0; y + 1 < side; y++)
+		{
+			for (UINT x = 0; x + 1 < side; x++)
+			{
+				UINT a = y * side + x + 1, b = a + 1, c = a + side, d = c + 1;
+				if (y + 1 + relativeRows >= side)
+				{
+					int total = int(side * side);
+					snprintf(line, sizeof(line), "f %d %d %d\nf %d %d %d\n",
+						int(a) - total - 1, int(c) - total - 1, int(b) - total - 1,
+						int(b) - total - 1, int(c) - total - 1, int(d) - total - 1);
+				}
+				else if (y % 3 == 0)
+					snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\nf %u/%u/%u %u/%u/%u %u/%u/%u\n",
+						a, a, a, c, c, c, b, b, b, b, b, b, c, c, c, d, d, d);
+				else if (y % 3 == 1)
+					snprintf(line, sizeof(line), "f %u//%u %u//%u %u//%u\r\nf %u//%u %u//%u %u//%u\r\n",
+						a, a, c, c, b, b, b, b, c, c, d, d);
+				else
+					snprintf(line, sizeof(line), "f %u %u %u\nf %u %u %u\n", a, c, b, b, c, d);
+				text += line;
+			}
+		}
+		std::ofstream out(filename, std::ios::binary);
+		out.write(text.data(), text.size());
+	}
+
+	bool readTinyObj(const std::string& filename, WMeshData& mesh)
+	{
+		tinyobj::ObjReader reader;
+		tinyobj::ObjReaderConfig config;
+		if (!reader.ParseFromFile(filename, config))
+			return false;
+		const auto& attrib = reader.GetAttrib();
+		mesh.vertices = attrib.vertices;
+		mesh.normals = attrib.normals;
+		mesh.texCoords = attrib.texcoords;
+		for (const auto& shape : reader.GetShapes())
+		{
+			for (const auto& index : shape.mesh.indices)
+			{
+				mesh.indices.push_back(static_cast<UINT32>(index.vertex_index));
+				mesh.normalIndices.push_back(index.normal_index);
+				mesh.texCoordIndices.push_back(index.texcoord_index);
+			}
+		}
+		return true;
+	}
+
+	bool rejects(WBenchContext& ctx, const char* text)
+	{
+		std::string filename = ctx.tempPath("bad.obj");
+		{
+			std::ofstream out(filename, std::ios::binary);
+			out << text;
+		}
+		WMeshData mesh;
+		std::string message;
+		bool loaded = readObjFast(filename, mesh, message);
+		std::filesystem::remove(filename);
+		return !loaded && mesh.indices.empty();
+	}
+}
+
+void benchObjReader(WBenchContext& ctx)
+{
+	std::string filename = ctx.tempPath("grid.obj");
+	writeGridObj(filename, static_cast<UINT>(ctx.size(1024, 96)));
+	double megabytes = std::filesystem::file_size(filename) / (1024.0 * 1024.0);
+
+	WMeshData fast, reference;
+	std::string message;
+	bool fastLoaded = false, referenceLoaded = false;
+	double fastSeconds = benchSeconds([&]() {
+		fast = WMeshData();
+		fastLoaded = readObjFast(filename, fast, message);
+	});
+	double referenceSeconds = benchSeconds([&]() {
+		reference = WMeshData();
+		referenceLoaded = readTinyObj(filename, reference);
+	}, ctx.quick() ? 1 : 2);
+	std::filesystem::remove(filename);
+
+	ctx.report("file", megabytes, "MB");
+	ctx.report("WObjReader", megabytes / fastSeconds, "MB/s");
+	ctx.report("tiny_obj_loader", megabytes / referenceSeconds, "MB/s");
+	ctx.report("speedup", referenceSeconds / fastSeconds, "x");
+
+	ctx.check(fastLoaded && referenceLoaded, "both readers load the grid");
+	ctx.check(fast.vertices == reference.vertices && fast.normals == reference.normals &&
+		fast.texCoords == reference.texCoords, "same attributes as tiny_obj_loader");
+	ctx.check(fast.indices == reference.indices && fast.normalIndices == reference.normalIndices &&
+		fast.texCoordIndices == reference.texCoordIndices, "same index streams as tiny_obj_loader");
+
+	ctx.check(rejects(ctx, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n"), "vertex index past the end is rejected");
+	ctx.check(rejects(ctx, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -1 -2 -4\n"), "relative index before the start is rejected");
+	ctx.check(rejects(ctx, "v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf 1//1 2//2 3//1\n"), "normal index past the end is rejected");
+}
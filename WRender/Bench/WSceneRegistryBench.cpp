@@ -0,0 +1,155 @@
+#include "WBench.h"
+#include "../Utils/WSceneRegistry.h"
+#include "../FrameResource.h"
+#include <vector>
+#include <map>
+#include <random>
+#include <cstring>
+
+namespace
+{
+	// Render items and a quarter as many materials named like parsed scenes, objIdx and MatIdx in
+	// declaration order
+	void makeScene(size_t count, std::map<std::string, WMaterial>& materials, std::map<std::string, WRenderItem>& items)
+	{
+		std::mt19937 rng(12);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const size_t materialCount = (std::max)(count / 4, size_t(1));
+		for (size_t i = 0; i < materialCount; i++)
+		{
+			WMaterial m;
+			m.Name = "material_" + std::to_string(i);
+			m.MatIdx = static_cast<UINT>(i);
+			m.Albedo = DirectX::XMFLOAT4(unit(rng), unit(rng), unit(rng), 1.0f);
+			m.Smoothness = unit(rng);
+			materials[m.Name] = m;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			WRenderItem r;
+			r.objName = "object_" + std::to_string(i);
+			r.objIdx = static_cast<UINT>(i);
+			r.matIdx = static_cast<UINT>(rng() % materialCount);
+			r.materialName = "material_" + std::to_string(r.matIdx);
+			items[r.objName] = r;
+		}
+	}
+
+	// What UpdateMaterialBuffer does for one material
+	void writeMaterial(WMaterial& m, std::vector<WMaterialData>& buffer)
+	{
+		if (m.NumFramesDirty <= 0)
+			return;
+		WMaterialData data(m.Albedo, m.Emission, m.Transparent, m.Smoothness, m.Metallic, m.DiffuseMapIdx, m.NormalMapIdx);
+		data.TransColor = m.TransColor;
+		data.F0 = m.F0;
+		data.RefractiveIndex = m.RefractiveIndex;
+		data.Sigma = m.Sigma;
+		buffer[m.MatIdx] = data;
+		--m.NumFramesDirty;
+	}
+}
+
+void benchSceneRegistry(WBenchContext& ctx)
+{
+	const std::vector<size_t> counts = ctx.quick() ? std::vector<size_t>{ 1000, 10000 } :
+		std::vector<size_t>{ 1000, 10000, 100000 };
+	const int frames = static_cast<int>(ctx.size(100, 10));
+	for (size_t count : counts)
+	{
+		const std::string suffix = " " + std::to_string(count);
+		std::map<std::string, WMaterial> materialMap;
+		std::map<std::string, WRenderItem> itemMap;
+		makeScene(count, materialMap, itemMap);
+		WSceneRegistry<WMaterial> materials;
+		WSceneRegistry<WRenderItem> items;
+		materials.assign(materialMap, [](const WMaterial& m) { return m.MatIdx; });
+		items.assign(itemMap, [](const WRenderItem& r) { return r.objIdx; });
+
+		// Per-frame material walk, every material dirty so both paths write the whole buffer
+		std::vector<WMaterialData> mapBuffer(materials.size()), registryBuffer(materials.size());
+		double mapSeconds = benchSeconds([&] {
+			for (int frame = 0; frame < frames; frame++)
+				for (auto& m : materialMap)
+				{
+					m.second.NumFramesDirty = 1;
+					writeMaterial(m.second, mapBuffer);
+				}
+		});
+		double registrySeconds = benchSeconds([&] {
+			for (int frame = 0; frame < frames; frame++)
+				for (auto& m : materials)
+				{
+					m.NumFramesDirty = 1;
+					writeMaterial(m, registryBuffer);
+				}
+		});
+		ctx.report("dirty frame map" + suffix, mapSeconds / frames * 1e6, "us");
+		ctx.report("dirty frame registry" + suffix, registrySeconds / frames * 1e6, "us");
+		ctx.check(memcmp(mapBuffer.data(), registryBuffer.data(), mapBuffer.size() * sizeof(WMaterialData)) == 0,
+			"map and registry walks write the same material buffer" + suffix);
+
+		// A static frame only tests the dirty counters
+		mapSeconds = benchSeconds([&] {
+			for (int frame = 0; frame < frames; frame++)
+				for (auto& m : materialMap)
+					writeMaterial(m.second, mapBuffer);
+		});
+		registrySeconds = benchSeconds([&] {
+			for (int frame = 0; frame < frames; frame++)
+				for (auto& m : materials)
+					writeMaterial(m, registryBuffer);
+		});
+		ctx.report("static frame map" + suffix, mapSeconds / frames * 1e6, "us");
+		ctx.report("static frame registry" + suffix, registrySeconds / frames * 1e6, "us");
+
+		// TLAS setup resolves every instance's material, by name in the map or by matIdx
+		std::vector<float> mapSmoothness(count), registrySmoothness(count);
+		mapSeconds = benchSeconds([&] {
+			for (const auto& r : itemMap)
+				mapSmoothness[r.second.objIdx] = materialMap.find(r.second.materialName)->second.Smoothness;
+		});
+		registrySeconds = benchSeconds([&] {
+			for (size_t i = 0; i < items.size(); i++)
+				registrySmoothness[i] = materials[items[i].matIdx].Smoothness;
+		});
+		ctx.report("material lookup map" + suffix, mapSeconds * 1e6, "us");
+		ctx.report("material lookup registry" + suffix, registrySeconds * 1e6, "us");
+		ctx.check(mapSmoothness == registrySmoothness, "map and registry resolve the same materials" + suffix);
+
+		// Items sit at their GPU index and every name resolves back to it
+		bool indexed = true;
+		for (size_t i = 0; i < items.size(); i++)
+			indexed &= items[i].objIdx == i && items.name(i) == items[i].objName && items.indexOf(items.name(i)) == INT64(i);
+		for (size_t i = 0; i < materials.size(); i++)
+			indexed &= materials[i].MatIdx == i && materials.find(materials[i].Name) == &materials[i];
+		ctx.check(indexed, "registries are indexed by objIdx and MatIdx" + suffix);
+	}
+
+	WSceneRegistry<WRenderItem> items;
+	std::map<std::string, WRenderItem> itemMap;
+	itemMap["a"].objIdx = 0;
+	itemMap["b"].objIdx = 0;
+	bool threw = false;
+	try
+	{
+		items.assign(itemMap, [](const WRenderItem& r) { return r.objIdx; });
+	}
+	catch (const std::invalid_argument&)
+	{
+		threw = true;
+	}
+	ctx.check(threw, "duplicate indices are rejected");
+	itemMap["b"].objIdx = 1;
+	items.assign(itemMap, [](const WRenderItem& r) { return r.objIdx; });
+	threw = false;
+	try
+	{
+		items.at("c");
+	}
+	catch (const std::out_of_range&)
+	{
+		threw = true;
+	}
+	ctx.check(threw && items.indexOf("c") < 0 && items.find("c") == nullptr, "unknown names are not found");
+}
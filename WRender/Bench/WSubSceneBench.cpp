@@ -0,0 +1,177 @@
+#include "WBench.h"
+#include "../Utils/WSceneDescParser.h"
+#include "../Utils/WSubSceneStreamer.h"
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+
+namespace
+{
+	// Spacing of the includes along x, each sub-scene fits in a 10 unit box
+	const float SubSceneSpacing = 100.0f;
+
+	// A "quads" x "quads" grid in the xz plane, 10 units wide
+	void writeGridObj(const std::string& path, size_t quads)
+	{
+		std::ofstream obj(path, std::ios::binary);
+		const float step = 10.0f / quads;
+		for (size_t z = 0; z <= quads; z++)
+			for (size_t x = 0; x <= quads; x++)
+				obj << "v " << x * step << " 0 " << z * step << "\n";
+		for (size_t z = 0; z < quads; z++)
+			for (size_t x = 0; x < quads; x++)
+			{
+				const size_t a = z * (quads + 1) + x + 1, b = a + 1, c = a + quads + 1, d = c + 1;
+				obj << "f " << a << " " << c << " " << b << "\nf " << b << " " << c << " " << d << "\n";
+			}
+	}
+
+	void writeSubScene(const std::string& path, const std::string& objName, size_t index)
+	{
+		std::ofstream(path, std::ios::binary) << "<scene>\n\t<object name=\"district_" << index << "\">\n"
+			"\t\t<Material name=\"ground\">\n\t\t\t<albedo>0.5,0.5,0.5,1</albedo>\n\t\t</Material>\n"
+			"\t\t<Mesh>\n\t\t\t<geometry>" << objName << "</geometry>\n\t\t</Mesh>\n\t</object>\n</scene>\n";
+	}
+
+	// "files" lazy includes along x, each with bounds around its grid
+	void writeMainScene(const std::string& path, const std::vector<std::string>& files)
+	{
+		std::ofstream scene(path, std::ios::binary);
+		scene << "<scene>\n";
+		for (size_t i = 0; i < files.size(); i++)
+			scene << "\t<include file=\"" << files[i] << "\" lazy=\"true\" bounds=\"0,-1,0, 10,1,10\">\n"
+				"\t\t<transform>\n\t\t\t<translation>" << i * SubSceneSpacing << ",0,0</translation>\n\t\t</transform>\n"
+				"\t</include>\n";
+		scene << "</scene>\n";
+	}
+
+	// Takes over loads until none is in flight, false when they take longer than 10 s
+	bool finishLoads(WSubSceneStreamer& streamer, UINT64 frame)
+	{
+		for (int i = 0; i < 10000; i++)
+		{
+			streamer.update(frame);
+			if (streamer.stats().loading == 0)
+				return true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return false;
+	}
+
+	std::vector<size_t> residentSet(const WSubSceneStreamer& streamer)
+	{
+		std::vector<size_t> resident;
+		for (size_t i = 0; i < streamer.size(); i++)
+			if (streamer.state(i) == SUBSCENE_RESIDENT)
+				resident.push_back(i);
+		return resident;
+	}
+
+	void configureLoad(WSceneDescParser& parser)
+	{
+		parser.setUseSceneCache(false);
+	}
+}
+
+void benchSubScenes(WBenchContext& ctx)
+{
+	const size_t subScenes = ctx.size(16, 6);
+	const size_t quads = ctx.size(200, 20);
+	const std::string objName = ctx.tempPath("subscene_grid.obj"), mainScene = ctx.tempPath("subscene_main.xml");
+	writeGridObj(objName, quads);
+	std::vector<std::string> files;
+	for (size_t i = 0; i < subScenes; i++)
+	{
+		files.push_back(ctx.tempPath("subscene_" + std::to_string(i) + ".xml"));
+		writeSubScene(files.back(), objName, i);
+	}
+	// Placed after the last sub-scene, its file does not exist
+	files.push_back(ctx.tempPath("subscene_missing.xml"));
+	writeMainScene(mainScene, files);
+	const size_t missing = subScenes;
+
+	// Startup only registers the includes
+	WSceneDescParser parser;
+	parser.setUseSceneCache(false);
+	ctx.check(parser.Parse(mainScene.c_str()), "the main scene parses");
+	const auto& records = parser.getSubScenes();
+	const auto& hierarchy = parser.getTransformHierarchy();
+	bool registered = records.size() == subScenes + 1 && parser.getRenderItems().empty() && parser.getGeometryMap().empty();
+	for (size_t i = 0; registered && i < records.size(); i++)
+		registered = records[i].file == files[i] && records[i].hasBounds && records[i].boundsMax.x == 10.0f &&
+			hierarchy.worlds[records[i].transformNode].m[0][3] == i * SubSceneSpacing;
+	ctx.check(registered, "lazy includes register bounds and placement without loading geometry");
+
+	// Load on first request
+	WSubSceneStreamer streamer;
+	streamer.reset(records, configureLoad);
+	UINT64 frame = 1;
+	streamer.request(0, frame);
+	ctx.check(streamer.state(0) == SUBSCENE_LOADING, "a request queues the load");
+	ctx.check(finishLoads(streamer, frame), "the load finishes");
+	const WSceneDescParser* first = streamer.residentScene(0);
+	ctx.check(first && first->getRenderItems().size() == 1 && first->getGeometryMap().size() == 1 &&
+		first->getGeometryMap().begin()->second.indexCount == 6 * quads * quads && streamer.stats().loads == 1,
+		"a requested sub-scene becomes resident with its geometry");
+	const UINT64 subSceneBytes = streamer.stats().residentBytes;
+	ctx.report("sub-scene", subSceneBytes / 1024.0, "KB");
+	ctx.report("load", streamer.stats().loadSeconds * 1e3, "ms");
+
+	// LRU eviction: the budget holds three, requesting one per frame keeps the last three
+	const UINT64 budget = 3 * subSceneBytes + subSceneBytes / 2;
+	streamer.setBudget(budget);
+	bool withinBudget = true;
+	for (size_t i = 1; i < subScenes; i++)
+	{
+		streamer.request(i, ++frame);
+		withinBudget &= finishLoads(streamer, frame) && streamer.stats().residentBytes <= budget;
+	}
+	const WSubSceneStats afterSweep = streamer.stats();
+	ctx.report("evictions", static_cast<double>(afterSweep.evictions), "");
+	ctx.check(withinBudget, "resident sub-scenes stay within the budget");
+	ctx.check(residentSet(streamer) == std::vector<size_t>{ subScenes - 3, subScenes - 2, subScenes - 1 } &&
+		afterSweep.loads == subScenes && afterSweep.evictions == subScenes - 3 && !streamer.residentScene(0),
+		"the least recently requested sub-scenes are evicted");
+
+	// Coming back reloads, the oldest resident one makes room
+	streamer.request(0, ++frame);
+	finishLoads(streamer, frame);
+	ctx.check(residentSet(streamer) == std::vector<size_t>{ 0, subScenes - 2, subScenes - 1 } &&
+		streamer.stats().loads == subScenes + 1, "an evicted sub-scene is loaded again on request");
+	// A request on a resident sub-scene makes it the most recent one without loading it
+	streamer.request(subScenes - 2, ++frame);
+	streamer.request(1, ++frame);
+	finishLoads(streamer, frame);
+	ctx.check(residentSet(streamer) == std::vector<size_t>{ 0, 1, subScenes - 2 } && streamer.stats().loads == subScenes + 2,
+		"requests refresh resident sub-scenes");
+
+	// Whatever is requested in the current frame stays, over budget if need be
+	++frame;
+	for (size_t i = 0; i < subScenes; i++)
+		streamer.request(i, frame);
+	finishLoads(streamer, frame);
+	ctx.check(residentSet(streamer).size() == subScenes && streamer.stats().residentBytes > budget,
+		"sub-scenes in view are never evicted");
+	streamer.request(0, ++frame);
+	streamer.update(frame);
+	ctx.check(streamer.stats().residentBytes <= budget && streamer.state(0) == SUBSCENE_RESIDENT,
+		"the budget applies again once they leave the view");
+
+	// Frustum requests: an orthographic view of the last sub-scene and the missing file next to it
+	streamer.reset(records, configureLoad);
+	const float viewLeft = (subScenes - 1) * SubSceneSpacing - 20.0f, viewRight = subScenes * SubSceneSpacing + 30.0f;
+	DirectX::XMMATRIX viewProj = DirectX::XMMatrixOrthographicOffCenterLH(viewLeft, viewRight, -50.0f, 50.0f, -50.0f, 50.0f);
+	const size_t requested = streamer.requestVisible(viewProj, hierarchy, 1);
+	finishLoads(streamer, 1);
+	ctx.check(requested == 2 && residentSet(streamer) == std::vector<size_t>{ subScenes - 1 } &&
+		streamer.state(missing) == SUBSCENE_FAILED &&
+		streamer.stats().failures == 1, "the frustum requests the sub-scenes it intersects, missing files fail");
+
+	std::error_code ec;
+	for (const std::string& file : files)
+		std::filesystem::remove(file, ec);
+	for (const std::string& file : { objName, mainScene })
+		std::filesystem::remove(file, ec);
+}
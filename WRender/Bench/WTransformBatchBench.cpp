@@ -0,0 +1,130 @@
+#include "WBench.h"
+#include "../Utils/WTransformBatch.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Instances as the parser stores them: translation, rotation in degrees and scaling,
+	// non-uniform and partly mirrored so the inverses see more than rotations
+	struct BenchTRS
+	{
+		std::vector<DirectX::XMFLOAT3> translations;
+		std::vector<DirectX::XMFLOAT3> rotations;
+		std::vector<DirectX::XMFLOAT3> scalings;
+	};
+
+	BenchTRS randomTRS(size_t count, UINT32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> angle(-360.0f, 360.0f);
+		std::uniform_real_distribution<float> logScale(-1.0f, 1.0f);
+		BenchTRS trs;
+		for (size_t i = 0; i < count; i++)
+		{
+			trs.translations.push_back(DirectX::XMFLOAT3(position(rng), position(rng), position(rng)));
+			trs.rotations.push_back(DirectX::XMFLOAT3(angle(rng), angle(rng), angle(rng)));
+			float s[3];
+			for (float& c : s)
+				c = std::pow(10.0f, logScale(rng));
+			if (i % 7 == 0)
+				s[i % 3] = -s[i % 3];
+			trs.scalings.push_back(DirectX::XMFLOAT3(s[0], s[1], s[2]));
+		}
+		return trs;
+	}
+
+	void composeAll(const BenchTRS& trs, std::vector<DirectX::XMFLOAT3X4>& transforms)
+	{
+		transforms.resize(trs.translations.size());
+		composeTRSBatch(&trs.translations[0].x, &trs.rotations[0].x, &trs.scalings[0].x, 3,
+			nullptr, transforms.size(), transforms.data());
+	}
+
+	// Largest entry difference relative to the largest entry of "reference"
+	double relativeError(const float* a, const float* reference, int n)
+	{
+		double diff = 0.0, scale = 0.0;
+		for (int i = 0; i < n; i++)
+		{
+			diff = (std::max)(diff, std::fabs(double(a[i]) - reference[i]));
+			scale = (std::max)(scale, std::fabs(double(reference[i])));
+		}
+		return diff / (std::max)(scale, 1e-30);
+	}
+}
+
+void benchTransformBatch(WBenchContext& ctx)
+{
+	const WSIMD_PATH startPath = transformBatchPath();
+	const bool avx2 = cpuSupportsAvx2();
+	const size_t count = ctx.size(1000000, 20000) + 5;
+	const BenchTRS trs = randomTRS(count, 15);
+
+	std::vector<DirectX::XMFLOAT3X4> scalarTransforms, transforms;
+	setTransformBatchPath(SIMD_PATH_SCALAR);
+	double scalarSeconds = benchSeconds([&] { composeAll(trs, scalarTransforms); });
+	ctx.report("TRS scalar", count / scalarSeconds * 1e-6, "M/s");
+	if (avx2)
+	{
+		setTransformBatchPath(SIMD_PATH_AVX2);
+		double seconds = benchSeconds([&] { composeAll(trs, transforms); });
+		ctx.report("TRS AVX2", count / seconds * 1e-6, "M/s");
+		ctx.report("TRS AVX2 speedup", scalarSeconds / seconds, "x");
+		double maxError = 0.0;
+		for (size_t i = 0; i < count; i++)
+			maxError = (std::max)(maxError, relativeError(&transforms[i].m[0][0], &scalarTransforms[i].m[0][0], 12));
+		ctx.report("TRS AVX2 vs scalar", maxError, "relative");
+		ctx.check(maxError < 1e-5, "AVX2 and scalar TRS agree");
+	}
+
+	// InvTranspose against a general XMMatrixInverse of ObjectToWorld, as WObjectConstants did
+	// before the batch
+	std::vector<DirectX::XMFLOAT4X4> objectToWorld(count), invTranspose(count);
+	std::vector<DirectX::XMFLOAT4X4> referenceObjectToWorld(count), referenceInvTranspose(count);
+	double referenceSeconds = benchSeconds([&] {
+		for (size_t i = 0; i < count; i++)
+		{
+			DirectX::XMMATRIX m = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat3x4(&scalarTransforms[i]));
+			DirectX::XMStoreFloat4x4(&referenceObjectToWorld[i], m);
+			DirectX::XMStoreFloat4x4(&referenceInvTranspose[i], DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, m)));
+		}
+	});
+	ctx.report("XMMatrixInverse", count / referenceSeconds * 1e-6, "M/s");
+
+	// Scalar on every path, see invTransposeRows
+	double seconds = benchSeconds([&] {
+		objectMatricesBatch(scalarTransforms.data(), nullptr, count, objectToWorld.data(), invTranspose.data());
+	});
+	ctx.report("InvTranspose", count / seconds * 1e-6, "M/s");
+	ctx.report("InvTranspose vs XMMatrixInverse speedup", referenceSeconds / seconds, "x");
+	double maxError = 0.0;
+	bool sameObjectToWorld = true;
+	for (size_t i = 0; i < count; i++)
+	{
+		maxError = (std::max)(maxError, relativeError(&invTranspose[i].m[0][0], &referenceInvTranspose[i].m[0][0], 16));
+		sameObjectToWorld &= memcmp(&objectToWorld[i], &referenceObjectToWorld[i], sizeof(DirectX::XMFLOAT4X4)) == 0;
+	}
+	ctx.report("InvTranspose vs XMMatrixInverse", maxError, "relative");
+	ctx.check(maxError < 1e-4, "InvTranspose matches XMMatrixInverse");
+	ctx.check(sameObjectToWorld, "ObjectToWorld is the transposed 3x4");
+
+	// Dirty subsets go through indices
+	std::vector<UINT32> indices;
+	for (UINT32 i = 0; i < count; i += 3)
+		indices.push_back(static_cast<UINT32>(count - 1 - i));
+	std::vector<DirectX::XMFLOAT4X4> subsetObjectToWorld(indices.size()), subsetInvTranspose(indices.size());
+	objectMatricesBatch(scalarTransforms.data(), indices.data(), indices.size(), subsetObjectToWorld.data(),
+		subsetInvTranspose.data());
+	bool sameSubset = true;
+	for (size_t k = 0; k < indices.size(); k++)
+	{
+		sameSubset &= memcmp(&subsetInvTranspose[k], &invTranspose[indices[k]], sizeof(DirectX::XMFLOAT4X4)) == 0;
+		sameSubset &= memcmp(&subsetObjectToWorld[k], &objectToWorld[indices[k]], sizeof(DirectX::XMFLOAT4X4)) == 0;
+	}
+	ctx.check(sameSubset, "indexed batches match the full batch");
+	setTransformBatchPath(startPath);
+}
@@ -0,0 +1,121 @@
+#include "WBench.h"
+#include "../Utils/WTransformHierarchy.h"
+#include <vector>
+#include <random>
+#include <cstring>
+
+namespace
+{
+	DirectX::XMMATRIX randomLocal(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+		std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+		return DirectX::XMMatrixMultiply(DirectX::XMMatrixRotationY(angle(rng)),
+			DirectX::XMMatrixTranslation(position(rng), position(rng), position(rng)));
+	}
+
+	// "groups" root groups of "children" objects each, under one scene root
+	WTransformHierarchy makeHierarchy(UINT32 groups, UINT32 children)
+	{
+		std::mt19937 rng(14);
+		WTransformHierarchy hierarchy;
+		UINT32 root = hierarchy.addNode(-1, -1, "root", DirectX::XMMatrixIdentity());
+		INT32 objIdx = 0;
+		for (UINT32 g = 0; g < groups; g++)
+		{
+			UINT32 group = hierarchy.addNode(static_cast<INT32>(root), -1, "group_" + std::to_string(g), randomLocal(rng));
+			for (UINT32 c = 0; c < children; c++)
+			{
+				UINT32 child = hierarchy.addNode(static_cast<INT32>(group), objIdx, "object_" + std::to_string(objIdx), randomLocal(rng));
+				objIdx++;
+				hierarchy.closeNode(child);
+			}
+			hierarchy.closeNode(group);
+		}
+		hierarchy.closeNode(root);
+		hierarchy.update();
+		return hierarchy;
+	}
+
+	// World matrices recomputed from the locals alone, walking each node's parent chain
+	std::vector<DirectX::XMFLOAT3X4> referenceWorlds(const WTransformHierarchy& hierarchy)
+	{
+		std::vector<DirectX::XMFLOAT3X4> worlds(hierarchy.size());
+		for (size_t i = 0; i < hierarchy.size(); i++)
+		{
+			std::vector<UINT32> chain;
+			for (INT32 node = static_cast<INT32>(i); node >= 0; node = hierarchy.parents[node])
+				chain.push_back(static_cast<UINT32>(node));
+			DirectX::XMMATRIX world = DirectX::XMLoadFloat3x4(&hierarchy.locals[chain.back()]);
+			for (size_t k = chain.size() - 1; k-- > 0;)
+				world = DirectX::XMMatrixMultiply(DirectX::XMLoadFloat3x4(&hierarchy.locals[chain[k]]), world);
+			DirectX::XMStoreFloat3x4(&worlds[i], world);
+		}
+		return worlds;
+	}
+
+	bool sameWorlds(const WTransformHierarchy& hierarchy, const std::vector<DirectX::XMFLOAT3X4>& worlds)
+	{
+		return memcmp(hierarchy.worlds.data(), worlds.data(), worlds.size() * sizeof(DirectX::XMFLOAT3X4)) == 0;
+	}
+}
+
+void benchTransformHierarchy(WBenchContext& ctx)
+{
+	// Ten groups of 10k objects (quick: 1k), moving one group touches a tenth of the scene
+	const UINT32 groups = 10;
+	const UINT32 children = static_cast<UINT32>(ctx.size(10000, 1000));
+	WTransformHierarchy hierarchy = makeHierarchy(groups, children);
+	ctx.check(hierarchy.size() == 1 + groups * (1 + children) && hierarchy.subtreeEnd[0] == hierarchy.size(),
+		"groups enclose their children");
+	ctx.check(sameWorlds(hierarchy, referenceWorlds(hierarchy)), "initial worlds match the parent chains");
+
+	std::mt19937 rng(41);
+	const UINT32 parent = 1 + 3 * (1 + children);
+	const UINT32 subtreeSize = hierarchy.subtreeEnd[parent] - parent;
+	std::vector<UINT32> changed;
+	size_t updated = 0;
+	const int moves = static_cast<int>(ctx.size(20, 5));
+	double seconds = benchSeconds([&] {
+		for (int move = 0; move < moves; move++)
+		{
+			changed.clear();
+			hierarchy.setLocal(parent, randomLocal(rng));
+			updated = hierarchy.update(&changed);
+		}
+	});
+	ctx.report("move parent of " + std::to_string(children), seconds / moves * 1e6, "us");
+	ctx.check(subtreeSize == children + 1 && updated == subtreeSize && changed.size() == subtreeSize &&
+		changed.front() == parent && changed.back() == parent + children, "moving a parent recomputes only its subtree");
+
+	// Everything dirty is the cost of recomputing the whole scene
+	seconds = benchSeconds([&] {
+		for (int move = 0; move < moves; move++)
+		{
+			hierarchy.setLocal(0, randomLocal(rng));
+			updated = hierarchy.update();
+		}
+	});
+	ctx.report("move scene root of " + std::to_string(hierarchy.size()), seconds / moves * 1e6, "us");
+	ctx.check(updated == hierarchy.size(), "moving the root recomputes every node");
+
+	// A group and objects inside it moved in the same frame are recomputed once each
+	hierarchy.setLocal(parent + 5, randomLocal(rng));
+	hierarchy.setLocal(parent, randomLocal(rng));
+	hierarchy.setLocal(parent + 1, randomLocal(rng));
+	hierarchy.setLocal(parent, randomLocal(rng));
+	ctx.check(hierarchy.update() == subtreeSize, "nested moves recompute the enclosing subtree once");
+
+	// A single object moves alone
+	const std::vector<DirectX::XMFLOAT3X4> before = hierarchy.worlds;
+	hierarchy.setLocal(parent + 7, randomLocal(rng));
+	changed.clear();
+	ctx.check(hierarchy.update(&changed) == 1 && changed.size() == 1 && changed[0] == parent + 7, "a leaf recomputes alone");
+	bool othersKept = true;
+	for (size_t i = 0; i < hierarchy.size(); i++)
+		if (i != parent + 7)
+			othersKept &= memcmp(&before[i], &hierarchy.worlds[i], sizeof(DirectX::XMFLOAT3X4)) == 0;
+	ctx.check(othersKept, "other nodes keep their worlds");
+	ctx.check(hierarchy.update() == 0, "a clean hierarchy recomputes nothing");
+	ctx.check(sameWorlds(hierarchy, referenceWorlds(hierarchy)), "incremental worlds match the parent chains");
+}
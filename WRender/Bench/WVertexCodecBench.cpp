@@ -0,0 +1,259 @@
+#include "WBench.h"
+#include "../Utils/WVertexCodec.h"
+#include "../Utils/WMeshOptimizer.h"
+#include "../Utils/WSceneDescParser.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
+#include <memory>
+
+namespace
+{
+	// Uniform directions plus the axes, the octant diagonals and points next to the folded edges
+	std::vector<float> benchNormals(size_t count, UINT32 seed)
+	{
+		std::vector<float> normals;
+		const float edge = 1e-4f;
+		const float special[][3] = {
+			{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+			{ 1, 1, 1 }, { -1, 1, -1 }, { 1, -1, -1 }, { -1, -1, 1 },
+			{ 0.5f, 0.5f, -edge }, { -0.5f, 0.5f, edge }, { edge, -0.7f, -0.7f }, { -edge, 0.7f, -0.7f } };
+		for (const auto& n : special)
+			normals.insert(normals.end(), n, n + 3);
+		std::mt19937 rng(seed);
+		std::normal_distribution<float> gauss;
+		while (normals.size() < 3 * count)
+		{
+			float n[3] = { gauss(rng), gauss(rng), gauss(rng) };
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length < 1e-6f)
+				continue;
+			for (float& c : n)
+				normals.push_back(c / length);
+		}
+		return normals;
+	}
+
+	double angleBetween(const float* a, const float* b)
+	{
+		double cx = double(a[1]) * b[2] - double(a[2]) * b[1];
+		double cy = double(a[2]) * b[0] - double(a[0]) * b[2];
+		double cz = double(a[0]) * b[1] - double(a[1]) * b[0];
+		double dot = double(a[0]) * b[0] + double(a[1]) * b[1] + double(a[2]) * b[2];
+		return std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot);
+	}
+
+	WMeshData texCoordMesh(const std::vector<float>& texCoords)
+	{
+		WMeshData mesh;
+		mesh.texCoords = texCoords;
+		return mesh;
+	}
+
+	// A cube with a normal per face and texcoords per corner, so welding splits its corners, a
+	// quad without texcoords and one tiled far beyond what half precision holds
+	void writeWeldScene(const std::string& sceneName, const std::string& cubeName, const std::string& quadName,
+		const std::string& tiledName)
+	{
+		std::ofstream cube(cubeName, std::ios::binary);
+		cube << "v -1 -1 -1\nv 1 -1 -1\nv 1 1 -1\nv -1 1 -1\nv -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\n"
+			"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+			"vn 0 0 -1\nvn 0 0 1\nvn 0 -1 0\nvn 0 1 0\nvn -1 0 0\nvn 1 0 0\n"
+			"f 1/1/1 4/4/1 3/3/1\nf 1/1/1 3/3/1 2/2/1\nf 5/1/2 6/2/2 7/3/2\nf 5/1/2 7/3/2 8/4/2\n"
+			"f 1/1/3 2/2/3 6/3/3\nf 1/1/3 6/3/3 5/4/3\nf 4/1/4 8/2/4 7/3/4\nf 4/1/4 7/3/4 3/4/4\n"
+			"f 1/1/5 5/2/5 8/3/5\nf 1/1/5 8/3/5 4/4/5\nf 2/1/6 3/2/6 7/3/6\nf 2/1/6 7/3/6 6/4/6\n";
+		std::ofstream quad(quadName, std::ios::binary);
+		quad << "v 0 0 0\nv 1 0 0\nv 1 0 1\nv 0 0 1\nvn 0 1 0\nf 1//1 3//1 2//1\nf 1//1 4//1 3//1\n";
+		std::ofstream tiled(tiledName, std::ios::binary);
+		tiled << "v 0 0 0\nv 1 0 0\nv 1 0 1\nv 0 0 1\nvt 0.1 0.2\nvt 37.3 0.2\nvt 37.3 -41.7\nvt 0.1 -41.7\nvn 0 1 0\n"
+			"f 1/1/1 3/3/1 2/2/1\nf 1/1/1 4/4/1 3/3/1\n";
+		std::ofstream scene(sceneName, std::ios::binary);
+		scene << "<scene>\n";
+		for (const std::string& geometry : { cubeName, quadName, tiledName })
+			scene << "\t<object name=\"" << geometry << "\">\n\t\t<Material name=\"white\">\n\t\t\t<albedo>1,1,1,1</albedo>\n"
+				"\t\t</Material>\n\t\t<Mesh>\n\t\t\t<geometry>" << geometry << "</geometry>\n\t\t</Mesh>\n\t</object>\n";
+		scene << "</scene>\n";
+	}
+
+	std::unique_ptr<WSceneDescParser> parseWeldScene(const std::string& sceneName, bool weld, bool quantize)
+	{
+		auto parser = std::make_unique<WSceneDescParser>();
+		parser->setUseSceneCache(false);
+		parser->setWeldVertices(weld);
+		parser->setQuantizeAttributes(quantize);
+		if (!parser->Parse(sceneName.c_str()))
+			return nullptr;
+		return parser;
+	}
+
+	// Every corner of the welded scenes has to see the position, normal and texcoord the
+	// separate index streams of the reference give it, through its one index
+	bool sameCorners(WSceneDescParser& reference, WSceneDescParser& welded)
+	{
+		const auto referenceVertices = reference.getVertexBuffer(), vertices = welded.getVertexBuffer();
+		const auto referenceNormals = reference.getNormalBuffer(), referenceTexCoords = reference.getTexCoordBuffer();
+		const auto referenceIndices = reference.getIndexBuffer(), indices = welded.getIndexBuffer();
+		const auto normalIndices = reference.getNormalIndexBuffer(), texCoordIndices = reference.getTexCoordIndexBuffer();
+		const auto attributes = welded.getVertexAttributeBuffer();
+		const auto packedAttributes = welded.getPackedVertexAttributeBuffer();
+		const auto floatTexCoords = welded.getPackedTexCoordBuffer();
+		const bool quantized = welded.isQuantized();
+		const size_t stride = quantized ? sizeof(SPackedVertexAttributes) : sizeof(SVertexAttributes);
+		if (!welded.getNormalBuffer().empty() || !welded.getPackedNormalBuffer().empty() || !welded.getNormalIndexBuffer().empty() ||
+			(quantized ? packedAttributes.empty() || !attributes.empty() : attributes.empty() || !packedAttributes.empty()))
+			return false;
+		for (const auto& gItem : reference.getGeometryMap())
+		{
+			const WGeometryRecord& r = gItem.second;
+			const WGeometryRecord& w = welded.getGeometryMap().at(gItem.first);
+			if (w.indexCount != r.indexCount || (r.texCoordOffsetInBytes < 0) != (w.texCoordOffsetInBytes < 0) ||
+				(w.texCoordOffsetInBytes >= 0 && !w.floatTexCoords && w.texCoordOffsetInBytes != w.normalOffsetInBytes))
+				return false;
+			for (size_t k = 0; k < r.indexCount; k++)
+			{
+				const size_t referenceCorner = r.indexOffsetInBytes / sizeof(UINT32) + k;
+				const size_t vertex = indices[w.indexOffsetInBytes / sizeof(UINT32) + k];
+				const float* p = &referenceVertices[r.vertexOffsetInBytes / sizeof(float) + 3 * size_t(referenceIndices[referenceCorner])];
+				const float* q = &vertices[w.vertexOffsetInBytes / sizeof(float) + 3 * vertex];
+				const float* n = &referenceNormals[r.normalOffsetInBytes / sizeof(float) + 3 * size_t(normalIndices[referenceCorner])];
+				const float zero[2] = { 0, 0 };
+				const float* uv = r.texCoordOffsetInBytes < 0 ? zero :
+					&referenceTexCoords[r.texCoordOffsetInBytes / sizeof(float) + 2 * size_t(texCoordIndices[referenceCorner])];
+				const size_t attribute = w.normalOffsetInBytes / stride + vertex;
+				bool same = p[0] == q[0] && p[1] == q[1] && p[2] == q[2];
+				if (quantized && w.floatTexCoords)
+				{
+					// Float bit pairs in the packed texcoord buffer, addressed with the same index
+					const size_t texCoord = w.texCoordOffsetInBytes / sizeof(UINT32) + 2 * vertex;
+					same &= packedAttributes[2 * attribute] == encodeOctahedralNormal(n[0], n[1], n[2]) &&
+						packedAttributes[2 * attribute + 1] == 0 && memcmp(&floatTexCoords[texCoord], uv, 2 * sizeof(float)) == 0;
+				}
+				else if (quantized)
+					same &= packedAttributes[2 * attribute] == encodeOctahedralNormal(n[0], n[1], n[2]) &&
+						packedAttributes[2 * attribute + 1] == (r.texCoordOffsetInBytes < 0 ? 0 : encodeHalfTexCoord(uv[0], uv[1]));
+				else
+					same &= std::equal(n, n + 3, &attributes[5 * attribute]) && std::equal(uv, uv + 2, &attributes[5 * attribute + 3]);
+				if (!same)
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+void benchVertexCodec(WBenchContext& ctx)
+{
+	// Every half except NaN survives a round trip through float
+	bool halfRoundTrip = true;
+	for (UINT32 h = 0; h < 0x10000; h++)
+	{
+		const UINT16 half = static_cast<UINT16>(h);
+		if ((half & 0x7C00) == 0x7C00 && (half & 0x3FF) != 0)
+			continue;
+		halfRoundTrip &= floatToHalf(halfToFloat(half)) == half;
+	}
+	ctx.check(halfRoundTrip, "every half round trips through float");
+	// Ties between two halves go to the even one
+	ctx.check(floatToHalf(1.0f + 1.0f / 2048.0f) == 0x3C00, "1 + 2^-11 rounds down to even");
+	ctx.check(floatToHalf(1.0f + 3.0f / 2048.0f) == 0x3C02, "1 + 3 * 2^-11 rounds up to even");
+	ctx.check(floatToHalf(70000.0f) == 0x7C00, "values above the half range become infinity");
+
+	const size_t count = ctx.size(4000000, 200000);
+	const std::vector<float> normals = benchNormals(count, 5);
+	std::vector<UINT32> packed(count);
+	double seconds = benchSeconds([&] {
+		for (size_t i = 0; i < count; i++)
+			packed[i] = encodeOctahedralNormal(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+	});
+	ctx.report("normal encode", count / seconds * 1e-6, "M/s");
+	std::vector<float> decoded(3 * count);
+	seconds = benchSeconds([&] {
+		for (size_t i = 0; i < count; i++)
+			decodeOctahedralNormal(packed[i], decoded[3 * i], decoded[3 * i + 1], decoded[3 * i + 2]);
+	});
+	ctx.report("normal decode", count / seconds * 1e-6, "M/s");
+	double maxAngle = 0.0;
+	for (size_t i = 0; i < count; i++)
+		maxAngle = (std::max)(maxAngle, angleBetween(&normals[3 * i], &decoded[3 * i]));
+	ctx.report("max normal error", maxAngle, "rad");
+	ctx.check(maxAngle <= WOctNormalMaxAngularError, "octahedral normals within their error bound");
+
+	// quantizeMeshAttributes has to agree with the standalone measurement
+	WMeshData normalMesh;
+	normalMesh.normals = normals;
+	WQuantizationStats normalStats = quantizeMeshAttributes(normalMesh);
+	// It measures with float cross products, so the last digits differ
+	ctx.check(normalStats.withinBounds && std::fabs(normalStats.maxNormalError - maxAngle) <= 1e-3 * maxAngle,
+		"quantizeMeshAttributes measures the same normal error");
+	ctx.check(normalStats.bytesAfter * 3 == normalStats.bytesBefore, "packed normals take a third of the floats");
+
+	// Texcoords in [-1, 1] hold the absolute bound, tiled texcoords further out must fail it
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<float> texCoords(2 * count);
+	for (auto& c : texCoords)
+		c = unit(rng);
+	texCoords[0] = 1.0f;
+	texCoords[1] = -1.0f;
+	WMeshData unitMesh = texCoordMesh(texCoords);
+	WQuantizationStats unitStats = quantizeMeshAttributes(unitMesh);
+	ctx.report("max texcoord error in [-1, 1]", unitStats.maxTexCoordError, "");
+	ctx.check(unitStats.withinBounds, "texcoords in [-1, 1] within the absolute bound");
+	bool decodedMatch = true;
+	for (size_t i = 0; i < count; i++)
+	{
+		float u, v;
+		decodeHalfTexCoord(unitMesh.packedTexCoords[i], u, v);
+		decodedMatch &= std::fabs(u - texCoords[2 * i]) <= WHalfTexCoordMaxAbsoluteError &&
+			std::fabs(v - texCoords[2 * i + 1]) <= WHalfTexCoordMaxAbsoluteError;
+	}
+	ctx.check(decodedMatch, "decoded texcoords match the source");
+
+	ctx.check(!unitStats.floatTexCoords, "texcoords in [-1, 1] are packed");
+
+	// Half precision loses too much on tiled texcoords, those meshes keep the floats
+	const std::vector<float> tiledTexCoords = { 0.25f, 0.5f, 37.3f, 0.1f };
+	float halfU, halfV;
+	decodeHalfTexCoord(encodeHalfTexCoord(37.3f, 0.1f), halfU, halfV);
+	ctx.report("half texcoord error at 37.3", std::fabs(double(halfU) - 37.3f), "");
+	WMeshData tiledMesh = texCoordMesh(tiledTexCoords);
+	WQuantizationStats tiledStats = quantizeMeshAttributes(tiledMesh);
+	ctx.check(std::fabs(double(halfU) - 37.3f) > WHalfTexCoordMaxAbsoluteError, "half exceeds the bound at 37.3");
+	ctx.check(tiledStats.floatTexCoords && tiledStats.withinBounds && tiledStats.maxTexCoordError == 0.0 &&
+		tiledMesh.texCoords == tiledTexCoords && tiledMesh.packedTexCoords.empty(), "texcoords tiled far out stay float");
+
+	const std::string sceneName = ctx.tempPath("weld.xml");
+	const std::string cubeName = ctx.tempPath("weld_cube.obj"), quadName = ctx.tempPath("weld_quad.obj");
+	const std::string tiledName = ctx.tempPath("weld_tiled.obj");
+	writeWeldScene(sceneName, cubeName, quadName, tiledName);
+	auto reference = parseWeldScene(sceneName, false, false);
+	auto quantized = parseWeldScene(sceneName, false, true);
+	auto welded = parseWeldScene(sceneName, true, false);
+	auto weldedQuantized = parseWeldScene(sceneName, true, true);
+	ctx.check(reference && quantized && welded && weldedQuantized && reference->getGeometryMap().size() == 3,
+		"the weld scene parses");
+	if (reference && quantized && welded && weldedQuantized)
+	{
+		ctx.check(welded->getVertexBuffer().size() == 3 * (24 + 4 + 4), "welding splits the cube's corners by face");
+		ctx.check(sameCorners(*reference, *welded), "welded corners read interleaved attributes through their one index");
+		ctx.check(sameCorners(*reference, *weldedQuantized), "packed welded corners read interleaved attributes through their one index");
+
+		// Unwelded, the tiled quad's float pairs sit among the packed texcoords at its texcoord indices
+		const WGeometryRecord& r = reference->getGeometryMap().at(tiledName);
+		const WGeometryRecord& q = quantized->getGeometryMap().at(tiledName);
+		const auto referenceTexCoords = reference->getTexCoordBuffer();
+		const auto packedTexCoords = quantized->getPackedTexCoordBuffer();
+		const auto referenceIndices = reference->getTexCoordIndexBuffer(), indices = quantized->getTexCoordIndexBuffer();
+		bool exact = q.floatTexCoords && !quantized->getGeometryMap().at(cubeName).floatTexCoords;
+		for (size_t k = 0; exact && k < r.indexCount; k++)
+			exact = memcmp(&packedTexCoords[q.texCoordOffsetInBytes / sizeof(UINT32) + 2 * size_t(indices[q.indexOffsetInBytes / sizeof(UINT32) + k])],
+				&referenceTexCoords[r.texCoordOffsetInBytes / sizeof(float) + 2 * size_t(referenceIndices[r.indexOffsetInBytes / sizeof(UINT32) + k])],
+				2 * sizeof(float)) == 0;
+		ctx.check(exact, "quantized scenes keep tiled texcoords exact");
+	}
+	std::error_code ec;
+	for (const std::string& file : { sceneName, cubeName, quadName, tiledName })
+		std::filesystem::remove(file, ec);
+}
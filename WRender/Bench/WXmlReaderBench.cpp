@@ -0,0 +1,222 @@
+#include "WBench.h"
+#include "WXmlSceneWalk.h"
+#include "../Utils/WXmlReader.h"
+#include "../Utils/WMappedFile.h"
+#include "../Utils/WSceneDescParser.h"
+#include <vector>
+#include <random>
+#include <charconv>
+#include <fstream>
+#include <filesystem>
+#include <memory>
+
+namespace
+{
+	void appendFloats(std::string& xml, std::mt19937& rng, int count, float low, float high)
+	{
+		std::uniform_real_distribution<float> value(low, high);
+		char buffer[32];
+		for (int i = 0; i < count; i++)
+		{
+			if (i > 0)
+				xml += ',';
+			xml.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value(rng)).ptr);
+		}
+	}
+
+	// "objects" objects with their own material and a TRS transform, laid out like the exported
+	// scenes, after a light and a camera the walks skip
+	void writeScene(const std::string& path, size_t objects)
+	{
+		std::mt19937 rng(17);
+		std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<scene>\n";
+		xml += "\t<!-- generated by WBench -->\n";
+		xml += "\t<light>\n\t\t<corner>-1,4,-1</corner>\n\t\t<v1>2,0,0</v1>\n\t\t<v2>0,0,2</v2>\n\t\t<emission>10,10,10</emission>\n\t</light>\n";
+		xml += "\t<camera>\n\t\t<position>0,2,-10</position>\n\t\t<direction>0,0,1</direction>\n\t</camera>\n";
+		for (size_t i = 0; i < objects; i++)
+		{
+			const std::string index = std::to_string(i);
+			xml += "\t<object name=\"object_" + index + "\">\n";
+			xml += "\t\t<Material name=\"material_" + index + "\">\n\t\t\t<albedo>";
+			appendFloats(xml, rng, 3, 0.0f, 1.0f);
+			xml += ",1</albedo>\n\t\t\t<smoothness>";
+			appendFloats(xml, rng, 1, 0.0f, 1.0f);
+			xml += "</smoothness>\n\t\t\t<metallic>";
+			appendFloats(xml, rng, 1, 0.0f, 1.0f);
+			xml += "</metallic>\n\t\t\t<emission>";
+			appendFloats(xml, rng, 3, 0.0f, 4.0f);
+			xml += "</emission>\n\t\t</Material>\n";
+			xml += "\t\t<Mesh>\n\t\t\t<geometry>mesh_" + std::to_string(i % 8) + ".obj</geometry>\n\t\t\t<transform>\n\t\t\t\t<translation>";
+			appendFloats(xml, rng, 3, -1000.0f, 1000.0f);
+			xml += "</translation>\n\t\t\t\t<rotation>";
+			appendFloats(xml, rng, 3, -180.0f, 180.0f);
+			xml += "</rotation>\n\t\t\t\t<scale>";
+			appendFloats(xml, rng, 3, 0.25f, 4.0f);
+			xml += "</scale>\n\t\t\t</transform>\n\t\t</Mesh>\n\t</object>\n";
+		}
+		xml += "</scene>\n";
+		std::ofstream(path, std::ios::binary).write(xml.data(), xml.size());
+	}
+
+	void addFloats(std::string_view text, std::vector<float>& scratch, WXmlSceneSummary& summary)
+	{
+		scratch.clear();
+		parseFloatList(text, scratch);
+		for (float value : scratch)
+			summary.floatSum += value;
+		summary.floats += scratch.size();
+	}
+
+	// The walk of walkSceneTinyXml on the pull reader, the way WSceneDescParser reads the scene
+	bool walkSceneXmlReader(const std::string& path, WXmlSceneSummary& summary)
+	{
+		WMappedFile file;
+		if (!file.Open(path))
+			return false;
+		WXmlReader reader(file.data(), static_cast<size_t>(file.size()));
+		if (!reader.nextChild() || reader.name() != "scene")
+			return false;
+		std::vector<float> scratch;
+		while (reader.nextChild())
+		{
+			if (reader.name() != "object")
+			{
+				reader.skip();
+				continue;
+			}
+			summary.objects++;
+			summary.nameChars += reader.attribute("name").size();
+			while (reader.nextChild())
+			{
+				if (reader.name() == "Material")
+				{
+					summary.materials++;
+					summary.nameChars += reader.attribute("name").size();
+					while (reader.nextChild())
+						addFloats(reader.readText(), scratch, summary);
+				}
+				else if (reader.name() == "Mesh")
+				{
+					while (reader.nextChild())
+					{
+						if (reader.name() == "geometry")
+							summary.nameChars += reader.readText().size();
+						else if (reader.name() == "transform")
+							while (reader.nextChild())
+								addFloats(reader.readText(), scratch, summary);
+						else
+							reader.skip();
+					}
+				}
+				else
+					reader.skip();
+			}
+		}
+		return !reader.failed();
+	}
+
+	void walkAll(WXmlReader& reader)
+	{
+		while (reader.nextChild())
+			walkAll(reader);
+	}
+
+	// Reads a whole document and returns the reader's error, empty when it is well formed
+	std::string readError(const std::string& xml)
+	{
+		WXmlReader reader(xml.data(), xml.size());
+		walkAll(reader);
+		return reader.failed() ? reader.error() : std::string();
+	}
+
+	void checkErrors(WBenchContext& ctx)
+	{
+		ctx.check(readError("<scene>\n\t<object>\n\t\t<t></u>\n\t</object>\n</scene>") == "3:6: end tag </u> does not match <t>",
+			"mismatched end tags are reported with line and column");
+		ctx.check(readError("<scene>\n\t<object>") == "2:10: unexpected end of document, <object> is not closed",
+			"unclosed elements are reported");
+		ctx.check(readError("<scene a=1/>").find("expected a quoted value for attribute a") != std::string::npos,
+			"unquoted attributes are rejected");
+		ctx.check(readError("<scene><!-- open").find("unterminated markup, missing -->") != std::string::npos,
+			"unterminated comments are rejected");
+		ctx.check(readError("</scene>").find("unexpected end tag </scene>") != std::string::npos,
+			"end tags without a start tag are rejected");
+
+		std::string deep;
+		for (UINT32 i = 0; i <= WXmlReader::MaxDepth; i++)
+			deep += "<e>";
+		ctx.check(readError(deep).find("elements nested deeper than 64") != std::string::npos, "nesting is limited");
+		std::string attributes = "<e";
+		for (UINT32 i = 0; i <= WXmlReader::MaxAttributes; i++)
+			attributes += " a" + std::to_string(i) + "=\"0\"";
+		ctx.check(readError(attributes + "/>").find("more than 16 attributes in <e>") != std::string::npos,
+			"attribute count is limited");
+
+		const std::string xml =
+			"<?xml version=\"1.0\"?>\n<!DOCTYPE scene>\n<scene>\n"
+			"\t<!-- <object name=\"commented\"/> -->\n"
+			"\t<name>a &lt;b&gt; &amp; &#65;&#x42;</name>\n"
+			"\t<code><![CDATA[x < y]]></code>\n"
+			"\t<v f=\" 2.5 \" u=\"7\" b=\"True\" bad=\"1.5x\"/>\n"
+			"</scene>\n";
+		WXmlReader reader(xml.data(), xml.size());
+		bool read = reader.nextChild() && reader.name() == "scene" && reader.nextChild() && reader.name() == "name" &&
+			WXmlReader::decode(reader.readText()) == "a <b> & AB" && reader.nextChild() && reader.name() == "code" &&
+			reader.readText() == "x < y" && reader.nextChild() && reader.name() == "v";
+		float f = 0.0f, bad = -1.0f;
+		UINT32 u = 0;
+		bool b = false;
+		read = read && reader.queryFloatAttribute("f", f) && f == 2.5f && reader.queryUnsignedAttribute("u", u) && u == 7 &&
+			reader.queryBoolAttribute("b", b) && b && !reader.queryFloatAttribute("bad", bad) && bad == -1.0f &&
+			!reader.queryFloatAttribute("missing", bad) && !reader.hasAttribute("missing");
+		reader.skip();
+		read = read && !reader.nextChild() && !reader.nextChild() && !reader.failed();
+		ctx.check(read, "comments, declarations, entities and CDATA are read");
+
+		float values[4] = {};
+		ctx.check(parseFloats("1, 2;3\n4", values, 4) && values[0] == 1.0f && values[3] == 4.0f &&
+			!parseFloats("1,2", values, 3) && !parseFloats("1,2,3,4", values, 3) && !parseFloats("1,x,3", values, 3),
+			"parseFloats takes exactly the expected count");
+		std::vector<float> list;
+		ctx.check(parseFloatList(" 1e3,-2.5 ", list) && list == std::vector<float>{ 1000.0f, -2.5f } && !parseFloatList("1,x", list),
+			"parseFloatList reads every number");
+	}
+}
+
+void benchXmlReader(WBenchContext& ctx)
+{
+	checkErrors(ctx);
+
+	const size_t objects = ctx.size(100000, 5000);
+	const std::string path = ctx.tempPath("wbench_scene.xml");
+	writeScene(path, objects);
+	const double megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+	ctx.report("scene " + std::to_string(objects) + " objects", megabytes, "MB");
+
+	WXmlSceneSummary tinyXml, xmlReader;
+	bool walked = true;
+	double seconds = benchSeconds([&] {
+		tinyXml = WXmlSceneSummary();
+		walked &= walkSceneTinyXml(path, tinyXml);
+	});
+	ctx.report("tinyxml2 DOM + stof", megabytes / seconds, "MB/s");
+	const double tinyXmlSeconds = seconds;
+	seconds = benchSeconds([&] {
+		xmlReader = WXmlSceneSummary();
+		walked &= walkSceneXmlReader(path, xmlReader);
+	});
+	ctx.report("WXmlReader + from_chars", megabytes / seconds, "MB/s");
+	ctx.report("speedup", tinyXmlSeconds / seconds, "x");
+	ctx.check(walked, "both readers parse the scene");
+	ctx.check(xmlReader == tinyXml && xmlReader.objects == objects && xmlReader.materials == objects &&
+		xmlReader.floats == objects * 18, "both readers see the same objects, names and numbers");
+
+	// The whole description parse with every handler of the loader
+	bool parsed = true;
+	seconds = benchSeconds([&] {
+		parsed &= std::make_unique<WSceneDescParser>()->ParseDescription(path.c_str());
+	});
+	ctx.report("ParseDescription", megabytes / seconds, "MB/s");
+	ctx.check(parsed, "the loader parses the generated scene");
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+// What a walk over the generated bench scene collected, both readers have to agree on it
+struct WXmlSceneSummary
+{
+	size_t objects = 0;
+	size_t materials = 0;
+	size_t floats = 0;
+	double floatSum = 0.0;
+	// Characters of the object, material and geometry names
+	size_t nameChars = 0;
+
+	bool operator==(const WXmlSceneSummary& rhs) const
+	{
+		return objects == rhs.objects && materials == rhs.materials && floats == rhs.floats &&
+			floatSum == rhs.floatSum && nameChars == rhs.nameChars;
+	}
+};
+
+// The scene loading path before WXmlReader: the file copied through a stringstream, a
+// tinyxml2 DOM and istringstream + std::stof for the numbers
+bool walkSceneTinyXml(const std::string& path, WXmlSceneSummary& summary);
@@ -0,0 +1,69 @@
+#include "WXmlSceneWalk.h"
+#include <../Include/tinyxml2.h>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+namespace
+{
+	// parseFloat3/parseFloat4 as they were, for any number of comma separated values
+	void addFloats(const char* text, WXmlSceneSummary& summary)
+	{
+		if (!text)
+			return;
+		std::istringstream tstream(text);
+		std::string tmpVal;
+		while (std::getline(tstream, tmpVal, ','))
+		{
+			summary.floatSum += std::stof(tmpVal);
+			summary.floats++;
+		}
+	}
+
+	void addName(const char* name, WXmlSceneSummary& summary)
+	{
+		if (name)
+			summary.nameChars += strlen(name);
+	}
+}
+
+bool walkSceneTinyXml(const std::string& path, WXmlSceneSummary& summary)
+{
+	std::ifstream XMLFileStream(path);
+	std::stringstream XMLContentBuffer;
+	XMLContentBuffer << XMLFileStream.rdbuf();
+	std::string XMLContentStr(XMLContentBuffer.str());
+	tinyxml2::XMLDocument XMLParser;
+	if (XMLParser.Parse(XMLContentStr.c_str()) != tinyxml2::XML_SUCCESS)
+		return false;
+
+	tinyxml2::XMLElement* root = XMLParser.FirstChildElement("scene");
+	if (!root)
+		return false;
+	for (tinyxml2::XMLElement* e = root->FirstChildElement(); e; e = e->NextSiblingElement())
+	{
+		if (std::string(e->Value()) != "object")
+			continue;
+		summary.objects++;
+		addName(e->Attribute("name"), summary);
+		tinyxml2::XMLElement* materialElem = e->FirstChildElement("Material");
+		if (materialElem)
+		{
+			summary.materials++;
+			addName(materialElem->Attribute("name"), summary);
+			for (tinyxml2::XMLElement* p = materialElem->FirstChildElement(); p; p = p->NextSiblingElement())
+				addFloats(p->GetText(), summary);
+		}
+		tinyxml2::XMLElement* meshElem = e->FirstChildElement("Mesh");
+		if (!meshElem)
+			continue;
+		tinyxml2::XMLElement* geometryElem = meshElem->FirstChildElement("geometry");
+		if (geometryElem)
+			addName(geometryElem->GetText(), summary);
+		tinyxml2::XMLElement* transformElem = meshElem->FirstChildElement("transform");
+		if (transformElem)
+			for (tinyxml2::XMLElement* t = transformElem->FirstChildElement(); t; t = t->NextSiblingElement())
+				addFloats(t->GetText(), summary);
+	}
+	return true;
+}
@@ -62,9 +62,9 @@ static const D3D12_HEAP_PROPERTIES kDefaultHeapProps = {
     D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 0, 0};
 
 //--------------------------------------------------------------------------------------------------
-// Compile a HLSL file into a DXIL library
+// Compile a HLSL file into a DXIL library, with optional preprocessor defines
 //
-IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
+IDxcBlob* CompileShaderLibrary(LPCWSTR fileName, const DxcDefine* defines = nullptr, UINT32 defineCount = 0)
 {
   static IDxcCompiler* pCompiler = nullptr;
   static IDxcLibrary* pLibrary = nullptr;
@@ -96,7 +96,7 @@ IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
 
   // Compile
   IDxcOperationResult* pResult;
-  ThrowIfFailed(pCompiler->Compile(pTextBlob, fileName, L"", L"lib_6_3", nullptr, 0, nullptr, 0,
+  ThrowIfFailed(pCompiler->Compile(pTextBlob, fileName, L"", L"lib_6_3", nullptr, 0, defines, defineCount,
                                    dxcIncludeHandler, &pResult));
 
   // Verify the result
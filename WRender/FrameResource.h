@@ -15,13 +15,18 @@ struct WObjectConstants
 	UINT     IndexOffset;
 	INT32    NormalOffset = -1;
 	INT32    TexCoordOffset = -1;
+	INT32    MaterialIdOffset = -1;  // First triangle's entry in the material id buffer, -1 uses MatIdx
+	UINT     MaterialIdBits = 0;
+	UINT     FloatTexCoords = 0;  // Quantized scene, the texcoords are float pairs in the packed texcoord buffer
 
 	WObjectConstants() = default;
 	WObjectConstants(
 		DirectX::XMMATRIX _Transform, UINT _MatIdx, UINT _VertexOffset, 
-		UINT _IndexOffset, INT32 _NormalOffset = -1, INT32 _TexCoordOffset = -1)
+		UINT _IndexOffset, INT32 _NormalOffset = -1, INT32 _TexCoordOffset = -1,
+		INT32 _MaterialIdOffset = -1, UINT _MaterialIdBits = 0, UINT _FloatTexCoords = 0)
 		: MatIdx(_MatIdx), VertexOffset(_VertexOffset), IndexOffset(_IndexOffset),
-		NormalOffset(_NormalOffset), TexCoordOffset(_TexCoordOffset)
+		NormalOffset(_NormalOffset), TexCoordOffset(_TexCoordOffset),
+		MaterialIdOffset(_MaterialIdOffset), MaterialIdBits(_MaterialIdBits), FloatTexCoords(_FloatTexCoords)
 	{
 		auto InvMatrix = DirectX::XMMatrixInverse(&XMMatrixDeterminant(_Transform), _Transform);
 		auto InvTranposeMatrix = DirectX::XMMatrixTranspose(InvMatrix);
@@ -29,6 +34,17 @@ struct WObjectConstants
 		DirectX::XMStoreFloat4x4(&InvTranspose, InvTranposeMatrix);
 		DirectX::XMStoreFloat4x4(&ObjectToWorld, _Transform);
 	};
+	// Matrices computed in a batch by objectMatricesBatch
+	WObjectConstants(
+		const DirectX::XMFLOAT4X4& _ObjectToWorld, const DirectX::XMFLOAT4X4& _InvTranspose, UINT _MatIdx,
+		UINT _VertexOffset, UINT _IndexOffset, INT32 _NormalOffset = -1, INT32 _TexCoordOffset = -1,
+		INT32 _MaterialIdOffset = -1, UINT _MaterialIdBits = 0, UINT _FloatTexCoords = 0)
+		: ObjectToWorld(_ObjectToWorld), InvTranspose(_InvTranspose), MatIdx(_MatIdx),
+		VertexOffset(_VertexOffset), IndexOffset(_IndexOffset),
+		NormalOffset(_NormalOffset), TexCoordOffset(_TexCoordOffset),
+		MaterialIdOffset(_MaterialIdOffset), MaterialIdBits(_MaterialIdBits), FloatTexCoords(_FloatTexCoords)
+	{
+	};
 };
 
 struct WPassConstants
@@ -55,6 +71,9 @@ struct WPassConstantsItem
 	UINT SqrtSamples = 1;
 	UINT MaxDepth = 16;
 	UINT NumFaces = 0;
+	UINT NumAnimatedObjects = 0;
+	bool PlayAnimations = true;
+	float AnimationTime = 0.0f;
 
 	// Dirty flag indicating the material has changed and we need to update the constant buffer.
 	// Because we have a material constant buffer for each FrameResource, we have to apply the
@@ -79,6 +98,30 @@ struct STexCoord
 	DirectX::XMFLOAT2 UV;
 };
 
+// Quantized attributes, see Utils/WVertexCodec.h
+struct SPackedNormal
+{
+	UINT32 Oct;
+};
+
+struct SPackedTexCoord
+{
+	UINT32 UV;
+};
+
+// Normal and texcoord of one vertex of a welded mesh, read with the position's index
+struct SVertexAttributes
+{
+	DirectX::XMFLOAT3 Normal;
+	DirectX::XMFLOAT2 UV;
+};
+
+struct SPackedVertexAttributes
+{
+	UINT32 Oct;
+	UINT32 UV;
+};
+
 struct RVertex
 {
 	typedef DirectX::XMFLOAT3 XMFLOAT3;
@@ -202,12 +245,14 @@ struct WTexture
 struct WGeometryRecord
 {
 	// -1 means not used
-	UINT64 vertexOffsetInBytes;  // Offset of the first vertex in the vertex buffer
+	UINT64 vertexOffsetInBytes = 0;  // Offset of the first vertex in the vertex buffer
 	INT64 normalOffsetInBytes = -1;  // Offset of the first normal in the normal buffer
 	INT64 texCoordOffsetInBytes = -1;  // Offset of the first texcoord in the texcoord buffer
-	UINT32 vertexCount;    // Number of vertices to consider in the buffer
-	UINT64 indexOffsetInBytes;  // Offset of the first index in the index buffer
-	UINT32 indexCount;    // Number of indices to consider in the buffer
+	UINT32 vertexCount = 0;    // Number of vertices to consider in the buffer
+	UINT64 indexOffsetInBytes = 0;  // Offset of the first index in the index buffer
+	UINT32 indexCount = 0;    // Number of indices to consider in the buffer
+	INT64 materialIdOffset = -1;  // First triangle's entry in the material id buffer
+	bool floatTexCoords = false;  // Quantized scene, the texcoords are float pairs in the packed texcoord buffer
 
 };
 
@@ -227,45 +272,22 @@ struct WRenderItem
 	UINT32 vertexCount;    // Number of vertices to consider in the buffer
 	UINT64 indexOffsetInBytes;  // Offset of the first index in the index buffer
 	UINT32 indexCount;    // Number of indices to consider in the buffer
-
-	DirectX::XMMATRIX transform;
+	INT64 materialIdOffset = -1;  // First triangle's entry in the material id buffer
+	bool floatTexCoords = false;  // Quantized scene, the texcoords are float pairs in the packed texcoord buffer
+
+	// LOD policy from <lod>: a fixed level, or camera distances at which the next level starts
+	UINT32 lodLevel = 0;
+	std::vector<float> lodDistances;
+	// Level picked when the geometry is loaded, the buffers above describe lodGeometryName(geometryName, lodSelected)
+	UINT32 lodSelected = 0;
+
+	// As parsed and relative to the enclosing <group>, the running scene keeps transforms and TRS
+	// in WInstanceStore and world matrices in WTransformHierarchy
+	DirectX::XMMATRIX transform = DirectX::XMMatrixIdentity();
 	DirectX::XMFLOAT3 translation = { 0,0,0 };
 	DirectX::XMFLOAT3 rotation = { 0,0,0 };
 	DirectX::XMFLOAT3 scaling = { 1,1,1 };
-
-	WMaterial* material = nullptr;
-
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
-	void UpdateTransform()
-	{
-		// translation
-		auto& transformF4x4 = MathHelper::Identity4x4();
-		auto& transformMatrix = DirectX::XMLoadFloat4x4(&transformF4x4);
-		auto& transVector = DirectX::XMLoadFloat3(&translation);
-		auto& T = DirectX::XMMatrixTranslationFromVector(transVector);
-		transformMatrix = DirectX::XMMatrixMultiply(T, transformMatrix);
-
-		// rotation
-		using DirectX::XM_PI;
-		auto& Rx = DirectX::XMMatrixRotationX(rotation.x * XM_PI / 180.0f);
-		transformMatrix = DirectX::XMMatrixMultiply(Rx, transformMatrix);
-		auto& Ry = DirectX::XMMatrixRotationY(rotation.y * XM_PI / 180.0f);
-		transformMatrix = DirectX::XMMatrixMultiply(Ry, transformMatrix);
-		auto& Rz = DirectX::XMMatrixRotationZ(rotation.z * XM_PI / 180.0f);
-		transformMatrix = DirectX::XMMatrixMultiply(Rz, transformMatrix);
-
-		// scaling
-		auto& scaleVector = DirectX::XMLoadFloat3(&scaling);
-		auto& S = DirectX::XMMatrixScalingFromVector(scaleVector);
-		transformMatrix = DirectX::XMMatrixMultiply(S, transformMatrix);
-		
-		// update
-		transform = transformMatrix;
-	}
+	UINT32 transformNode = 0;
 };
 
 struct ParallelogramLight
@@ -276,7 +298,7 @@ struct ParallelogramLight
 	DirectX::XMFLOAT3 v2 = { 0.0f, 0.0f, 0.0f };
 	DirectX::XMFLOAT3 normal = { 0.0f, 0.0f, 0.0f };
 	DirectX::XMFLOAT3 emission = { 0.0f, 0.0f, 0.0f };
-	float lightPad0;
+	float lightPad0 = 0.0f;
 
 	ParallelogramLight() = default;
 	ParallelogramLight(XMFLOAT3 _corner, XMFLOAT3 _v1, XMFLOAT3 _v2, XMFLOAT3 _emission)
@@ -10,6 +10,8 @@
 #include "imgui_impl_dx12.h"
 #include "../../Common/d3dUtil.h"
 #include "../FrameResource.h"
+#include "../Utils/WSceneRegistry.h"
+#include "../Utils/WInstanceStore.h"
 using namespace DirectX;
 
 extern const int gNumFrameResources;
@@ -34,17 +36,18 @@ class WGUILayout
 {
 public:
 	typedef WPassConstantsItem PassData;
-	typedef std::map<std::string, WRenderItem> RenderItemList;
-	typedef std::map<std::string, WMaterial> MaterialList;
+	typedef WSceneRegistry<WRenderItem> RenderItemList;
+	typedef WSceneRegistry<WMaterial> MaterialList;
+	typedef WInstanceStore InstanceStore;
 	typedef std::unordered_map<std::string, std::unique_ptr<WTexture>> TextureList;
 	WGUILayout() = default;
 	static void HelpMarker(const char* desc);
-	static void ShowObjectInspector(bool* p_open, std::string objName, RenderItemList& renderItems, MaterialList& materials, TextureList& textures);
+	static void ShowObjectInspector(bool* p_open, std::string objName, RenderItemList& renderItems, InstanceStore& instances, MaterialList& materials, TextureList& textures);
 	static void ShowMaterialAttributes(std::string materialName, MaterialList& materials, TextureList& textures);
 	static void ShowMaterialModifier(bool* p_open, std::string materialName, MaterialList& materials, TextureList& textures);
 	static void DrawGUILayout(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& mCommandList, 
 		const Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& mSrvHeap, 
-		PassData& passData, RenderItemList& renderItems, MaterialList& materials, TextureList& textures);
+		PassData& passData, RenderItemList& renderItems, InstanceStore& instances, MaterialList& materials, TextureList& textures);
 };
 
 // Helper to display a little (?) mark which shows a tooltip when hovered.
@@ -64,9 +67,9 @@ void WGUILayout::HelpMarker(const char* desc)
 
 // Create a simple object inspector
 void WGUILayout::ShowObjectInspector(bool* p_open, std::string objName,
-	RenderItemList& renderItems, MaterialList& materials, TextureList& textures)
+	RenderItemList& renderItems, InstanceStore& instances, MaterialList& materials, TextureList& textures)
 {
-	if (renderItems.find(objName) == renderItems.end()) return;
+	if (!renderItems.contains(objName)) return;
 	ImGui::SetNextWindowSize(ImVec2(350, 350), ImGuiCond_FirstUseEver);
 	if (!ImGui::Begin("Object Inspector", p_open))
 	{
@@ -75,33 +78,32 @@ void WGUILayout::ShowObjectInspector(bool* p_open, std::string objName,
 	}
 
 	auto& r = renderItems.at(objName);
+	const UINT i = r.objIdx;
 	ImGui::Text("Object Name: %s", objName.c_str());
 	ImGui::Separator();
 
 	// Object's transform property
 	ImGui::Text("Transform");
-	if (ImGui::DragFloat3("Translation##value", &r.translation.x, 0.01f))
-		r.NumFramesDirty = gNumFrameResources;
-	if (ImGui::DragFloat3("Rotation##value", &r.rotation.x, 0.1f, -180, 180))
-		r.NumFramesDirty = gNumFrameResources;
-	if (ImGui::DragFloat3("Scaling##value", &r.scaling.x, 0.1f, 0))
-		r.NumFramesDirty = gNumFrameResources;
+	if (ImGui::DragFloat3("Translation##value", &instances.translations[i].x, 0.01f))
+		instances.markTransformDirty(i, gNumFrameResources);
+	if (ImGui::DragFloat3("Rotation##value", &instances.rotations[i].x, 0.1f, -180, 180))
+		instances.markTransformDirty(i, gNumFrameResources);
+	if (ImGui::DragFloat3("Scaling##value", &instances.scalings[i].x, 0.1f, 0))
+		instances.markTransformDirty(i, gNumFrameResources);
 	ImGui::Separator();
 
 	// Object's material attributes
 	static std::vector<const char*> material_items(materials.size());
 	static int item_current = 0;
-	int n = 0;
-	for (auto iter = materials.begin(); iter != materials.end(); ++iter, ++n)
-	{
-		material_items[n] = iter->first.c_str();
-		if (iter->first == r.materialName) item_current = n;
-	}
+	for (size_t n = 0; n < materials.size(); n++)
+		material_items[n] = materials.name(n).c_str();
+	item_current = r.matIdx;
 	if (ImGui::Combo("Material", &item_current, material_items.data(), materials.size()))
 	{
-		r.materialName = std::string(material_items[item_current]);
-		r.matIdx = materials[r.materialName].MatIdx;
-		r.NumFramesDirty = gNumFrameResources;
+		r.materialName = materials.name(item_current);
+		r.matIdx = item_current;
+		instances.matIdx[i] = r.matIdx;
+		instances.markDirty(i, gNumFrameResources);
 	}
 
 
@@ -113,7 +115,7 @@ void WGUILayout::ShowObjectInspector(bool* p_open, std::string objName,
 void WGUILayout::ShowMaterialAttributes(std::string materialName,
 	MaterialList& materials, TextureList& textures)
 {
-	if (materials.find(materialName) == materials.end()) return;
+	if (!materials.contains(materialName)) return;
 	auto& m = materials.at(materialName);
 	auto& Shader = m.Shader;
 	// Show Shader Name
@@ -285,7 +287,7 @@ void WGUILayout::ShowMaterialAttributes(std::string materialName,
 void WGUILayout::ShowMaterialModifier(bool* p_open, std::string materialName,
 	MaterialList& materials, TextureList& textures)
 {
-	if (materials.find(materialName) == materials.end()) return;
+	if (!materials.contains(materialName)) return;
 	ImGui::SetNextWindowSize(ImVec2(350, 350), ImGuiCond_FirstUseEver);
 	if (!ImGui::Begin("Material Modifier", p_open))
 	{
@@ -302,7 +304,7 @@ void WGUILayout::ShowMaterialModifier(bool* p_open, std::string materialName,
 
 void WGUILayout::DrawGUILayout(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& mCommandList,
 	const Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& mSrvHeap,
-	PassData& passData, RenderItemList& renderItems, MaterialList& materials, TextureList& textures)
+	PassData& passData, RenderItemList& renderItems, InstanceStore& instances, MaterialList& materials, TextureList& textures)
 {
 	//// Prepare
 	//static std::vector<std::string> OrderedRenderItemNames(renderItems.size());
@@ -412,40 +414,42 @@ void WGUILayout::DrawGUILayout(const Microsoft::WRL::ComPtr<ID3D12GraphicsComman
 		passData.NumFramesDirty = gNumFrameResources;
 	if(ImGui::SliderFloat("Scene Epsilon##value", &passData.SceneEpsilon, 0.0001, 0.1, "%.4f", ImGuiSliderFlags_Logarithmic))
 		passData.NumFramesDirty = gNumFrameResources;
+	if (passData.NumAnimatedObjects > 0)
+	{
+		ImGui::Checkbox("Play animations", &passData.PlayAnimations);
+		ImGui::SameLine();
+		ImGui::Text("%.2f s, %d objects", passData.AnimationTime, passData.NumAnimatedObjects);
+	}
 
 	if (ImGui::CollapsingHeader("Objects"))
 	{
 		static int selected = -1;
 		static std::string selectedObjName;
-		int n = 0;
-		for (const auto& ritem : renderItems)
+		for (int n = 0; n < (int)renderItems.size(); n++)
 		{
-			const auto& objName = ritem.first;
+			const auto& objName = renderItems.name(n);
 			if (ImGui::Selectable(objName.c_str(), selected == n))
 			{
 				selected = n;
 				selectedObjName = objName;
 			}
-			++n;
 		}
 		if (selected != -1)
-			ShowObjectInspector(&show_inspector, selectedObjName, renderItems, materials, textures);
+			ShowObjectInspector(&show_inspector, selectedObjName, renderItems, instances, materials, textures);
 	}
 
 	if (ImGui::CollapsingHeader("Material Modifier"))
 	{
 		static int selected = -1;
 		static std::string selectedMaterialName;
-		int n = 0;
-		for (const auto& mitem : materials)
+		for (int n = 0; n < (int)materials.size(); n++)
 		{
-			const auto& materialName = mitem.first;
+			const auto& materialName = materials.name(n);
 			if (ImGui::Selectable(materialName.c_str(), selected == n))
 			{
 				selected = n;
 				selectedMaterialName = materialName;
 			}
-			++n;
 		}
 		if (selected != -1)
 			ShowMaterialModifier(&show_material_modifier, selectedMaterialName, materials, textures);
@@ -3,6 +3,8 @@
 //***************************************************************************************
 
 #include <vector>
+#include <set>
+#include <algorithm>
 #include "../Common/d3dApp.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
@@ -10,6 +12,12 @@
 #include "../Common/Camera.h"
 #include "FrameResource.h"
 #include "Utils/WSceneDescParser.h"
+#include "Utils/WSceneDiff.h"
+#include "Utils/WFileWatcher.h"
+#include "Utils/WSceneRegistry.h"
+#include "Utils/WSubSceneStreamer.h"
+#include "Utils/WInstanceStore.h"
+#include "Utils/WTransformBatch.h"
 #include "Include/WGUILayout.h"
 #include "Include/GeometryShape.h"
 #include "Include/LowDiscrepancy.h"
@@ -44,6 +52,53 @@ struct AccelerationStructureBuffers
 const int gNumFrameResources = 3;
 static const UINT gNumRayTypes = 2;
 
+// Scene pipeline settings, read from the command line
+struct WSceneOptions
+{
+	// --no-weld: keeps the separate normal and texcoord index streams
+	bool weldVertices = true;
+	// --no-quantize: keeps float normals and texcoords
+	bool quantizeAttributes = true;
+	// --subscene-budget-mb <n>: host memory of the resident lazy includes
+	UINT64 subSceneBudgetBytes = WSubSceneStreamer::DefaultBudgetBytes;
+	// --paged-geometry-mb <n>: host memory for the scene geometry while it is loaded and uploaded,
+	// the rest stays in the scene cache. 0 keeps the geometry in memory, set a budget for scenes
+	// larger than the host memory.
+	UINT64 pagedGeometryBytes = 0;
+};
+
+static WSceneOptions parseSceneOptions(const char* cmdLine)
+{
+	WSceneOptions options;
+	std::istringstream args(cmdLine ? cmdLine : "");
+	std::string arg;
+	UINT64 megabytes = 0;
+	while (args >> arg)
+	{
+		if (arg == "--no-weld")
+			options.weldVertices = false;
+		else if (arg == "--no-quantize")
+			options.quantizeAttributes = false;
+		else if (arg == "--subscene-budget-mb" && args >> megabytes)
+			options.subSceneBudgetBytes = megabytes * 1024 * 1024;
+		else if (arg == "--paged-geometry-mb" && args >> megabytes)
+			options.pagedGeometryBytes = megabytes * 1024 * 1024;
+		else
+			OutputDebugStringA(("MainApp: unknown option " + arg + "\n").c_str());
+	}
+	return options;
+}
+
+// Settings every parser of the scene shares, main scene and lazy includes alike
+static void configureSceneParser(WSceneDescParser& parser, const WSceneOptions& options)
+{
+	parser.setCleanupMeshes(true);
+	parser.setWeldVertices(options.weldVertices);
+	parser.setReorderForLocality(true);
+	// The hit shaders are compiled for the layout these two produce
+	parser.setQuantizeAttributes(options.quantizeAttributes);
+}
+
 static std::map<std::string, UINT> ShaderToHitGroupTable = {
 	{"GlassMaterial", 0},
 	{"GlassSpecularMaterial", 1},
@@ -54,6 +109,14 @@ static std::map<std::string, UINT> ShaderToHitGroupTable = {
 	//{"DisneyMaterial",6},
 	{"Default",2}
 };
+// Material hit groups per scene in the SBT, each followed by the shadow hit group
+static const UINT gNumMaterialHitGroups = 6;
+
+static UINT hitGroupIndex(const std::string& shader)
+{
+	auto hitGroup = ShaderToHitGroupTable.find(shader);
+	return hitGroup != ShaderToHitGroupTable.end() ? hitGroup->second : ShaderToHitGroupTable.at("Default");
+}
 
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
@@ -90,6 +153,30 @@ struct RenderItem
 	int BaseVertexLocation = 0;
 };
 
+// GPU side of a resident lazy include: its own geometry buffers, BLASes, object and material
+// buffers, and a copy of the material hit groups in the SBT pointing at them. Lights and
+// cameras of sub-scenes are ignored.
+struct SubSceneResources
+{
+	// Index in the WSubSceneStreamer
+	size_t index = 0;
+	WInstanceStore store;
+	// Instance transforms placed by the include's hierarchy node, referenced by the TLAS
+	std::vector<XMFLOAT3X4> worlds;
+	std::vector<UINT> hitGroups;
+	// Indexed by the store's geometryIdx
+	std::vector<ComPtr<ID3D12Resource>> instanceBLAS;
+	std::unique_ptr<UploadBuffer<WObjectConstants>> objectBuffer;
+	std::unique_ptr<UploadBuffer<WMaterialData>> materialBuffer;
+	ComPtr<ID3D12Resource> vertexBuffer = nullptr;
+	ComPtr<ID3D12Resource> normalBuffer = nullptr;
+	ComPtr<ID3D12Resource> texCoordBuffer = nullptr;
+	ComPtr<ID3D12Resource> indexBuffer = nullptr;
+	ComPtr<ID3D12Resource> normalIndexBuffer = nullptr;
+	ComPtr<ID3D12Resource> texCoordIndexBuffer = nullptr;
+	ComPtr<ID3D12Resource> materialIdBuffer = nullptr;
+};
+
 enum class RenderLayer : int
 {
 	Opaque = 0,
@@ -100,7 +187,7 @@ enum class RenderLayer : int
 class MainApp : public D3DApp
 {
 public:
-	MainApp(HINSTANCE hInstance);
+	MainApp(HINSTANCE hInstance, const WSceneOptions& sceneOptions);
 	MainApp(const MainApp& rhs) = delete;
 	MainApp& operator=(const MainApp& rhs) = delete;
 	~MainApp();
@@ -122,6 +209,7 @@ private:
 
 	void OnKeyboardInput(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
+	void AnimateObjects(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
@@ -174,13 +262,14 @@ private:
 	/// \param     vVertexBuffers : pair of buffer and vertex count
 	/// \return    AccelerationStructureBuffers for TLAS
 	void CreateBottomLevelAS(std::map<std::string, AccelerationStructureBuffers>& bottemLevelBuffers);
+	// Records the build of one geometry's BLAS, the scratch buffer has to live until it ran
+	AccelerationStructureBuffers CreateGeometryBLAS(ID3D12Resource* vertexBuffer, ID3D12Resource* indexBuffer,
+		const WGeometryRecord& g);
 
 	/// Create the main acceleration structure that holds
-	/// all instances of the scene
-	/// \param     instances : pair of BLAS and transform
+	/// all instances of mInstanceStore
 	/// \param     updateOnly: if true, perform a refit instead of a full build
-	void CreateTopLevelAS(
-		const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>& instances, bool updateOnly = false);
+	void CreateTopLevelAS(bool updateOnly = false);
 
 	/// Create all acceleration structures, bottom and top
 	void CreateAccelerationStructures();
@@ -191,7 +280,18 @@ private:
 
 	nv_helpers_dx12::TopLevelASGenerator mTopLevelASGenerator;
 	AccelerationStructureBuffers mTopLevelASBuffers;
-	std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> mInstances;
+	// Render items come first, followed by the parser's instance table
+	WInstanceStore mInstanceStore;
+	// World matrices of render items and <group> nodes, edits move whole subtrees
+	WTransformHierarchy mTransformHierarchy;
+	std::vector<UINT32> mMovedNodes;
+	WTransformBatch mTransformBatch;
+	// Keyframe tracks writing into the TRS arrays of mInstanceStore
+	WAnimationSet mAnimations;
+	// Indexed by the store's geometryIdx
+	std::vector<ComPtr<ID3D12Resource>> mInstanceBLAS;
+	// Refit only when a transform moved, the descriptors of large instance tables are costly to rewrite
+	bool mTLASDirty = false;
 
 
 	// #DXR
@@ -251,14 +351,36 @@ private:
 
 	// My SceneDescParser
 	WSceneDescParser mSceneDescParser;
+	WSceneOptions mSceneOptions;
 	std::map<std::string, WGeometryRecord> mGeometryMap;
-	std::map<std::string, WRenderItem> mRenderItems;
-	std::map<std::string, WMaterial> mMaterials;
+	// Indexed by objIdx and MatIdx
+	WSceneRegistry<WRenderItem> mRenderItems;
+	WSceneRegistry<WMaterial> mMaterials;
 	WPassConstantsItem mPassItem;
 	void SetupSceneWithXML(const char* filename);
+	// d3dUtil::CreateDefaultBuffer filled from a section of the paged scene cache
+	ComPtr<ID3D12Resource> CreateDefaultBufferFromPages(UINT32 section, ComPtr<ID3D12Resource>& uploadBuffer);
 	void SetupCamera(const WCamereConfig& cameraConfig);
 	void LoadTextures(const std::map<std::string, WTextureRecord>& mTextureItems);
 
+	// Scene hot reload, watches the scene XML and its OBJ files
+	std::string mSceneFileName;
+	WFileWatcher mSceneWatcher;
+	float mSceneWatchTimer = 0.0f;
+	void PollSceneReload(const GameTimer& gt);
+
+	// Lazy includes, requested by the view frustum every frame. Resident ones are drawn after
+	// the main scene's instances, in streamer order.
+	WSubSceneStreamer mSubSceneStreamer;
+	std::vector<std::unique_ptr<SubSceneResources>> mSubSceneResources;
+	UINT64 mSubSceneFrame = 0;
+	void UpdateSubScenes();
+	// Records the uploads and BLAS builds, "temporaries" keeps their upload and scratch buffers.
+	// nullptr for sub-scenes without objects.
+	std::unique_ptr<SubSceneResources> CreateSubSceneResources(size_t index, const WSceneDescParser& scene,
+		std::vector<ComPtr<ID3D12Resource>>& temporaries);
+	void WriteSubSceneConstants(SubSceneResources& resources, const WSceneDescParser& scene);
+
 	// Vertex Buffer & Index Buffer
 	ComPtr<ID3D12Resource> mVertexBuffer = nullptr;
 	ComPtr<ID3D12Resource> mVertexBufferUploader = nullptr;
@@ -272,6 +394,8 @@ private:
 	ComPtr<ID3D12Resource> mNormalIndexBufferUploader = nullptr;
 	ComPtr<ID3D12Resource> mTexCoordIndexBuffer = nullptr;
 	ComPtr<ID3D12Resource> mTexCoordIndexBufferUploader = nullptr;
+	ComPtr<ID3D12Resource> mMaterialIdBuffer = nullptr;
+	ComPtr<ID3D12Resource> mMaterialIdBufferUploader = nullptr;
 
 	// Frame resource on CPU
 	WPassConstants mPassCB;
@@ -299,7 +423,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 	try
 	{
-		MainApp theApp(hInstance);
+		MainApp theApp(hInstance, parseSceneOptions(cmdLine));
 		if (!theApp.Initialize())
 			return 0;
 
@@ -312,8 +436,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	}
 }
 
-MainApp::MainApp(HINSTANCE hInstance)
-	: D3DApp(hInstance)
+MainApp::MainApp(HINSTANCE hInstance, const WSceneOptions& sceneOptions)
+	: D3DApp(hInstance), mSceneOptions(sceneOptions)
 {
 }
 
@@ -429,6 +553,7 @@ void MainApp::OnResize()
 void MainApp::Update(const GameTimer& gt)
 {
 	OnKeyboardInput(gt);
+	PollSceneReload(gt);
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -445,7 +570,9 @@ void MainApp::Update(const GameTimer& gt)
 	}
 
 	AnimateMaterials(gt);
+	AnimateObjects(gt);
 	UpdateObjectCBs(gt);
+	UpdateSubScenes();
 	UpdateMaterialBuffer(gt);
 	UpdateMainPassCB(gt);
 }
@@ -482,7 +609,11 @@ void MainApp::DrawForRayTracing(const GameTimer& gt)
 	// Specify the buffers we are going to render to.
 	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
 
-	CreateTopLevelAS(mInstances, true);
+	if (mTLASDirty)
+	{
+		CreateTopLevelAS(true);
+		mTLASDirty = false;
+	}
 
 	// #DXR
 	// Bind the descriptor heap giving access to the top-level acceleration
@@ -562,7 +693,7 @@ void MainApp::DrawForRayTracing(const GameTimer& gt)
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PRESENT));
 
-	WGUILayout::DrawGUILayout(mCommandList, mSrvHeap, mPassItem, mRenderItems, mMaterials, mTextures);
+	WGUILayout::DrawGUILayout(mCommandList, mSrvHeap, mPassItem, mRenderItems, mInstanceStore, mMaterials, mTextures);
 
 	// Done recording commands.
 	ThrowIfFailed(mCommandList->Close());
@@ -660,70 +791,140 @@ void MainApp::AnimateMaterials(const GameTimer& gt)
 
 }
 
+void MainApp::AnimateObjects(const GameTimer& gt)
+{
+	if (mAnimations.empty() || !mPassItem.PlayAnimations)
+		return;
+	mPassItem.AnimationTime += gt.DeltaTime();
+	evaluateAnimations(mAnimations, mPassItem.AnimationTime, mInstanceStore, gNumFrameResources);
+}
+
+// Object constants of an instance of "g", offsets in the buffer layout "parser" produced
+static WObjectConstants objectConstants(const WSceneDescParser& parser, const WGeometryRecord& g,
+	const XMFLOAT4X4& objectToWorld, const XMFLOAT4X4& invTranspose, UINT matIdx)
+{
+	UINT64 normalStride = parser.isQuantized() ? sizeof(SPackedNormal) : sizeof(SNormal);
+	UINT64 texCoordStride = parser.isQuantized() ? sizeof(SPackedTexCoord) : sizeof(STexCoord);
+	// Welded scenes address both through the interleaved vertex attributes
+	if (parser.isWelded())
+	{
+		normalStride = parser.isQuantized() ? sizeof(SPackedVertexAttributes) : sizeof(SVertexAttributes);
+		texCoordStride = normalStride;
+	}
+	INT32 normalOffset = (INT32)(g.normalOffsetInBytes >= 0 ?
+		g.normalOffsetInBytes / normalStride : g.normalOffsetInBytes);
+	// Texcoords half cannot hold are float pairs in the packed texcoord buffer
+	INT32 texCoordOffset = (INT32)(g.texCoordOffsetInBytes >= 0 ?
+		g.texCoordOffsetInBytes / (g.floatTexCoords ? sizeof(STexCoord) : texCoordStride) : g.texCoordOffsetInBytes);
+	return WObjectConstants(
+		objectToWorld, invTranspose, matIdx,
+		(UINT)(g.vertexOffsetInBytes / (sizeof(SVertex))),
+		(UINT)(g.indexOffsetInBytes / sizeof(UINT)),
+		normalOffset,
+		texCoordOffset,
+		(INT32)g.materialIdOffset,
+		parser.getMaterialIdBits(),
+		g.floatTexCoords ? 1u : 0u
+	);
+}
+
 void MainApp::UpdateObjectCBs(const GameTimer& gt)
 {
 	auto currObjectBuffer = mCurrFrameResource->ObjectBuffer.get();
-	for (auto& ritem : mRenderItems)
+	auto& store = mInstanceStore;
+	auto& batch = mTransformBatch;
+
+	// Edited TRS replace local transforms, then only the subtrees below them get new world matrices
+	batch.indices.clear();
+	for (UINT32 i = 0; i < store.editableCount(); i++)
 	{
-		auto& r = ritem.second;
-		// Only update the buffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (r.NumFramesDirty > 0)
+		if (store.dirty[i] & INSTANCE_DIRTY_TRANSFORM)
 		{
-			r.UpdateTransform();
-			mInstances[r.objIdx].second = r.transform;
-			INT32 normalOffset = (INT32)(r.normalOffsetInBytes >= 0 ?
-				r.normalOffsetInBytes / (sizeof(SNormal)) : r.normalOffsetInBytes);
-			INT32 texCoordOffset = (INT32)(r.texCoordOffsetInBytes >= 0 ?
-				r.texCoordOffsetInBytes / (sizeof(STexCoord)) : r.texCoordOffsetInBytes);
-			WObjectConstants objConstants(
-				DirectX::XMMatrixTranspose(r.transform), r.matIdx,
-				(UINT)(r.vertexOffsetInBytes / (sizeof(SVertex))),
-				(UINT)(r.indexOffsetInBytes / sizeof(UINT)),
-				normalOffset,
-				texCoordOffset
-			);
-
-			currObjectBuffer->CopyData(r.objIdx, objConstants);
-
-			// Next FrameResource need to be updated too.
-			--r.NumFramesDirty;
-			mNumStaticFrame = 0;
+			batch.indices.push_back(i);
+			store.dirty[i] &= ~INSTANCE_DIRTY_TRANSFORM;
+		}
+	}
+	if (!batch.indices.empty())
+	{
+		batch.transforms.resize(batch.indices.size());
+		composeTRSBatch(&store.translations[0].x, &store.rotations[0].x, &store.scalings[0].x, 3,
+			batch.indices.data(), batch.indices.size(), batch.transforms.data());
+		for (size_t k = 0; k < batch.indices.size(); k++)
+			mTransformHierarchy.setLocal(store.transformNodes[batch.indices[k]], batch.transforms[k]);
+	}
+	mMovedNodes.clear();
+	if (mTransformHierarchy.update(&mMovedNodes) > 0)
+	{
+		for (UINT32 node : mMovedNodes)
+		{
+			INT32 objIdx = mTransformHierarchy.objects[node];
+			if (objIdx < 0)
+				continue;
+			store.transforms[objIdx] = mTransformHierarchy.worlds[node];
+			store.markDirty(objIdx, gNumFrameResources);
 		}
+		mTLASDirty = true;
+	}
+
+	// Only update the buffer data if the constants have changed.  
+	// This needs to be tracked per frame resource.
+	batch.indices.clear();
+	for (UINT32 i = 0; i < store.size(); i++)
+		if (store.dirty[i] != 0)
+			batch.indices.push_back(i);
+	batch.objectToWorld.resize(batch.indices.size());
+	batch.invTranspose.resize(batch.indices.size());
+	objectMatricesBatch(store.transforms.data(), batch.indices.data(), batch.indices.size(),
+		batch.objectToWorld.data(), batch.invTranspose.data());
+
+	for (size_t k = 0; k < batch.indices.size(); k++)
+	{
+		const UINT32 i = batch.indices[k];
+		const auto& g = store.geometries[store.geometryIdx[i]];
+		WObjectConstants objConstants = objectConstants(mSceneDescParser, g,
+			batch.objectToWorld[k], batch.invTranspose[k], store.matIdx[i]);
+		currObjectBuffer->CopyData((int)i, objConstants);
+
+		// Next FrameResource need to be updated too.
+		--store.dirty[i];
+		mNumStaticFrame = 0;
 	}
 }
 
+static WMaterialData materialData(const WMaterial& m)
+{
+	WMaterialData materialData(
+		m.Albedo, m.Emission, m.Transparent, m.Smoothness, m.Metallic,
+		m.DiffuseMapIdx, m.NormalMapIdx
+	);
+	materialData.TransColor = m.TransColor;
+	materialData.F0 = m.F0;
+	materialData.k = m.k;
+	materialData.kd = m.kd;
+	materialData.ks = m.ks;
+	materialData.RefractiveIndex = m.RefractiveIndex;
+	materialData.specularTint = m.specularTint;
+	materialData.anisotropic = m.anisotropic;
+	materialData.sheen = m.sheen;
+	materialData.sheenTint = m.sheenTint;
+	materialData.clearcoat = m.clearcoat;
+	materialData.clearcoatGloss = m.clearcoatGloss;
+	materialData.specularTrans = m.specularTrans;
+	materialData.diffuseTrans = m.diffuseTrans;
+	materialData.Sigma = m.Sigma;
+	return materialData;
+}
+
 void MainApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
 	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
-	for (auto& mitem : mMaterials)
+	for (auto& m : mMaterials)
 	{
-		auto& m = mitem.second;
 		// Only update the cbuffer data if the constants have changed.  
 		// This needs to be tracked per frame resource.
 		if (m.NumFramesDirty > 0)
 		{
-			WMaterialData materialData(
-				m.Albedo, m.Emission, m.Transparent, m.Smoothness, m.Metallic,
-				m.DiffuseMapIdx, m.NormalMapIdx
-			);
-			materialData.TransColor = m.TransColor;
-			materialData.F0 = m.F0;
-			materialData.k = m.k;
-			materialData.kd = m.kd;
-			materialData.ks = m.ks;
-			materialData.RefractiveIndex = m.RefractiveIndex;
-			materialData.specularTint = m.specularTint;
-			materialData.anisotropic = m.anisotropic;
-			materialData.sheen = m.sheen;
-			materialData.sheenTint = m.sheenTint;
-			materialData.clearcoat = m.clearcoat;
-			materialData.clearcoatGloss = m.clearcoatGloss;
-			materialData.specularTrans = m.specularTrans;
-			materialData.diffuseTrans = m.diffuseTrans;
-			materialData.Sigma = m.Sigma;
-
-			currMaterialBuffer->CopyData(m.MatIdx, materialData);
+			currMaterialBuffer->CopyData(m.MatIdx, materialData(m));
 
 			// Next FrameResource need to be updated too.
 			--m.NumFramesDirty;
@@ -773,7 +974,7 @@ void MainApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mRenderItems.size(), (UINT)mMaterials.size()));
+			1, (UINT)mInstanceStore.size(), (UINT)mMaterials.size()));
 	}
 }
 
@@ -844,17 +1045,12 @@ void MainApp::CreateAccelerationStructures() {
 	std::map<std::string, AccelerationStructureBuffers> bottomLevelBuffers;
 	CreateBottomLevelAS(bottomLevelBuffers);
 
-	// Build all the Instances from the RenderItems
-	mInstances.resize(mRenderItems.size());
-	size_t i = 0;
-	for (const auto& ritem : mRenderItems)
-	{
-		const auto& r = ritem.second;
-		auto& bottomLevelBufferPointer = bottomLevelBuffers[r.geometryName].pResult;
-		mInstances[r.objIdx] = { bottomLevelBufferPointer, r.transform };
-	}
+	// Instances look their BLAS up by geometry index
+	mInstanceBLAS.clear();
+	for (const auto& geometryName : mInstanceStore.geometryNames)
+		mInstanceBLAS.push_back(bottomLevelBuffers[geometryName].pResult);
 	// Create Top Level Acceleration Structure
-	CreateTopLevelAS(mInstances);
+	CreateTopLevelAS();
 
 	// Flush the command list and wait for it to finish
 	// Execute the accerelaration structure create commands.
@@ -882,14 +1078,36 @@ void MainApp::CreateAccelerationStructures() {
 void
 MainApp::CreateBottomLevelAS(
 	std::map<std::string, AccelerationStructureBuffers>& bottemLevelBuffers) {
-	for (const auto& gItem : mGeometryMap) {
-		nv_helpers_dx12::BottomLevelASGenerator bottomLevelAS;
+	// LOD levels no render item selected stay in the buffers without a BLAS
+	std::set<std::string> selectedLods;
+	for (const auto& r : mRenderItems)
+		selectedLods.insert(lodGeometryName(r.geometryName, r.lodSelected));
 
+	// Deduplicated geometry files alias the same slice, which only needs one BLAS
+	std::map<std::pair<UINT64, UINT64>, std::string> builtSlices;
+	for (const auto& gItem : mGeometryMap) {
+		if (isLodGeometryName(gItem.first) && selectedLods.find(gItem.first) == selectedLods.end())
+			continue;
 		const auto& g = gItem.second;
+		auto slice = builtSlices.emplace(std::make_pair(g.vertexOffsetInBytes, g.indexOffsetInBytes), gItem.first);
+		if (!slice.second)
+		{
+			bottemLevelBuffers[gItem.first] = bottemLevelBuffers[slice.first->second];
+			continue;
+		}
+		bottemLevelBuffers[gItem.first] = CreateGeometryBLAS(mVertexBuffer.Get(), mIndexBuffer.Get(), g);
+	}
+}
+
+AccelerationStructureBuffers MainApp::CreateGeometryBLAS(ID3D12Resource* vertexBuffer, ID3D12Resource* indexBuffer,
+	const WGeometryRecord& g)
+{
+	nv_helpers_dx12::BottomLevelASGenerator bottomLevelAS;
+	{
 		// Add vertex buffer and not transforming their position.
 		bottomLevelAS.AddVertexBuffer(
-			mVertexBuffer.Get(), g.vertexOffsetInBytes, g.vertexCount, sizeof(SVertex),
-			mIndexBuffer.Get(), g.indexOffsetInBytes, g.indexCount,
+			vertexBuffer, g.vertexOffsetInBytes, g.vertexCount, sizeof(SVertex),
+			indexBuffer, g.indexOffsetInBytes, g.indexCount,
 			0, 0);
 
 		// The AS build requires some scratch space to store temporary information.
@@ -921,22 +1139,10 @@ MainApp::CreateBottomLevelAS(
 		// after this method.
 		bottomLevelAS.Generate(mCommandList.Get(), buffers.pScratch.Get(),
 			buffers.pResult.Get(), false, nullptr);
-		bottemLevelBuffers[gItem.first] = std::move(buffers);
+		return buffers;
 	}
 }
 
-WRenderItem findRenderItem(const std::map < std::string, WRenderItem > renderItems, int objIdx)
-{
-	for (const auto& ritem : renderItems)
-	{
-		if (objIdx == ritem.second.objIdx)
-		{
-			return ritem.second;
-		}
-	}
-	return WRenderItem();
-}
-
 //-----------------------------------------------------------------------------
 // Create the main acceleration structure that holds all instances of the scene.
 // Similarly to the bottom-level AS generation, it is done in 3 steps: gathering
@@ -944,27 +1150,32 @@ WRenderItem findRenderItem(const std::map < std::string, WRenderItem > renderIte
 // AS itself
 //
 void MainApp::CreateTopLevelAS(
-	const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>
-	& instances, // pair of bottom level AS and matrix of the instance
 	bool updateOnly  // If true the top-level AS will only be refitted and not
 				   // rebuilt from scratch
 ) {
 
 	if (!updateOnly)
 	{
-		// Gather all the instances into the builder helper
-		for (size_t i = 0; i < instances.size(); i++) {
-			const auto& ritem = findRenderItem(mRenderItems, i);
-			const auto& material = mMaterials[ritem.materialName];
-			const auto& Shader = material.Shader;
-			if(ShaderToHitGroupTable.find(Shader)!=ShaderToHitGroupTable.end())
-				mTopLevelASGenerator.AddInstance(instances[i].first.Get(),
-					instances[i].second, static_cast<UINT>(i),
-					gNumRayTypes * ShaderToHitGroupTable[Shader]);
-			else
-				mTopLevelASGenerator.AddInstance(instances[i].first.Get(),
-					instances[i].second, static_cast<UINT>(i),
-					gNumRayTypes * ShaderToHitGroupTable[Shader]); // MatteMaterial
+		// Gather all the instances into the builder helper, it keeps referencing the store's transforms.
+		// Unknown shaders fall back to the Default hit group.
+		mTopLevelASGenerator.Reset();
+		const auto& store = mInstanceStore;
+		for (size_t i = 0; i < store.size(); i++) {
+			const auto& material = mMaterials[store.matIdx[i]];
+			auto bottomLevelAS = mInstanceBLAS[store.geometryIdx[i]].Get();
+			mTopLevelASGenerator.AddInstance(bottomLevelAS,
+				store.transforms[i], static_cast<UINT>(i),
+				gNumRayTypes * hitGroupIndex(material.Shader));
+		}
+		// Resident sub-scenes follow with their own copy of the hit groups, instance ids index
+		// their own object buffer
+		for (size_t s = 0; s < mSubSceneResources.size(); s++) {
+			const auto& resources = *mSubSceneResources[s];
+			const UINT hitGroupBase = gNumMaterialHitGroups * static_cast<UINT>(s + 1);
+			for (size_t i = 0; i < resources.store.size(); i++)
+				mTopLevelASGenerator.AddInstance(resources.instanceBLAS[resources.store.geometryIdx[i]].Get(),
+					resources.worlds[i], static_cast<UINT>(i),
+					gNumRayTypes * (hitGroupBase + resources.hitGroups[i]));
 		}
 
 		// As for the bottom-level AS, the building the AS requires some scratch space
@@ -1051,6 +1262,7 @@ ComPtr<ID3D12RootSignature> MainApp::CreateHitSignature() {
 	rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0, 7);
 	rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0, 8);
 	rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0, 9);
+	rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0, 10); // Per-triangle material ids
 	rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0, 100); // RadicalInversePermutations
 	rsc.AddHeapRangesParameter(
 		{
@@ -1119,14 +1331,22 @@ void MainApp::CreateRayTracingPipeline()
 	// used.
 	m_rayGenLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\RayGen.hlsl");
 	m_missLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Miss.hlsl");
-	m_hitShadowLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_Shadow.hlsl");
-	m_hitGlassLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_GlassMaterial.hlsl");
-	m_hitGlassSpecularLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_GlassSpecularMaterial.hlsl");
-	m_hitMatteLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_MatteMaterial.hlsl");
-	m_hitMetalLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_MetalMaterial.hlsl");
-	m_hitPlasticLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_PlasticMaterial.hlsl");
-	m_hitMirrorLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_MirrorMaterial.hlsl");
-	m_hitDisneyLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_DisneyMaterial.hlsl");
+	// The hit shaders read normals and texcoords in the layout the parser produced
+	std::vector<DxcDefine> hitDefineList;
+	if (mSceneDescParser.isQuantized())
+		hitDefineList.push_back({ L"PACKED_ATTRIBUTES", L"1" });
+	if (mSceneDescParser.isWelded())
+		hitDefineList.push_back({ L"WELDED", L"1" });
+	const DxcDefine* hitDefines = hitDefineList.empty() ? nullptr : hitDefineList.data();
+	const UINT32 hitDefineCount = (UINT32)hitDefineList.size();
+	m_hitShadowLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_Shadow.hlsl", hitDefines, hitDefineCount);
+	m_hitGlassLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_GlassMaterial.hlsl", hitDefines, hitDefineCount);
+	m_hitGlassSpecularLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_GlassSpecularMaterial.hlsl", hitDefines, hitDefineCount);
+	m_hitMatteLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_MatteMaterial.hlsl", hitDefines, hitDefineCount);
+	m_hitMetalLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_MetalMaterial.hlsl", hitDefines, hitDefineCount);
+	m_hitPlasticLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_PlasticMaterial.hlsl", hitDefines, hitDefineCount);
+	m_hitMirrorLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_MirrorMaterial.hlsl", hitDefines, hitDefineCount);
+	m_hitDisneyLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayTracing\\Hit_DisneyMaterial.hlsl", hitDefines, hitDefineCount);
 
 	// In a way similar to DLLs, each library is associated with a number of
 	// exported symbols. This
@@ -1391,11 +1611,20 @@ void MainApp::CreateShaderBindingTable() {
 
 	auto VertexBufferPointer = reinterpret_cast<UINT64*>(mVertexBuffer->GetGPUVirtualAddress());
 	auto NormalBufferPointer = reinterpret_cast<UINT64*>(mNormalBuffer->GetGPUVirtualAddress());
-	auto TexCoordBufferPointer = reinterpret_cast<UINT64*>(mTexCoordBuffer->GetGPUVirtualAddress());
+	// Welded scenes bind their interleaved attributes in the normal slot, the texcoord slot only
+	// holds float texcoords of quantized meshes
+	auto TexCoordBufferPointer = reinterpret_cast<UINT64*>(mSceneDescParser.isWelded() && !mTexCoordBuffer ?
+		mNormalBuffer->GetGPUVirtualAddress() : mTexCoordBuffer->GetGPUVirtualAddress());
 	auto IndexBufferPointer = reinterpret_cast<UINT64*>(mIndexBuffer->GetGPUVirtualAddress());
-	auto NormalIndexBufferPointer = reinterpret_cast<UINT64*>(mNormalIndexBuffer->GetGPUVirtualAddress());
-	auto TexCoordIndexBufferPointer = reinterpret_cast<UINT64*>(mTexCoordIndexBuffer->GetGPUVirtualAddress());
+	// Welded scenes share one index stream, so all three index slots alias mIndexBuffer
+	auto NormalIndexBufferPointer = reinterpret_cast<UINT64*>(mSceneDescParser.isWelded() ?
+		mIndexBuffer->GetGPUVirtualAddress() : mNormalIndexBuffer->GetGPUVirtualAddress());
+	auto TexCoordIndexBufferPointer = reinterpret_cast<UINT64*>(mSceneDescParser.isWelded() ?
+		mIndexBuffer->GetGPUVirtualAddress() : mTexCoordIndexBuffer->GetGPUVirtualAddress());
 	auto lightBufferPointer = reinterpret_cast<UINT64*>(mLightBuffer->GetGPUVirtualAddress());
+	// Scenes without multi-material meshes never read the material id slot
+	auto MaterialIdBufferPointer = reinterpret_cast<UINT64*>(mMaterialIdBuffer ?
+		mMaterialIdBuffer->GetGPUVirtualAddress() : mIndexBuffer->GetGPUVirtualAddress());
 	auto permutationsBufferPointer = reinterpret_cast<UINT64*>(mPermutationsBuffer->GetGPUVirtualAddress());
 	// The ray generation only uses heap data
 	m_sbtHelper.AddRayGenerationProgram(L"RayGen",
@@ -1424,6 +1653,7 @@ void MainApp::CreateShaderBindingTable() {
 			NormalIndexBufferPointer,
 			TexCoordIndexBufferPointer,
 			lightBufferPointer,
+			MaterialIdBufferPointer,
 			permutationsBufferPointer,
 			heapPointer
 		});
@@ -1443,6 +1673,7 @@ void MainApp::CreateShaderBindingTable() {
 			NormalIndexBufferPointer,
 			TexCoordIndexBufferPointer,
 			lightBufferPointer,
+			MaterialIdBufferPointer,
 			permutationsBufferPointer,
 			heapPointer
 		});
@@ -1462,6 +1693,7 @@ void MainApp::CreateShaderBindingTable() {
 			NormalIndexBufferPointer,
 			TexCoordIndexBufferPointer,
 			lightBufferPointer,
+			MaterialIdBufferPointer,
 			permutationsBufferPointer,
 			heapPointer
 		});
@@ -1481,6 +1713,7 @@ void MainApp::CreateShaderBindingTable() {
 			NormalIndexBufferPointer,
 			TexCoordIndexBufferPointer,
 			lightBufferPointer,
+			MaterialIdBufferPointer,
 			permutationsBufferPointer,
 			heapPointer
 		});
@@ -1500,6 +1733,7 @@ void MainApp::CreateShaderBindingTable() {
 			NormalIndexBufferPointer,
 			TexCoordIndexBufferPointer,
 			lightBufferPointer,
+			MaterialIdBufferPointer,
 			permutationsBufferPointer,
 			heapPointer
 		});
@@ -1519,6 +1753,7 @@ void MainApp::CreateShaderBindingTable() {
 			NormalIndexBufferPointer,
 			TexCoordIndexBufferPointer,
 			lightBufferPointer,
+			MaterialIdBufferPointer,
 			permutationsBufferPointer,
 			heapPointer
 		});
@@ -1538,6 +1773,7 @@ void MainApp::CreateShaderBindingTable() {
 	//		NormalIndexBufferPointer,
 	//		TexCoordIndexBufferPointer,
 	//		lightBufferPointer,
+	//		MaterialIdBufferPointer,
 	//		heapPointer
 	//	});
 	//m_sbtHelper.AddHitGroup(L"HitGroup_Shadow",
@@ -1545,7 +1781,42 @@ void MainApp::CreateShaderBindingTable() {
 	//		objectBufferPointer,
 	//		materialBufferPointer
 	//	});
-	
+
+	// Every resident sub-scene repeats the material hit groups above with its own buffers
+	static const wchar_t* materialHitGroups[gNumMaterialHitGroups] = {
+		L"HitGroup_GlassMaterial", L"HitGroup_GlassSpecularMaterial", L"HitGroup_MatteMaterial",
+		L"HitGroup_MetalMaterial", L"HitGroup_PlasticMaterial", L"HitGroup_MirrorMaterial"
+	};
+	for (const auto& resources : mSubSceneResources)
+	{
+		// Slots the layout never reads point at the vertex buffer, welded scenes alias them like above
+		auto bufferPointer = [&](const ComPtr<ID3D12Resource>& buffer) {
+			return reinterpret_cast<UINT64*>((buffer ? buffer : resources->vertexBuffer)->GetGPUVirtualAddress());
+		};
+		const bool welded = mSceneDescParser.isWelded();
+		auto subSceneObjectBufferPointer = reinterpret_cast<UINT64*>(resources->objectBuffer->Resource()->GetGPUVirtualAddress());
+		auto subSceneMaterialBufferPointer = reinterpret_cast<UINT64*>(resources->materialBuffer->Resource()->GetGPUVirtualAddress());
+		std::vector<void*> hitGroupData = {
+			subSceneObjectBufferPointer,
+			subSceneMaterialBufferPointer,
+			bufferPointer(resources->vertexBuffer),
+			bufferPointer(resources->normalBuffer),
+			bufferPointer(welded && !resources->texCoordBuffer ? resources->normalBuffer : resources->texCoordBuffer),
+			bufferPointer(resources->indexBuffer),
+			bufferPointer(welded ? resources->indexBuffer : resources->normalIndexBuffer),
+			bufferPointer(welded ? resources->indexBuffer : resources->texCoordIndexBuffer),
+			lightBufferPointer,
+			bufferPointer(resources->materialIdBuffer),
+			permutationsBufferPointer,
+			heapPointer
+		};
+		for (const wchar_t* hitGroup : materialHitGroups)
+		{
+			m_sbtHelper.AddHitGroup(hitGroup, hitGroupData);
+			m_sbtHelper.AddHitGroup(L"HitGroup_Shadow", { subSceneObjectBufferPointer, subSceneMaterialBufferPointer });
+		}
+	}
+
 
 	// Compute the size of the SBT given the number of shaders and their
   // parameters
@@ -1606,55 +1877,136 @@ void MainApp::CreateVertexBuffer()
 
 void MainApp::SetupSceneWithXML(const char* filename)
 {
+	configureSceneParser(mSceneDescParser, mSceneOptions);
+	mSceneDescParser.setPagedGeometry(mSceneOptions.pagedGeometryBytes);
 	mSceneDescParser.Parse(filename);
 	mGeometryMap = mSceneDescParser.getGeometryMap();
-	mRenderItems = mSceneDescParser.getRenderItems();
-	mMaterials = mSceneDescParser.getMaterialItems();
+	mRenderItems.assign(mSceneDescParser.getRenderItems(), [](const WRenderItem& r) { return r.objIdx; });
+	mMaterials.assign(mSceneDescParser.getMaterialItems(), [](const WMaterial& m) { return m.MatIdx; });
+	mTransformHierarchy = mSceneDescParser.getTransformHierarchy();
+	buildInstanceStore(mRenderItems, mTransformHierarchy, mSceneDescParser.getInstanceTable(), mGeometryMap,
+		gNumFrameResources, mInstanceStore);
+	std::ostringstream storeReport;
+	storeReport << "WInstanceStore: " << mInstanceStore.size() << " instances (" << mInstanceStore.editableCount()
+		<< " editable), " << mInstanceStore.bytesPerInstance() << " B per instance, "
+		<< mInstanceStore.bytesPerEditableInstance() << " B per editable instance (WRenderItem alone is "
+		<< sizeof(WRenderItem) << " B), " << mInstanceStore.memoryBytes() / 1024.0 << " KB total, "
+		<< simdPathName(transformBatchPath()) << " transform batches\n";
+	OutputDebugStringA(storeReport.str().c_str());
+
+	// Lazy includes load in the background once the view frustum reaches them, UpdateSubScenes
+	// uploads them. Their geometry stays in memory, only the main scene is paged.
+	mSubSceneResources.clear();
+	mSubSceneStreamer.setBudget(mSceneOptions.subSceneBudgetBytes);
+	mSubSceneStreamer.reset(mSceneDescParser.getSubScenes(), [options = mSceneOptions](WSceneDescParser& parser) {
+		configureSceneParser(parser, options);
+	});
+
+	mAnimations = mSceneDescParser.getAnimations();
+	mPassItem.NumAnimatedObjects = (UINT)mAnimations.animatedObjectCount();
+	mPassItem.AnimationTime = 0.0f;
+	if (!mAnimations.empty())
+	{
+		std::ostringstream animationReport;
+		animationReport << "WAnimation: " << mAnimations.size() << " channels, " << mAnimations.keyTimes.size()
+			<< " keys on " << mPassItem.NumAnimatedObjects << " objects\n";
+		OutputDebugStringA(animationReport.str().c_str());
+	}
 	
 	const auto& textureItems = mSceneDescParser.getTextureItems();
 
 	const auto& vertexBuffer = mSceneDescParser.getVertexBuffer();
 	const auto& normalBuffer = mSceneDescParser.getNormalBuffer();
 	const auto& texCoordBuffer = mSceneDescParser.getTexCoordBuffer();
+	const auto& packedNormalBuffer = mSceneDescParser.getPackedNormalBuffer();
+	const auto& packedTexCoordBuffer = mSceneDescParser.getPackedTexCoordBuffer();
+	const auto& vertexAttributeBuffer = mSceneDescParser.getVertexAttributeBuffer();
+	const auto& packedVertexAttributeBuffer = mSceneDescParser.getPackedVertexAttributeBuffer();
 	const auto& indexBuffer = mSceneDescParser.getIndexBuffer();
 	const auto& normalIndexBuffer = mSceneDescParser.getNormalIndexBuffer();
 	const auto& texCoordIndexBuffer = mSceneDescParser.getTexCoordIndexBuffer();
+	const auto& materialIdBuffer = mSceneDescParser.getMaterialIdBuffer();
 
 	const auto& cameraConfig = mSceneDescParser.getCameraConfig();
 	const auto& lights = mSceneDescParser.getLights();
 
-	mPassItem.NumFaces = indexBuffer.size() / 3;
-
-	UINT64 vertexBufferSize = vertexBuffer.size() * sizeof(tinyobj::real_t);
-	mVertexBuffer = d3dUtil::CreateDefaultBuffer(
-		md3dDevice.Get(), mCommandList.Get(), vertexBuffer.data(),
-		vertexBufferSize, mVertexBufferUploader
-	);
-	UINT64 normalBufferSize = normalBuffer.size() * sizeof(tinyobj::real_t);
-	mNormalBuffer = d3dUtil::CreateDefaultBuffer(
-		md3dDevice.Get(), mCommandList.Get(), normalBuffer.data(),
-		normalBufferSize, mNormalBufferUploader
-	);
-	UINT64 texCoordBufferSize = texCoordBuffer.size() * sizeof(tinyobj::real_t);
-	mTexCoordBuffer = d3dUtil::CreateDefaultBuffer(
-		md3dDevice.Get(), mCommandList.Get(), texCoordBuffer.data(),
-		texCoordBufferSize, mTexCoordBufferUploader
-	);
-	UINT64 indexBufferSize = indexBuffer.size() * sizeof(UINT32);
-	mIndexBuffer = d3dUtil::CreateDefaultBuffer(
-		md3dDevice.Get(), mCommandList.Get(), indexBuffer.data(),
-		indexBufferSize, mIndexBufferUploader
-	);
-	UINT64 normalIndexBufferSize = normalIndexBuffer.size() * sizeof(INT32);
-	mNormalIndexBuffer = d3dUtil::CreateDefaultBuffer(
-		md3dDevice.Get(), mCommandList.Get(), normalIndexBuffer.data(),
-		normalIndexBufferSize, mNormalIndexBufferUploader
-	);
-	UINT64 texCoordIndexBufferSize = texCoordIndexBuffer.size() * sizeof(INT32);
-	mTexCoordIndexBuffer = d3dUtil::CreateDefaultBuffer(
-		md3dDevice.Get(), mCommandList.Get(), texCoordIndexBuffer.data(),
-		texCoordIndexBufferSize, mTexCoordIndexBufferUploader
-	);
+	mSceneFileName = filename;
+	mSceneWatcher.Watch(mSceneFileName);
+	for (const auto& includeFile : mSceneDescParser.getIncludeFiles())
+		mSceneWatcher.Watch(includeFile);
+	for (const auto& geometryFile : mSceneDescParser.getGeometryFiles())
+		mSceneWatcher.Watch(geometryFile);
+	for (const auto& instanceFile : mSceneDescParser.getInstanceFiles())
+		mSceneWatcher.Watch(instanceFile);
+
+	const bool paged = mSceneDescParser.isGeometryPaged();
+	auto& geometryPages = mSceneDescParser.getGeometryPages();
+	mPassItem.NumFaces = paged ? geometryPages.sectionSize(CACHE_INDEX_BUFFER) / (3 * sizeof(UINT32)) : indexBuffer.size() / 3;
+
+	// Paged geometry goes from the scene cache to the upload heaps a page at a time
+	auto createGeometryBuffer = [&](UINT32 section, const void* data, UINT64 byteSize, ComPtr<ID3D12Resource>& uploader) {
+		if (paged)
+			return CreateDefaultBufferFromPages(section, uploader);
+		return d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), data, byteSize, uploader);
+	};
+	mVertexBuffer = createGeometryBuffer(CACHE_VERTEX_BUFFER,
+		vertexBuffer.data(), vertexBuffer.size() * sizeof(tinyobj::real_t), mVertexBufferUploader);
+	if (mSceneDescParser.isWelded() && mSceneDescParser.isQuantized())
+	{
+		mNormalBuffer = createGeometryBuffer(CACHE_PACKED_VERTEX_ATTRIBUTE_BUFFER, packedVertexAttributeBuffer.data(),
+			packedVertexAttributeBuffer.size() * sizeof(UINT32), mNormalBufferUploader);
+		// Only meshes whose texcoords kept float have any here
+		mTexCoordBuffer = nullptr;
+		if (!packedTexCoordBuffer.empty() || geometryPages.sectionSize(CACHE_PACKED_TEXCOORD_BUFFER) > 0)
+		{
+			mTexCoordBuffer = createGeometryBuffer(CACHE_PACKED_TEXCOORD_BUFFER,
+				packedTexCoordBuffer.data(), packedTexCoordBuffer.size() * sizeof(UINT32), mTexCoordBufferUploader);
+		}
+	}
+	else if (mSceneDescParser.isWelded())
+	{
+		mNormalBuffer = createGeometryBuffer(CACHE_VERTEX_ATTRIBUTE_BUFFER, vertexAttributeBuffer.data(),
+			vertexAttributeBuffer.size() * sizeof(tinyobj::real_t), mNormalBufferUploader);
+		mTexCoordBuffer = nullptr;
+	}
+	else if (mSceneDescParser.isQuantized())
+	{
+		mNormalBuffer = createGeometryBuffer(CACHE_PACKED_NORMAL_BUFFER,
+			packedNormalBuffer.data(), packedNormalBuffer.size() * sizeof(SPackedNormal), mNormalBufferUploader);
+		mTexCoordBuffer = createGeometryBuffer(CACHE_PACKED_TEXCOORD_BUFFER,
+			packedTexCoordBuffer.data(), packedTexCoordBuffer.size() * sizeof(SPackedTexCoord), mTexCoordBufferUploader);
+	}
+	else
+	{
+		mNormalBuffer = createGeometryBuffer(CACHE_NORMAL_BUFFER,
+			normalBuffer.data(), normalBuffer.size() * sizeof(tinyobj::real_t), mNormalBufferUploader);
+		mTexCoordBuffer = createGeometryBuffer(CACHE_TEXCOORD_BUFFER,
+			texCoordBuffer.data(), texCoordBuffer.size() * sizeof(tinyobj::real_t), mTexCoordBufferUploader);
+	}
+	mIndexBuffer = createGeometryBuffer(CACHE_INDEX_BUFFER,
+		indexBuffer.data(), indexBuffer.size() * sizeof(UINT32), mIndexBufferUploader);
+	if (!mSceneDescParser.isWelded())
+	{
+		mNormalIndexBuffer = createGeometryBuffer(CACHE_NORMAL_INDEX_BUFFER,
+			normalIndexBuffer.data(), normalIndexBuffer.size() * sizeof(INT32), mNormalIndexBufferUploader);
+		mTexCoordIndexBuffer = createGeometryBuffer(CACHE_TEXCOORD_INDEX_BUFFER,
+			texCoordIndexBuffer.data(), texCoordIndexBuffer.size() * sizeof(INT32), mTexCoordIndexBufferUploader);
+	}
+	if (!materialIdBuffer.empty() || geometryPages.sectionSize(CACHE_MATERIAL_ID_BUFFER) > 0)
+	{
+		mMaterialIdBuffer = createGeometryBuffer(CACHE_MATERIAL_ID_BUFFER,
+			materialIdBuffer.data(), materialIdBuffer.size() * sizeof(UINT32), mMaterialIdBufferUploader);
+	}
+	if (paged)
+	{
+		const auto& pageStats = geometryPages.stats();
+		std::ostringstream pageReport;
+		pageReport << "WGeometryPageStore: " << geometryPages.pageCount() << " pages of " << WGeometryPageStore::PageSize / 1024
+			<< " KB in the cache, " << pageStats.capacityPages << " resident at most, " << pageStats.faults << " faults in "
+			<< pageStats.accesses << " accesses (" << pageStats.faultRate() * 100.0 << "%), "
+			<< pageStats.bytesStreamed / (1024.0 * 1024.0) << " MB streamed, " << pageStats.evictions << " evictions\n";
+		OutputDebugStringA(pageReport.str().c_str());
+	}
 	UINT64 lightBufferSize = lights.size() * sizeof(ParallelogramLight);
 	mLightBuffer = d3dUtil::CreateDefaultBuffer(
 		md3dDevice.Get(), mCommandList.Get(), lights.data(),
@@ -1677,6 +2029,298 @@ void MainApp::SetupSceneWithXML(const char* filename)
 	LoadTextures(textureItems);
 }
 
+ComPtr<ID3D12Resource> MainApp::CreateDefaultBufferFromPages(UINT32 section, ComPtr<ID3D12Resource>& uploadBuffer)
+{
+	auto& geometryPages = mSceneDescParser.getGeometryPages();
+	const UINT64 byteSize = geometryPages.sectionSize(section);
+	ComPtr<ID3D12Resource> defaultBuffer;
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(uploadBuffer.GetAddressOf())));
+
+	// Pages are copied straight into the mapped upload heap, the section is never whole in host memory
+	void* mapped = nullptr;
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(uploadBuffer->Map(0, &readRange, &mapped));
+	const bool read = geometryPages.read(section, 0, mapped, byteSize);
+	uploadBuffer->Unmap(0, nullptr);
+	ThrowIfFailed(read ? S_OK : HRESULT_FROM_WIN32(ERROR_READ_FAULT));
+
+	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
+		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+	mCommandList->CopyBufferRegion(defaultBuffer.Get(), 0, uploadBuffer.Get(), 0, byteSize);
+	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+	return defaultBuffer;
+}
+
+void MainApp::UpdateSubScenes()
+{
+	if (mSubSceneStreamer.size() == 0)
+		return;
+	++mSubSceneFrame;
+	XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+	mSubSceneStreamer.requestVisible(viewProj, mTransformHierarchy, mSubSceneFrame);
+	std::vector<size_t> changed;
+	mSubSceneStreamer.update(mSubSceneFrame, &changed);
+	// Includes inside a moved group carry their instances along
+	bool moved = false;
+	for (const auto& resources : mSubSceneResources)
+		moved |= std::find(mMovedNodes.begin(), mMovedNodes.end(),
+			mSubSceneStreamer.record(resources->index).transformNode) != mMovedNodes.end();
+	if (changed.empty() && !moved)
+		return;
+
+	// The GPU must be done with the buffers and the TLAS that are replaced
+	FlushCommandQueue();
+	ThrowIfFailed(mDirectCmdListAlloc->Reset());
+	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+
+	std::vector<ComPtr<ID3D12Resource>> temporaries;
+	std::vector<std::unique_ptr<SubSceneResources>> resident;
+	for (size_t i = 0; i < mSubSceneStreamer.size(); i++)
+	{
+		const WSceneDescParser* scene = mSubSceneStreamer.residentScene(i);
+		if (!scene)
+			continue;
+		auto kept = std::find_if(mSubSceneResources.begin(), mSubSceneResources.end(),
+			[i](const std::unique_ptr<SubSceneResources>& r) { return r->index == i; });
+		auto resources = kept != mSubSceneResources.end() ? std::move(*kept) : CreateSubSceneResources(i, *scene, temporaries);
+		if (!resources)
+			continue;
+		WriteSubSceneConstants(*resources, *scene);
+		resident.push_back(std::move(resources));
+	}
+	// Evicted sub-scenes release their resources here
+	mSubSceneResources = std::move(resident);
+	CreateTopLevelAS();
+	mTLASDirty = false;
+
+	ThrowIfFailed(mCommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	FlushCommandQueue();
+	// The rebuilt TLAS is a new buffer, the heap has to point at it
+	CreateShaderResourceHeap();
+	mNumStaticFrame = 0;
+
+	const auto& stats = mSubSceneStreamer.stats();
+	std::ostringstream report;
+	report << "WSubSceneStreamer: " << stats.resident << " of " << mSubSceneStreamer.size() << " sub-scenes resident, "
+		<< stats.residentBytes / (1024.0 * 1024.0) << " of " << stats.budgetBytes / (1024.0 * 1024.0) << " MB, "
+		<< stats.loads << " loads, " << stats.evictions << " evictions, " << stats.failures << " failed\n";
+	OutputDebugStringA(report.str().c_str());
+}
+
+std::unique_ptr<SubSceneResources> MainApp::CreateSubSceneResources(size_t index, const WSceneDescParser& scene,
+	std::vector<ComPtr<ID3D12Resource>>& temporaries)
+{
+	WSceneRegistry<WRenderItem> renderItems;
+	renderItems.assign(scene.getRenderItems(), [](const WRenderItem& r) { return r.objIdx; });
+	WSceneRegistry<WMaterial> materials;
+	materials.assign(scene.getMaterialItems(), [](const WMaterial& m) { return m.MatIdx; });
+	auto resources = std::make_unique<SubSceneResources>();
+	resources->index = index;
+	auto& store = resources->store;
+	buildInstanceStore(renderItems, scene.getTransformHierarchy(), scene.getInstanceTable(), scene.getGeometryMap(),
+		gNumFrameResources, store);
+	if (store.empty())
+	{
+		OutputDebugStringA(("WSubSceneStreamer: " + mSubSceneStreamer.record(index).file + " has no objects\n").c_str());
+		return nullptr;
+	}
+
+	// The same layout as the main scene, the parsers share their settings
+	auto upload = [&](const void* data, UINT64 byteSize, ComPtr<ID3D12Resource>& buffer) {
+		if (byteSize == 0)
+			return;
+		temporaries.emplace_back();
+		buffer = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), data, byteSize, temporaries.back());
+	};
+	const auto vertexBuffer = scene.getVertexBuffer();
+	upload(vertexBuffer.data(), vertexBuffer.size() * sizeof(tinyobj::real_t), resources->vertexBuffer);
+	if (scene.isWelded() && scene.isQuantized())
+	{
+		const auto attributes = scene.getPackedVertexAttributeBuffer();
+		const auto texCoords = scene.getPackedTexCoordBuffer();
+		upload(attributes.data(), attributes.size() * sizeof(UINT32), resources->normalBuffer);
+		upload(texCoords.data(), texCoords.size() * sizeof(UINT32), resources->texCoordBuffer);
+	}
+	else if (scene.isWelded())
+	{
+		const auto attributes = scene.getVertexAttributeBuffer();
+		upload(attributes.data(), attributes.size() * sizeof(tinyobj::real_t), resources->normalBuffer);
+	}
+	else if (scene.isQuantized())
+	{
+		const auto normals = scene.getPackedNormalBuffer();
+		const auto texCoords = scene.getPackedTexCoordBuffer();
+		upload(normals.data(), normals.size() * sizeof(SPackedNormal), resources->normalBuffer);
+		upload(texCoords.data(), texCoords.size() * sizeof(SPackedTexCoord), resources->texCoordBuffer);
+	}
+	else
+	{
+		const auto normals = scene.getNormalBuffer();
+		const auto texCoords = scene.getTexCoordBuffer();
+		upload(normals.data(), normals.size() * sizeof(tinyobj::real_t), resources->normalBuffer);
+		upload(texCoords.data(), texCoords.size() * sizeof(tinyobj::real_t), resources->texCoordBuffer);
+	}
+	const auto indexBuffer = scene.getIndexBuffer();
+	const auto normalIndexBuffer = scene.getNormalIndexBuffer();
+	const auto texCoordIndexBuffer = scene.getTexCoordIndexBuffer();
+	const auto materialIdBuffer = scene.getMaterialIdBuffer();
+	upload(indexBuffer.data(), indexBuffer.size() * sizeof(UINT32), resources->indexBuffer);
+	upload(normalIndexBuffer.data(), normalIndexBuffer.size() * sizeof(INT32), resources->normalIndexBuffer);
+	upload(texCoordIndexBuffer.data(), texCoordIndexBuffer.size() * sizeof(INT32), resources->texCoordIndexBuffer);
+	upload(materialIdBuffer.data(), materialIdBuffer.size() * sizeof(UINT32), resources->materialIdBuffer);
+
+	// One BLAS per slice, deduplicated geometry files alias it
+	std::map<std::pair<UINT64, UINT64>, ComPtr<ID3D12Resource>> builtSlices;
+	for (const auto& g : store.geometries)
+	{
+		auto& blas = builtSlices[std::make_pair(g.vertexOffsetInBytes, g.indexOffsetInBytes)];
+		if (!blas)
+		{
+			AccelerationStructureBuffers buffers = CreateGeometryBLAS(resources->vertexBuffer.Get(), resources->indexBuffer.Get(), g);
+			temporaries.push_back(buffers.pScratch);
+			blas = buffers.pResult;
+		}
+		resources->instanceBLAS.push_back(blas);
+	}
+
+	// Textures are looked up by name among the main scene's, others are dropped
+	resources->materialBuffer = std::make_unique<UploadBuffer<WMaterialData>>(md3dDevice.Get(), (UINT)materials.size(), false);
+	auto textureIdx = [&](const std::string& name, int idx) {
+		auto texture = mTextures.find(name);
+		return idx < 0 || texture == mTextures.end() ? -1 : (int)texture->second->TextureIdx;
+	};
+	for (const auto& m : materials)
+	{
+		WMaterial placed = m;
+		placed.DiffuseMapIdx = textureIdx(m.DiffuseMapName, m.DiffuseMapIdx);
+		placed.NormalMapIdx = textureIdx(m.NormalMapName, m.NormalMapIdx);
+		resources->materialBuffer->CopyData(m.MatIdx, materialData(placed));
+	}
+	resources->objectBuffer = std::make_unique<UploadBuffer<WObjectConstants>>(md3dDevice.Get(), (UINT)store.size(), false);
+	for (size_t i = 0; i < store.size(); i++)
+		resources->hitGroups.push_back(hitGroupIndex(materials[store.matIdx[i]].Shader));
+	return resources;
+}
+
+void MainApp::WriteSubSceneConstants(SubSceneResources& resources, const WSceneDescParser& scene)
+{
+	const auto& store = resources.store;
+	XMMATRIX placement = mTransformHierarchy.world(mSubSceneStreamer.record(resources.index).transformNode);
+	resources.worlds.resize(store.size());
+	for (size_t i = 0; i < store.size(); i++)
+		XMStoreFloat3x4(&resources.worlds[i], XMMatrixMultiply(XMLoadFloat3x4(&store.transforms[i]), placement));
+
+	auto& batch = mTransformBatch;
+	batch.objectToWorld.resize(store.size());
+	batch.invTranspose.resize(store.size());
+	objectMatricesBatch(resources.worlds.data(), nullptr, store.size(), batch.objectToWorld.data(), batch.invTranspose.data());
+	for (size_t i = 0; i < store.size(); i++)
+	{
+		resources.objectBuffer->CopyData((int)i, objectConstants(scene, store.geometries[store.geometryIdx[i]],
+			batch.objectToWorld[i], batch.invTranspose[i], store.matIdx[i]));
+	}
+}
+
+void MainApp::PollSceneReload(const GameTimer& gt)
+{
+	// A few checks per second are enough for editing
+	mSceneWatchTimer += gt.DeltaTime();
+	if (mSceneWatchTimer < 0.25f)
+		return;
+	mSceneWatchTimer = 0.0f;
+
+	auto modifiedFiles = mSceneWatcher.Poll();
+	if (modifiedFiles.empty())
+		return;
+
+	WSceneDescParser snapshot;
+	if (!snapshot.ParseDescription(mSceneFileName.c_str()))
+	{
+		OutputDebugStringA(("WSceneReload: cannot parse " + mSceneFileName + ", keeping the current scene\n").c_str());
+		return;
+	}
+	for (const auto& includeFile : snapshot.getIncludeFiles())
+		mSceneWatcher.Watch(includeFile);
+	for (const auto& geometryFile : snapshot.getGeometryFiles())
+		mSceneWatcher.Watch(geometryFile);
+	for (const auto& instanceFile : snapshot.getInstanceFiles())
+		mSceneWatcher.Watch(instanceFile);
+
+	auto changes = diffScenes(mRenderItems, mMaterials, mGeometryMap,
+		mSceneDescParser.getTextureItems(), mSceneDescParser.getLights(), mSceneDescParser.getInstanceTable(),
+		mTransformHierarchy, mAnimations, mSceneDescParser.getSubScenes(), snapshot, modifiedFiles);
+	for (const auto& reason : changes.rebuildReasons)
+		OutputDebugStringA(("WSceneReload: " + reason + ", restart to apply\n").c_str());
+
+	// Everything else is applied in place, the dirty flags push it to every frame resource
+	const auto& newItems = snapshot.getRenderItems();
+	for (const auto& name : changes.transformsChanged)
+	{
+		auto& r = mRenderItems.at(name);
+		const auto& updated = newItems.at(name);
+		r.transform = updated.transform;
+		r.translation = updated.translation;
+		r.rotation = updated.rotation;
+		r.scaling = updated.scaling;
+		mInstanceStore.translations[r.objIdx] = r.translation;
+		mInstanceStore.rotations[r.objIdx] = r.rotation;
+		mInstanceStore.scalings[r.objIdx] = r.scaling;
+		mTransformHierarchy.setLocal(r.transformNode, r.transform);
+	}
+	const auto& newHierarchy = snapshot.getTransformHierarchy();
+	for (UINT32 node : changes.groupsMoved)
+		mTransformHierarchy.setLocal(node, XMLoadFloat3x4(&newHierarchy.locals[node]));
+	if (changes.animationsChanged)
+	{
+		// The snapshot numbers objects in declaration order, the running scene keeps its objIdx
+		std::vector<UINT32> runningIdx(newItems.size());
+		for (const auto& rItem : newItems)
+			runningIdx[rItem.second.objIdx] = (UINT32)mRenderItems.indexOf(rItem.first);
+		mAnimations = snapshot.getAnimations();
+		for (auto& objIdx : mAnimations.objIdx)
+			objIdx = runningIdx[objIdx];
+		mPassItem.NumAnimatedObjects = (UINT)mAnimations.animatedObjectCount();
+	}
+	for (const auto& name : changes.materialAssignmentsChanged)
+	{
+		auto& r = mRenderItems.at(name);
+		r.materialName = newItems.at(name).materialName;
+		r.matIdx = mMaterials.at(r.materialName).MatIdx;
+		mInstanceStore.matIdx[r.objIdx] = r.matIdx;
+		mInstanceStore.markDirty(r.objIdx, gNumFrameResources);
+	}
+	for (const auto& name : changes.materialsChanged)
+	{
+		auto& m = mMaterials.at(name);
+		m = snapshot.getMaterialItems().at(name);
+		m.NumFramesDirty = gNumFrameResources;
+	}
+
+	std::ostringstream summary;
+	summary << "WSceneReload: " << changes.transformsChanged.size() << " transforms, "
+		<< changes.groupsMoved.size() << " groups, "
+		<< (changes.animationsChanged ? "animations, " : "")
+		<< changes.materialsChanged.size() << " materials, "
+		<< changes.materialAssignmentsChanged.size() << " material assignments updated; meshes +"
+		<< changes.meshesAdded.size() << " -" << changes.meshesRemoved.size() << " ~" << changes.meshesModified.size() << "\n";
+	OutputDebugStringA(summary.str().c_str());
+}
 
 void MainApp::SetupCamera(const WCamereConfig& cameraConfig)
 {
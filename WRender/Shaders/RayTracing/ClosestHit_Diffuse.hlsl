@@ -15,18 +15,16 @@ void ClosestHit_Diffuse(inout RayPayload current_payload, Attributes attrib)
     
     // Calculate world_geometric_normal
     ObjectConstants objectData = gObjectBuffer[InstanceID()];
-    uint vertId = 3 * PrimitiveIndex() + objectData.IndexOffset;
-    uint vertOffset = objectData.VertexOffset;
-    int texCoordOffset = objectData.TexCoordOffset;
-    float3 v0 = gVertexBuffer[vertOffset + gIndexBuffer[vertId]].pos;
-    float3 v1 = gVertexBuffer[vertOffset + gIndexBuffer[vertId + 1]].pos;
-    float3 v2 = gVertexBuffer[vertOffset + gIndexBuffer[vertId + 2]].pos;
+    TriangleIndices tri = LoadTriangleIndices(objectData, PrimitiveIndex());
+    float3 v0 = gVertexBuffer[tri.position.x].pos;
+    float3 v1 = gVertexBuffer[tri.position.y].pos;
+    float3 v2 = gVertexBuffer[tri.position.z].pos;
     float2 uv0, uv1, uv2;
-    if (texCoordOffset >= 0)
+    if (objectData.TexCoordOffset >= 0)
     {
-        uv0 = gTexCoordBuffer[texCoordOffset + gTexCoordIndexBuffer[vertId]].uv;
-        uv1 = gTexCoordBuffer[texCoordOffset + gTexCoordIndexBuffer[vertId + 1]].uv;
-        uv2 = gTexCoordBuffer[texCoordOffset + gTexCoordIndexBuffer[vertId + 2]].uv;
+        uv0 = LoadTexCoord(objectData, tri.texCoord.x);
+        uv1 = LoadTexCoord(objectData, tri.texCoord.y);
+        uv2 = LoadTexCoord(objectData, tri.texCoord.z);
     }
     else
     {
@@ -37,7 +35,7 @@ void ClosestHit_Diffuse(inout RayPayload current_payload, Attributes attrib)
     float3 barycentrics = float3(1.f - attrib.bary.x - attrib.bary.y, attrib.bary.x, attrib.bary.y);
     float2 uv = barycentrics.x * uv0 + barycentrics.y * uv1 + barycentrics.z * uv2;
     // Fetch Material Data
-    uint matIdx = objectData.MatIdx;
+    uint matIdx = LoadMaterialIdx(objectData, PrimitiveIndex());
     MaterialData matData = gMaterialBuffer[matIdx];
 
     float3 geometric_normal = normalize(cross(v1 - v0, v2 - v0));
@@ -58,6 +58,9 @@ struct ObjectConstants
 	uint IndexOffset;
     int NormalOffset;
     int TexCoordOffset;
+    int MaterialIdOffset;
+    uint MaterialIdBits;
+    uint FloatTexCoords;
 };
 
 struct MaterialData
@@ -111,6 +114,19 @@ struct TexCoord
     float2 uv;
 };
 
+// Normal and texcoord of a welded vertex, addressed with the position's index
+struct VertexAttributes
+{
+    float3 normal;
+    float2 uv;
+};
+
+struct PackedVertexAttributes
+{
+    uint normal;
+    uint uv;
+};
+
 // Surface Info
 struct SurfaceInfo
 {
@@ -6,12 +6,26 @@
 StructuredBuffer<ObjectConstants> gObjectBuffer : register(t0, space1);
 StructuredBuffer<MaterialData> gMaterialBuffer : register(t0, space2);
 StructuredBuffer<Vertex> gVertexBuffer : register(t0, space3);
+// Normals and texcoords are packed when the scene is quantized, see LoadNormal/LoadTexCoord.
+// Welded scenes interleave them per vertex in the normal slot.
+#if defined(WELDED) && defined(PACKED_ATTRIBUTES)
+StructuredBuffer<PackedVertexAttributes> gVertexAttributeBuffer : register(t0, space4);
+StructuredBuffer<uint> gTexCoordBuffer : register(t0, space5);
+#elif defined(WELDED)
+StructuredBuffer<VertexAttributes> gVertexAttributeBuffer : register(t0, space4);
+#elif defined(PACKED_ATTRIBUTES)
+StructuredBuffer<uint> gNormalBuffer : register(t0, space4);
+StructuredBuffer<uint> gTexCoordBuffer : register(t0, space5);
+#else
 StructuredBuffer<Normal> gNormalBuffer : register(t0, space4);
 StructuredBuffer<TexCoord> gTexCoordBuffer : register(t0, space5);
+#endif
 StructuredBuffer<int> gIndexBuffer : register(t0, space6);
 StructuredBuffer<int> gNormalIndexBuffer : register(t0, space7);
 StructuredBuffer<int> gTexCoordIndexBuffer : register(t0, space8);
 StructuredBuffer<ParallelogramLight> gLightBuffer : register(t0, space9);
+// Per-triangle material ids, MaterialIdBits wide and packed into 32-bit words
+StructuredBuffer<uint> gMaterialIdBuffer : register(t0, space10);
 
 RaytracingAccelerationStructure SceneBVH : register(t0);
 Texture2D gTextureMaps[] : register(t1, space0);
@@ -23,4 +37,91 @@ SamplerState gsamLinearClamp : register(s3);
 SamplerState gsamAnisotropicWrap : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 
+// Octahedral normal, 2 x 16-bit SNORM (x in the low half)
+float3 DecodeOctahedralNormal(uint packed)
+{
+    int2 s = int2(packed << 16, packed) >> 16;
+    float2 e = max(float2(s) / 32767.0, -1.0);
+    float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy -= (step(0.0, n.xy) * 2.0 - 1.0) * t;
+    return normalize(n);
+}
+
+// Texcoord stored as 2 x half (u in the low half)
+float2 DecodeHalfTexCoord(uint packed)
+{
+    return f16tof32(uint2(packed, packed >> 16));
+}
+
+float3 LoadNormal(uint idx)
+{
+#if defined(WELDED) && defined(PACKED_ATTRIBUTES)
+    return DecodeOctahedralNormal(gVertexAttributeBuffer[idx].normal);
+#elif defined(WELDED)
+    return gVertexAttributeBuffer[idx].normal;
+#elif defined(PACKED_ATTRIBUTES)
+    return DecodeOctahedralNormal(gNormalBuffer[idx]);
+#else
+    return gNormalBuffer[idx].normal;
+#endif
+}
+
+float2 LoadTexCoord(ObjectConstants objectData, uint idx)
+{
+#ifdef PACKED_ATTRIBUTES
+    // Texcoords half precision cannot hold stay float, as bit pairs in the texcoord slot
+    if (objectData.FloatTexCoords != 0)
+        return asfloat(uint2(gTexCoordBuffer[2 * idx], gTexCoordBuffer[2 * idx + 1]));
+#endif
+#if defined(WELDED) && defined(PACKED_ATTRIBUTES)
+    return DecodeHalfTexCoord(gVertexAttributeBuffer[idx].uv);
+#elif defined(WELDED)
+    return gVertexAttributeBuffer[idx].uv;
+#elif defined(PACKED_ATTRIBUTES)
+    return DecodeHalfTexCoord(gTexCoordBuffer[idx]);
+#else
+    return gTexCoordBuffer[idx].uv;
+#endif
+}
+
+// Where the corners of a triangle find their position, normal and texcoord, object offsets included
+struct TriangleIndices
+{
+    uint3 position;
+    uint3 normal;
+    uint3 texCoord;
+};
+
+TriangleIndices LoadTriangleIndices(ObjectConstants objectData, uint primitiveIdx)
+{
+    uint vertId = 3 * primitiveIdx + objectData.IndexOffset;
+    uint3 index = uint3(gIndexBuffer[vertId], gIndexBuffer[vertId + 1], gIndexBuffer[vertId + 2]);
+    TriangleIndices tri;
+    tri.position = objectData.VertexOffset + index;
+#ifdef WELDED
+    // The position's index also addresses the interleaved normal and texcoord
+    tri.normal = objectData.NormalOffset + index;
+    tri.texCoord = objectData.TexCoordOffset + index;
+#else
+    tri.normal = objectData.NormalOffset + uint3(gNormalIndexBuffer[vertId], gNormalIndexBuffer[vertId + 1], gNormalIndexBuffer[vertId + 2]);
+    tri.texCoord = uint3(0, 0, 0);
+    if (objectData.TexCoordOffset >= 0)
+        tri.texCoord = objectData.TexCoordOffset + uint3(gTexCoordIndexBuffer[vertId], gTexCoordIndexBuffer[vertId + 1], gTexCoordIndexBuffer[vertId + 2]);
+#endif
+    return tri;
+}
+
+// Multi-material meshes pick the material per triangle, an all-ones id falls back to the object's
+uint LoadMaterialIdx(ObjectConstants objectData, uint primitiveIdx)
+{
+    if (objectData.MaterialIdOffset < 0)
+        return objectData.MatIdx;
+    uint idsPerWord = 32 / objectData.MaterialIdBits;
+    uint id = objectData.MaterialIdOffset + primitiveIdx;
+    uint mask = objectData.MaterialIdBits == 32 ? 0xFFFFFFFF : (1u << objectData.MaterialIdBits) - 1;
+    uint matIdx = (gMaterialIdBuffer[id / idsPerWord] >> ((id % idsPerWord) * objectData.MaterialIdBits)) & mask;
+    return matIdx == mask ? objectData.MatIdx : matIdx;
+}
+
 #endif
\ No newline at end of file
@@ -265,19 +265,16 @@ void ClosestHit_DisneyMaterial(inout RayPayload current_payload, Attributes attr
     
     // Fetch UV
     ObjectConstants objectData = gObjectBuffer[InstanceID()];
-    uint vertId = 3 * PrimitiveIndex() + objectData.IndexOffset;
-    uint vertOffset = objectData.VertexOffset;
-    int texCoordOffset = objectData.TexCoordOffset;
-    int normalOffset = objectData.NormalOffset;
-    float3 v0 = gVertexBuffer[vertOffset + gIndexBuffer[vertId]].pos;
-    float3 v1 = gVertexBuffer[vertOffset + gIndexBuffer[vertId + 1]].pos;
-    float3 v2 = gVertexBuffer[vertOffset + gIndexBuffer[vertId + 2]].pos;
+    TriangleIndices tri = LoadTriangleIndices(objectData, PrimitiveIndex());
+    float3 v0 = gVertexBuffer[tri.position.x].pos;
+    float3 v1 = gVertexBuffer[tri.position.y].pos;
+    float3 v2 = gVertexBuffer[tri.position.z].pos;
     float2 uv0, uv1, uv2;
-    if (texCoordOffset >= 0)
+    if (objectData.TexCoordOffset >= 0)
     {
-        uv0 = gTexCoordBuffer[texCoordOffset + gTexCoordIndexBuffer[vertId]].uv;
-        uv1 = gTexCoordBuffer[texCoordOffset + gTexCoordIndexBuffer[vertId + 1]].uv;
-        uv2 = gTexCoordBuffer[texCoordOffset + gTexCoordIndexBuffer[vertId + 2]].uv;
+        uv0 = LoadTexCoord(objectData, tri.texCoord.x);
+        uv1 = LoadTexCoord(objectData, tri.texCoord.y);
+        uv2 = LoadTexCoord(objectData, tri.texCoord.z);
     }
     else
     {
@@ -289,7 +286,7 @@ void ClosestHit_DisneyMaterial(inout RayPayload current_payload, Attributes attr
     float2 uv = barycentrics.x * uv0 + barycentrics.y * uv1 + barycentrics.z * uv2;
     
     // Fetch Material Data
-    uint matIdx = objectData.MatIdx;
+    uint matIdx = LoadMaterialIdx(objectData, PrimitiveIndex());
     MaterialData matData = gMaterialBuffer[matIdx];
     
     // Calculate Normal
@@ -308,9 +305,9 @@ void ClosestHit_DisneyMaterial(inout RayPayload current_payload, Attributes attr
     }
     else
     {
-        float3 normal0 = gNormalBuffer[normalOffset + gNormalIndexBuffer[vertId]].normal;
-        float3 normal1 = gNormalBuffer[normalOffset + gNormalIndexBuffer[vertId + 1]].normal;
-        float3 normal2 = gNormalBuffer[normalOffset + gNormalIndexBuffer[vertId + 2]].normal;
+        float3 normal0 = LoadNormal(tri.normal.x);
+        float3 normal1 = LoadNormal(tri.normal.y);
+        float3 normal2 = LoadNormal(tri.normal.z);
         float3 shading_normal = barycentrics.x * normal0 + barycentrics.y * normal1 + barycentrics.z * normal2;
         float3 world_shading_normal = mul(shading_normal, (float3x3) inverseTranspose);
         ffnormal = normalize(world_shading_normal);
@@ -0,0 +1,154 @@
+#include "WAnimation.h"
+#include "WInstanceStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+void WAnimationSet::clear()
+{
+	objIdx.clear();
+	targets.clear();
+	interpolations.clear();
+	loops.clear();
+	firstKeys.clear();
+	keyCounts.clear();
+	cursors.clear();
+	keyTimes.clear();
+	keyValues.clear();
+}
+
+void WAnimationSet::addChannel(UINT32 object, WANIMATION_TARGET target, WINTERPOLATION interpolation, bool loop,
+	const std::vector<float>& times, const std::vector<DirectX::XMFLOAT3>& values)
+{
+	objIdx.push_back(object);
+	targets.push_back(target);
+	interpolations.push_back(interpolation);
+	loops.push_back(loop ? 1 : 0);
+	firstKeys.push_back(static_cast<UINT32>(keyTimes.size()));
+	keyCounts.push_back(static_cast<UINT32>(times.size()));
+	cursors.push_back(0);
+	keyTimes.insert(keyTimes.end(), times.begin(), times.end());
+	keyValues.insert(keyValues.end(), values.begin(), values.end());
+}
+
+size_t WAnimationSet::animatedObjectCount() const
+{
+	std::vector<UINT32> objects(objIdx);
+	std::sort(objects.begin(), objects.end());
+	return std::unique(objects.begin(), objects.end()) - objects.begin();
+}
+
+bool WAnimationSet::sameTracks(const WAnimationSet& other) const
+{
+	return objIdx == other.objIdx && targets == other.targets && interpolations == other.interpolations &&
+		loops == other.loops && firstKeys == other.firstKeys && keyCounts == other.keyCounts &&
+		keyTimes == other.keyTimes && keyValues.size() == other.keyValues.size() &&
+		(keyValues.empty() ||
+			memcmp(keyValues.data(), other.keyValues.data(), keyValues.size() * sizeof(keyValues[0])) == 0);
+}
+
+size_t evaluateAnimations(WAnimationSet& animations, float time, WInstanceStore& store, int frameCount)
+{
+	const size_t count = animations.size();
+	animations.sampleKeys.resize(count * 4);
+	animations.sampleWeights.resize(count * 4);
+	animations.samples.resize(count);
+	const float* keyTimes = animations.keyTimes.data();
+
+	// Find the segment of every channel and express the sample as weights of four keys,
+	// linear segments use the middle two
+	for (size_t c = 0; c < count; c++)
+	{
+		const UINT32 first = animations.firstKeys[c];
+		const UINT32 last = first + animations.keyCounts[c] - 1;
+		UINT32* keys = &animations.sampleKeys[c * 4];
+		float* weights = &animations.sampleWeights[c * 4];
+		const float start = keyTimes[first];
+		const float end = keyTimes[last];
+		if (last == first || end <= start)
+		{
+			keys[0] = keys[1] = keys[2] = keys[3] = last;
+			weights[0] = 0.0f; weights[1] = 1.0f; weights[2] = 0.0f; weights[3] = 0.0f;
+			continue;
+		}
+
+		// Times inside the track are used as given, so samples at key times are the keys
+		float t = time;
+		if (animations.loops[c] && (t < start || t > end))
+		{
+			const float length = end - start;
+			t -= start;
+			t = start + (t - std::floor(t / length) * length);
+		}
+		t = (std::min)((std::max)(t, start), end);
+
+		UINT32 segment = first + animations.cursors[c];
+		if (segment >= last || t < keyTimes[segment])
+			segment = first;
+		while (segment + 1 < last && t > keyTimes[segment + 1])
+			++segment;
+		animations.cursors[c] = segment - first;
+
+		const float t1 = keyTimes[segment];
+		const float t2 = keyTimes[segment + 1];
+		const float dt = t2 - t1;
+		const float u = dt > 0.0f ? (t - t1) / dt : 0.0f;
+		keys[0] = segment > first ? segment - 1 : segment;
+		keys[1] = segment;
+		keys[2] = segment + 1;
+		keys[3] = segment + 2 <= last ? segment + 2 : segment + 1;
+		if (animations.interpolations[c] == INTERPOLATION_CUBIC && dt > 0.0f)
+		{
+			// Hermite with tangents (p2 - p0) * a and (p3 - p1) * b, scaled to the segment length
+			const float a = dt / (t2 - keyTimes[keys[0]]);
+			const float b = dt / (keyTimes[keys[3]] - t1);
+			const float u2 = u * u;
+			const float u3 = u2 * u;
+			const float h00 = 2.0f * u3 - 3.0f * u2 + 1.0f;
+			const float h10 = u3 - 2.0f * u2 + u;
+			const float h01 = -2.0f * u3 + 3.0f * u2;
+			const float h11 = u3 - u2;
+			weights[0] = -h10 * a;
+			weights[1] = h00 - h11 * b;
+			weights[2] = h01 + h10 * a;
+			weights[3] = h11 * b;
+		}
+		else
+		{
+			weights[0] = 0.0f; weights[1] = 1.0f - u; weights[2] = u; weights[3] = 0.0f;
+		}
+	}
+
+	// Same arithmetic for every channel
+	const DirectX::XMFLOAT3* values = animations.keyValues.data();
+	for (size_t c = 0; c < count; c++)
+	{
+		const UINT32* keys = &animations.sampleKeys[c * 4];
+		const float* w = &animations.sampleWeights[c * 4];
+		const auto& p0 = values[keys[0]];
+		const auto& p1 = values[keys[1]];
+		const auto& p2 = values[keys[2]];
+		const auto& p3 = values[keys[3]];
+		auto& sample = animations.samples[c];
+		sample.x = w[0] * p0.x + w[1] * p1.x + w[2] * p2.x + w[3] * p3.x;
+		sample.y = w[0] * p0.y + w[1] * p1.y + w[2] * p2.y + w[3] * p3.y;
+		sample.z = w[0] * p0.z + w[1] * p1.z + w[2] * p2.z + w[3] * p3.z;
+	}
+
+	// Held keys and paused tracks leave their instances clean
+	size_t flagged = 0;
+	std::vector<DirectX::XMFLOAT3>* targets[] = { &store.translations, &store.rotations, &store.scalings };
+	for (size_t c = 0; c < count; c++)
+	{
+		const UINT32 i = animations.objIdx[c];
+		auto& value = (*targets[animations.targets[c]])[i];
+		const auto& sample = animations.samples[c];
+		if (memcmp(&value, &sample, sizeof(sample)) == 0)
+			continue;
+		value = sample;
+		if (!(store.dirty[i] & INSTANCE_DIRTY_TRANSFORM))
+			++flagged;
+		store.markTransformDirty(i, frameCount);
+	}
+	return flagged;
+}
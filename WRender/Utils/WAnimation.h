@@ -0,0 +1,75 @@
+#pragma once
+#include <windows.h>
+#include <vector>
+#include <DirectXMath.h>
+
+struct WInstanceStore;
+
+// Keyframe tracks of <animation> elements on objects:
+//
+// <object name="...">
+//   <animation loop="true">
+//     <translation interpolation="cubic">
+//       <key time="0">0,0,0</key>
+//       <key time="2">0,5,0</key>
+//     </translation>
+//     <rotation> ... </rotation>   (degrees)
+//     <scale> ... </scale>
+//   </animation>
+// </object>
+//
+// Interpolation is "linear" (default) or "cubic", a Catmull-Rom spline through the keys
+// with tangents clamped at the first and last key. Looping tracks repeat after their last
+// key, others hold it. Tracks replace the TRS given in <transform>.
+
+enum WANIMATION_TARGET : UINT32
+{
+	ANIMATION_TRANSLATION = 0,
+	ANIMATION_ROTATION,
+	ANIMATION_SCALE
+};
+
+enum WINTERPOLATION : UINT32
+{
+	INTERPOLATION_LINEAR = 0,
+	INTERPOLATION_CUBIC
+};
+
+// Every channel of a scene as structure of arrays, the keys of one channel are contiguous
+// and sorted by time
+struct WAnimationSet
+{
+	// Per channel
+	std::vector<UINT32> objIdx;
+	std::vector<UINT32> targets;
+	std::vector<UINT32> interpolations;
+	std::vector<UINT8> loops;
+	std::vector<UINT32> firstKeys;
+	std::vector<UINT32> keyCounts;
+	// Segment of the previous evaluation, playback mostly moves forward
+	std::vector<UINT32> cursors;
+
+	// Per key
+	std::vector<float> keyTimes;
+	std::vector<DirectX::XMFLOAT3> keyValues;
+
+	// Scratch of evaluateAnimations, four keys and weights per channel
+	std::vector<UINT32> sampleKeys;
+	std::vector<float> sampleWeights;
+	std::vector<DirectX::XMFLOAT3> samples;
+
+	size_t size() const { return objIdx.size(); }
+	bool empty() const { return objIdx.empty(); }
+	void clear();
+
+	// "times" and "values" are sorted by the caller and hold at least one key
+	void addChannel(UINT32 object, WANIMATION_TARGET target, WINTERPOLATION interpolation, bool loop,
+		const std::vector<float>& times, const std::vector<DirectX::XMFLOAT3>& values);
+	size_t animatedObjectCount() const;
+	// Channels and keys, ignoring the playback cursors
+	bool sameTracks(const WAnimationSet& other) const;
+};
+
+// Samples every channel at "time" (seconds) straight into the TRS arrays of "store".
+// Only instances whose TRS changed are flagged for recomposition, returns their number.
+size_t evaluateAnimations(WAnimationSet& animations, float time, WInstanceStore& store, int frameCount);
@@ -0,0 +1,1054 @@
+#include "WBvh.h"
+#include "WThreadPool.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// The fourth lane is padding, growing works on all four with SSE
+	struct Box
+	{
+		alignas(16) float lower[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+		alignas(16) float upper[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void grow(const float p[3])
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				lower[k] = (std::min)(lower[k], p[k]);
+				upper[k] = (std::max)(upper[k], p[k]);
+			}
+		}
+		void grow(const Box& b)
+		{
+			_mm_store_ps(lower, _mm_min_ps(_mm_load_ps(lower), _mm_load_ps(b.lower)));
+			_mm_store_ps(upper, _mm_max_ps(_mm_load_ps(upper), _mm_load_ps(b.upper)));
+		}
+		// Half the surface area, the SAH only needs ratios
+		float halfArea() const
+		{
+			if (lower[0] > upper[0])
+				return 0.0f;
+			float dx = upper[0] - lower[0], dy = upper[1] - lower[1], dz = upper[2] - lower[2];
+			return dx * dy + dy * dz + dz * dx;
+		}
+	};
+
+	// Triangle bounds travel with the triangle through the partitions, which keeps binning
+	// and partitioning on contiguous memory
+	struct Reference
+	{
+		Box bounds;
+		UINT32 triangle = 0;
+
+		float centroid(int axis) const { return (bounds.lower[axis] + bounds.upper[axis]) * 0.5f; }
+	};
+
+	struct BuildNode
+	{
+		Box bounds;
+		UINT32 left = 0;
+		UINT32 right = 0;
+		UINT32 first = 0;
+		UINT32 count = 0;   // 0 for inner nodes
+	};
+
+	struct Bin
+	{
+		Box bounds;
+		UINT32 count = 0;
+	};
+
+	struct AxisBins
+	{
+		Bin bins[3][WBvh::MaxBins];
+
+		void reset(UINT32 binCount)
+		{
+			for (int axis = 0; axis < 3; axis++)
+				std::fill(bins[axis], bins[axis] + binCount, Bin());
+		}
+
+		void merge(const AxisBins& other, UINT32 binCount)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (UINT32 b = 0; b < binCount; b++)
+				{
+					bins[axis][b].bounds.grow(other.bins[axis][b].bounds);
+					bins[axis][b].count += other.bins[axis][b].count;
+				}
+			}
+		}
+	};
+
+	// Ranges longer than this are binned and bounded in parallel chunks
+	const UINT32 ParallelChunkSize = 16384;
+
+	// Best split of a node, the bounds and counts are those of its two sides
+	struct Split
+	{
+		float cost = FLT_MAX;
+		int axis = -1;
+		UINT32 bin = 0;
+		bool spatial = false;
+		Box left;
+		Box right;
+		UINT32 leftCount = 0;
+		UINT32 rightCount = 0;
+	};
+
+	struct BuildContext
+	{
+		WBvhBuildOptions options;
+		WBvhMesh mesh;
+		// Object splits partition this in place, leaves refer to its ranges
+		std::vector<Reference> references;
+		std::vector<BuildNode> nodes;
+		std::atomic<UINT32> nodeCount{ 1 };
+		// Spatial splits hand references down in per-node vectors, leaves are appended here
+		std::vector<UINT32> leafTriangles;
+		std::atomic<UINT32> leafTriangleCount{ 0 };
+		std::atomic<INT64> duplicateBudget{ 0 };
+		std::atomic<UINT32> spatialSplits{ 0 };
+		float rootArea = 0.0f;
+	};
+
+	template<typename ChunkFunction>
+	void forChunks(UINT32 begin, UINT32 end, ChunkFunction&& function)
+	{
+		const UINT32 chunks = (end - begin + ParallelChunkSize - 1) / ParallelChunkSize;
+		if (chunks <= 1)
+		{
+			function(0, begin, end);
+			return;
+		}
+		WThreadPool::global().parallelFor(chunks, [&](size_t c) {
+			UINT32 chunkBegin = begin + static_cast<UINT32>(c) * ParallelChunkSize;
+			function(c, chunkBegin, (std::min)(chunkBegin + ParallelChunkSize, end));
+		});
+	}
+
+	void boundChunk(const Reference* references, UINT32 begin, UINT32 end, Box& bounds, Box& centroidBounds)
+	{
+		for (UINT32 i = begin; i < end; i++)
+		{
+			const Reference& reference = references[i];
+			const float centroid[3] = { reference.centroid(0), reference.centroid(1), reference.centroid(2) };
+			bounds.grow(reference.bounds);
+			centroidBounds.grow(centroid);
+		}
+	}
+
+	void rangeBounds(const Reference* references, UINT32 count, Box& bounds, Box& centroidBounds)
+	{
+		const UINT32 chunks = (count + ParallelChunkSize - 1) / ParallelChunkSize;
+		if (chunks <= 1)
+		{
+			boundChunk(references, 0, count, bounds, centroidBounds);
+			return;
+		}
+		std::vector<Box> chunkBounds(chunks), chunkCentroids(chunks);
+		forChunks(0, count, [&](size_t c, UINT32 chunkBegin, UINT32 chunkEnd) {
+			boundChunk(references, chunkBegin, chunkEnd, chunkBounds[c], chunkCentroids[c]);
+		});
+		for (UINT32 c = 0; c < chunks; c++)
+		{
+			bounds.grow(chunkBounds[c]);
+			centroidBounds.grow(chunkCentroids[c]);
+		}
+	}
+
+	inline UINT32 binOf(float c, float lower, float scale, UINT32 binCount)
+	{
+		INT32 b = static_cast<INT32>((c - lower) * scale);
+		return static_cast<UINT32>((std::min)((std::max)(b, 0), static_cast<INT32>(binCount) - 1));
+	}
+
+	void binRange(const Reference* references, UINT32 count, const Box& centroidBounds, const float scale[3],
+		UINT32 binCount, AxisBins& result)
+	{
+		const UINT32 chunks = (count + ParallelChunkSize - 1) / ParallelChunkSize;
+		auto binChunk = [&](UINT32 chunkBegin, UINT32 chunkEnd, AxisBins& bins) {
+			bins.reset(binCount);
+			for (UINT32 i = chunkBegin; i < chunkEnd; i++)
+			{
+				const Reference& reference = references[i];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					auto& bin = bins.bins[axis][binOf(reference.centroid(axis), centroidBounds.lower[axis], scale[axis], binCount)];
+					bin.bounds.grow(reference.bounds);
+					++bin.count;
+				}
+			}
+		};
+		if (chunks <= 1)
+		{
+			binChunk(0, count, result);
+			return;
+		}
+		std::vector<AxisBins> chunkBins(chunks);
+		forChunks(0, count, [&](size_t c, UINT32 chunkBegin, UINT32 chunkEnd) {
+			binChunk(chunkBegin, chunkEnd, chunkBins[c]);
+		});
+		result = chunkBins[0];
+		for (UINT32 c = 1; c < chunks; c++)
+			result.merge(chunkBins[c], binCount);
+	}
+
+	// Binned SAH over all three axes, costs are in triangle tests. The bins are per thread
+	// scratch, neither on the recursion stack nor constructed for every node.
+	void findObjectSplit(const BuildContext& ctx, const Reference* references, UINT32 count, const Box& bounds,
+		const Box& centroidBounds, const float scale[3], UINT32 binCount, Split& best)
+	{
+		thread_local AxisBins bins;
+		binRange(references, count, centroidBounds, scale, binCount, bins);
+		const float parentArea = (std::max)(bounds.halfArea(), FLT_MIN);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (scale[axis] == 0.0f)
+				continue;
+			// right[b]: bounds of bins b and above
+			Box right[WBvh::MaxBins];
+			UINT32 rightCount[WBvh::MaxBins];
+			UINT32 count = 0;
+			for (UINT32 b = binCount - 1; b > 0; b--)
+			{
+				right[b] = b + 1 < binCount ? right[b + 1] : Box();
+				right[b].grow(bins.bins[axis][b].bounds);
+				count += bins.bins[axis][b].count;
+				rightCount[b] = count;
+			}
+			Box left;
+			UINT32 leftCount = 0;
+			for (UINT32 split = 1; split < binCount; split++)
+			{
+				left.grow(bins.bins[axis][split - 1].bounds);
+				leftCount += bins.bins[axis][split - 1].count;
+				if (leftCount == 0 || rightCount[split] == 0)
+					continue;
+				float cost = ctx.options.traversalCost + (left.halfArea() * leftCount + right[split].halfArea() * rightCount[split]) / parentArea;
+				if (cost < best.cost)
+				{
+					best.cost = cost;
+					best.axis = axis;
+					best.bin = split;
+					best.spatial = false;
+					best.left = left;
+					best.right = right[split];
+					best.leftCount = leftCount;
+					best.rightCount = rightCount[split];
+				}
+			}
+		}
+	}
+
+	inline Box intersection(const Box& a, const Box& b)
+	{
+		Box result;
+		_mm_store_ps(result.lower, _mm_max_ps(_mm_load_ps(a.lower), _mm_load_ps(b.lower)));
+		_mm_store_ps(result.upper, _mm_min_ps(_mm_load_ps(a.upper), _mm_load_ps(b.upper)));
+		return result;
+	}
+
+	inline bool isEmpty(const Box& box)
+	{
+		return box.lower[0] > box.upper[0] || box.lower[1] > box.upper[1] || box.lower[2] > box.upper[2];
+	}
+
+	// Bounds of the part of a triangle between two planes along "axis", limited to the bounds
+	// of its reference, which may already be a clipped part
+	Box clipTriangle(const WBvhMesh& mesh, const Reference& reference, int axis, float lower, float upper)
+	{
+		const UINT32* corner = &mesh.indices[3 * static_cast<size_t>(reference.triangle)];
+		const float* p[3];
+		for (int k = 0; k < 3; k++)
+			p[k] = &mesh.vertices[3 * static_cast<size_t>(corner[k])];
+		Box box;
+		for (int k = 0; k < 3; k++)
+		{
+			const float* a = p[k];
+			const float* b = p[(k + 1) % 3];
+			if (a[axis] >= lower && a[axis] <= upper)
+				box.grow(a);
+			for (float plane : { lower, upper })
+			{
+				if ((a[axis] < plane && b[axis] > plane) || (a[axis] > plane && b[axis] < plane))
+				{
+					const float t = (plane - a[axis]) / (b[axis] - a[axis]);
+					float q[3] = { a[0] + t * (b[0] - a[0]), a[1] + t * (b[1] - a[1]), a[2] + t * (b[2] - a[2]) };
+					q[axis] = plane;
+					box.grow(q);
+				}
+			}
+		}
+		return intersection(box, reference.bounds);
+	}
+
+	struct SpatialBin
+	{
+		Box bounds;
+		UINT32 entries = 0;   // References starting in the bin
+		UINT32 exits = 0;     // References ending in the bin
+	};
+
+	struct SpatialBins
+	{
+		SpatialBin bins[3][WBvh::MaxBins];
+
+		void reset(UINT32 binCount)
+		{
+			for (int axis = 0; axis < 3; axis++)
+				std::fill(bins[axis], bins[axis] + binCount, SpatialBin());
+		}
+	};
+
+	// Spatial binning (Stich et al. 2009): references are clipped into every bin they span,
+	// the sides of a split count the references entering and leaving them
+	void findSpatialSplit(const BuildContext& ctx, const Reference* references, UINT32 count, const Box& bounds,
+		UINT32 binCount, Split& best)
+	{
+		thread_local SpatialBins bins;
+		bins.reset(binCount);
+		float scale[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = bounds.upper[axis] - bounds.lower[axis];
+			scale[axis] = extent > 0.0f ? binCount / extent : 0.0f;
+		}
+		for (UINT32 i = 0; i < count; i++)
+		{
+			const Reference& reference = references[i];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (scale[axis] == 0.0f)
+					continue;
+				const UINT32 entry = binOf(reference.bounds.lower[axis], bounds.lower[axis], scale[axis], binCount);
+				const UINT32 exit = binOf(reference.bounds.upper[axis], bounds.lower[axis], scale[axis], binCount);
+				auto* axisBins = bins.bins[axis];
+				if (entry == exit)
+				{
+					axisBins[entry].bounds.grow(reference.bounds);
+				}
+				else
+				{
+					for (UINT32 b = entry; b <= exit; b++)
+					{
+						const float lower = b == entry ? -FLT_MAX : bounds.lower[axis] + b / scale[axis];
+						const float upper = b == exit ? FLT_MAX : bounds.lower[axis] + (b + 1) / scale[axis];
+						axisBins[b].bounds.grow(clipTriangle(ctx.mesh, reference, axis, lower, upper));
+					}
+				}
+				++axisBins[entry].entries;
+				++axisBins[exit].exits;
+			}
+		}
+
+		const float parentArea = (std::max)(bounds.halfArea(), FLT_MIN);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (scale[axis] == 0.0f)
+				continue;
+			Box right[WBvh::MaxBins];
+			UINT32 rightCount[WBvh::MaxBins];
+			UINT32 exits = 0;
+			for (UINT32 b = binCount - 1; b > 0; b--)
+			{
+				right[b] = b + 1 < binCount ? right[b + 1] : Box();
+				right[b].grow(bins.bins[axis][b].bounds);
+				exits += bins.bins[axis][b].exits;
+				rightCount[b] = exits;
+			}
+			Box left;
+			UINT32 leftCount = 0;
+			for (UINT32 split = 1; split < binCount; split++)
+			{
+				left.grow(bins.bins[axis][split - 1].bounds);
+				leftCount += bins.bins[axis][split - 1].entries;
+				if (leftCount == 0 || rightCount[split] == 0)
+					continue;
+				float cost = ctx.options.traversalCost + (left.halfArea() * leftCount + right[split].halfArea() * rightCount[split]) / parentArea;
+				if (cost < best.cost)
+				{
+					best.cost = cost;
+					best.axis = axis;
+					best.bin = split;
+					best.spatial = true;
+					best.left = left;
+					best.right = right[split];
+					best.leftCount = leftCount;
+					best.rightCount = rightCount[split];
+				}
+			}
+		}
+	}
+
+	// Sorts the references to the sides of a spatial split. Straddling ones are split at the
+	// plane unless moving them whole to one side is cheaper (reference unsplitting). False when
+	// the duplicates exceed the budget or a side ends up empty, "references" is unchanged then.
+	bool spatialPartition(BuildContext& ctx, const std::vector<Reference>& references, const Box& bounds, UINT32 binCount,
+		Split split, std::vector<Reference>& left, std::vector<Reference>& right)
+	{
+		const UINT32 count = static_cast<UINT32>(references.size());
+		const INT64 reserved = static_cast<INT64>(split.leftCount) + split.rightCount - count;
+		if (ctx.duplicateBudget.fetch_sub(reserved) < reserved)
+		{
+			ctx.duplicateBudget.fetch_add(reserved);
+			return false;
+		}
+		const int axis = split.axis;
+		const float scale = binCount / (bounds.upper[axis] - bounds.lower[axis]);
+		const float plane = bounds.lower[axis] + split.bin / scale;
+		left.reserve(split.leftCount);
+		right.reserve(split.rightCount);
+		for (const auto& reference : references)
+		{
+			const UINT32 entry = binOf(reference.bounds.lower[axis], bounds.lower[axis], scale, binCount);
+			const UINT32 exit = binOf(reference.bounds.upper[axis], bounds.lower[axis], scale, binCount);
+			if (exit < split.bin)
+			{
+				left.push_back(reference);
+				continue;
+			}
+			if (entry >= split.bin)
+			{
+				right.push_back(reference);
+				continue;
+			}
+			Box leftUnsplit = split.left, rightUnsplit = split.right;
+			leftUnsplit.grow(reference.bounds);
+			rightUnsplit.grow(reference.bounds);
+			const float splitCost = split.left.halfArea() * split.leftCount + split.right.halfArea() * split.rightCount;
+			const float leftCost = leftUnsplit.halfArea() * split.leftCount + split.right.halfArea() * (split.rightCount - 1);
+			const float rightCost = split.left.halfArea() * (split.leftCount - 1) + rightUnsplit.halfArea() * split.rightCount;
+			if (leftCost < splitCost && leftCost <= rightCost)
+			{
+				left.push_back(reference);
+				split.left = leftUnsplit;
+				--split.rightCount;
+				continue;
+			}
+			if (rightCost < splitCost)
+			{
+				right.push_back(reference);
+				split.right = rightUnsplit;
+				--split.leftCount;
+				continue;
+			}
+			Reference leftPart = reference, rightPart = reference;
+			leftPart.bounds = clipTriangle(ctx.mesh, reference, axis, -FLT_MAX, plane);
+			rightPart.bounds = clipTriangle(ctx.mesh, reference, axis, plane, FLT_MAX);
+			if (!isEmpty(leftPart.bounds))
+				left.push_back(leftPart);
+			if (!isEmpty(rightPart.bounds))
+				right.push_back(rightPart);
+		}
+		const INT64 duplicates = static_cast<INT64>(left.size() + right.size()) - count;
+		if (left.empty() || right.empty())
+		{
+			ctx.duplicateBudget.fetch_add(reserved);
+			left.clear();
+			right.clear();
+			return false;
+		}
+		ctx.duplicateBudget.fetch_add(reserved - duplicates);
+		return true;
+	}
+
+	// Median of the widest centroid axis, for identical centroids or nodes too deep for the SAH
+	template<typename Iterator>
+	void medianSplit(Iterator first, UINT32 count, const Box& centroidBounds)
+	{
+		int axis = 0;
+		for (int k = 1; k < 3; k++)
+			if (centroidBounds.upper[k] - centroidBounds.lower[k] > centroidBounds.upper[axis] - centroidBounds.lower[axis])
+				axis = k;
+		std::nth_element(first, first + count / 2, first + count,
+			[&](const Reference& a, const Reference& b) { return a.centroid(axis) < b.centroid(axis); });
+	}
+
+	// Small nodes do not fill the bins, fewer keep the per-node sweep short
+	UINT32 centroidScale(const BuildContext& ctx, UINT32 count, const Box& centroidBounds, float scale[3])
+	{
+		const UINT32 binCount = (std::min)(ctx.options.binCount, count);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = centroidBounds.upper[axis] - centroidBounds.lower[axis];
+			scale[axis] = extent > 0.0f ? binCount / extent : 0.0f;
+		}
+		return binCount;
+	}
+
+	// Object splits only, the references of a node are the range [begin, end)
+	void buildNode(BuildContext& ctx, UINT32 nodeIndex, UINT32 begin, UINT32 end, UINT32 depth)
+	{
+		BuildNode& node = ctx.nodes[nodeIndex];
+		Box centroidBounds;
+		rangeBounds(ctx.references.data() + begin, end - begin, node.bounds, centroidBounds);
+		const UINT32 count = end - begin;
+		const auto& options = ctx.options;
+		node.first = begin;
+		node.count = count;
+		if (count == 1)
+			return;
+
+		float scale[3];
+		const UINT32 binCount = centroidScale(ctx, count, centroidBounds, scale);
+		Split split;
+		if (depth < WBvh::MaxSahDepth)
+			findObjectSplit(ctx, ctx.references.data() + begin, count, node.bounds, centroidBounds, scale, binCount, split);
+
+		UINT32 middle;
+		auto first = ctx.references.begin() + begin;
+		if (split.axis >= 0 && (split.cost < static_cast<float>(count) || count > options.maxLeafSize))
+		{
+			const int axis = split.axis;
+			const float lower = centroidBounds.lower[axis];
+			auto middleIt = std::partition(first, first + count, [&](const Reference& reference) {
+				return binOf(reference.centroid(axis), lower, scale[axis], binCount) < split.bin;
+			});
+			middle = begin + static_cast<UINT32>(middleIt - first);
+		}
+		else if (count <= options.maxLeafSize)
+		{
+			return;
+		}
+		else
+		{
+			medianSplit(first, count, centroidBounds);
+			middle = begin + count / 2;
+		}
+
+		const UINT32 left = ctx.nodeCount.fetch_add(2);
+		node.left = left;
+		node.right = left + 1;
+		node.count = 0;
+		if (count >= options.parallelThreshold)
+		{
+			WThreadPool::global().parallelFor(2, [&](size_t child) {
+				if (child == 0)
+					buildNode(ctx, left, begin, middle, depth + 1);
+				else
+					buildNode(ctx, left + 1, middle, end, depth + 1);
+			});
+		}
+		else
+		{
+			buildNode(ctx, left, begin, middle, depth + 1);
+			buildNode(ctx, left + 1, middle, end, depth + 1);
+		}
+	}
+
+	// SBVH, takes the references of the node over and frees them before recursing
+	void buildSpatialNode(BuildContext& ctx, UINT32 nodeIndex, std::vector<Reference>& references, UINT32 depth)
+	{
+		BuildNode& node = ctx.nodes[nodeIndex];
+		Box centroidBounds;
+		const UINT32 count = static_cast<UINT32>(references.size());
+		rangeBounds(references.data(), count, node.bounds, centroidBounds);
+		if (nodeIndex == 0)
+			ctx.rootArea = node.bounds.halfArea();
+		const auto& options = ctx.options;
+		auto makeLeaf = [&]() {
+			node.first = ctx.leafTriangleCount.fetch_add(count);
+			node.count = count;
+			for (UINT32 i = 0; i < count; i++)
+				ctx.leafTriangles[node.first + i] = references[i].triangle;
+			std::vector<Reference>().swap(references);
+		};
+		if (count == 1)
+		{
+			makeLeaf();
+			return;
+		}
+
+		float scale[3];
+		const UINT32 binCount = centroidScale(ctx, count, centroidBounds, scale);
+		const UINT32 spatialBinCount = (std::min)(options.binCount, 2 * count);
+		Split split;
+		if (depth < WBvh::MaxSahDepth)
+		{
+			findObjectSplit(ctx, references.data(), count, node.bounds, centroidBounds, scale, binCount, split);
+			// Spatial splits only pay off where the object split leaves the children overlapping
+			const float overlap = split.axis >= 0 ? intersection(split.left, split.right).halfArea() : ctx.rootArea;
+			if (overlap > options.spatialSplitAlpha * ctx.rootArea && ctx.duplicateBudget.load() > 0)
+				findSpatialSplit(ctx, references.data(), count, node.bounds, spatialBinCount, split);
+		}
+		const bool worthSplitting = split.axis >= 0 && (split.cost < static_cast<float>(count) || count > options.maxLeafSize);
+		if (!worthSplitting && count <= options.maxLeafSize)
+		{
+			makeLeaf();
+			return;
+		}
+
+		std::vector<Reference> left, right;
+		bool divided = false;
+		if (worthSplitting && split.spatial)
+		{
+			divided = spatialPartition(ctx, references, node.bounds, spatialBinCount, split, left, right);
+			if (divided)
+			{
+				++ctx.spatialSplits;
+			}
+			else
+			{
+				// Over budget, fall back to the object split
+				split = Split();
+				findObjectSplit(ctx, references.data(), count, node.bounds, centroidBounds, scale, binCount, split);
+			}
+		}
+		if (!divided && split.axis >= 0 && (split.cost < static_cast<float>(count) || count > options.maxLeafSize))
+		{
+			const int axis = split.axis;
+			const float lower = centroidBounds.lower[axis];
+			for (const auto& reference : references)
+			{
+				if (binOf(reference.centroid(axis), lower, scale[axis], binCount) < split.bin)
+					left.push_back(reference);
+				else
+					right.push_back(reference);
+			}
+			divided = true;
+		}
+		if (!divided)
+		{
+			if (count <= options.maxLeafSize)
+			{
+				makeLeaf();
+				return;
+			}
+			medianSplit(references.begin(), count, centroidBounds);
+			left.assign(references.begin(), references.begin() + count / 2);
+			right.assign(references.begin() + count / 2, references.end());
+		}
+		std::vector<Reference>().swap(references);
+
+		const UINT32 leftIndex = ctx.nodeCount.fetch_add(2);
+		node.left = leftIndex;
+		node.right = leftIndex + 1;
+		node.count = 0;
+		if (count >= options.parallelThreshold)
+		{
+			WThreadPool::global().parallelFor(2, [&](size_t child) {
+				if (child == 0)
+					buildSpatialNode(ctx, leftIndex, left, depth + 1);
+				else
+					buildSpatialNode(ctx, leftIndex + 1, right, depth + 1);
+			});
+		}
+		else
+		{
+			buildSpatialNode(ctx, leftIndex, left, depth + 1);
+			buildSpatialNode(ctx, leftIndex + 1, right, depth + 1);
+		}
+	}
+
+	// Entry distance of the ray into the node box, FLT_MAX on a miss
+	// WBvhNode records of the build nodes, counts leaves and depth into "stats"
+	void flattenNodes(const BuildContext& ctx, std::vector<WBvhNode>& nodes, WBvhStats& stats)
+	{
+		// Depth-first order, the right child is linked once it is reached
+		struct Pending
+		{
+			UINT32 node;
+			UINT32 parent;   // Flat index of the parent of a right child, ~0u otherwise
+			UINT32 depth;
+		};
+		const UINT32 nodeCount = ctx.nodeCount.load();
+		nodes.reserve(nodeCount);
+		std::vector<Pending> pending;
+		pending.push_back({ 0, ~0u, 1 });
+		while (!pending.empty())
+		{
+			Pending item = pending.back();
+			pending.pop_back();
+			const BuildNode& source = ctx.nodes[item.node];
+			const UINT32 flat = static_cast<UINT32>(nodes.size());
+			if (item.parent != ~0u)
+				nodes[item.parent].firstOrRight = flat;
+			WBvhNode node;
+			node.boundsMin = DirectX::XMFLOAT3(source.bounds.lower[0], source.bounds.lower[1], source.bounds.lower[2]);
+			node.boundsMax = DirectX::XMFLOAT3(source.bounds.upper[0], source.bounds.upper[1], source.bounds.upper[2]);
+			node.firstOrRight = source.first;
+			node.count = source.count;
+			nodes.push_back(node);
+			stats.maxDepth = (std::max)(stats.maxDepth, item.depth);
+			if (source.count > 0)
+			{
+				++stats.leaves;
+				continue;
+			}
+			pending.push_back({ source.right, flat, item.depth + 1 });
+			pending.push_back({ source.left, ~0u, item.depth + 1 });
+		}
+	}
+
+	// Closest hit when "anyHit" is false, the first one found otherwise
+	bool traverse(const WBvh& bvh, const WRay& ray, bool anyHit, WRayHit& hit)
+	{
+		const auto& nodes = bvh.nodes();
+		if (nodes.empty())
+			return false;
+		const auto& mesh = bvh.mesh();
+		const UINT32* triangles = bvh.triangles().data();
+		const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+		const float invDirection[3] = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+		float closest = ray.tMax;
+		bool found = false;
+
+		UINT32 stack[WBvh::StackSize];
+		UINT32 stackSize = 0;
+		UINT32 index = 0;
+		if (intersectBox(nodes[0], origin, invDirection, ray.tMin, closest) == FLT_MAX)
+			return false;
+		for (;;)
+		{
+			const WBvhNode& node = nodes[index];
+			if (node.isLeaf())
+			{
+				for (UINT32 i = 0; i < node.count; i++)
+				{
+					const UINT32 triangle = triangles[node.firstOrRight + i];
+					const UINT32* corner = &mesh.indices[3 * static_cast<size_t>(triangle)];
+					float t, u, v;
+					WRay clipped = ray;
+					clipped.tMax = closest;
+					if (!intersectTriangle(clipped, &mesh.vertices[3 * static_cast<size_t>(corner[0])],
+						&mesh.vertices[3 * static_cast<size_t>(corner[1])], &mesh.vertices[3 * static_cast<size_t>(corner[2])], t, u, v))
+						continue;
+					closest = t;
+					hit.t = t;
+					hit.triangle = triangle;
+					hit.u = u;
+					hit.v = v;
+					found = true;
+					if (anyHit)
+						return true;
+				}
+			}
+			else
+			{
+				const UINT32 left = index + 1;
+				const UINT32 right = node.firstOrRight;
+				float tLeft = intersectBox(nodes[left], origin, invDirection, ray.tMin, closest);
+				float tRight = intersectBox(nodes[right], origin, invDirection, ray.tMin, closest);
+				if (tLeft != FLT_MAX && tRight != FLT_MAX)
+				{
+					// Nearer child first
+					index = tLeft <= tRight ? left : right;
+					stack[stackSize++] = tLeft <= tRight ? right : left;
+					continue;
+				}
+				if (tLeft != FLT_MAX || tRight != FLT_MAX)
+				{
+					index = tLeft != FLT_MAX ? left : right;
+					continue;
+				}
+			}
+			if (stackSize == 0)
+				break;
+			index = stack[--stackSize];
+		}
+		return found;
+	}
+}
+
+WBvhMesh bvhMeshOfRecord(WBufferView<tinyobj::real_t> vertexBuffer, WBufferView<UINT32> indexBuffer, const WGeometryRecord& record)
+{
+	WBvhMesh mesh;
+	const size_t firstVertex = static_cast<size_t>(record.vertexOffsetInBytes / sizeof(tinyobj::real_t));
+	const size_t firstIndex = static_cast<size_t>(record.indexOffsetInBytes / sizeof(UINT32));
+	if (firstVertex + 3 * static_cast<size_t>(record.vertexCount) > vertexBuffer.size() ||
+		firstIndex + record.indexCount > indexBuffer.size())
+		return mesh;
+	mesh.vertices = vertexBuffer.data() + firstVertex;
+	mesh.vertexCount = record.vertexCount;
+	mesh.indices = indexBuffer.data() + firstIndex;
+	mesh.triangleCount = record.indexCount / 3;
+	return mesh;
+}
+
+void WBvh::build(const WBvhMesh& mesh, const WBvhBuildOptions& options)
+{
+	auto start = std::chrono::steady_clock::now();
+	mMesh = mesh;
+	mNodes.clear();
+	mTriangles.clear();
+	mStats = WBvhStats();
+	const UINT32 triangleCount = static_cast<UINT32>(mesh.triangleCount);
+	mStats.triangles = triangleCount;
+	if (triangleCount == 0)
+		return;
+
+	BuildContext ctx;
+	ctx.options = options;
+	ctx.options.binCount = (std::min)((std::max)(options.binCount, 2u), MaxBins);
+	ctx.options.maxLeafSize = (std::max)(options.maxLeafSize, 1u);
+	ctx.references.resize(triangleCount);
+	forChunks(0, triangleCount, [&](size_t, UINT32 chunkBegin, UINT32 chunkEnd) {
+		for (UINT32 t = chunkBegin; t < chunkEnd; t++)
+		{
+			Reference& reference = ctx.references[t];
+			for (int k = 0; k < 3; k++)
+				reference.bounds.grow(&mesh.vertices[3 * static_cast<size_t>(mesh.indices[3 * static_cast<size_t>(t) + k])]);
+			reference.triangle = t;
+		}
+	});
+	if (options.spatialSplits)
+	{
+		// The budget bounds the references, and with them the nodes and leaf entries
+		const INT64 budget = static_cast<INT64>(triangleCount * static_cast<double>((std::max)(options.maxDuplication, 0.0f)));
+		const size_t capacity = triangleCount + static_cast<size_t>(budget);
+		ctx.mesh = mesh;
+		ctx.duplicateBudget = budget;
+		ctx.leafTriangles.resize(capacity);
+		ctx.nodes.resize(2 * capacity);
+		buildSpatialNode(ctx, 0, ctx.references, 0);
+		ctx.leafTriangles.resize(ctx.leafTriangleCount.load());
+		mTriangles = std::move(ctx.leafTriangles);
+		mStats.spatialSplits = ctx.spatialSplits.load();
+	}
+	else
+	{
+		ctx.nodes.resize(2 * static_cast<size_t>(triangleCount));
+		buildNode(ctx, 0, 0, triangleCount, 0);
+		mTriangles.resize(triangleCount);
+		for (UINT32 i = 0; i < triangleCount; i++)
+			mTriangles[i] = ctx.references[i].triangle;
+	}
+	mStats.references = mTriangles.size();
+	flattenNodes(ctx, mNodes, mStats);
+	mStats.nodes = mNodes.size();
+	mStats.sahCost = bvhSahCost(mNodes, options.traversalCost);
+	mStats.overlap = bvhOverlap(mNodes);
+	mStats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void WBvh::build(std::vector<float> vertices, std::vector<UINT32> indices, const WBvhBuildOptions& options)
+{
+	mOwnedVertices = std::move(vertices);
+	mOwnedIndices = std::move(indices);
+	WBvhMesh mesh;
+	mesh.vertices = mOwnedVertices.data();
+	mesh.vertexCount = mOwnedVertices.size() / 3;
+	mesh.indices = mOwnedIndices.data();
+	mesh.triangleCount = mOwnedIndices.size() / 3;
+	build(mesh, options);
+}
+
+void buildBoxBvh(const std::vector<DirectX::XMFLOAT3>& boxMin, const std::vector<DirectX::XMFLOAT3>& boxMax,
+	const WBvhBuildOptions& options, std::vector<WBvhNode>& nodes, std::vector<UINT32>& items, WBvhStats& stats)
+{
+	auto start = std::chrono::steady_clock::now();
+	nodes.clear();
+	items.clear();
+	stats = WBvhStats();
+	const UINT32 count = static_cast<UINT32>(boxMin.size());
+	stats.triangles = count;
+	if (count == 0)
+		return;
+
+	BuildContext ctx;
+	ctx.options = options;
+	ctx.options.binCount = (std::min)((std::max)(options.binCount, 2u), WBvh::MaxBins);
+	ctx.options.maxLeafSize = (std::max)(options.maxLeafSize, 1u);
+	ctx.references.resize(count);
+	for (UINT32 i = 0; i < count; i++)
+	{
+		Reference& reference = ctx.references[i];
+		reference.bounds.grow(&boxMin[i].x);
+		reference.bounds.grow(&boxMax[i].x);
+		reference.triangle = i;
+	}
+	ctx.nodes.resize(2 * static_cast<size_t>(count));
+	buildNode(ctx, 0, 0, count, 0);
+	items.resize(count);
+	for (UINT32 i = 0; i < count; i++)
+		items[i] = ctx.references[i].triangle;
+	stats.references = count;
+	flattenNodes(ctx, nodes, stats);
+	stats.nodes = nodes.size();
+	stats.sahCost = bvhSahCost(nodes, options.traversalCost);
+	stats.overlap = bvhOverlap(nodes);
+	stats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void WBvh::clear()
+{
+	mMesh = WBvhMesh();
+	std::vector<float>().swap(mOwnedVertices);
+	std::vector<UINT32>().swap(mOwnedIndices);
+	std::vector<WBvhNode>().swap(mNodes);
+	std::vector<UINT32>().swap(mTriangles);
+	mStats = WBvhStats();
+}
+
+bool WBvh::intersect(const WRay& ray, WRayHit& hit) const
+{
+	WRayHit closest;
+	if (!traverse(*this, ray, false, closest))
+		return false;
+	hit = closest;
+	return true;
+}
+
+bool WBvh::occluded(const WRay& ray) const
+{
+	WRayHit any;
+	return traverse(*this, ray, true, any);
+}
+
+UINT64 WBvh::memoryBytes() const
+{
+	return mNodes.size() * sizeof(WBvhNode) + mTriangles.size() * sizeof(UINT32) +
+		mOwnedVertices.size() * sizeof(float) + mOwnedIndices.size() * sizeof(UINT32);
+}
+
+double bvhSahCost(const std::vector<WBvhNode>& nodes, float traversalCost)
+{
+	if (nodes.empty())
+		return 0.0;
+	auto halfArea = [](const WBvhNode& node) {
+		double dx = node.boundsMax.x - node.boundsMin.x;
+		double dy = node.boundsMax.y - node.boundsMin.y;
+		double dz = node.boundsMax.z - node.boundsMin.z;
+		return dx * dy + dy * dz + dz * dx;
+	};
+	const double rootArea = (std::max)(halfArea(nodes[0]), 1e-30);
+	double cost = 0.0;
+	for (const auto& node : nodes)
+		cost += halfArea(node) / rootArea * (node.isLeaf() ? static_cast<double>(node.count) : traversalCost);
+	return cost;
+}
+
+double bvhOverlap(const std::vector<WBvhNode>& nodes)
+{
+	if (nodes.empty())
+		return 0.0;
+	auto halfArea = [](const DirectX::XMFLOAT3& lower, const DirectX::XMFLOAT3& upper) {
+		double dx = upper.x - lower.x, dy = upper.y - lower.y, dz = upper.z - lower.z;
+		return dx < 0.0 || dy < 0.0 || dz < 0.0 ? 0.0 : dx * dy + dy * dz + dz * dx;
+	};
+	const double rootArea = (std::max)(halfArea(nodes[0].boundsMin, nodes[0].boundsMax), 1e-30);
+	double overlap = 0.0;
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].isLeaf())
+			continue;
+		const WBvhNode& left = nodes[i + 1];
+		const WBvhNode& right = nodes[nodes[i].firstOrRight];
+		DirectX::XMFLOAT3 lower((std::max)(left.boundsMin.x, right.boundsMin.x), (std::max)(left.boundsMin.y, right.boundsMin.y),
+			(std::max)(left.boundsMin.z, right.boundsMin.z));
+		DirectX::XMFLOAT3 upper((std::min)(left.boundsMax.x, right.boundsMax.x), (std::min)(left.boundsMax.y, right.boundsMax.y),
+			(std::min)(left.boundsMax.z, right.boundsMax.z));
+		overlap += halfArea(lower, upper);
+	}
+	return overlap / rootArea;
+}
+
+float intersectBox(const WBvhNode& node, const float origin[3], const float invDirection[3], float tMin, float tMax)
+{
+	float t0 = (node.boundsMin.x - origin[0]) * invDirection[0];
+	float t1 = (node.boundsMax.x - origin[0]) * invDirection[0];
+	float entry = (std::min)(t0, t1), exit = (std::max)(t0, t1);
+	t0 = (node.boundsMin.y - origin[1]) * invDirection[1];
+	t1 = (node.boundsMax.y - origin[1]) * invDirection[1];
+	entry = (std::max)(entry, (std::min)(t0, t1));
+	exit = (std::min)(exit, (std::max)(t0, t1));
+	t0 = (node.boundsMin.z - origin[2]) * invDirection[2];
+	t1 = (node.boundsMax.z - origin[2]) * invDirection[2];
+	entry = (std::max)(entry, (std::min)(t0, t1));
+	exit = (std::min)(exit, (std::max)(t0, t1));
+	entry = (std::max)(entry, tMin);
+	exit = (std::min)(exit, tMax);
+	return entry <= exit ? entry : FLT_MAX;
+}
+
+bool intersectTriangle(const WRay& ray, const float* p0, const float* p1, const float* p2, float& t, float& u, float& v)
+{
+	const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	const float* d = &ray.direction.x;
+	const float pv[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+	const float det = e1[0] * pv[0] + e1[1] * pv[1] + e1[2] * pv[2];
+	if (std::fabs(det) < 1e-20f)
+		return false;
+	const float invDet = 1.0f / det;
+	const float s[3] = { ray.origin.x - p0[0], ray.origin.y - p0[1], ray.origin.z - p0[2] };
+	u = (s[0] * pv[0] + s[1] * pv[1] + s[2] * pv[2]) * invDet;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+	const float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+	v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+	t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+	return t >= ray.tMin && t <= ray.tMax;
+}
+
+const WBvh* WGeometryBvhSet::find(const std::string& geometryName) const
+{
+	auto it = bvhOfGeometry.find(geometryName);
+	return it != bvhOfGeometry.end() ? &bvhs[it->second] : nullptr;
+}
+
+UINT64 WGeometryBvhSet::memoryBytes() const
+{
+	UINT64 bytes = 0;
+	for (const auto& bvh : bvhs)
+		bytes += bvh.memoryBytes();
+	return bytes;
+}
+
+void buildGeometryBvhs(const std::map<std::string, WGeometryRecord>& geometryMap, const std::vector<std::string>& geometryNames,
+	WBufferView<tinyobj::real_t> vertexBuffer, WBufferView<UINT32> indexBuffer, WGeometryBvhSet& set, const WBvhBuildOptions& options)
+{
+	auto start = std::chrono::steady_clock::now();
+	set.bvhs.clear();
+	set.bvhOfGeometry.clear();
+	set.total = WBvhStats();
+
+	std::map<std::pair<UINT64, UINT64>, UINT32> slices;
+	std::vector<const WGeometryRecord*> records;
+	for (const auto& geometryName : geometryNames)
+	{
+		auto gItem = geometryMap.find(geometryName);
+		if (gItem == geometryMap.end())
+			continue;
+		const auto& record = gItem->second;
+		auto slice = slices.emplace(std::make_pair(record.vertexOffsetInBytes, record.indexOffsetInBytes),
+			static_cast<UINT32>(records.size()));
+		if (slice.second)
+			records.push_back(&record);
+		set.bvhOfGeometry[geometryName] = slice.first->second;
+	}
+
+	// Geometries build concurrently, large ones split their subtrees over the pool as well
+	set.bvhs.resize(records.size());
+	WThreadPool::global().parallelFor(records.size(), [&](size_t i) {
+		const auto& record = *records[i];
+		set.bvhs[i].build(bvhMeshOfRecord(vertexBuffer, indexBuffer, record), options);
+	});
+
+	for (const auto& bvh : set.bvhs)
+	{
+		const auto& stats = bvh.stats();
+		set.total.triangles += stats.triangles;
+		set.total.nodes += stats.nodes;
+		set.total.leaves += stats.leaves;
+		set.total.references += stats.references;
+		set.total.spatialSplits += stats.spatialSplits;
+		set.total.overlap += stats.overlap * stats.triangles;
+		set.total.maxDepth = (std::max)(set.total.maxDepth, stats.maxDepth);
+		set.total.sahCost += stats.sahCost * stats.triangles;
+	}
+	if (set.total.triangles > 0)
+	{
+		set.total.sahCost /= set.total.triangles;
+		set.total.overlap /= set.total.triangles;
+	}
+	set.total.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <windows.h>
+#include <vector>
+#include <map>
+#include <string>
+#include <cfloat>
+#include <DirectXMath.h>
+#include <../Include/tiny_obj_loader.h>
+#include "../FrameResource.h"
+#include "WSceneCache.h"
+
+// CPU bounding volume hierarchies over the scene's triangle buffers, for tracing rays
+// without the GPU (validation, picking, baking).
+
+// Triangles of one geometry. Indices are relative to "vertices" like in the scene buffers.
+struct WBvhMesh
+{
+	const float* vertices = nullptr;   // xyz
+	size_t vertexCount = 0;
+	const UINT32* indices = nullptr;   // 3 per triangle
+	size_t triangleCount = 0;
+};
+
+// The slice of the scene buffers "record" refers to, empty when it lies outside of them
+WBvhMesh bvhMeshOfRecord(WBufferView<tinyobj::real_t> vertexBuffer, WBufferView<UINT32> indexBuffer, const WGeometryRecord& record);
+
+// 32 bytes, depth-first: the left child of an inner node is the node right after it
+struct WBvhNode
+{
+	DirectX::XMFLOAT3 boundsMin;
+	UINT32 firstOrRight;   // Leaf: first entry of WBvh::triangles(), inner node: index of the right child
+	DirectX::XMFLOAT3 boundsMax;
+	UINT32 count;          // Triangles of a leaf, 0 for inner nodes
+
+	bool isLeaf() const { return count > 0; }
+};
+
+struct WBvhBuildOptions
+{
+	UINT32 binCount = 16;
+	// Leaves with more triangles are split even when the SAH prefers a leaf
+	UINT32 maxLeafSize = 8;
+	// SAH cost of visiting a node, relative to one triangle test
+	float traversalCost = 1.0f;
+	// Nodes with at least this many triangles build their children as separate tasks
+	UINT32 parallelThreshold = 4096;
+	// SBVH: nodes may also split at a plane, which duplicates the references of the
+	// triangles crossing it. Pays off for long, thin triangles (walls, floors).
+	bool spatialSplits = false;
+	// At most triangles * (1 + maxDuplication) references
+	float maxDuplication = 0.3f;
+	// Spatial splits are only tried where the children of the best object split overlap by
+	// more than this fraction of the root surface area
+	float spatialSplitAlpha = 1e-5f;
+};
+
+struct WBvhStats
+{
+	size_t triangles = 0;
+	size_t nodes = 0;
+	size_t leaves = 0;
+	// Leaf entries, more than triangles when spatial splits duplicated them
+	size_t references = 0;
+	size_t spatialSplits = 0;
+	UINT32 maxDepth = 0;
+	// Expected node visits and triangle tests of a ray through the root box (SAH with the
+	// build's traversal cost), lower is better
+	double sahCost = 0.0;
+	// Surface area shared by sibling boxes relative to the root, see bvhOverlap()
+	double overlap = 0.0;
+	double buildSeconds = 0.0;
+
+	double averageLeafSize() const { return leaves > 0 ? static_cast<double>(references) / leaves : 0.0; }
+	size_t duplicatedReferences() const { return references > triangles ? references - triangles : 0; }
+	double mtrisPerSecond() const { return buildSeconds > 0.0 ? triangles / buildSeconds * 1e-6 : 0.0; }
+};
+
+struct WRay
+{
+	DirectX::XMFLOAT3 origin = { 0.0f, 0.0f, 0.0f };
+	float tMin = 0.0f;
+	DirectX::XMFLOAT3 direction = { 0.0f, 0.0f, 1.0f };
+	float tMax = FLT_MAX;
+};
+
+struct WRayHit
+{
+	float t = FLT_MAX;
+	UINT32 triangle = ~0u;   // Index into the mesh, ~0u on a miss
+	float u = 0.0f;          // Barycentrics of the second and third vertex
+	float v = 0.0f;
+
+	bool hit() const { return triangle != ~0u; }
+};
+
+// Binary BVH built with binned SAH, optionally with spatial splits (SBVH). Subtrees are
+// built as tasks of the global thread pool, the nodes are stored depth-first in one array.
+class WBvh
+{
+public:
+	static constexpr UINT32 MaxBins = 64;
+	// Deeper nodes split at the median, which bounds the traversal stack
+	static constexpr UINT32 MaxSahDepth = 64;
+	static constexpr UINT32 StackSize = 128;
+
+	WBvh() = default;
+	WBvh(const WBvh& rhs) = delete;
+	WBvh& operator=(const WBvh& rhs) = delete;
+	// Moving keeps owned geometry in place, the mesh stays valid
+	WBvh(WBvh&& rhs) = default;
+	WBvh& operator=(WBvh&& rhs) = default;
+
+	// The mesh is referenced, not copied, and must outlive the BVH
+	void build(const WBvhMesh& mesh, const WBvhBuildOptions& options = WBvhBuildOptions());
+	// Takes the positions and indices over, for geometry that is not in memory otherwise
+	void build(std::vector<float> vertices, std::vector<UINT32> indices, const WBvhBuildOptions& options = WBvhBuildOptions());
+	void clear();
+
+	// Closest hit in [tMin, tMax], "hit" is left untouched on a miss
+	bool intersect(const WRay& ray, WRayHit& hit) const;
+	// Any hit in [tMin, tMax]
+	bool occluded(const WRay& ray) const;
+
+	bool empty() const { return mNodes.empty(); }
+	const WBvhMesh& mesh() const { return mMesh; }
+	const std::vector<WBvhNode>& nodes() const { return mNodes; }
+	// Triangle indices in leaf order
+	const std::vector<UINT32>& triangles() const { return mTriangles; }
+	const WBvhStats& stats() const { return mStats; }
+	// Nodes and triangle indices, plus owned geometry
+	UINT64 memoryBytes() const;
+private:
+	WBvhMesh mMesh;
+	std::vector<float> mOwnedVertices;
+	std::vector<UINT32> mOwnedIndices;
+	std::vector<WBvhNode> mNodes;
+	std::vector<UINT32> mTriangles;
+	WBvhStats mStats;
+};
+
+// SAH cost of a node array as reported in WBvhStats::sahCost
+double bvhSahCost(const std::vector<WBvhNode>& nodes, float traversalCost);
+
+// Summed surface area of the intersections of sibling boxes over the root surface area, the
+// area rays pay for visiting both children
+double bvhOverlap(const std::vector<WBvhNode>& nodes);
+
+// Slab test, the entry distance clamped to [tMin, tMax] or FLT_MAX on a miss
+float intersectBox(const WBvhNode& node, const float origin[3], const float invDirection[3], float tMin, float tMax);
+
+// Moller-Trumbore, "t" must lie in [tMin, tMax]
+bool intersectTriangle(const WRay& ray, const float* p0, const float* p1, const float* p2, float& t, float& u, float& v);
+
+// Binned SAH over boxes instead of triangles (object splits only), e.g. the instance bounds of
+// a top-level BVH. Leaves refer to "items", which holds box indices. Stats count boxes as
+// triangles.
+void buildBoxBvh(const std::vector<DirectX::XMFLOAT3>& boxMin, const std::vector<DirectX::XMFLOAT3>& boxMax,
+	const WBvhBuildOptions& options, std::vector<WBvhNode>& nodes, std::vector<UINT32>& items, WBvhStats& stats);
+
+// One BVH per distinct slice of the scene buffers, geometries sharing a slice (deduplicated
+// files) share the BVH.
+struct WGeometryBvhSet
+{
+	std::vector<WBvh> bvhs;
+	std::map<std::string, UINT32> bvhOfGeometry;
+	// Summed over the BVHs, except sahCost (weighted by triangle count) and buildSeconds
+	// (wall time of the whole set)
+	WBvhStats total;
+
+	const WBvh* find(const std::string& geometryName) const;
+	UINT64 memoryBytes() const;
+};
+
+// BVHs for the geometries in "geometryNames", which may name LOD levels ("foo.obj|lod2"), e.g.
+// the geometries the instances of the scene use. Records outside the buffers get empty BVHs.
+void buildGeometryBvhs(const std::map<std::string, WGeometryRecord>& geometryMap, const std::vector<std::string>& geometryNames,
+	WBufferView<tinyobj::real_t> vertexBuffer, WBufferView<UINT32> indexBuffer, WGeometryBvhSet& set, const WBvhBuildOptions& options = WBvhBuildOptions());
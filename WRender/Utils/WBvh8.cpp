@@ -0,0 +1,624 @@
+#include "WBvh8.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Per ray constants of the slab test: t = (bound - origin) * invDirection.
+	// Axis parallel directions have infinite inverses, t is then +-inf or NaN for an origin on
+	// the bound. The kernels keep the running entry and exit on a NaN like std::max/min do:
+	// the SIMD max/min return their second operand then, so the slab distance goes first.
+	struct RaySlabs
+	{
+		float origin[3];
+		float invDirection[3];
+		// 1 where the direction is negative, the near bound is then the upper one
+		int negative[3];
+	};
+
+	RaySlabs raySlabs(const WRay& ray)
+	{
+		RaySlabs slabs;
+		const float* origin = &ray.origin.x;
+		const float* direction = &ray.direction.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			slabs.origin[axis] = origin[axis];
+			slabs.invDirection[axis] = 1.0f / direction[axis];
+			// 1 / -0 is -inf, so the sign of the inverse also orders the bounds of -0 directions
+			slabs.negative[axis] = slabs.invDirection[axis] < 0.0f ? 1 : 0;
+		}
+		return slabs;
+	}
+
+	// 2^exponent, built from the float bits since the exponent is within the normal range
+	inline float exponentScale(int exponent)
+	{
+		const UINT32 bits = static_cast<UINT32>(exponent + 127) << 23;
+		float scale;
+		memcpy(&scale, &bits, sizeof(scale));
+		return scale;
+	}
+
+	// Decoded relative to the ray origin, the slab distances of a compressed node are
+	// t = (q * step + offset) * invDirection per axis, near and far bounds picked by the ray
+	// direction
+	struct CompressedSlabs
+	{
+		const UINT8* nearBounds[3];
+		const UINT8* farBounds[3];
+		float step[3];
+		float offset[3];
+
+		CompressedSlabs(const WBvh8CompressedNode& node, const RaySlabs& slabs)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				nearBounds[axis] = slabs.negative[axis] ? node.upper[axis] : node.lower[axis];
+				farBounds[axis] = slabs.negative[axis] ? node.lower[axis] : node.upper[axis];
+				step[axis] = exponentScale(node.exponent[axis]);
+				offset[axis] = node.origin[axis] - slabs.origin[axis];
+			}
+		}
+	};
+
+	// The kernels return the mask of the children entered within [tMin, tMax] and write the
+	// entry distances of all eight to "entry"
+	struct ScalarKernel
+	{
+		static UINT32 intersect(const WBvh8Node& node, const RaySlabs& slabs, float tMin, float tMax, float entry[8])
+		{
+			UINT32 mask = 0;
+			for (UINT32 i = 0; i < WBvh8::Width; i++)
+			{
+				float tEntry = tMin, tExit = tMax;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const float tNear = (node.bounds[2 * axis + slabs.negative[axis]][i] - slabs.origin[axis]) * slabs.invDirection[axis];
+					const float tFar = (node.bounds[2 * axis + 1 - slabs.negative[axis]][i] - slabs.origin[axis]) * slabs.invDirection[axis];
+					tEntry = (std::max)(tEntry, tNear);
+					tExit = (std::min)(tExit, tFar);
+				}
+				entry[i] = tEntry;
+				if (tEntry <= tExit)
+					mask |= 1u << i;
+			}
+			return mask;
+		}
+
+		static UINT32 intersect(const WBvh8CompressedNode& node, const RaySlabs& slabs, float tMin, float tMax, float entry[8])
+		{
+			CompressedSlabs compressed(node, slabs);
+			UINT32 mask = 0;
+			for (UINT32 i = 0; i < WBvh8::Width; i++)
+			{
+				float tEntry = tMin, tExit = tMax;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					tEntry = (std::max)(tEntry, (compressed.nearBounds[axis][i] * compressed.step[axis] + compressed.offset[axis]) * slabs.invDirection[axis]);
+					tExit = (std::min)(tExit, (compressed.farBounds[axis][i] * compressed.step[axis] + compressed.offset[axis]) * slabs.invDirection[axis]);
+				}
+				entry[i] = tEntry;
+				if (tEntry <= tExit)
+					mask |= 1u << i;
+			}
+			return mask;
+		}
+	};
+
+	struct SseKernel
+	{
+		static UINT32 intersect(const WBvh8Node& node, const RaySlabs& slabs, float tMin, float tMax, float entry[8])
+		{
+			UINT32 mask = 0;
+			for (UINT32 half = 0; half < 2; half++)
+			{
+				__m128 tEntry = _mm_set1_ps(tMin), tExit = _mm_set1_ps(tMax);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const __m128 origin = _mm_set1_ps(slabs.origin[axis]);
+					const __m128 inv = _mm_set1_ps(slabs.invDirection[axis]);
+					const __m128 nearBound = _mm_load_ps(&node.bounds[2 * axis + slabs.negative[axis]][4 * half]);
+					const __m128 farBound = _mm_load_ps(&node.bounds[2 * axis + 1 - slabs.negative[axis]][4 * half]);
+					tEntry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(nearBound, origin), inv), tEntry);
+					tExit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(farBound, origin), inv), tExit);
+				}
+				_mm_storeu_ps(entry + 4 * half, tEntry);
+				mask |= static_cast<UINT32>(_mm_movemask_ps(_mm_cmple_ps(tEntry, tExit))) << (4 * half);
+			}
+			return mask;
+		}
+
+		// SSE2 has no byte to dword conversion, the bytes are widened by unpacking with zero
+		static __m128 decode(const UINT8* bytes)
+		{
+			int packed;
+			memcpy(&packed, bytes, sizeof(packed));
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+			return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+		}
+
+		static UINT32 intersect(const WBvh8CompressedNode& node, const RaySlabs& slabs, float tMin, float tMax, float entry[8])
+		{
+			CompressedSlabs compressed(node, slabs);
+			UINT32 mask = 0;
+			for (UINT32 half = 0; half < 2; half++)
+			{
+				__m128 tEntry = _mm_set1_ps(tMin), tExit = _mm_set1_ps(tMax);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const __m128 step = _mm_set1_ps(compressed.step[axis]);
+					const __m128 offset = _mm_set1_ps(compressed.offset[axis]);
+					const __m128 inv = _mm_set1_ps(slabs.invDirection[axis]);
+					const __m128 nearBound = _mm_add_ps(_mm_mul_ps(decode(compressed.nearBounds[axis] + 4 * half), step), offset);
+					const __m128 farBound = _mm_add_ps(_mm_mul_ps(decode(compressed.farBounds[axis] + 4 * half), step), offset);
+					tEntry = _mm_max_ps(_mm_mul_ps(nearBound, inv), tEntry);
+					tExit = _mm_min_ps(_mm_mul_ps(farBound, inv), tExit);
+				}
+				_mm_storeu_ps(entry + 4 * half, tEntry);
+				mask |= static_cast<UINT32>(_mm_movemask_ps(_mm_cmple_ps(tEntry, tExit))) << (4 * half);
+			}
+			return mask;
+		}
+	};
+
+	struct Avx2Kernel
+	{
+		static UINT32 intersect(const WBvh8Node& node, const RaySlabs& slabs, float tMin, float tMax, float entry[8])
+		{
+			__m256 tEntry = _mm256_set1_ps(tMin), tExit = _mm256_set1_ps(tMax);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const __m256 origin = _mm256_set1_ps(slabs.origin[axis]);
+				const __m256 inv = _mm256_set1_ps(slabs.invDirection[axis]);
+				const __m256 nearBound = _mm256_load_ps(node.bounds[2 * axis + slabs.negative[axis]]);
+				const __m256 farBound = _mm256_load_ps(node.bounds[2 * axis + 1 - slabs.negative[axis]]);
+				tEntry = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(nearBound, origin), inv), tEntry);
+				tExit = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(farBound, origin), inv), tExit);
+			}
+			_mm256_storeu_ps(entry, tEntry);
+			return static_cast<UINT32>(_mm256_movemask_ps(_mm256_cmp_ps(tEntry, tExit, _CMP_LE_OQ)));
+		}
+
+		static __m256 decode(const UINT8* bytes)
+		{
+			return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bytes))));
+		}
+
+		static UINT32 intersect(const WBvh8CompressedNode& node, const RaySlabs& slabs, float tMin, float tMax, float entry[8])
+		{
+			CompressedSlabs compressed(node, slabs);
+			__m256 tEntry = _mm256_set1_ps(tMin), tExit = _mm256_set1_ps(tMax);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const __m256 step = _mm256_set1_ps(compressed.step[axis]);
+				const __m256 offset = _mm256_set1_ps(compressed.offset[axis]);
+				const __m256 inv = _mm256_set1_ps(slabs.invDirection[axis]);
+				const __m256 nearBound = _mm256_add_ps(_mm256_mul_ps(decode(compressed.nearBounds[axis]), step), offset);
+				const __m256 farBound = _mm256_add_ps(_mm256_mul_ps(decode(compressed.farBounds[axis]), step), offset);
+				tEntry = _mm256_max_ps(_mm256_mul_ps(nearBound, inv), tEntry);
+				tExit = _mm256_min_ps(_mm256_mul_ps(farBound, inv), tExit);
+			}
+			_mm256_storeu_ps(entry, tEntry);
+			return static_cast<UINT32>(_mm256_movemask_ps(_mm256_cmp_ps(tEntry, tExit, _CMP_LE_OQ)));
+		}
+	};
+
+	struct StackEntry
+	{
+		UINT32 child;
+		UINT32 count;   // 0 for inner nodes
+		float t;        // Entry distance, the entry is skipped once a closer hit is known
+	};
+
+	// Node index of an inner child, or the triangle range of a leaf child. False for empty slots.
+	inline bool childOf(const WBvh8Node& node, UINT32 slot, UINT32& child, UINT32& count)
+	{
+		child = node.child[slot];
+		count = node.count[slot];
+		return child != WBvh8::EmptySlot;
+	}
+
+	inline UINT32 bitCount(UINT32 bits)
+	{
+		UINT32 count = 0;
+		for (; bits; bits &= bits - 1)
+			count++;
+		return count;
+	}
+
+	inline bool childOf(const WBvh8CompressedNode& node, UINT32 slot, UINT32& child, UINT32& count)
+	{
+		if (node.innerMask & (1u << slot))
+		{
+			child = node.childBase + bitCount(node.innerMask & ((1u << slot) - 1));
+			count = 0;
+			return true;
+		}
+		count = node.leafCount[slot];
+		child = node.triangleBase;
+		for (UINT32 i = 0; i < slot; i++)
+			child += node.leafCount[i];
+		return count > 0;
+	}
+
+	// Closest hit when "anyHit" is false, the first one found otherwise
+	template<typename Kernel, typename Node>
+	bool traverse(const std::vector<Node>& nodes, const WBvhMesh& mesh, const UINT32* triangles,
+		const WRay& ray, bool anyHit, WRayHit& hit)
+	{
+		if (nodes.empty())
+			return false;
+		const RaySlabs slabs = raySlabs(ray);
+		float closest = ray.tMax;
+		bool found = false;
+
+		StackEntry stack[WBvh8::StackSize];
+		UINT32 stackSize = 0;
+		stack[stackSize++] = { 0, 0, ray.tMin };
+		while (stackSize > 0)
+		{
+			const StackEntry entry = stack[--stackSize];
+			if (entry.t > closest)
+				continue;
+			if (entry.count > 0)
+			{
+				for (UINT32 i = 0; i < entry.count; i++)
+				{
+					const UINT32 triangle = triangles[entry.child + i];
+					const UINT32* corner = &mesh.indices[3 * static_cast<size_t>(triangle)];
+					float t, u, v;
+					WRay clipped = ray;
+					clipped.tMax = closest;
+					if (!intersectTriangle(clipped, &mesh.vertices[3 * static_cast<size_t>(corner[0])],
+						&mesh.vertices[3 * static_cast<size_t>(corner[1])], &mesh.vertices[3 * static_cast<size_t>(corner[2])], t, u, v))
+						continue;
+					closest = t;
+					hit.t = t;
+					hit.triangle = triangle;
+					hit.u = u;
+					hit.v = v;
+					found = true;
+					if (anyHit)
+						return true;
+				}
+				continue;
+			}
+
+			const Node& node = nodes[entry.child];
+			float entryT[8];
+			UINT32 mask = Kernel::intersect(node, slabs, ray.tMin, closest, entryT);
+			// Farthest first onto the stack, so the nearest child is popped next
+			UINT32 order[8];
+			UINT32 hits = 0;
+			while (mask)
+			{
+				UINT32 slot = 0;
+				while (!(mask & (1u << slot)))
+					slot++;
+				mask &= mask - 1;
+				UINT32 k = hits++;
+				for (; k > 0 && entryT[order[k - 1]] < entryT[slot]; k--)
+					order[k] = order[k - 1];
+				order[k] = slot;
+			}
+			for (UINT32 k = 0; k < hits; k++)
+			{
+				StackEntry& child = stack[stackSize];
+				if (childOf(node, order[k], child.child, child.count))
+				{
+					child.t = entryT[order[k]];
+					stackSize++;
+				}
+			}
+		}
+		return found;
+	}
+
+	template<typename Node>
+	bool traverse(const std::vector<Node>& nodes, const WBvhMesh& mesh, const std::vector<UINT32>& triangles,
+		WSIMD_PATH path, const WRay& ray, bool anyHit, WRayHit& hit)
+	{
+		if (path == SIMD_PATH_AVX2)
+			return traverse<Avx2Kernel>(nodes, mesh, triangles.data(), ray, anyHit, hit);
+		if (path == SIMD_PATH_SSE)
+			return traverse<SseKernel>(nodes, mesh, triangles.data(), ray, anyHit, hit);
+		return traverse<ScalarKernel>(nodes, mesh, triangles.data(), ray, anyHit, hit);
+	}
+
+	// Smallest power of two step that spans [lower, upper] in 255 steps from "lower"
+	int quantizeExponent(float lower, float upper)
+	{
+		int exponent = -126;
+		if (upper > lower)
+		{
+			std::frexp((upper - lower) / 255.0f, &exponent);
+			exponent = (std::max)(exponent - 1, -126);
+		}
+		while (exponent < 127 && lower + 255.0f * exponentScale(exponent) < upper)
+			exponent++;
+		return exponent;
+	}
+
+	// Steps from "origin" rounded outwards, so the decoded bounds contain [lower, upper]
+	void quantizeBounds(float origin, float step, float lower, float upper, UINT8& quantizedLower, UINT8& quantizedUpper)
+	{
+		float low = (std::max)(std::floor((lower - origin) / step), 0.0f);
+		while (low > 0.0f && origin + low * step > lower)
+			low -= 1.0f;
+		float high = (std::min)(std::ceil((upper - origin) / step), 255.0f);
+		while (high < 255.0f && origin + high * step < upper)
+			high += 1.0f;
+		quantizedLower = static_cast<UINT8>(low);
+		quantizedUpper = static_cast<UINT8>(high);
+	}
+
+	float halfArea(const WBvhNode& node)
+	{
+		float dx = node.boundsMax.x - node.boundsMin.x;
+		float dy = node.boundsMax.y - node.boundsMin.y;
+		float dz = node.boundsMax.z - node.boundsMin.z;
+		return dx * dy + dy * dz + dz * dx;
+	}
+}
+
+WBvh8::WBvh8()
+	: mPath(cpuSupportsAvx2() ? SIMD_PATH_AVX2 : SIMD_PATH_SSE)
+{
+}
+
+void WBvh8::build(const WBvh& bvh)
+{
+	auto start = std::chrono::steady_clock::now();
+	clear();
+	mMesh = bvh.mesh();
+	mTriangles = bvh.triangles();
+	const auto& binary = bvh.nodes();
+	if (binary.empty())
+		return;
+
+	struct Pending
+	{
+		UINT32 binary;   // Binary node whose subtree the wide node covers
+		UINT32 wide;
+		UINT32 depth;
+	};
+	std::vector<Pending> pending;
+	mNodes.emplace_back();
+	pending.push_back({ 0, 0, 1 });
+	size_t occupied = 0;
+	while (!pending.empty())
+	{
+		const Pending item = pending.back();
+		pending.pop_back();
+		mStats.maxDepth = (std::max)(mStats.maxDepth, item.depth);
+
+		// A binary leaf root becomes the only child of the wide root
+		UINT32 children[Width];
+		UINT32 childCount = 0;
+		const WBvhNode& source = binary[item.binary];
+		if (source.isLeaf())
+		{
+			children[childCount++] = item.binary;
+		}
+		else
+		{
+			children[childCount++] = item.binary + 1;
+			children[childCount++] = source.firstOrRight;
+		}
+		while (childCount < Width)
+		{
+			// Open the inner child with the largest surface area
+			UINT32 largest = Width;
+			float largestArea = -1.0f;
+			for (UINT32 i = 0; i < childCount; i++)
+			{
+				const WBvhNode& child = binary[children[i]];
+				if (!child.isLeaf() && halfArea(child) > largestArea)
+				{
+					largest = i;
+					largestArea = halfArea(child);
+				}
+			}
+			if (largest == Width)
+				break;
+			const UINT32 opened = children[largest];
+			children[largest] = opened + 1;
+			children[childCount++] = binary[opened].firstOrRight;
+		}
+
+		for (UINT32 i = 0; i < Width; i++)
+		{
+			WBvh8Node& node = mNodes[item.wide];
+			if (i >= childCount)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					node.bounds[2 * axis][i] = FLT_MAX;
+					node.bounds[2 * axis + 1][i] = -FLT_MAX;
+				}
+				node.child[i] = EmptySlot;
+				node.count[i] = 0;
+				continue;
+			}
+			const WBvhNode& child = binary[children[i]];
+			const float* lower = &child.boundsMin.x;
+			const float* upper = &child.boundsMax.x;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				node.bounds[2 * axis][i] = lower[axis];
+				node.bounds[2 * axis + 1][i] = upper[axis];
+			}
+			if (child.isLeaf())
+			{
+				node.child[i] = child.firstOrRight;
+				node.count[i] = child.count;
+				++mStats.leaves;
+			}
+			else
+			{
+				const UINT32 wide = static_cast<UINT32>(mNodes.size());
+				node.child[i] = wide;
+				node.count[i] = 0;
+				mNodes.emplace_back();
+				pending.push_back({ children[i], wide, item.depth + 1 });
+			}
+		}
+		occupied += childCount;
+	}
+	mStats.nodes = mNodes.size();
+	mStats.averageChildren = static_cast<double>(occupied) / mNodes.size();
+	mStats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void WBvh8::clear()
+{
+	mMesh = WBvhMesh();
+	std::vector<WBvh8Node>().swap(mNodes);
+	std::vector<UINT32>().swap(mTriangles);
+	mStats = WBvh8Stats();
+}
+
+bool WBvh8::intersect(const WRay& ray, WRayHit& hit) const
+{
+	WRayHit closest;
+	if (!traverse(mNodes, mMesh, mTriangles, mPath, ray, false, closest))
+		return false;
+	hit = closest;
+	return true;
+}
+
+bool WBvh8::occluded(const WRay& ray) const
+{
+	WRayHit any;
+	return traverse(mNodes, mMesh, mTriangles, mPath, ray, true, any);
+}
+
+void WBvh8::setPath(WSIMD_PATH path)
+{
+	mPath = path == SIMD_PATH_AVX2 && !cpuSupportsAvx2() ? SIMD_PATH_SSE : path;
+}
+
+WBvh8Compressed::WBvh8Compressed()
+	: mPath(cpuSupportsAvx2() ? SIMD_PATH_AVX2 : SIMD_PATH_SSE)
+{
+}
+
+bool WBvh8Compressed::build(const WBvh8& wide)
+{
+	clear();
+	mMesh = wide.mesh();
+	const auto& source = wide.nodes();
+	if (source.empty())
+		return true;
+	mTriangles.reserve(wide.triangles().size());
+
+	struct Pending
+	{
+		UINT32 wide;
+		UINT32 compressed;
+	};
+	std::vector<Pending> pending;
+	mNodes.reserve(source.size());
+	mNodes.emplace_back();
+	pending.push_back({ 0, 0 });
+	while (!pending.empty())
+	{
+		const Pending item = pending.back();
+		pending.pop_back();
+		const WBvh8Node& node = source[item.wide];
+
+		float lower[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float upper[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (UINT32 i = 0; i < WBvh8::Width; i++)
+		{
+			if (node.child[i] == WBvh8::EmptySlot)
+				continue;
+			if (node.count[i] > MaxLeafSize)
+			{
+				clear();
+				return false;
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				lower[axis] = (std::min)(lower[axis], node.bounds[2 * axis][i]);
+				upper[axis] = (std::max)(upper[axis], node.bounds[2 * axis + 1][i]);
+			}
+		}
+
+		WBvh8CompressedNode compressed = {};
+		float step[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const int exponent = quantizeExponent(lower[axis], upper[axis]);
+			compressed.origin[axis] = lower[axis];
+			compressed.exponent[axis] = static_cast<INT8>(exponent);
+			step[axis] = exponentScale(exponent);
+		}
+		compressed.childBase = static_cast<UINT32>(mNodes.size());
+		compressed.triangleBase = static_cast<UINT32>(mTriangles.size());
+		for (UINT32 i = 0; i < WBvh8::Width; i++)
+		{
+			if (node.child[i] == WBvh8::EmptySlot)
+			{
+				// Inverted, entered by no ray
+				for (int axis = 0; axis < 3; axis++)
+				{
+					compressed.lower[axis][i] = 255;
+					compressed.upper[axis][i] = 0;
+				}
+				continue;
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				quantizeBounds(compressed.origin[axis], step[axis], node.bounds[2 * axis][i], node.bounds[2 * axis + 1][i],
+					compressed.lower[axis][i], compressed.upper[axis][i]);
+			}
+			if (node.count[i] > 0)
+			{
+				compressed.leafCount[i] = static_cast<UINT8>(node.count[i]);
+				const UINT32* first = wide.triangles().data() + node.child[i];
+				mTriangles.insert(mTriangles.end(), first, first + node.count[i]);
+			}
+			else
+			{
+				compressed.innerMask |= static_cast<UINT8>(1u << i);
+				pending.push_back({ node.child[i], static_cast<UINT32>(mNodes.size()) });
+				mNodes.emplace_back();
+			}
+		}
+		mNodes[item.compressed] = compressed;
+	}
+	return true;
+}
+
+void WBvh8Compressed::clear()
+{
+	mMesh = WBvhMesh();
+	std::vector<WBvh8CompressedNode>().swap(mNodes);
+	std::vector<UINT32>().swap(mTriangles);
+}
+
+bool WBvh8Compressed::intersect(const WRay& ray, WRayHit& hit) const
+{
+	WRayHit closest;
+	if (!traverse(mNodes, mMesh, mTriangles, mPath, ray, false, closest))
+		return false;
+	hit = closest;
+	return true;
+}
+
+bool WBvh8Compressed::occluded(const WRay& ray) const
+{
+	WRayHit any;
+	return traverse(mNodes, mMesh, mTriangles, mPath, ray, true, any);
+}
+
+void WBvh8Compressed::setPath(WSIMD_PATH path)
+{
+	mPath = path == SIMD_PATH_AVX2 && !cpuSupportsAvx2() ? SIMD_PATH_SSE : path;
+}
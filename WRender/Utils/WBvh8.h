@@ -0,0 +1,128 @@
+#pragma once
+#include <windows.h>
+#include <vector>
+#include "WBvh.h"
+#include "WTransformBatch.h"
+
+// 8-wide BVH collapsed from a binary WBvh, for tracing many rays on the CPU. The boxes of
+// all children of a node are tested together (one AVX2 pass, two SSE passes, or a loop on
+// CPUs without either) and the hit children are visited nearest first.
+
+// 256 bytes, child bounds stored per axis
+struct alignas(32) WBvh8Node
+{
+	// bounds[2 * axis] lower, bounds[2 * axis + 1] upper bounds of the children on "axis".
+	// Empty slots have inverted bounds, which no ray enters.
+	float bounds[6][8];
+	// Inner child: node index, leaf child: first entry of WBvh8::triangles()
+	UINT32 child[8];
+	// Triangles of a leaf child, 0 for inner children and empty slots
+	UINT32 count[8];
+};
+
+struct WBvh8Stats
+{
+	size_t nodes = 0;
+	size_t leaves = 0;
+	UINT32 maxDepth = 0;
+	// Occupied slots per node
+	double averageChildren = 0.0;
+	double buildSeconds = 0.0;
+};
+
+class WBvh8
+{
+public:
+	static constexpr UINT32 Width = 8;
+	static constexpr UINT32 EmptySlot = ~0u;
+	// A node pops one entry and pushes up to Width, the collapsed tree is no deeper than the
+	// binary one
+	static constexpr UINT32 StackSize = (Width - 1) * WBvh::StackSize + 1;
+
+	WBvh8();
+	WBvh8(const WBvh8& rhs) = delete;
+	WBvh8& operator=(const WBvh8& rhs) = delete;
+	WBvh8(WBvh8&& rhs) = default;
+	WBvh8& operator=(WBvh8&& rhs) = default;
+
+	// Each node takes the children of a binary node and repeatedly opens the one with the
+	// largest surface area until all slots are filled. The mesh of "bvh" is referenced and
+	// must outlive this BVH, the nodes and triangle indices are copied.
+	void build(const WBvh& bvh);
+	void clear();
+
+	// Same contract as WBvh::intersect() and WBvh::occluded()
+	bool intersect(const WRay& ray, WRayHit& hit) const;
+	bool occluded(const WRay& ray) const;
+
+	// Box test kernel, the widest the CPU supports unless set
+	WSIMD_PATH path() const { return mPath; }
+	// AVX2 falls back to SSE on CPUs without it
+	void setPath(WSIMD_PATH path);
+
+	bool empty() const { return mNodes.empty(); }
+	const WBvhMesh& mesh() const { return mMesh; }
+	const std::vector<WBvh8Node>& nodes() const { return mNodes; }
+	const std::vector<UINT32>& triangles() const { return mTriangles; }
+	const WBvh8Stats& stats() const { return mStats; }
+	UINT64 memoryBytes() const { return mNodes.size() * sizeof(WBvh8Node) + mTriangles.size() * sizeof(UINT32); }
+private:
+	WBvhMesh mMesh;
+	std::vector<WBvh8Node> mNodes;
+	std::vector<UINT32> mTriangles;
+	WSIMD_PATH mPath;
+	WBvh8Stats mStats;
+};
+
+// 80 bytes. Child bounds are 8-bit steps of 2^exponent from the lower corner of the node box,
+// rounded outwards, so a decoded box always contains the exact one.
+struct WBvh8CompressedNode
+{
+	float origin[3];
+	INT8 exponent[3];
+	// Bit i: child i is an inner node
+	UINT8 innerMask;
+	// The inner children are consecutive nodes in slot order
+	UINT32 childBase;
+	// The triangles of the leaf children follow each other in slot order
+	UINT32 triangleBase;
+	// Triangles of leaf child i, 0 for inner children and empty slots
+	UINT8 leafCount[8];
+	UINT8 lower[3][8];
+	UINT8 upper[3][8];
+};
+
+// WBvh8 with WBvh8CompressedNode, about a third of its memory. Traversal decodes the child
+// bounds of a node while testing them.
+class WBvh8Compressed
+{
+public:
+	static constexpr UINT32 MaxLeafSize = 255;
+
+	WBvh8Compressed();
+	WBvh8Compressed(const WBvh8Compressed& rhs) = delete;
+	WBvh8Compressed& operator=(const WBvh8Compressed& rhs) = delete;
+	WBvh8Compressed(WBvh8Compressed&& rhs) = default;
+	WBvh8Compressed& operator=(WBvh8Compressed&& rhs) = default;
+
+	// The mesh of "wide" is referenced like in WBvh8::build(). False when a leaf holds more
+	// than MaxLeafSize triangles.
+	bool build(const WBvh8& wide);
+	void clear();
+
+	bool intersect(const WRay& ray, WRayHit& hit) const;
+	bool occluded(const WRay& ray) const;
+
+	WSIMD_PATH path() const { return mPath; }
+	void setPath(WSIMD_PATH path);
+
+	bool empty() const { return mNodes.empty(); }
+	const std::vector<WBvh8CompressedNode>& nodes() const { return mNodes; }
+	const std::vector<UINT32>& triangles() const { return mTriangles; }
+	UINT64 memoryBytes() const { return mNodes.size() * sizeof(WBvh8CompressedNode) + mTriangles.size() * sizeof(UINT32); }
+private:
+	WBvhMesh mMesh;
+	std::vector<WBvh8CompressedNode> mNodes;
+	std::vector<UINT32> mTriangles;
+	WSIMD_PATH mPath;
+};
@@ -0,0 +1,39 @@
+#include "WFileWatcher.h"
+
+WFileWatcher::FileState WFileWatcher::queryState(const std::string& filename)
+{
+	FileState state;
+	std::error_code ec;
+	state.lastWrite = std::filesystem::last_write_time(filename, ec);
+	if (ec)
+		return state;
+	state.size = std::filesystem::file_size(filename, ec);
+	state.exists = !ec;
+	return state;
+}
+
+void WFileWatcher::Watch(const std::string& filename)
+{
+	if (mFiles.find(filename) != mFiles.end())
+		return;
+	WatchedFile file;
+	file.reported = file.observed = queryState(filename);
+	mFiles[filename] = file;
+}
+
+std::vector<std::string> WFileWatcher::Poll()
+{
+	std::vector<std::string> changed;
+	for (auto& fItem : mFiles)
+	{
+		auto& file = fItem.second;
+		FileState current = queryState(fItem.first);
+		if (current == file.observed && current != file.reported)
+		{
+			file.reported = current;
+			changed.push_back(fItem.first);
+		}
+		file.observed = current;
+	}
+	return changed;
+}
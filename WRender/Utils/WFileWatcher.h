@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+
+// Polling file watcher for hot reload.
+// A change is reported once the file's timestamp and size have been stable for one
+// poll, so that files are not picked up while an editor is still writing them.
+class WFileWatcher
+{
+public:
+	WFileWatcher() = default;
+	void Watch(const std::string& filename);
+	void Clear() { mFiles.clear(); }
+	// Returns the watched files that changed since they were last reported
+	std::vector<std::string> Poll();
+private:
+	struct FileState
+	{
+		bool exists = false;
+		std::filesystem::file_time_type lastWrite;
+		std::uintmax_t size = 0;
+		bool operator==(const FileState& rhs) const
+		{
+			return exists == rhs.exists && lastWrite == rhs.lastWrite && size == rhs.size;
+		}
+		bool operator!=(const FileState& rhs) const { return !(*this == rhs); }
+	};
+	struct WatchedFile
+	{
+		FileState reported;  // State at the last report
+		FileState observed;  // State at the last poll
+	};
+	static FileState queryState(const std::string& filename);
+	std::map<std::string, WatchedFile> mFiles;
+};
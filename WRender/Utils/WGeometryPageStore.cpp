@@ -0,0 +1,194 @@
+#include "WGeometryPageStore.h"
+#include <algorithm>
+#include <cstring>
+
+bool WGeometryPageStore::Open(const std::string& cacheFilename, UINT64 budgetBytes)
+{
+	Close();
+	mFile = CreateFileA(cacheFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(mFile, &fileSize))
+	{
+		Close();
+		return false;
+	}
+	mFileSize = static_cast<UINT64>(fileSize.QuadPart);
+
+	// Only the header and the section table are read up front
+	WSceneCacheHeader header = {};
+	if (mFileSize < sizeof(header) || !readFile(0, &header, sizeof(header)) ||
+		header.Magic != WSceneCacheMagic || header.Version != WSceneCacheVersion ||
+		sizeof(header) + static_cast<UINT64>(header.SectionCount) * sizeof(WSceneCacheSection) > mFileSize)
+	{
+		Close();
+		return false;
+	}
+	mSections.resize(header.SectionCount);
+	if (!mSections.empty() && !readFile(sizeof(header), mSections.data(),
+		static_cast<UINT32>(mSections.size() * sizeof(WSceneCacheSection))))
+	{
+		Close();
+		return false;
+	}
+	for (const auto& section : mSections)
+	{
+		if (section.Offset > mFileSize || section.Size > mFileSize - section.Offset)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	const UINT64 pageCount = (mFileSize + PageSize - 1) / PageSize;
+	mPageFrames.assign(static_cast<size_t>(pageCount), NoFrame);
+	// No point in more frames than the file has pages
+	UINT64 capacity = (std::max)(budgetBytes / PageSize, static_cast<UINT64>(MinResidentPages));
+	capacity = (std::min)(capacity, pageCount);
+	mFrames.assign(static_cast<size_t>(capacity), Frame());
+	mPool.resize(static_cast<size_t>(capacity * PageSize));
+	mClockHand = 0;
+	mStats = WPageStats();
+	mStats.capacityPages = static_cast<UINT32>(capacity);
+	return true;
+}
+
+void WGeometryPageStore::Close()
+{
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+	mFile = INVALID_HANDLE_VALUE;
+	mFileSize = 0;
+	mSections.clear();
+	std::vector<char>().swap(mPool);
+	mFrames.clear();
+	mPageFrames.clear();
+	mClockHand = 0;
+	mStats = WPageStats();
+}
+
+const WSceneCacheSection* WGeometryPageStore::findSection(UINT32 id) const
+{
+	for (const auto& section : mSections)
+		if (section.Id == id)
+			return &section;
+	return nullptr;
+}
+
+UINT64 WGeometryPageStore::sectionSize(UINT32 id) const
+{
+	const auto* section = findSection(id);
+	return section ? section->Size : 0;
+}
+
+bool WGeometryPageStore::read(UINT32 id, UINT64 offset, void* dst, UINT64 size)
+{
+	const auto* section = findSection(id);
+	if (!section || offset > section->Size || size > section->Size - offset)
+		return false;
+	char* out = static_cast<char*>(dst);
+	UINT64 position = section->Offset + offset;
+	const UINT64 end = position + size;
+	while (position < end)
+	{
+		const UINT64 page = position / PageSize;
+		const UINT64 inPage = position - page * PageSize;
+		const UINT64 length = (std::min)(end - position, PageSize - inPage);
+		const char* data = pin(page);
+		if (!data)
+			return false;
+		memcpy(out, data + inPage, static_cast<size_t>(length));
+		unpin(page);
+		out += length;
+		position += length;
+	}
+	return true;
+}
+
+const char* WGeometryPageStore::pin(UINT64 page)
+{
+	if (page >= mPageFrames.size())
+		return nullptr;
+	++mStats.accesses;
+	UINT32 frame = mPageFrames[page];
+	if (frame == NoFrame)
+	{
+		frame = findVictim();
+		if (frame == NoFrame)
+			return nullptr;
+		auto& victim = mFrames[frame];
+		if (victim.page != NoPage)
+		{
+			mPageFrames[victim.page] = NoFrame;
+			victim.page = NoPage;
+			--mStats.residentPages;
+			++mStats.evictions;
+		}
+		const UINT64 offset = page * PageSize;
+		const UINT32 length = static_cast<UINT32>((std::min)(static_cast<UINT64>(PageSize), mFileSize - offset));
+		if (!readFile(offset, &mPool[static_cast<size_t>(frame) * PageSize], length))
+			return nullptr;
+		victim.page = page;
+		mPageFrames[page] = frame;
+		++mStats.residentPages;
+		++mStats.faults;
+		mStats.bytesStreamed += length;
+	}
+	auto& entry = mFrames[frame];
+	++entry.pins;
+	entry.referenced = true;
+	return &mPool[static_cast<size_t>(frame) * PageSize];
+}
+
+void WGeometryPageStore::unpin(UINT64 page)
+{
+	if (page >= mPageFrames.size() || mPageFrames[page] == NoFrame)
+		return;
+	auto& frame = mFrames[mPageFrames[page]];
+	if (frame.pins > 0)
+		--frame.pins;
+}
+
+void WGeometryPageStore::resetStats()
+{
+	const UINT32 residentPages = mStats.residentPages;
+	const UINT32 capacityPages = mStats.capacityPages;
+	mStats = WPageStats();
+	mStats.residentPages = residentPages;
+	mStats.capacityPages = capacityPages;
+}
+
+UINT32 WGeometryPageStore::findVictim()
+{
+	// The first sweep may only clear reference bits, nothing found by the end of the second
+	// means every frame is pinned
+	const size_t count = mFrames.size();
+	for (size_t step = 0; step < 2 * count + 1; step++)
+	{
+		const UINT32 frame = mClockHand;
+		mClockHand = static_cast<UINT32>((mClockHand + 1) % count);
+		auto& entry = mFrames[frame];
+		if (entry.pins > 0)
+			continue;
+		if (entry.page == NoPage)
+			return frame;
+		if (entry.referenced)
+		{
+			entry.referenced = false;
+			continue;
+		}
+		return frame;
+	}
+	return NoFrame;
+}
+
+bool WGeometryPageStore::readFile(UINT64 offset, void* dst, UINT32 size)
+{
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = static_cast<DWORD>(offset);
+	overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	DWORD bytesRead = 0;
+	return ReadFile(mFile, dst, size, &bytesRead, &overlapped) && bytesRead == size;
+}
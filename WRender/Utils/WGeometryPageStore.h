@@ -0,0 +1,86 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "WSceneCache.h"
+
+struct WPageStats
+{
+	UINT32 residentPages = 0;
+	UINT32 capacityPages = 0;
+	// Since Open() or resetStats()
+	UINT64 accesses = 0;
+	UINT64 faults = 0;
+	UINT64 evictions = 0;
+	UINT64 bytesStreamed = 0;
+
+	double faultRate() const { return accesses > 0 ? static_cast<double>(faults) / static_cast<double>(accesses) : 0.0; }
+};
+
+// Reads the sections of a scene cache through a bounded set of resident pages instead of
+// mapping or loading the whole file, so the geometry of a scene may exceed host memory.
+// A page is PageSize bytes of the file. It is read on first access, stays resident while
+// pinned, and unpinned pages are recycled with the clock (second chance) policy.
+// Not thread-safe.
+class WGeometryPageStore
+{
+public:
+	static const UINT32 PageSize = 64 * 1024;
+	// The resident set never gets smaller than this, whatever the budget
+	static const UINT32 MinResidentPages = 4;
+
+	WGeometryPageStore() = default;
+	WGeometryPageStore(const WGeometryPageStore& rhs) = delete;
+	WGeometryPageStore& operator=(const WGeometryPageStore& rhs) = delete;
+	~WGeometryPageStore() { Close(); }
+
+	// "budgetBytes" bounds the resident pages, it is rounded down to whole pages
+	bool Open(const std::string& cacheFilename, UINT64 budgetBytes);
+	void Close();
+	bool isOpen() const { return mFile != INVALID_HANDLE_VALUE; }
+
+	// 0 when the section is missing
+	UINT64 sectionSize(UINT32 id) const;
+	// Copies "size" bytes from "offset" of a section, faulting pages in as needed
+	bool read(UINT32 id, UINT64 offset, void* dst, UINT64 size);
+	template<typename T>
+	bool read(UINT32 id, UINT64 offsetInBytes, size_t count, std::vector<T>& values)
+	{
+		values.resize(count);
+		return read(id, offsetInBytes, values.data(), count * sizeof(T));
+	}
+
+	UINT64 pageCount() const { return mPageFrames.size(); }
+	// Page "page" of the file (PageSize bytes, shorter at the end), resident until the matching
+	// unpin(). nullptr when the read fails or every resident page is pinned.
+	const char* pin(UINT64 page);
+	void unpin(UINT64 page);
+
+	const WPageStats& stats() const { return mStats; }
+	void resetStats();
+	UINT64 residentBytes() const { return static_cast<UINT64>(mStats.residentPages) * PageSize; }
+private:
+	static constexpr UINT64 NoPage = ~0ull;
+	static constexpr UINT32 NoFrame = ~0u;
+	struct Frame
+	{
+		UINT64 page = NoPage;
+		UINT32 pins = 0;
+		bool referenced = false;
+	};
+	const WSceneCacheSection* findSection(UINT32 id) const;
+	bool readFile(UINT64 offset, void* dst, UINT32 size);
+	// Unpinned frame to load a page into, NoFrame when all are pinned
+	UINT32 findVictim();
+
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	UINT64 mFileSize = 0;
+	std::vector<WSceneCacheSection> mSections;
+	// Frame i holds PageSize bytes at mPool[i * PageSize]
+	std::vector<char> mPool;
+	std::vector<Frame> mFrames;
+	// Per page of the file
+	std::vector<UINT32> mPageFrames;
+	UINT32 mClockHand = 0;
+	WPageStats mStats;
+};
@@ -0,0 +1,118 @@
+#include "WHash.h"
+#include "WMappedFile.h"
+#include <cstring>
+
+namespace
+{
+	const UINT64 Prime64_1 = 0x9E3779B185EBCA87ULL;
+	const UINT64 Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+	const UINT64 Prime64_3 = 0x165667B19E3779F9ULL;
+	const UINT64 Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+	const UINT64 Prime64_5 = 0x27D4EB2F165667C5ULL;
+
+	inline UINT64 rotl64(UINT64 x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline UINT64 read64(const unsigned char* p)
+	{
+		UINT64 v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline UINT32 read32(const unsigned char* p)
+	{
+		UINT32 v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline UINT64 round64(UINT64 acc, UINT64 input)
+	{
+		acc += input * Prime64_2;
+		acc = rotl64(acc, 31);
+		acc *= Prime64_1;
+		return acc;
+	}
+
+	inline UINT64 mergeRound64(UINT64 acc, UINT64 val)
+	{
+		val = round64(0, val);
+		acc ^= val;
+		acc = acc * Prime64_1 + Prime64_4;
+		return acc;
+	}
+}
+
+UINT64 xxHash64(const void* data, size_t length, UINT64 seed)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	const unsigned char* const end = p + length;
+	UINT64 h64;
+
+	if (length >= 32)
+	{
+		const unsigned char* const limit = end - 32;
+		UINT64 v1 = seed + Prime64_1 + Prime64_2;
+		UINT64 v2 = seed + Prime64_2;
+		UINT64 v3 = seed + 0;
+		UINT64 v4 = seed - Prime64_1;
+		do
+		{
+			v1 = round64(v1, read64(p)); p += 8;
+			v2 = round64(v2, read64(p)); p += 8;
+			v3 = round64(v3, read64(p)); p += 8;
+			v4 = round64(v4, read64(p)); p += 8;
+		} while (p <= limit);
+
+		h64 = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h64 = mergeRound64(h64, v1);
+		h64 = mergeRound64(h64, v2);
+		h64 = mergeRound64(h64, v3);
+		h64 = mergeRound64(h64, v4);
+	}
+	else
+	{
+		h64 = seed + Prime64_5;
+	}
+
+	h64 += static_cast<UINT64>(length);
+
+	while (p + 8 <= end)
+	{
+		h64 ^= round64(0, read64(p));
+		h64 = rotl64(h64, 27) * Prime64_1 + Prime64_4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		h64 ^= static_cast<UINT64>(read32(p)) * Prime64_1;
+		h64 = rotl64(h64, 23) * Prime64_2 + Prime64_3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		h64 ^= (*p) * Prime64_5;
+		h64 = rotl64(h64, 11) * Prime64_1;
+		p++;
+	}
+
+	// Final avalanche
+	h64 ^= h64 >> 33;
+	h64 *= Prime64_2;
+	h64 ^= h64 >> 29;
+	h64 *= Prime64_3;
+	h64 ^= h64 >> 32;
+	return h64;
+}
+
+bool hashFileContent(const std::string& filename, UINT64& hash)
+{
+	WMappedFile file;
+	if (!file.Open(filename))
+		return false;
+	hash = xxHash64(file.data(), static_cast<size_t>(file.size()));
+	return true;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <windows.h>
+#include <string>
+
+// 64-bit xxHash (XXH64) of a memory block
+UINT64 xxHash64(const void* data, size_t length, UINT64 seed = 0);
+
+// Hash the whole content of a file, returns false if the file can not be read
+bool hashFileContent(const std::string& filename, UINT64& hash);
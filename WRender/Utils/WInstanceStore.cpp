@@ -0,0 +1,51 @@
+#include "WInstanceStore.h"
+#include "WSceneDescParser.h"
+
+void buildInstanceStore(const WSceneRegistry<WRenderItem>& renderItems, const WTransformHierarchy& hierarchy,
+	const WInstanceTable& instanceTable, const std::map<std::string, WGeometryRecord>& geometryMap, int frameCount,
+	WInstanceStore& store)
+{
+	store = WInstanceStore();
+	const size_t count = renderItems.size() + instanceTable.size();
+	store.transforms.resize(count);
+	store.matIdx.resize(count);
+	store.geometryIdx.resize(count);
+	store.dirty.assign(count, static_cast<UINT8>(frameCount));
+	store.translations.resize(renderItems.size());
+	store.rotations.resize(renderItems.size());
+	store.scalings.resize(renderItems.size());
+	store.transformNodes.resize(renderItems.size());
+
+	std::map<std::string, UINT32> geometryIndices;
+	auto geometryIndex = [&](const std::string& name) {
+		auto inserted = geometryIndices.emplace(name, static_cast<UINT32>(store.geometryNames.size()));
+		if (inserted.second)
+		{
+			store.geometryNames.push_back(name);
+			store.geometries.push_back(geometryMap.at(name));
+		}
+		return inserted.first->second;
+	};
+
+	for (size_t i = 0; i < renderItems.size(); i++)
+	{
+		const auto& r = renderItems[i];
+		store.transforms[i] = hierarchy.worlds[r.transformNode];
+		store.translations[i] = r.translation;
+		store.rotations[i] = r.rotation;
+		store.scalings[i] = r.scaling;
+		store.transformNodes[i] = r.transformNode;
+		store.matIdx[i] = r.matIdx;
+		store.geometryIdx[i] = geometryIndex(lodGeometryName(r.geometryName, r.lodSelected));
+	}
+
+	// The instance table shares one geometry record per batch
+	const size_t first = renderItems.size();
+	std::copy(instanceTable.transforms.begin(), instanceTable.transforms.end(), store.transforms.begin() + first);
+	for (const auto& batch : instanceTable.batches)
+	{
+		UINT32 g = geometryIndex(batch.geometryName);
+		std::fill_n(store.matIdx.begin() + first + batch.first, batch.count, batch.matIdx);
+		std::fill_n(store.geometryIdx.begin() + first + batch.first, batch.count, g);
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <windows.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "../FrameResource.h"
+#include "WInstanceTable.h"
+#include "WTransformHierarchy.h"
+#include "WSceneRegistry.h"
+
+// Per-instance data of the running scene as structure of arrays, indexed like the
+// object buffer and the TLAS: render items first (by objIdx), then the instance table.
+// Names, LOD policies and other parse-time data stay in the WRenderItem records.
+
+enum WINSTANCE_DIRTY : UINT8
+{
+	INSTANCE_DIRTY_FRAMES = 0x7F,     // Frame resources still missing the object constants
+	INSTANCE_DIRTY_TRANSFORM = 0x80   // The local transform has to be recomposed from TRS first
+};
+
+struct WInstanceStore
+{
+	// Object to world, in the 3x4 layout of D3D12_RAYTRACING_INSTANCE_DESC
+	std::vector<DirectX::XMFLOAT3X4> transforms;
+	// Local TRS of the editable instances (the render items), rotation in degrees
+	std::vector<DirectX::XMFLOAT3> translations;
+	std::vector<DirectX::XMFLOAT3> rotations;
+	std::vector<DirectX::XMFLOAT3> scalings;
+	std::vector<UINT32> transformNodes;
+	std::vector<UINT32> matIdx;
+	std::vector<UINT32> geometryIdx;
+	std::vector<UINT8> dirty;
+
+	// Indexed by geometryIdx, records of the geometry (LOD level) each instance uses
+	std::vector<std::string> geometryNames;
+	std::vector<WGeometryRecord> geometries;
+
+	size_t size() const { return transforms.size(); }
+	size_t editableCount() const { return translations.size(); }
+	bool empty() const { return transforms.empty(); }
+
+	void markDirty(size_t i, int frameCount)
+	{
+		dirty[i] = (dirty[i] & INSTANCE_DIRTY_TRANSFORM) | static_cast<UINT8>(frameCount);
+	}
+	void markTransformDirty(size_t i, int frameCount)
+	{
+		dirty[i] = INSTANCE_DIRTY_TRANSFORM | static_cast<UINT8>(frameCount);
+	}
+
+	// Bytes per instance: the arrays every instance has, and the TRS only render items carry
+	static UINT64 bytesPerInstance()
+	{
+		return sizeof(DirectX::XMFLOAT3X4) + 2 * sizeof(UINT32) + sizeof(UINT8);
+	}
+	static UINT64 bytesPerEditableInstance()
+	{
+		return bytesPerInstance() + 3 * sizeof(DirectX::XMFLOAT3) + sizeof(UINT32);
+	}
+	UINT64 memoryBytes() const
+	{
+		return size() * bytesPerInstance() + editableCount() * (bytesPerEditableInstance() - bytesPerInstance()) +
+			geometries.size() * sizeof(WGeometryRecord);
+	}
+};
+
+// Render item transforms are taken from the (updated) world matrices of "hierarchy".
+// Every instance starts dirty for "frameCount" frame resources.
+void buildInstanceStore(const WSceneRegistry<WRenderItem>& renderItems, const WTransformHierarchy& hierarchy,
+	const WInstanceTable& instanceTable, const std::map<std::string, WGeometryRecord>& geometryMap, int frameCount,
+	WInstanceStore& store);
@@ -0,0 +1,83 @@
+#include "WInstanceTable.h"
+#include "WThreadPool.h"
+#include "WTransformBatch.h"
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	// Instances converted per task
+	const size_t InstanceBlockSize = 4096;
+
+	inline bool isSeparator(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ';';
+	}
+
+}
+
+DirectX::XMMATRIX composeTRS(const DirectX::XMFLOAT3& translation, const DirectX::XMFLOAT3& rotation,
+	const DirectX::XMFLOAT3& scaling)
+{
+	using namespace DirectX;
+	XMMATRIX T = XMMatrixTranslation(translation.x, translation.y, translation.z);
+	XMMATRIX Rx = XMMatrixRotationX(rotation.x * XM_PI / 180.0f);
+	XMMATRIX Ry = XMMatrixRotationY(rotation.y * XM_PI / 180.0f);
+	XMMATRIX Rz = XMMatrixRotationZ(rotation.z * XM_PI / 180.0f);
+	XMMATRIX S = XMMatrixScaling(scaling.x, scaling.y, scaling.z);
+	return XMMatrixMultiply(S, XMMatrixMultiply(Rz, XMMatrixMultiply(Ry, XMMatrixMultiply(Rx, T))));
+}
+
+bool parseInstanceFormat(std::string_view text, WINSTANCE_FORMAT& format)
+{
+	if (text.empty() || text == "trs")
+		format = INSTANCE_FORMAT_TRS;
+	else if (text == "matrix")
+		format = INSTANCE_FORMAT_MATRIX;
+	else
+		return false;
+	return true;
+}
+
+bool parseInstanceValues(const char* begin, const char* end, std::vector<float>& values, std::string& error)
+{
+	const char* p = begin;
+	for (;;)
+	{
+		while (p < end && isSeparator(*p))
+			++p;
+		if (p >= end)
+			return true;
+		if (*p == '+')
+			++p;
+		float value;
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc())
+		{
+			error = "invalid instance value at offset " + std::to_string(p - begin);
+			return false;
+		}
+		values.push_back(value);
+		p = result.ptr;
+	}
+}
+
+void appendInstances(WInstanceTable& table, UINT32 batchId, const float* values, size_t count, WINSTANCE_FORMAT format)
+{
+	size_t first = table.transforms.size();
+	table.transforms.resize(first + count);
+	table.batchIds.resize(first + count, batchId);
+
+	const UINT32 stride = instanceFormatStride(format);
+	size_t numBlocks = (count + InstanceBlockSize - 1) / InstanceBlockSize;
+	WThreadPool::global().parallelFor(numBlocks, [&](size_t block) {
+		size_t blockBegin = block * InstanceBlockSize;
+		size_t blockEnd = (std::min)(count, blockBegin + InstanceBlockSize);
+		const float* v = values + blockBegin * stride;
+		if (format == INSTANCE_FORMAT_MATRIX)
+			memcpy(&table.transforms[first + blockBegin], v, (blockEnd - blockBegin) * sizeof(DirectX::XMFLOAT3X4));
+		else
+			composeTRSBatch(v, v + 3, v + 6, stride, nullptr, blockEnd - blockBegin, &table.transforms[first + blockBegin]);
+	});
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <DirectXMath.h>
+
+// Instances declared with <instances mesh="..." material="...">, expanded into a
+// structure-of-arrays table instead of one WRenderItem per instance.
+//
+// Transforms are given inline as the element text or in a binary sidecar file
+// (file="..."), as float32 values in one of two layouts:
+//   format="trs"    translation, rotation (degrees) and scale, 9 floats per instance (default)
+//   format="matrix" row-major 3x4 object-to-world matrix (translation in the last column),
+//                   12 floats per instance
+// Inline values may be separated by whitespace, commas or semicolons.
+// The material must be declared by an <object> earlier in the scene.
+
+enum WINSTANCE_FORMAT : UINT32
+{
+	INSTANCE_FORMAT_TRS = 0,
+	INSTANCE_FORMAT_MATRIX
+};
+
+inline UINT32 instanceFormatStride(WINSTANCE_FORMAT format)
+{
+	return format == INSTANCE_FORMAT_TRS ? 9 : 12;
+}
+
+// All instances of one <instances> element share mesh and material
+struct WInstanceBatch
+{
+	std::string geometryName;
+	std::string materialName;
+	UINT32 matIdx = 0;
+	UINT32 first = 0;
+	UINT32 count = 0;
+};
+
+struct WInstanceTable
+{
+	std::vector<WInstanceBatch> batches;
+	// One entry per instance. Transforms use the 3x4 layout of D3D12_RAYTRACING_INSTANCE_DESC.
+	std::vector<DirectX::XMFLOAT3X4> transforms;
+	std::vector<UINT32> batchIds;
+
+	size_t size() const { return transforms.size(); }
+	bool empty() const { return transforms.empty(); }
+	void clear()
+	{
+		batches.clear();
+		transforms.clear();
+		batchIds.clear();
+	}
+	UINT64 memoryBytes() const
+	{
+		return transforms.size() * sizeof(DirectX::XMFLOAT3X4) + batchIds.size() * sizeof(UINT32) +
+			batches.size() * sizeof(WInstanceBatch);
+	}
+};
+
+// Object to world from translation, rotation (degrees, applied X then Y then Z) and scale,
+// the composition <transform> elements of objects use as well
+DirectX::XMMATRIX composeTRS(const DirectX::XMFLOAT3& translation, const DirectX::XMFLOAT3& rotation,
+	const DirectX::XMFLOAT3& scaling);
+
+// Empty text is the default format
+bool parseInstanceFormat(std::string_view text, WINSTANCE_FORMAT& format);
+
+// Parses inline instance values; "error" receives the offset of the first bad token
+bool parseInstanceValues(const char* begin, const char* end, std::vector<float>& values, std::string& error);
+
+// Appends "count" instances read from "values" to the batch, which must be the last one in the table
+void appendInstances(WInstanceTable& table, UINT32 batchId, const float* values, size_t count, WINSTANCE_FORMAT format);
@@ -0,0 +1,49 @@
+#include "WMappedFile.h"
+
+bool WMappedFile::Open(const std::string& filename)
+{
+	Close();
+	mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(mFile, &fileSize))
+	{
+		Close();
+		return false;
+	}
+	mSize = static_cast<UINT64>(fileSize.QuadPart);
+	// An empty file can not be mapped, but it is still a valid (empty) view
+	if (mSize == 0)
+		return true;
+
+	mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mMapping)
+	{
+		Close();
+		return false;
+	}
+	mData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if (!mData)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void WMappedFile::Close()
+{
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+	mData = nullptr;
+	mMapping = nullptr;
+	mFile = INVALID_HANDLE_VALUE;
+	mSize = 0;
+}
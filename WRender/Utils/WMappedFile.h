@@ -0,0 +1,26 @@
+#pragma once
+#include <windows.h>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+// The view stays valid until Close() is called or the object is destroyed.
+class WMappedFile
+{
+public:
+	WMappedFile() = default;
+	WMappedFile(const WMappedFile& rhs) = delete;
+	WMappedFile& operator=(const WMappedFile& rhs) = delete;
+	~WMappedFile() { Close(); }
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	bool isOpen() const { return mFile != INVALID_HANDLE_VALUE; }
+	const char* data() const { return mData; }
+	UINT64 size() const { return mSize; }
+private:
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+	const char* mData = nullptr;
+	UINT64 mSize = 0;
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include <windows.h>
+#include <vector>
+#include <string>
+#include <../Include/tiny_obj_loader.h>
+
+// One loaded mesh before it is flattened into the global scene buffers.
+// All three index streams have the same length (3 per triangle); normals are
+// always present (generated when the file has none), texcoords are optional.
+// After quantization normals and texcoords live in the packed arrays instead (see WVertexCodec.h),
+// except texcoords half precision cannot hold within its bound, which stay float.
+// Files using more than one material (usemtl) keep one material slot per triangle; every
+// pass that reorders or drops triangles keeps materialIds in step with them.
+struct WMeshData
+{
+	std::vector<tinyobj::real_t> vertices;
+	std::vector<tinyobj::real_t> normals;
+	std::vector<tinyobj::real_t> texCoords;
+	std::vector<UINT32> packedNormals;
+	std::vector<UINT32> packedTexCoords;
+	std::vector<UINT32> indices;
+	std::vector<INT32> normalIndices;
+	std::vector<INT32> texCoordIndices;
+	std::vector<UINT32> materialIds;         // Per triangle, indexes materialNames
+	std::vector<std::string> materialNames;  // usemtl names, "" for faces before the first usemtl
+
+	bool hasTexCoords() const { return !texCoords.empty() || !packedTexCoords.empty(); }
+	bool hasMaterialIds() const { return !materialIds.empty(); }
+};
@@ -0,0 +1,529 @@
+#include "WMeshOptimizer.h"
+#include "WVertexCodec.h"
+#include "WHash.h"
+#include "WThreadPool.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+#include <algorithm>
+#include <list>
+#include <cfloat>
+#include <cstring>
+
+namespace
+{
+	struct VertexTuple
+	{
+		UINT32 position;
+		INT32 normal;
+		INT32 texCoord;
+		bool operator==(const VertexTuple& rhs) const
+		{
+			return position == rhs.position && normal == rhs.normal && texCoord == rhs.texCoord;
+		}
+	};
+
+	struct VertexTupleHash
+	{
+		size_t operator()(const VertexTuple& t) const
+		{
+			UINT64 h = t.position * 0x9E3779B185EBCA87ULL;
+			h ^= static_cast<UINT32>(t.normal) * 0xC2B2AE3D27D4EB4FULL + (h << 6) + (h >> 2);
+			h ^= static_cast<UINT32>(t.texCoord) * 0x165667B19E3779F9ULL + (h << 6) + (h >> 2);
+			return static_cast<size_t>(h);
+		}
+	};
+
+	inline UINT64 meshBytes(const WMeshData& mesh)
+	{
+		return (mesh.vertices.size() + mesh.normals.size() + mesh.texCoords.size()) * sizeof(tinyobj::real_t) +
+			(mesh.packedNormals.size() + mesh.packedTexCoords.size()) * sizeof(UINT32) +
+			mesh.indices.size() * sizeof(UINT32) +
+			(mesh.normalIndices.size() + mesh.texCoordIndices.size()) * sizeof(INT32) +
+			mesh.materialIds.size() * sizeof(UINT32);
+	}
+
+	// Triangle corners, or the bit patterns of a position
+	struct Words3
+	{
+		UINT32 words[3];
+		bool operator==(const Words3& rhs) const
+		{
+			return words[0] == rhs.words[0] && words[1] == rhs.words[1] && words[2] == rhs.words[2];
+		}
+	};
+
+	struct Words3Hash
+	{
+		size_t operator()(const Words3& t) const
+		{
+			UINT64 h = t.words[0] * 0x9E3779B185EBCA87ULL;
+			h ^= t.words[1] * 0xC2B2AE3D27D4EB4FULL + (h << 6) + (h >> 2);
+			h ^= t.words[2] * 0x165667B19E3779F9ULL + (h << 6) + (h >> 2);
+			return static_cast<size_t>(h);
+		}
+	};
+
+	// Drops the elements not referenced by "indices" and keeps the order of the others,
+	// returns the number dropped
+	template<typename IndexT>
+	size_t compactAttributes(std::vector<IndexT>& indices, std::vector<tinyobj::real_t>& attributes, size_t stride)
+	{
+		const size_t count = attributes.size() / stride;
+		std::vector<char> used(count, 0);
+		for (auto index : indices)
+			if (static_cast<INT64>(index) >= 0)
+				used[index] = 1;
+		std::vector<IndexT> remap(count);
+		size_t kept = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			remap[i] = static_cast<IndexT>(kept);
+			if (!used[i])
+				continue;
+			if (kept != i)
+				std::copy(attributes.begin() + i * stride, attributes.begin() + (i + 1) * stride, attributes.begin() + kept * stride);
+			++kept;
+		}
+		attributes.resize(kept * stride);
+		for (auto& index : indices)
+			if (static_cast<INT64>(index) >= 0)
+				index = remap[index];
+		return count - kept;
+	}
+
+	template<typename T>
+	inline UINT64 hashStream(const std::vector<T>& stream, UINT64 seed)
+	{
+		// Fold the length in, so data can not move between neighbouring streams unnoticed
+		return xxHash64(stream.data(), stream.size() * sizeof(T), seed ^ stream.size());
+	}
+
+	UINT64 hashMesh(const WMeshData& mesh)
+	{
+		UINT64 h = hashStream(mesh.vertices, 0);
+		h = hashStream(mesh.indices, h);
+		h = hashStream(mesh.normals, h);
+		h = hashStream(mesh.texCoords, h);
+		h = hashStream(mesh.packedNormals, h);
+		h = hashStream(mesh.packedTexCoords, h);
+		h = hashStream(mesh.normalIndices, h);
+		h = hashStream(mesh.texCoordIndices, h);
+		return hashStream(mesh.materialIds, h);
+	}
+
+	template<typename T>
+	inline bool sameStream(const std::vector<T>& a, const std::vector<T>& b)
+	{
+		return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+	}
+
+	bool sameMesh(const WMeshData& a, const WMeshData& b)
+	{
+		return sameStream(a.vertices, b.vertices) && sameStream(a.indices, b.indices) &&
+			sameStream(a.normals, b.normals) && sameStream(a.texCoords, b.texCoords) &&
+			sameStream(a.packedNormals, b.packedNormals) && sameStream(a.packedTexCoords, b.packedTexCoords) &&
+			sameStream(a.normalIndices, b.normalIndices) && sameStream(a.texCoordIndices, b.texCoordIndices) &&
+			sameStream(a.materialIds, b.materialIds) && a.materialNames == b.materialNames;
+	}
+}
+
+WWeldStats weldMeshVertices(WMeshData& mesh)
+{
+	WWeldStats stats;
+	stats.vertexCountBefore = mesh.vertices.size() / 3;
+	stats.bytesBefore = meshBytes(mesh);
+
+	const bool hasNormals = !mesh.normals.empty();
+	const bool hasTexCoords = mesh.hasTexCoords();
+	std::vector<tinyobj::real_t> vertices, normals, texCoords;
+	std::vector<UINT32> indices(mesh.indices.size());
+	std::unordered_map<VertexTuple, UINT32, VertexTupleHash> tupleToVertex;
+	tupleToVertex.reserve(stats.vertexCountBefore * 2);
+	vertices.reserve(mesh.vertices.size());
+
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		VertexTuple t = { mesh.indices[i], mesh.normalIndices[i], mesh.texCoordIndices[i] };
+		auto result = tupleToVertex.emplace(t, static_cast<UINT32>(vertices.size() / 3));
+		if (result.second)
+		{
+			const tinyobj::real_t* p = &mesh.vertices[3 * static_cast<size_t>(t.position)];
+			vertices.insert(vertices.end(), p, p + 3);
+			if (hasNormals)
+			{
+				// Corners without a normal index get a zero normal
+				tinyobj::real_t zero[3] = { 0, 0, 0 };
+				const tinyobj::real_t* n = t.normal >= 0 ? &mesh.normals[3 * static_cast<size_t>(t.normal)] : zero;
+				normals.insert(normals.end(), n, n + 3);
+			}
+			if (hasTexCoords)
+			{
+				tinyobj::real_t zero[2] = { 0, 0 };
+				const tinyobj::real_t* uv = t.texCoord >= 0 ? &mesh.texCoords[2 * static_cast<size_t>(t.texCoord)] : zero;
+				texCoords.insert(texCoords.end(), uv, uv + 2);
+			}
+		}
+		indices[i] = result.first->second;
+	}
+
+	mesh.vertices = std::move(vertices);
+	mesh.normals = std::move(normals);
+	mesh.texCoords = std::move(texCoords);
+	mesh.indices = std::move(indices);
+	mesh.normalIndices.assign(mesh.indices.begin(), mesh.indices.end());
+	mesh.texCoordIndices.assign(mesh.indices.begin(), mesh.indices.end());
+
+	stats.vertexCountAfter = mesh.vertices.size() / 3;
+	// The separate normal/texcoord index streams are not uploaded for welded meshes
+	stats.bytesAfter = (mesh.vertices.size() + mesh.normals.size() + mesh.texCoords.size()) * sizeof(tinyobj::real_t) +
+		mesh.indices.size() * sizeof(UINT32);
+	return stats;
+}
+
+WQuantizationStats quantizeMeshAttributes(WMeshData& mesh)
+{
+	WQuantizationStats stats;
+	stats.bytesBefore = (mesh.normals.size() + mesh.texCoords.size()) * sizeof(tinyobj::real_t);
+
+	mesh.packedNormals.resize(mesh.normals.size() / 3);
+	for (size_t i = 0; i < mesh.packedNormals.size(); i++)
+	{
+		const tinyobj::real_t* n = &mesh.normals[3 * i];
+		mesh.packedNormals[i] = encodeOctahedralNormal(n[0], n[1], n[2]);
+
+		float x, y, z;
+		decodeOctahedralNormal(mesh.packedNormals[i], x, y, z);
+		double length = std::sqrt(double(n[0]) * n[0] + double(n[1]) * n[1] + double(n[2]) * n[2]);
+		if (length == 0.0)
+			continue;
+		// atan2 of |cross| and dot stays accurate for tiny angles, unlike acos
+		double cx = (n[1] * z - n[2] * y) / length, cy = (n[2] * x - n[0] * z) / length, cz = (n[0] * y - n[1] * x) / length;
+		double dot = (n[0] * x + n[1] * y + n[2] * z) / length;
+		stats.maxNormalError = (std::max)(stats.maxNormalError, std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot));
+	}
+
+	mesh.packedTexCoords.resize(mesh.texCoords.size() / 2);
+	for (size_t i = 0; i < mesh.packedTexCoords.size(); i++)
+	{
+		const tinyobj::real_t* uv = &mesh.texCoords[2 * i];
+		mesh.packedTexCoords[i] = encodeHalfTexCoord(uv[0], uv[1]);
+
+		float decoded[2];
+		decodeHalfTexCoord(mesh.packedTexCoords[i], decoded[0], decoded[1]);
+		for (int c = 0; c < 2; c++)
+			stats.maxTexCoordError = (std::max)(stats.maxTexCoordError, std::fabs(double(decoded[c]) - uv[c]));
+	}
+	// Tiled texcoords far from 0 lose too much, their mesh keeps them exact
+	if (stats.maxTexCoordError > WHalfTexCoordMaxAbsoluteError)
+	{
+		stats.floatTexCoords = true;
+		stats.maxTexCoordError = 0.0;
+		std::vector<UINT32>().swap(mesh.packedTexCoords);
+	}
+
+	stats.withinBounds = stats.maxNormalError <= WOctNormalMaxAngularError;
+	stats.bytesAfter = (mesh.packedNormals.size() + mesh.packedTexCoords.size()) * sizeof(UINT32);
+	std::vector<tinyobj::real_t>().swap(mesh.normals);
+	if (stats.floatTexCoords)
+		stats.bytesAfter += mesh.texCoords.size() * sizeof(tinyobj::real_t);
+	else
+		std::vector<tinyobj::real_t>().swap(mesh.texCoords);
+	return stats;
+}
+
+namespace
+{
+	class LRULineCache
+	{
+	public:
+		explicit LRULineCache(size_t capacity) : mCapacity(capacity) { mLines.reserve(capacity * 2); }
+		// Returns true on a miss
+		bool access(UINT64 address)
+		{
+			UINT64 line = address / WLocalityCacheLineSize;
+			auto it = mLines.find(line);
+			if (it != mLines.end())
+			{
+				mOrder.splice(mOrder.begin(), mOrder, it->second);
+				return false;
+			}
+			if (mLines.size() == mCapacity)
+			{
+				mLines.erase(mOrder.back());
+				mOrder.pop_back();
+			}
+			mOrder.push_front(line);
+			mLines[line] = mOrder.begin();
+			return true;
+		}
+	private:
+		size_t mCapacity;
+		std::list<UINT64> mOrder;
+		std::unordered_map<UINT64, std::list<UINT64>::iterator> mLines;
+	};
+
+	// Spreads the low 10 bits of v so that there are two zero bits between each
+	inline UINT32 expandBits(UINT32 v)
+	{
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+
+	// Renumbers the elements referenced by "indices" in first-use order, unreferenced ones are dropped
+	template<typename IndexT>
+	void remapFirstUse(std::vector<IndexT>& indices, std::vector<tinyobj::real_t>& attributes, size_t stride)
+	{
+		if (attributes.empty())
+			return;
+		const IndexT unassigned = static_cast<IndexT>(-1);
+		std::vector<IndexT> remap(attributes.size() / stride, unassigned);
+		std::vector<tinyobj::real_t> reordered;
+		reordered.reserve(attributes.size());
+		for (auto& index : indices)
+		{
+			if (static_cast<INT64>(index) < 0)
+				continue;
+			if (remap[index] == unassigned)
+			{
+				remap[index] = static_cast<IndexT>(reordered.size() / stride);
+				reordered.insert(reordered.end(), attributes.begin() + index * stride, attributes.begin() + (index + 1) * stride);
+			}
+			index = remap[index];
+		}
+		attributes = std::move(reordered);
+	}
+}
+
+WCleanupStats cleanupMesh(WMeshData& mesh)
+{
+	WCleanupStats stats;
+	stats.trianglesBefore = mesh.indices.size() / 3;
+	stats.bytesBefore = meshBytes(mesh);
+
+	// Every position is represented by the first one with the same coordinates
+	const size_t positionCount = mesh.vertices.size() / 3;
+	std::vector<UINT32> representative(positionCount);
+	{
+		std::unordered_map<Words3, UINT32, Words3Hash> firstWithCoordinates;
+		firstWithCoordinates.reserve(positionCount);
+		for (size_t v = 0; v < positionCount; v++)
+		{
+			Words3 bits;
+			memcpy(bits.words, &mesh.vertices[3 * v], sizeof(bits.words));
+			representative[v] = firstWithCoordinates.emplace(bits, static_cast<UINT32>(v)).first->second;
+		}
+	}
+
+	const size_t triangleCount = stats.trianglesBefore;
+	std::unordered_set<Words3, Words3Hash> seen;
+	seen.reserve(triangleCount);
+	size_t kept = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		UINT32 a = representative[mesh.indices[3 * t]];
+		UINT32 b = representative[mesh.indices[3 * t + 1]];
+		UINT32 c = representative[mesh.indices[3 * t + 2]];
+		if (a == b || b == c || a == c)
+		{
+			++stats.degenerateTriangles;
+			continue;
+		}
+
+		// |cross| is the longest edge times the height, compared in squares
+		const tinyobj::real_t* p0 = &mesh.vertices[3 * static_cast<size_t>(a)];
+		const tinyobj::real_t* p1 = &mesh.vertices[3 * static_cast<size_t>(b)];
+		const tinyobj::real_t* p2 = &mesh.vertices[3 * static_cast<size_t>(c)];
+		double e1[3], e2[3], e3[3];
+		for (int k = 0; k < 3; k++)
+		{
+			e1[k] = double(p1[k]) - p0[k];
+			e2[k] = double(p2[k]) - p0[k];
+			e3[k] = double(p2[k]) - p1[k];
+		}
+		double cx = e1[1] * e2[2] - e1[2] * e2[1];
+		double cy = e1[2] * e2[0] - e1[0] * e2[2];
+		double cz = e1[0] * e2[1] - e1[1] * e2[0];
+		double longest = (std::max)((std::max)(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2],
+			e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2]), e3[0] * e3[0] + e3[1] * e3[1] + e3[2] * e3[2]);
+		double bound = WDegenerateTriangleTolerance * longest;
+		if (cx * cx + cy * cy + cz * cz <= bound * bound)
+		{
+			++stats.degenerateTriangles;
+			continue;
+		}
+
+		// Rotated so the smallest corner comes first, the winding stays
+		Words3 key = { { a, b, c } };
+		if (b < a && b < c)
+			key = { { b, c, a } };
+		else if (c < a && c < b)
+			key = { { c, a, b } };
+		if (!seen.insert(key).second)
+		{
+			++stats.duplicateTriangles;
+			continue;
+		}
+
+		if (kept != t)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				mesh.indices[3 * kept + k] = mesh.indices[3 * t + k];
+				mesh.normalIndices[3 * kept + k] = mesh.normalIndices[3 * t + k];
+				mesh.texCoordIndices[3 * kept + k] = mesh.texCoordIndices[3 * t + k];
+			}
+			if (mesh.hasMaterialIds())
+				mesh.materialIds[kept] = mesh.materialIds[t];
+		}
+		++kept;
+	}
+	mesh.indices.resize(3 * kept);
+	mesh.normalIndices.resize(3 * kept);
+	mesh.texCoordIndices.resize(3 * kept);
+	if (mesh.hasMaterialIds())
+		mesh.materialIds.resize(kept);
+
+	stats.verticesRemoved = compactAttributes(mesh.indices, mesh.vertices, 3);
+	stats.normalsRemoved = compactAttributes(mesh.normalIndices, mesh.normals, 3);
+	stats.texCoordsRemoved = compactAttributes(mesh.texCoordIndices, mesh.texCoords, 2);
+	stats.bytesAfter = meshBytes(mesh);
+	return stats;
+}
+
+UINT64 simulateAttributeCacheMisses(const WMeshData& mesh, UINT64* fetches)
+{
+	// The three streams live in separate buffers, give each its own address range
+	const UINT64 normalBase = 1ULL << 40, texCoordBase = 2ULL << 40;
+	LRULineCache cache(WLocalityCacheLines);
+	UINT64 misses = 0, count = 0;
+	const bool hasNormals = !mesh.normals.empty();
+	const bool hasTexCoords = !mesh.texCoords.empty();
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		misses += cache.access(static_cast<UINT64>(mesh.indices[i]) * 3 * sizeof(tinyobj::real_t));
+		count++;
+		if (hasNormals && mesh.normalIndices[i] >= 0)
+		{
+			misses += cache.access(normalBase + static_cast<UINT64>(mesh.normalIndices[i]) * 3 * sizeof(tinyobj::real_t));
+			count++;
+		}
+		if (hasTexCoords && mesh.texCoordIndices[i] >= 0)
+		{
+			misses += cache.access(texCoordBase + static_cast<UINT64>(mesh.texCoordIndices[i]) * 2 * sizeof(tinyobj::real_t));
+			count++;
+		}
+	}
+	if (fetches)
+		*fetches = count;
+	return misses;
+}
+
+WLocalityStats reorderMeshForLocality(WMeshData& mesh)
+{
+	WLocalityStats stats;
+	stats.missesBefore = simulateAttributeCacheMisses(mesh, &stats.fetches);
+
+	size_t triangleCount = mesh.indices.size() / 3;
+	if (triangleCount == 0)
+		return stats;
+
+	// Centroids and their bounds
+	std::vector<float> centroids(3 * triangleCount);
+	float lower[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, upper[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float c = (mesh.vertices[3 * static_cast<size_t>(mesh.indices[3 * t]) + axis] +
+				mesh.vertices[3 * static_cast<size_t>(mesh.indices[3 * t + 1]) + axis] +
+				mesh.vertices[3 * static_cast<size_t>(mesh.indices[3 * t + 2]) + axis]) / 3.0f;
+			centroids[3 * t + axis] = c;
+			lower[axis] = (std::min)(lower[axis], c);
+			upper[axis] = (std::max)(upper[axis], c);
+		}
+	}
+
+	// 30-bit Morton codes over the centroid bounds
+	std::vector<std::pair<UINT32, UINT32>> keys(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		UINT32 code = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = upper[axis] - lower[axis];
+			float n = extent > 0.0f ? (centroids[3 * t + axis] - lower[axis]) / extent : 0.0f;
+			UINT32 q = (std::min)(static_cast<UINT32>(n * 1024.0f), 1023u);
+			code |= expandBits(q) << (2 - axis);
+		}
+		keys[t] = { code, static_cast<UINT32>(t) };
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<UINT32> indices(mesh.indices.size());
+	std::vector<INT32> normalIndices(mesh.normalIndices.size());
+	std::vector<INT32> texCoordIndices(mesh.texCoordIndices.size());
+	std::vector<UINT32> materialIds(mesh.materialIds.size());
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		size_t src = 3 * static_cast<size_t>(keys[t].second);
+		for (size_t k = 0; k < 3; k++)
+		{
+			indices[3 * t + k] = mesh.indices[src + k];
+			normalIndices[3 * t + k] = mesh.normalIndices[src + k];
+			texCoordIndices[3 * t + k] = mesh.texCoordIndices[src + k];
+		}
+		if (mesh.hasMaterialIds())
+			materialIds[t] = mesh.materialIds[keys[t].second];
+	}
+	mesh.indices = std::move(indices);
+	mesh.normalIndices = std::move(normalIndices);
+	mesh.texCoordIndices = std::move(texCoordIndices);
+	mesh.materialIds = std::move(materialIds);
+
+	remapFirstUse(mesh.indices, mesh.vertices, 3);
+	remapFirstUse(mesh.normalIndices, mesh.normals, 3);
+	remapFirstUse(mesh.texCoordIndices, mesh.texCoords, 2);
+
+	stats.missesAfter = simulateAttributeCacheMisses(mesh);
+	return stats;
+}
+
+std::vector<size_t> findDuplicateMeshes(const std::vector<WMeshData>& meshes, WDeduplicationStats& stats)
+{
+	std::vector<UINT64> hashes(meshes.size());
+	WThreadPool::global().parallelFor(meshes.size(), [&](size_t i) {
+		hashes[i] = hashMesh(meshes[i]);
+	});
+
+	stats = WDeduplicationStats();
+	stats.meshCount = meshes.size();
+	std::vector<size_t> canonical(meshes.size());
+	std::unordered_multimap<UINT64, size_t> firstWithHash;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		canonical[i] = i;
+		auto range = firstWithHash.equal_range(hashes[i]);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (sameMesh(meshes[it->second], meshes[i]))
+			{
+				canonical[i] = it->second;
+				break;
+			}
+		}
+
+		UINT64 bytes = meshBytes(meshes[i]);
+		stats.bytesBefore += bytes;
+		if (canonical[i] == i)
+		{
+			firstWithHash.emplace(hashes[i], i);
+			stats.bytesAfter += bytes;
+			stats.uniqueMeshCount++;
+		}
+	}
+	return canonical;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <windows.h>
+#include "WMeshData.h"
+
+// Mesh processing passes run on every loaded mesh before it is flattened into the scene buffers
+
+// Triangles whose height is below this fraction of their longest edge have no area
+const double WDegenerateTriangleTolerance = 1e-6;
+
+struct WCleanupStats
+{
+	size_t trianglesBefore = 0;
+	size_t degenerateTriangles = 0;  // Repeated corners or no area
+	size_t duplicateTriangles = 0;   // Same corner positions and winding as an earlier triangle
+	size_t verticesRemoved = 0;      // Positions no kept triangle references
+	size_t normalsRemoved = 0;
+	size_t texCoordsRemoved = 0;
+	UINT64 bytesBefore = 0;
+	UINT64 bytesAfter = 0;
+
+	bool changed() const { return degenerateTriangles + duplicateTriangles + verticesRemoved + normalsRemoved + texCoordsRemoved > 0; }
+};
+
+// Drops degenerate and duplicate triangles, then every position, normal and texcoord no
+// remaining triangle references. Corners are compared by position value, so duplicates
+// made of unwelded vertex copies are found too. The first of a set of duplicates is kept
+// with its attributes and material; the same face with the opposite winding is not a
+// duplicate. Runs on the unwelded OBJ streams, the order of what is kept does not change.
+WCleanupStats cleanupMesh(WMeshData& mesh);
+
+struct WWeldStats
+{
+	size_t vertexCountBefore = 0;  // Position count of the source mesh
+	size_t vertexCountAfter = 0;   // Unique (position, normal, texcoord) tuples
+	UINT64 bytesBefore = 0;        // Attributes plus all three index streams
+	UINT64 bytesAfter = 0;         // Attributes plus the single index stream
+};
+
+// Welds every (position, normal, texcoord) index tuple into one vertex, so that a
+// single index addresses all attributes. Afterwards normalIndices and texCoordIndices
+// are identical to indices.
+WWeldStats weldMeshVertices(WMeshData& mesh);
+
+struct WQuantizationStats
+{
+	UINT64 bytesBefore = 0;          // Float normals and texcoords
+	UINT64 bytesAfter = 0;           // Packed normals and texcoords
+	double maxNormalError = 0.0;     // Largest angle between a source and a decoded normal, in radians
+	double maxTexCoordError = 0.0;   // Largest difference between a source and a decoded texcoord component
+	bool floatTexCoords = false;     // Half texcoords would exceed their bound, the float ones are kept
+	bool withinBounds = true;
+};
+
+// Replaces the float normals and texcoords by their packed encodings and checks every
+// decoded value against the error bounds in WVertexCodec.h. Texcoords that do not fit half
+// precision stay float, so only normals can exceed their bound.
+WQuantizationStats quantizeMeshAttributes(WMeshData& mesh);
+
+// Simulated fully-associative LRU cache used to compare attribute fetch orders
+const UINT32 WLocalityCacheLineSize = 64;
+const UINT32 WLocalityCacheLines = 512;
+
+struct WLocalityStats
+{
+	UINT64 fetches = 0;          // Attribute fetches, one per stream and triangle corner
+	UINT64 missesBefore = 0;
+	UINT64 missesAfter = 0;
+};
+
+// Simulates fetching every corner's position, normal and texcoord in index order
+// and returns the number of cache line misses
+UINT64 simulateAttributeCacheMisses(const WMeshData& mesh, UINT64* fetches = nullptr);
+
+// Sorts triangles along a Morton curve of their centroids, then renumbers every
+// attribute stream in first-use order of the new index order
+WLocalityStats reorderMeshForLocality(WMeshData& mesh);
+
+struct WDeduplicationStats
+{
+	size_t meshCount = 0;
+	size_t uniqueMeshCount = 0;
+	UINT64 bytesBefore = 0;      // All streams of all meshes
+	UINT64 bytesAfter = 0;       // All streams of the unique meshes
+};
+
+// Hashes every stream of each mesh with xxHash64 and returns, per mesh, the index of the
+// first mesh with identical content (itself when unique). Equal hashes are confirmed by
+// a full comparison, so a collision never aliases different meshes.
+std::vector<size_t> findDuplicateMeshes(const std::vector<WMeshData>& meshes, WDeduplicationStats& stats);
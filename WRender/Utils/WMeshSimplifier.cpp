@@ -0,0 +1,359 @@
+#include "WMeshSimplifier.h"
+#include <unordered_map>
+#include <queue>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <iterator>
+
+namespace
+{
+	// Boundary planes count this much more than surface planes
+	const double BoundaryWeight = 100.0;
+	// Smallest cosine allowed between a triangle normal before and after a collapse
+	const double MinNormalCosine = 0.25;
+
+	// Symmetric 4x4 matrix summing squared distances to a set of planes
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+		double a11 = 0, a12 = 0, a13 = 0;
+		double a22 = 0, a23 = 0;
+		double a33 = 0;
+
+		void addPlane(double a, double b, double c, double d, double w)
+		{
+			a00 += w * a * a; a01 += w * a * b; a02 += w * a * c; a03 += w * a * d;
+			a11 += w * b * b; a12 += w * b * c; a13 += w * b * d;
+			a22 += w * c * c; a23 += w * c * d;
+			a33 += w * d * d;
+		}
+		Quadric& operator+=(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			return *this;
+		}
+		double evaluate(const double* p) const
+		{
+			double x = p[0], y = p[1], z = p[2];
+			return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x +
+				a11 * y * y + 2 * a12 * y * z + 2 * a13 * y +
+				a22 * z * z + 2 * a23 * z + a33;
+		}
+	};
+
+	struct Candidate
+	{
+		double cost;
+		UINT32 from;          // Removed vertex
+		UINT32 to;            // Kept vertex
+		UINT32 fromVersion;
+		UINT32 toVersion;
+		bool operator>(const Candidate& rhs) const { return cost > rhs.cost; }
+	};
+
+	struct EdgeUse
+	{
+		UINT32 triangles = 0;
+		UINT32 materialId = 0;
+		bool materialSeam = false;  // Separates triangles of different materials
+	};
+
+	inline UINT64 edgeKey(UINT32 a, UINT32 b)
+	{
+		return a < b ? (UINT64(a) << 32) | b : (UINT64(b) << 32) | a;
+	}
+
+	inline void sub(const double* a, const double* b, double* r)
+	{
+		r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2];
+	}
+
+	inline void cross(const double* a, const double* b, double* r)
+	{
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline double dot(const double* a, const double* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	inline double length(const double* a)
+	{
+		return std::sqrt(dot(a, a));
+	}
+
+	// Unnormalized normal of the triangle (p0, p1, p2)
+	inline void triangleNormal(const double* p0, const double* p1, const double* p2, double* n)
+	{
+		double e1[3], e2[3];
+		sub(p1, p0, e1);
+		sub(p2, p0, e2);
+		cross(e1, e2, n);
+	}
+
+	// Renumbers a stream in first-use order of its indices and drops unused entries
+	template<typename Index, typename T>
+	void compactStream(std::vector<Index>& indices, const std::vector<T>& values, size_t components, std::vector<T>& result)
+	{
+		result.clear();
+		if (values.empty())
+			return;
+		std::vector<INT64> remap(values.size() / components, -1);
+		for (auto& idx : indices)
+		{
+			if (static_cast<INT64>(idx) < 0)
+				continue;
+			auto& mapped = remap[idx];
+			if (mapped < 0)
+			{
+				mapped = static_cast<INT64>(result.size() / components);
+				result.insert(result.end(), values.begin() + idx * components, values.begin() + (idx + 1) * components);
+			}
+			idx = static_cast<Index>(mapped);
+		}
+	}
+
+	template<typename Index>
+	bool sameIndices(const std::vector<UINT32>& indices, const std::vector<Index>& other)
+	{
+		return indices.size() == other.size() &&
+			std::equal(indices.begin(), indices.end(), other.begin(),
+				[](UINT32 a, Index b) { return static_cast<INT64>(a) == static_cast<INT64>(b); });
+	}
+}
+
+WSimplifyStats simplifyMesh(const WMeshData& mesh, size_t targetTriangles, WMeshData& result)
+{
+	WSimplifyStats stats;
+	const size_t triangleCount = mesh.indices.size() / 3;
+	const size_t vertexCount = mesh.vertices.size() / 3;
+	stats.trianglesBefore = triangleCount;
+
+	std::vector<double> positions(mesh.vertices.begin(), mesh.vertices.end());
+	std::vector<UINT32> corners(mesh.indices);
+	std::vector<INT32> normalCorners(mesh.normalIndices);
+	std::vector<INT32> texCoordCorners(mesh.texCoordIndices);
+	// Welded (or generated) attributes follow the position index of their corner
+	const bool normalsFollow = sameIndices(mesh.indices, mesh.normalIndices);
+	const bool texCoordsFollow = sameIndices(mesh.indices, mesh.texCoordIndices);
+
+	double bbMin[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+	double bbMax[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			bbMin[c] = (std::min)(bbMin[c], positions[3 * v + c]);
+			bbMax[c] = (std::max)(bbMax[c], positions[3 * v + c]);
+		}
+	}
+	double diagonal[3];
+	sub(bbMax, bbMin, diagonal);
+	const double diagonalLength = vertexCount > 0 ? (std::max)(length(diagonal), 1e-30) : 1.0;
+
+	// Surface quadrics and vertex to triangle adjacency
+	std::vector<Quadric> quadrics(vertexCount);
+	std::vector<std::vector<UINT32>> vertexTriangles(vertexCount);
+	std::unordered_map<UINT64, EdgeUse> edgeUse;
+	edgeUse.reserve(triangleCount * 3);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const UINT32* tri = &corners[3 * t];
+		double n[3];
+		triangleNormal(&positions[3 * tri[0]], &positions[3 * tri[1]], &positions[3 * tri[2]], n);
+		double len = length(n);
+		UINT32 materialId = mesh.hasMaterialIds() ? mesh.materialIds[t] : 0;
+		for (int k = 0; k < 3; k++)
+		{
+			vertexTriangles[tri[k]].push_back(static_cast<UINT32>(t));
+			auto& edge = edgeUse[edgeKey(tri[k], tri[(k + 1) % 3])];
+			if (edge.triangles++ == 0)
+				edge.materialId = materialId;
+			else if (edge.materialId != materialId)
+				edge.materialSeam = true;
+		}
+		if (len == 0.0)
+			continue;
+		n[0] /= len; n[1] /= len; n[2] /= len;
+		double d = -dot(n, &positions[3 * tri[0]]);
+		for (int k = 0; k < 3; k++)
+			quadrics[tri[k]].addPlane(n[0], n[1], n[2], d, 1.0);
+	}
+
+	// Planes through boundary and material seam edges, perpendicular to their triangle
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const UINT32* tri = &corners[3 * t];
+		double n[3];
+		triangleNormal(&positions[3 * tri[0]], &positions[3 * tri[1]], &positions[3 * tri[2]], n);
+		for (int k = 0; k < 3; k++)
+		{
+			UINT32 a = tri[k], b = tri[(k + 1) % 3];
+			const auto& edge = edgeUse[edgeKey(a, b)];
+			if (edge.triangles != 1 && !edge.materialSeam)
+				continue;
+			double e[3], bn[3];
+			sub(&positions[3 * b], &positions[3 * a], e);
+			cross(e, n, bn);
+			double len = length(bn);
+			if (len == 0.0)
+				continue;
+			bn[0] /= len; bn[1] /= len; bn[2] /= len;
+			double d = -dot(bn, &positions[3 * a]);
+			quadrics[a].addPlane(bn[0], bn[1], bn[2], d, BoundaryWeight);
+			quadrics[b].addPlane(bn[0], bn[1], bn[2], d, BoundaryWeight);
+		}
+	}
+
+	std::vector<UINT32> versions(vertexCount, 0);
+	std::vector<char> removed(vertexCount, 0);
+	std::vector<char> alive(triangleCount, 1);
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+	auto pushEdge = [&](UINT32 a, UINT32 b) {
+		Quadric q = quadrics[a];
+		q += quadrics[b];
+		double costAB = q.evaluate(&positions[3 * b]);
+		double costBA = q.evaluate(&positions[3 * a]);
+		if (costAB <= costBA)
+			heap.push({ (std::max)(costAB, 0.0), a, b, versions[a], versions[b] });
+		else
+			heap.push({ (std::max)(costBA, 0.0), b, a, versions[b], versions[a] });
+	};
+	for (const auto& eItem : edgeUse)
+		pushEdge(static_cast<UINT32>(eItem.first >> 32), static_cast<UINT32>(eItem.first & 0xFFFFFFFF));
+
+	auto containsVertex = [&](UINT32 t, UINT32 v) {
+		return corners[3 * t] == v || corners[3 * t + 1] == v || corners[3 * t + 2] == v;
+	};
+	std::vector<UINT32> neighborsFrom, neighborsTo, common;
+	auto gatherNeighbors = [&](UINT32 v, UINT32 exclude, std::vector<UINT32>& neighbors) {
+		neighbors.clear();
+		for (UINT32 t : vertexTriangles[v])
+		{
+			if (!alive[t])
+				continue;
+			for (int k = 0; k < 3; k++)
+				if (corners[3 * t + k] != v && corners[3 * t + k] != exclude)
+					neighbors.push_back(corners[3 * t + k]);
+		}
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	};
+
+	auto canCollapse = [&](UINT32 from, UINT32 to) {
+		size_t shared = 0;
+		for (UINT32 t : vertexTriangles[from])
+		{
+			if (!alive[t])
+				continue;
+			if (containsVertex(t, to))
+			{
+				shared++;
+				continue;
+			}
+			// The triangle keeps its orientation and area once "from" moves onto "to"
+			const double* p[3];
+			const double* q[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = &positions[3 * corners[3 * t + k]];
+				q[k] = corners[3 * t + k] == from ? &positions[3 * to] : p[k];
+			}
+			double before[3], after[3];
+			triangleNormal(p[0], p[1], p[2], before);
+			triangleNormal(q[0], q[1], q[2], after);
+			double lenBefore = length(before), lenAfter = length(after);
+			if (lenAfter == 0.0 || (lenBefore > 0.0 && dot(before, after) < MinNormalCosine * lenBefore * lenAfter))
+				return false;
+		}
+		if (shared == 0)
+			return false;
+		// Link condition: the only common neighbors are the apexes of the shared triangles
+		gatherNeighbors(from, to, neighborsFrom);
+		gatherNeighbors(to, from, neighborsTo);
+		common.clear();
+		std::set_intersection(neighborsFrom.begin(), neighborsFrom.end(), neighborsTo.begin(), neighborsTo.end(),
+			std::back_inserter(common));
+		return common.size() <= shared;
+	};
+
+	size_t liveTriangles = triangleCount;
+	double maxCost = 0.0;
+	while (liveTriangles > targetTriangles && !heap.empty())
+	{
+		Candidate c = heap.top();
+		heap.pop();
+		if (removed[c.from] || removed[c.to] || versions[c.from] != c.fromVersion || versions[c.to] != c.toVersion)
+			continue;
+		if (!canCollapse(c.from, c.to))
+			continue;
+
+		auto& keptTriangles = vertexTriangles[c.to];
+		for (UINT32 t : vertexTriangles[c.from])
+		{
+			if (!alive[t])
+				continue;
+			if (containsVertex(t, c.to))
+			{
+				alive[t] = 0;
+				liveTriangles--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				if (corners[3 * t + k] != c.from)
+					continue;
+				corners[3 * t + k] = c.to;
+				if (normalsFollow)
+					normalCorners[3 * t + k] = static_cast<INT32>(c.to);
+				if (texCoordsFollow)
+					texCoordCorners[3 * t + k] = static_cast<INT32>(c.to);
+			}
+			keptTriangles.push_back(t);
+		}
+		keptTriangles.erase(std::remove_if(keptTriangles.begin(), keptTriangles.end(),
+			[&](UINT32 t) { return !alive[t]; }), keptTriangles.end());
+		std::vector<UINT32>().swap(vertexTriangles[c.from]);
+		quadrics[c.to] += quadrics[c.from];
+		removed[c.from] = 1;
+		versions[c.to]++;
+		maxCost = (std::max)(maxCost, c.cost);
+
+		gatherNeighbors(c.to, c.to, neighborsTo);
+		for (UINT32 w : neighborsTo)
+			pushEdge(c.to, w);
+	}
+
+	// Emit the remaining triangles and drop unreferenced attributes
+	result = WMeshData();
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (!alive[t])
+			continue;
+		for (int k = 0; k < 3; k++)
+		{
+			result.indices.push_back(corners[3 * t + k]);
+			if (!normalCorners.empty())
+				result.normalIndices.push_back(normalCorners[3 * t + k]);
+			if (!texCoordCorners.empty())
+				result.texCoordIndices.push_back(texCoordCorners[3 * t + k]);
+		}
+		if (mesh.hasMaterialIds())
+			result.materialIds.push_back(mesh.materialIds[t]);
+	}
+	result.materialNames = mesh.materialNames;
+	compactStream(result.indices, mesh.vertices, 3, result.vertices);
+	compactStream(result.normalIndices, mesh.normals, 3, result.normals);
+	compactStream(result.texCoordIndices, mesh.texCoords, 2, result.texCoords);
+
+	stats.trianglesAfter = liveTriangles;
+	stats.maxError = std::sqrt(maxCost) / diagonalLength;
+	return stats;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <windows.h>
+#include "WMeshData.h"
+
+// Quadric error metric simplification (Garland and Heckbert), used to build LOD chains
+
+struct WSimplifyStats
+{
+	size_t trianglesBefore = 0;
+	size_t trianglesAfter = 0;
+	double maxError = 0.0;     // Square root of the largest collapse error, relative to the bounding box diagonal
+};
+
+// Collapses edges in order of quadric error until at most "targetTriangles" remain or no
+// valid collapse is left. Each collapse moves one endpoint onto the other, so attributes
+// never need to be interpolated. Open boundaries, which include attribute seams of welded
+// meshes, and edges between materials are held in place by extra boundary planes.
+// Collapses that would flip a triangle or make the surface non-manifold are skipped.
+// Must run before quantizeMeshAttributes.
+WSimplifyStats simplifyMesh(const WMeshData& mesh, size_t targetTriangles, WMeshData& result);
@@ -0,0 +1,341 @@
+#include "WObjReader.h"
+#include "WMappedFile.h"
+#include "WThreadPool.h"
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	// Chunks smaller than this are not worth a task
+	const UINT64 MinChunkSize = 1 << 20;
+
+	struct ObjChunk
+	{
+		std::vector<tinyobj::real_t> vertices;
+		std::vector<tinyobj::real_t> normals;
+		std::vector<tinyobj::real_t> texCoords;
+		// Indices are zero-based; relative ones are stored relative to the chunk start
+		// and listed in the fixup arrays until the chunk base is known
+		std::vector<INT32> indices;
+		std::vector<INT32> normalIndices;
+		std::vector<INT32> texCoordIndices;
+		std::vector<size_t> vertexFixups;
+		std::vector<size_t> normalFixups;
+		std::vector<size_t> texCoordFixups;
+		// usemtl names in order of appearance; triangles before the first one (-1)
+		// continue the material the previous chunk ended with
+		std::vector<std::string> materialNames;
+		std::vector<INT32> materialIds;
+		UINT64 errorOffset = 0;
+		std::string error;
+	};
+
+	struct FaceCorner
+	{
+		INT32 v, t, n;
+		bool vRelative, tRelative, nRelative;
+	};
+
+	inline const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+			++p;
+		return p;
+	}
+
+	inline const char* nextLine(const char* p, const char* end)
+	{
+		const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+		return eol ? eol + 1 : end;
+	}
+
+	inline bool parseReal(const char*& p, const char* end, tinyobj::real_t& value)
+	{
+		p = skipSpaces(p, end);
+		if (p < end && *p == '+')
+			++p;
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc())
+			return false;
+		p = result.ptr;
+		return true;
+	}
+
+	// Reads up to "count" reals, stops early at the end of the line
+	inline int parseReals(const char*& p, const char* end, tinyobj::real_t* values, int count)
+	{
+		int n = 0;
+		while (n < count && parseReal(p, end, values[n]))
+			n++;
+		return n;
+	}
+
+	// Converts an OBJ index (1-based or negative) to a zero-based one.
+	// Negative indices are resolved against the number of elements parsed so far in this chunk.
+	inline bool parseIndex(const char*& p, const char* end, size_t localCount, INT32& index, bool& relative)
+	{
+		int value = 0;
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc() || value == 0)
+			return false;
+		p = result.ptr;
+		relative = value < 0;
+		index = relative ? static_cast<INT32>(localCount) + value : value - 1;
+		return true;
+	}
+
+	void parseChunk(const char* begin, const char* end, const char* fileBegin, ObjChunk& chunk)
+	{
+		std::vector<FaceCorner> corners;
+		tinyobj::real_t values[4];
+		INT32 currentMaterial = -1;
+		for (const char* line = begin; line < end; line = nextLine(line, end))
+		{
+			const char* p = skipSpaces(line, end);
+			if (p + 1 >= end)
+				continue;
+
+			if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				p += 2;
+				if (parseReals(p, end, values, 3) != 3)
+				{
+					chunk.error = "invalid vertex";
+					chunk.errorOffset = line - fileBegin;
+					return;
+				}
+				chunk.vertices.insert(chunk.vertices.end(), values, values + 3);
+			}
+			else if (p[0] == 'v' && p[1] == 'n')
+			{
+				p += 2;
+				if (parseReals(p, end, values, 3) != 3)
+				{
+					chunk.error = "invalid normal";
+					chunk.errorOffset = line - fileBegin;
+					return;
+				}
+				chunk.normals.insert(chunk.normals.end(), values, values + 3);
+			}
+			else if (p[0] == 'v' && p[1] == 't')
+			{
+				p += 2;
+				// A missing v coordinate defaults to 0 like in tiny_obj_loader
+				values[1] = 0.0f;
+				if (parseReals(p, end, values, 2) < 1)
+				{
+					chunk.error = "invalid texcoord";
+					chunk.errorOffset = line - fileBegin;
+					return;
+				}
+				chunk.texCoords.insert(chunk.texCoords.end(), values, values + 2);
+			}
+			else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				p += 2;
+				corners.clear();
+				for (;;)
+				{
+					p = skipSpaces(p, end);
+					if (p >= end || *p == '\n' || *p == '#')
+						break;
+					FaceCorner c = { -1, -1, -1, false, false, false };
+					bool valid = parseIndex(p, end, chunk.vertices.size() / 3, c.v, c.vRelative);
+					if (valid && p < end && *p == '/')
+					{
+						++p;
+						if (p < end && *p != '/')
+							valid = parseIndex(p, end, chunk.texCoords.size() / 2, c.t, c.tRelative);
+						if (valid && p < end && *p == '/')
+						{
+							++p;
+							valid = parseIndex(p, end, chunk.normals.size() / 3, c.n, c.nRelative);
+						}
+					}
+					if (!valid)
+					{
+						chunk.error = "invalid face index";
+						chunk.errorOffset = line - fileBegin;
+						return;
+					}
+					corners.push_back(c);
+				}
+
+				// Fan triangulation (0, k, k+1)
+				for (size_t k = 1; k + 1 < corners.size(); k++)
+				{
+					chunk.materialIds.push_back(currentMaterial);
+					const FaceCorner* triangle[3] = { &corners[0], &corners[k], &corners[k + 1] };
+					for (const FaceCorner* c : triangle)
+					{
+						if (c->vRelative) chunk.vertexFixups.push_back(chunk.indices.size());
+						if (c->nRelative) chunk.normalFixups.push_back(chunk.normalIndices.size());
+						if (c->tRelative) chunk.texCoordFixups.push_back(chunk.texCoordIndices.size());
+						chunk.indices.push_back(c->v);
+						chunk.normalIndices.push_back(c->n);
+						chunk.texCoordIndices.push_back(c->t);
+					}
+				}
+			}
+			else if (end - p > 7 && memcmp(p, "usemtl", 6) == 0 && (p[6] == ' ' || p[6] == '\t'))
+			{
+				const char* nameBegin = skipSpaces(p + 7, end);
+				const char* nameEnd = nextLine(nameBegin, end);
+				while (nameEnd > nameBegin && (nameEnd[-1] == '\n' || nameEnd[-1] == '\r' || nameEnd[-1] == ' ' || nameEnd[-1] == '\t'))
+					--nameEnd;
+				std::string name(nameBegin, nameEnd);
+				auto it = std::find(chunk.materialNames.begin(), chunk.materialNames.end(), name);
+				currentMaterial = static_cast<INT32>(it - chunk.materialNames.begin());
+				if (it == chunk.materialNames.end())
+					chunk.materialNames.push_back(std::move(name));
+			}
+		}
+	}
+}
+
+bool readObjFast(const std::string& filename, WMeshData& mesh, std::string& message)
+{
+	WMappedFile file;
+	if (!file.Open(filename))
+	{
+		message = "Cannot open file [" + filename + "]\n";
+		return false;
+	}
+	const char* fileBegin = file.data();
+	const char* fileEnd = fileBegin + file.size();
+
+	// Split into line-aligned chunks, a few per worker for load balancing
+	UINT64 numTasks = 4 * (static_cast<UINT64>(WThreadPool::global().size()) + 1);
+	UINT64 chunkSize = (std::max)(MinChunkSize, file.size() / numTasks + 1);
+	std::vector<const char*> boundaries;
+	boundaries.push_back(fileBegin);
+	while (boundaries.back() < fileEnd)
+	{
+		const char* next = boundaries.back() + std::min<UINT64>(chunkSize, fileEnd - boundaries.back());
+		boundaries.push_back(next < fileEnd ? nextLine(next, fileEnd) : fileEnd);
+	}
+	size_t numChunks = boundaries.size() - 1;
+
+	std::vector<ObjChunk> chunks(numChunks);
+	WThreadPool::global().parallelFor(numChunks, [&](size_t i) {
+		parseChunk(boundaries[i], boundaries[i + 1], fileBegin, chunks[i]);
+	});
+	for (const auto& chunk : chunks)
+	{
+		if (!chunk.error.empty())
+		{
+			message = filename + ": " + chunk.error + " at byte " + std::to_string(chunk.errorOffset) + "\n";
+			return false;
+		}
+	}
+
+	// Prefix sums give every chunk its slice of the merged buffers and the
+	// element counts relative indices have to be rebased on
+	struct ChunkBase
+	{
+		size_t vertex;
+		size_t normal;
+		size_t texCoord;
+		size_t index;
+	};
+	std::vector<ChunkBase> bases(numChunks + 1);
+	bases[0] = { 0, 0, 0, 0 };
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		bases[i + 1].vertex = bases[i].vertex + chunks[i].vertices.size();
+		bases[i + 1].normal = bases[i].normal + chunks[i].normals.size();
+		bases[i + 1].texCoord = bases[i].texCoord + chunks[i].texCoords.size();
+		bases[i + 1].index = bases[i].index + chunks[i].indices.size();
+	}
+	const auto& total = bases[numChunks];
+
+	// Chunk material slots to file-wide ones, resolved in file order
+	std::vector<std::vector<UINT32>> chunkMaterials(numChunks);
+	std::vector<UINT32> inheritedMaterial(numChunks);
+	UINT32 lastMaterial = 0;
+	mesh.materialNames.assign(1, "");
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		inheritedMaterial[i] = lastMaterial;
+		for (const auto& name : chunks[i].materialNames)
+		{
+			auto it = std::find(mesh.materialNames.begin(), mesh.materialNames.end(), name);
+			chunkMaterials[i].push_back(static_cast<UINT32>(it - mesh.materialNames.begin()));
+			if (it == mesh.materialNames.end())
+				mesh.materialNames.push_back(name);
+		}
+		for (auto id = chunks[i].materialIds.rbegin(); id != chunks[i].materialIds.rend(); ++id)
+		{
+			if (*id >= 0)
+			{
+				lastMaterial = chunkMaterials[i][*id];
+				break;
+			}
+		}
+	}
+	// A single material needs no per-triangle slots
+	std::vector<char> materialUsed(mesh.materialNames.size(), 0);
+	for (size_t i = 0; i < numChunks; i++)
+		for (INT32 id : chunks[i].materialIds)
+			materialUsed[id < 0 ? inheritedMaterial[i] : chunkMaterials[i][id]] = 1;
+	bool multiMaterial = std::count(materialUsed.begin(), materialUsed.end(), 1) > 1;
+	if (!multiMaterial)
+		mesh.materialNames.clear();
+	mesh.materialIds.resize(multiMaterial ? total.index / 3 : 0);
+
+	mesh.vertices.resize(total.vertex);
+	mesh.normals.resize(total.normal);
+	mesh.texCoords.resize(total.texCoord);
+	mesh.indices.resize(total.index);
+	mesh.normalIndices.resize(total.index);
+	mesh.texCoordIndices.resize(total.index);
+
+	std::vector<char> invalidIndex(numChunks, 0);
+	WThreadPool::global().parallelFor(numChunks, [&](size_t i) {
+		const auto& chunk = chunks[i];
+		const auto& base = bases[i];
+		std::copy(chunk.vertices.begin(), chunk.vertices.end(), mesh.vertices.begin() + base.vertex);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + base.normal);
+		std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), mesh.texCoords.begin() + base.texCoord);
+		std::copy(chunk.indices.begin(), chunk.indices.end(), mesh.indices.begin() + base.index);
+		std::copy(chunk.normalIndices.begin(), chunk.normalIndices.end(), mesh.normalIndices.begin() + base.index);
+		std::copy(chunk.texCoordIndices.begin(), chunk.texCoordIndices.end(), mesh.texCoordIndices.begin() + base.index);
+		for (size_t f : chunk.vertexFixups)
+			mesh.indices[base.index + f] = static_cast<UINT32>(chunk.indices[f] + static_cast<INT32>(base.vertex / 3));
+		for (size_t f : chunk.normalFixups)
+			mesh.normalIndices[base.index + f] = chunk.normalIndices[f] + static_cast<INT32>(base.normal / 3);
+		for (size_t f : chunk.texCoordFixups)
+			mesh.texCoordIndices[base.index + f] = chunk.texCoordIndices[f] + static_cast<INT32>(base.texCoord / 2);
+		// Indices past the elements of the file would be read by every later pass
+		const UINT32 vertexCount = static_cast<UINT32>(total.vertex / 3);
+		const INT32 normalCount = static_cast<INT32>(total.normal / 3);
+		const INT32 texCoordCount = static_cast<INT32>(total.texCoord / 2);
+		for (size_t k = base.index; k < base.index + chunk.indices.size(); k++)
+		{
+			if (mesh.indices[k] >= vertexCount || mesh.normalIndices[k] < -1 || mesh.normalIndices[k] >= normalCount ||
+				mesh.texCoordIndices[k] < -1 || mesh.texCoordIndices[k] >= texCoordCount)
+			{
+				invalidIndex[i] = 1;
+				break;
+			}
+		}
+		if (!multiMaterial)
+			return;
+		for (size_t t = 0; t < chunk.materialIds.size(); t++)
+		{
+			INT32 id = chunk.materialIds[t];
+			mesh.materialIds[base.index / 3 + t] = id < 0 ? inheritedMaterial[i] : chunkMaterials[i][id];
+		}
+	});
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		if (invalidIndex[i])
+		{
+			message = filename + ": face index out of range after byte " + std::to_string(boundaries[i] - fileBegin) + "\n";
+			mesh = WMeshData();
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+#include "WMeshData.h"
+
+// Fast OBJ reader for large scanned meshes.
+// The file is memory-mapped and split into line-aligned chunks that are parsed in
+// parallel; only "v", "vn", "vt", "f" and "usemtl" records are read, everything else is skipped.
+// Files switching materials get per-triangle material slots named after their usemtl records.
+// Polygons are fan-triangulated and negative (relative) indices are supported.
+// The result has the same layout tiny_obj_loader + getIndicesFromStructShape produce,
+// missing normals are left empty for the caller to generate.
+bool readObjFast(const std::string& filename, WMeshData& mesh, std::string& message);
@@ -0,0 +1,240 @@
+#include "WSceneCache.h"
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+namespace
+{
+	// Every section starts on a cache line so mapped buffers are suitably aligned
+	const UINT64 SectionAlignment = 64;
+
+	inline UINT64 alignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	const UINT64 NotReserved = ~0ull;
+}
+
+void WCacheBlob::writeString(const std::string& str)
+{
+	writePod(static_cast<UINT32>(str.size()));
+	mBytes.insert(mBytes.end(), str.begin(), str.end());
+}
+
+void WCacheBlob::writeWString(const std::wstring& str)
+{
+	writePod(static_cast<UINT32>(str.size()));
+	const char* p = reinterpret_cast<const char*>(str.data());
+	mBytes.insert(mBytes.end(), p, p + str.size() * sizeof(wchar_t));
+}
+
+bool WCacheCursor::readString(std::string& str)
+{
+	UINT32 length = 0;
+	if (!readPod(length) || static_cast<UINT64>(mEnd - mData) < length)
+		return mValid = false;
+	str.assign(mData, length);
+	mData += length;
+	return true;
+}
+
+bool WCacheCursor::readWString(std::wstring& str)
+{
+	UINT32 length = 0;
+	if (!readPod(length) || static_cast<UINT64>(mEnd - mData) < length * sizeof(wchar_t))
+		return mValid = false;
+	str.resize(length);
+	memcpy(&str[0], mData, length * sizeof(wchar_t));
+	mData += length * sizeof(wchar_t);
+	return true;
+}
+
+WSceneCacheWriter::~WSceneCacheWriter()
+{
+	if (!isStreaming())
+		return;
+	mStream.close();
+	std::error_code ec;
+	std::filesystem::remove(mStreamFilename + ".tmp", ec);
+}
+
+void WSceneCacheWriter::addSection(UINT32 id, const void* data, UINT64 size)
+{
+	mSections.push_back({ id, data, size, -1, NotReserved });
+}
+
+WCacheBlob& WSceneCacheWriter::addBlob(UINT32 id)
+{
+	mBlobs.push_back(std::make_unique<WCacheBlob>());
+	mSections.push_back({ id, nullptr, 0, static_cast<int>(mBlobs.size() - 1), NotReserved });
+	return *mBlobs.back();
+}
+
+bool WSceneCacheWriter::beginStreaming(const std::string& filename)
+{
+	mStreamFilename = filename;
+	mStream.open(filename + ".tmp", std::ios::binary | std::ios::trunc);
+	mStreamEnd = alignUp(sizeof(WSceneCacheHeader) + MaxStreamedSections * sizeof(WSceneCacheSection), SectionAlignment);
+	return isStreaming();
+}
+
+void WSceneCacheWriter::reserveSection(UINT32 id, UINT64 size)
+{
+	mSections.push_back({ id, nullptr, size, -1, mStreamEnd });
+	mStreamEnd = alignUp(mStreamEnd + size, SectionAlignment);
+}
+
+bool WSceneCacheWriter::writeReserved(UINT32 id, UINT64 offset, const void* data, UINT64 size)
+{
+	for (const auto& s : mSections)
+	{
+		if (s.id != id || s.reservedOffset == NotReserved)
+			continue;
+		if (offset > s.size || size > s.size - offset)
+			return false;
+		mStream.seekp(static_cast<std::streamoff>(s.reservedOffset + offset));
+		mStream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		return static_cast<bool>(mStream);
+	}
+	return false;
+}
+
+bool WSceneCacheWriter::Write(const std::string& filename, UINT64 sceneHash)
+{
+	const bool streamed = isStreaming();
+	if (streamed && mSections.size() > MaxStreamedSections)
+		return false;
+	WSceneCacheHeader header = {};
+	header.Magic = WSceneCacheMagic;
+	header.Version = WSceneCacheVersion;
+	header.SceneHash = sceneHash;
+	header.SectionCount = static_cast<UINT32>(mSections.size());
+
+	// Lay out all sections before writing anything, streamed ones are in place already and the
+	// others follow them
+	std::vector<WSceneCacheSection> table(mSections.size());
+	UINT64 offset = streamed ? mStreamEnd :
+		alignUp(sizeof(WSceneCacheHeader) + table.size() * sizeof(WSceneCacheSection), SectionAlignment);
+	for (size_t i = 0; i < mSections.size(); i++)
+	{
+		auto& s = mSections[i];
+		if (s.blobIdx >= 0)
+		{
+			const auto& bytes = mBlobs[s.blobIdx]->bytes();
+			s.data = bytes.data();
+			s.size = bytes.size();
+		}
+		table[i].Id = s.id;
+		table[i].Pad = 0;
+		table[i].Size = s.size;
+		if (s.reservedOffset != NotReserved)
+		{
+			table[i].Offset = s.reservedOffset;
+			continue;
+		}
+		table[i].Offset = offset;
+		offset = alignUp(offset + s.size, SectionAlignment);
+	}
+
+	const std::string cacheFilename = streamed ? mStreamFilename : filename;
+	std::string tmpFilename = cacheFilename + ".tmp";
+	{
+		std::ofstream file;
+		if (!streamed)
+			file.open(tmpFilename, std::ios::binary | std::ios::trunc);
+		std::ofstream& out = streamed ? mStream : file;
+		if (!out)
+			return false;
+		// Padding up to every section, so the file reaches the offset of empty ones too
+		const char padding[SectionAlignment] = {};
+		out.seekp(0, std::ios::end);
+		UINT64 written = static_cast<UINT64>(out.tellp());
+		for (size_t i = 0; i < mSections.size(); i++)
+		{
+			if (mSections[i].reservedOffset != NotReserved)
+				continue;
+			for (UINT64 pad = table[i].Offset - written; pad > 0; pad -= (std::min)(pad, SectionAlignment))
+				out.write(padding, static_cast<std::streamsize>((std::min)(pad, SectionAlignment)));
+			if (mSections[i].size > 0)
+				out.write(static_cast<const char*>(mSections[i].data), static_cast<std::streamsize>(mSections[i].size));
+			written = table[i].Offset + mSections[i].size;
+		}
+		// The header and table go in last, in front of the sections
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(WSceneCacheSection));
+		if (!out)
+			return false;
+		out.close();
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpFilename, cacheFilename, ec);
+	if (ec)
+	{
+		std::filesystem::remove(tmpFilename, ec);
+		return false;
+	}
+	return true;
+}
+
+bool WSceneCacheReader::Open(const std::string& filename)
+{
+	Close();
+	if (!mFile.Open(filename))
+		return false;
+	if (mFile.size() < sizeof(WSceneCacheHeader))
+	{
+		Close();
+		return false;
+	}
+	memcpy(&mHeader, mFile.data(), sizeof(WSceneCacheHeader));
+	UINT64 tableEnd = sizeof(WSceneCacheHeader) + static_cast<UINT64>(mHeader.SectionCount) * sizeof(WSceneCacheSection);
+	if (mHeader.Magic != WSceneCacheMagic || mHeader.Version != WSceneCacheVersion || tableEnd > mFile.size())
+	{
+		Close();
+		return false;
+	}
+	mSections = reinterpret_cast<const WSceneCacheSection*>(mFile.data() + sizeof(WSceneCacheHeader));
+	for (UINT32 i = 0; i < mHeader.SectionCount; i++)
+	{
+		if (mSections[i].Offset > mFile.size() || mSections[i].Size > mFile.size() - mSections[i].Offset)
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void WSceneCacheReader::Close()
+{
+	mFile.Close();
+	mHeader = {};
+	mSections = nullptr;
+}
+
+bool WSceneCacheReader::section(UINT32 id, const char*& data, UINT64& size) const
+{
+	for (UINT32 i = 0; i < mHeader.SectionCount; i++)
+	{
+		if (mSections[i].Id == id)
+		{
+			data = mFile.data() + mSections[i].Offset;
+			size = mSections[i].Size;
+			return true;
+		}
+	}
+	return false;
+}
+
+WCacheCursor WSceneCacheReader::cursor(UINT32 id) const
+{
+	const char* data = nullptr;
+	UINT64 size = 0;
+	// A missing section yields an empty cursor, which fails on the first read
+	if (!section(id, data, size))
+		return WCacheCursor();
+	return WCacheCursor(data, size);
+}
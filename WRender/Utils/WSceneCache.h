@@ -0,0 +1,196 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <fstream>
+#include "WMappedFile.h"
+
+// Non-owning view over a contiguous buffer.
+// Points either into a std::vector owned by the parser or into a mapped scene cache.
+template<typename T>
+class WBufferView
+{
+public:
+	WBufferView() = default;
+	WBufferView(const T* data, size_t size) : mData(data), mSize(size) {}
+	WBufferView(const std::vector<T>& buffer) : mData(buffer.data()), mSize(buffer.size()) {}
+
+	const T* data() const { return mData; }
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+	const T* begin() const { return mData; }
+	const T* end() const { return mData + mSize; }
+	const T& operator[](size_t i) const { return mData[i]; }
+private:
+	const T* mData = nullptr;
+	size_t mSize = 0;
+};
+
+// Bump whenever the layout of any section changes
+static const UINT32 WSceneCacheMagic = 0x4E435357; // "WSCN"
+static const UINT32 WSceneCacheVersion = 9;
+
+enum WSCENE_CACHE_SECTION : UINT32
+{
+	CACHE_DEPENDENCIES = 0,
+	CACHE_VERTEX_BUFFER,
+	CACHE_NORMAL_BUFFER,
+	CACHE_TEXCOORD_BUFFER,
+	CACHE_INDEX_BUFFER,
+	CACHE_NORMAL_INDEX_BUFFER,
+	CACHE_TEXCOORD_INDEX_BUFFER,
+	CACHE_GEOMETRY_RECORDS,
+	CACHE_MATERIAL_RECORDS,
+	CACHE_TEXTURE_RECORDS,
+	CACHE_RENDER_ITEMS,
+	CACHE_LIGHTS,
+	CACHE_CAMERA,
+	CACHE_PACKED_NORMAL_BUFFER,
+	CACHE_PACKED_TEXCOORD_BUFFER,
+	CACHE_INSTANCE_BATCHES,
+	CACHE_INSTANCE_TRANSFORMS,
+	CACHE_INSTANCE_BATCH_IDS,
+	CACHE_MATERIAL_ID_BUFFER,
+	CACHE_TRANSFORM_NODES,
+	CACHE_ANIMATIONS,
+	CACHE_INCLUDES,
+	CACHE_VERTEX_ATTRIBUTE_BUFFER,
+	CACHE_PACKED_VERTEX_ATTRIBUTE_BUFFER
+};
+
+struct WSceneCacheHeader
+{
+	UINT32 Magic;
+	UINT32 Version;
+	UINT64 SceneHash;      // Content hash of the scene XML
+	UINT32 SectionCount;
+	UINT32 Pad;
+};
+
+struct WSceneCacheSection
+{
+	UINT32 Id;
+	UINT32 Pad;
+	UINT64 Offset;         // From the beginning of the file
+	UINT64 Size;           // In bytes
+};
+
+// Growable byte blob for small, non-POD records (materials, render items, ...)
+class WCacheBlob
+{
+public:
+	template<typename T>
+	void writePod(const T& value)
+	{
+		const char* p = reinterpret_cast<const char*>(&value);
+		mBytes.insert(mBytes.end(), p, p + sizeof(T));
+	}
+	void writeString(const std::string& str);
+	void writeWString(const std::wstring& str);
+	const std::vector<char>& bytes() const { return mBytes; }
+private:
+	std::vector<char> mBytes;
+};
+
+// Bounds-checked reader over a section written through WCacheBlob
+class WCacheCursor
+{
+public:
+	WCacheCursor() = default;
+	WCacheCursor(const char* data, UINT64 size) : mData(data), mEnd(data + size) {}
+
+	template<typename T>
+	bool readPod(T& value)
+	{
+		if (!mValid || static_cast<UINT64>(mEnd - mData) < sizeof(T))
+			return mValid = false;
+		memcpy(&value, mData, sizeof(T));
+		mData += sizeof(T);
+		return true;
+	}
+	bool readString(std::string& str);
+	bool readWString(std::wstring& str);
+	bool valid() const { return mValid; }
+private:
+	const char* mData = nullptr;
+	const char* mEnd = nullptr;
+	bool mValid = true;
+};
+
+class WSceneCacheWriter
+{
+public:
+	// Room for the section table of a streamed cache, which is written last
+	static const UINT32 MaxStreamedSections = 64;
+
+	WSceneCacheWriter() = default;
+	WSceneCacheWriter(const WSceneCacheWriter& rhs) = delete;
+	WSceneCacheWriter& operator=(const WSceneCacheWriter& rhs) = delete;
+	// Removes the temporary file of a stream Write() never finished
+	~WSceneCacheWriter();
+
+	// Raw sections are only referenced and must stay alive until Write() returns
+	void addSection(UINT32 id, const void* data, UINT64 size);
+	template<typename T>
+	void addSection(UINT32 id, const std::vector<T>& buffer)
+	{
+		addSection(id, buffer.data(), buffer.size() * sizeof(T));
+	}
+	WCacheBlob& addBlob(UINT32 id);
+
+	// Sections too large to hold in memory are streamed: beginStreaming() creates the file,
+	// reserveSection() places a section of known size in it and writeReserved() fills that a
+	// piece at a time. Write() then adds the other sections and the table.
+	bool beginStreaming(const std::string& filename);
+	bool isStreaming() const { return mStream.is_open(); }
+	void reserveSection(UINT32 id, UINT64 size);
+	bool writeReserved(UINT32 id, UINT64 offset, const void* data, UINT64 size);
+
+	// Writes to a temporary file first and renames it, so a crash never leaves a torn cache behind.
+	// A streamed cache is written to the file given to beginStreaming().
+	bool Write(const std::string& filename, UINT64 sceneHash);
+private:
+	struct PendingSection
+	{
+		UINT32 id;
+		const void* data;
+		UINT64 size;
+		int blobIdx;
+		// In the file already, at this offset, when streamed
+		UINT64 reservedOffset;
+	};
+	std::vector<PendingSection> mSections;
+	std::vector<std::unique_ptr<WCacheBlob>> mBlobs;
+	std::string mStreamFilename;
+	std::ofstream mStream;
+	// End of the last reserved section
+	UINT64 mStreamEnd = 0;
+};
+
+class WSceneCacheReader
+{
+public:
+	bool Open(const std::string& filename);
+	void Close();
+
+	UINT64 sceneHash() const { return mHeader.SceneHash; }
+	bool section(UINT32 id, const char*& data, UINT64& size) const;
+	WCacheCursor cursor(UINT32 id) const;
+
+	// Zero-copy view into the mapped file
+	template<typename T>
+	WBufferView<T> view(UINT32 id) const
+	{
+		const char* data = nullptr;
+		UINT64 size = 0;
+		if (!section(id, data, size))
+			return WBufferView<T>();
+		return WBufferView<T>(reinterpret_cast<const T*>(data), static_cast<size_t>(size / sizeof(T)));
+	}
+private:
+	WMappedFile mFile;
+	WSceneCacheHeader mHeader = {};
+	const WSceneCacheSection* mSections = nullptr;
+};
@@ -1,464 +1,1785 @@
 #include "WSceneDescParser.h"
+#include "WHash.h"
+#include "WObjReader.h"
+#include "WMeshOptimizer.h"
+#include "WMeshSimplifier.h"
+#include "WMappedFile.h"
+#include "WVertexCodec.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <set>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <../Include/tiny_obj_loader.h>
 
+namespace
+{
+	// Reads the text of the current element as floats, a malformed value is reported and
+	// leaves "value" untouched
+	template<typename T>
+	void readFloats(WXmlReader& reader, T& value)
+	{
+		std::string_view text = reader.readText();
+		T parsed;
+		if (parseFloats(text, reinterpret_cast<float*>(&parsed), sizeof(T) / sizeof(float)))
+			value = parsed;
+		else if (!reader.failed())
+			std::cerr << "WSceneDescParser: " << reader.position() << ": expected " << sizeof(T) / sizeof(float)
+				<< " numbers, found \"" << text << "\"" << std::endl;
+	}
+
+	std::string readString(WXmlReader& reader)
+	{
+		return WXmlReader::decode(reader.readText());
+	}
+
+	// <transform> holds either a <transformMatrix> or any of <translation>, <rotation> (degrees) and <scale>
+	DirectX::XMMATRIX parseTransform(WXmlReader& reader, DirectX::XMFLOAT3& translation,
+		DirectX::XMFLOAT3& rotation, DirectX::XMFLOAT3& scaling)
+	{
+		bool hasMatrix = false;
+		DirectX::XMFLOAT4X4 transformF4x4;
+		DirectX::XMStoreFloat4x4(&transformF4x4, DirectX::XMMatrixIdentity());
+		DirectX::XMFLOAT3 t = translation, r = rotation, s = scaling;
+		while (reader.nextChild())
+		{
+			std::string_view name = reader.name();
+			if (name == "transformMatrix")
+			{
+				readFloats(reader, transformF4x4);
+				hasMatrix = true;
+			}
+			else if (name == "translation")
+				readFloats(reader, t);
+			else if (name == "rotation")
+				readFloats(reader, r);
+			else if (name == "scale")
+				readFloats(reader, s);
+			else
+				reader.skip();
+		}
+		if (hasMatrix)
+			return DirectX::XMLoadFloat4x4(&transformF4x4);
+		translation = t;
+		rotation = r;
+		scaling = s;
+		return composeTRS(translation, rotation, scaling);
+	}
+}
+
 
-void WSceneDescParser::Parse(const char* xmlDoc)
+bool WSceneDescParser::Parse(const char* xmlDoc)
 {
-	std::ifstream XMLFileStream(xmlDoc);
-	std::stringstream XMLContentBuffer;
-	XMLContentBuffer << XMLFileStream.rdbuf();
-	std::string XMLContentStr(XMLContentBuffer.str());
-	mXMLParser.Parse(XMLContentStr.c_str());
+	std::string cacheFilename = std::string(xmlDoc) + ".wcache";
+	UINT64 sceneHash = 0;
+	bool hasSceneHash = mUseSceneCache && hashFileContent(xmlDoc, sceneHash);
+	// Options that change the produced buffers are part of the cache key
+	UINT32 pipelineOptions = (mWeldVertices ? 1u : 0u) | (mQuantizeAttributes ? 2u : 0u) | (mReorderForLocality ? 4u : 0u) |
+		(mCleanupMeshes ? 8u : 0u);
+	sceneHash = xxHash64(&pipelineOptions, sizeof(pipelineOptions), sceneHash);
+	sceneHash = xxHash64(&mLodReduction, sizeof(mLodReduction), sceneHash);
+	if (hasSceneHash && loadSceneCache(cacheFilename, sceneHash))
+	{
+		for (const auto& gItem : mGeometryMap)
+			if (!isLodGeometryName(gItem.first))
+				mGeometryFiles.push_back(gItem.first);
+		mLoadedFromCache = true;
+		if (mPagedGeometryBytes > 0)
+			pageGeometry(cacheFilename);
+		return true;
+	}
 
+	if (!parseSceneXML(xmlDoc))
+		return false;
+	// Paged scenes write their geometry straight into the cache as it is flattened instead of
+	// building it in memory first, a cache that cannot be created keeps it in memory
+	WSceneCacheWriter writer;
+	const bool streamGeometry = hasSceneHash && mPagedGeometryBytes > 0 && writer.beginStreaming(cacheFilename);
+	if (!loadGeometry(streamGeometry ? &writer : nullptr))
+		return false;
+	bindBufferViews();
 
-	tinyxml2::XMLHandle docHandle(&mXMLParser);
+	if (hasSceneHash && !saveSceneCache(writer, cacheFilename, sceneHash))
+	{
+		std::cerr << "WSceneDescParser: failed to write scene cache " << cacheFilename << std::endl;
+		// Its geometry only exists in the cache
+		if (streamGeometry)
+			return false;
+	}
+	else if (hasSceneHash && mPagedGeometryBytes > 0)
+		pageGeometry(cacheFilename);
+	return true;
+}
 
-	// Star parsing the root of XML doc ---- "scene"
-	tinyxml2::XMLElement* entry = docHandle.FirstChildElement("scene").ToElement();
+bool WSceneDescParser::pageGeometry(const std::string& cacheFilename)
+{
+	if (!mGeometryPages.Open(cacheFilename, mPagedGeometryBytes))
+	{
+		std::cerr << "WSceneDescParser: cannot page geometry from " << cacheFilename << ", keeping it in memory" << std::endl;
+		return false;
+	}
+	// Everything else was copied out of the mapping while loading
+	mSceneCache.Close();
+	std::vector<tinyobj::real_t>().swap(mVertexBuffer);
+	std::vector<tinyobj::real_t>().swap(mNormalBuffer);
+	std::vector<tinyobj::real_t>().swap(mTexCoordBuffer);
+	std::vector<UINT32>().swap(mPackedNormalBuffer);
+	std::vector<UINT32>().swap(mPackedTexCoordBuffer);
+	std::vector<tinyobj::real_t>().swap(mVertexAttributeBuffer);
+	std::vector<UINT32>().swap(mPackedVertexAttributeBuffer);
+	std::vector<UINT32>().swap(mIndexBuffer);
+	std::vector<INT32>().swap(mNormalIndexBuffer);
+	std::vector<INT32>().swap(mTexCoordIndexBuffer);
+	std::vector<UINT32>().swap(mMaterialIdBuffer);
+	bindBufferViews();
+	return true;
+}
+
+UINT64 WSceneDescParser::memoryBytes() const
+{
+	return mVertexView.size() * sizeof(tinyobj::real_t) + mNormalView.size() * sizeof(tinyobj::real_t) +
+		mTexCoordView.size() * sizeof(tinyobj::real_t) + mPackedNormalView.size() * sizeof(UINT32) +
+		mPackedTexCoordView.size() * sizeof(UINT32) + mVertexAttributeView.size() * sizeof(tinyobj::real_t) +
+		mPackedVertexAttributeView.size() * sizeof(UINT32) + mIndexView.size() * sizeof(UINT32) +
+		mNormalIndexView.size() * sizeof(INT32) + mTexCoordIndexView.size() * sizeof(INT32) +
+		mMaterialIdView.size() * sizeof(UINT32) + mInstanceTable.memoryBytes() + mGeometryPages.residentBytes();
+}
+
+bool WSceneDescParser::ParseDescription(const char* xmlDoc)
+{
+	return parseSceneXML(xmlDoc);
+}
+
+bool WSceneDescParser::parseSceneXML(const char* xmlDoc)
+{
+	// Geometry files are recorded in order of first use and loaded after the XML walk
+	std::map<std::string, size_t> geometryFileIdx;
+	mIncludeStack.assign(1, xmlDoc);
+	mIncludeFailed = false;
+	if (!parseSceneFile(xmlDoc, -1, geometryFileIdx) || mIncludeFailed)
+		return false;
+	mTransformHierarchy.update();
+
+	return true;
+}
+
+bool WSceneDescParser::parseSceneFile(const std::string& sceneFile, INT32 parentNode, std::map<std::string, size_t>& geometryFileIdx)
+{
+	// The document is read in place from the mapping, in a single pass
+	WMappedFile file;
+	if (!file.Open(sceneFile))
+	{
+		std::cerr << "WSceneDescParser: cannot read " << sceneFile << std::endl;
+		return false;
+	}
+	WXmlReader reader(file.data(), static_cast<size_t>(file.size()));
 
-	if (entry)
+	// Star parsing the root of XML doc ---- "scene"
+	bool foundScene = false;
+	while (reader.nextChild())
 	{
-		for (tinyxml2::XMLNode* node = entry->FirstChildElement(); node; node = node->NextSibling())
+		if (foundScene || reader.name() != "scene")
+		{
+			reader.skip();
+			continue;
+		}
+		foundScene = true;
+		while (reader.nextChild())
 		{
-			tinyxml2::XMLElement* e = node->ToElement();
-			if (!e) continue;
-			std::string nodeType(e->Value());
+			std::string_view nodeType = reader.name();
 			if (nodeType == "object")
 			{
-				WRenderItem r;
-				const char* objectName = e->Attribute("name");
-				r.objName = objectName;
-				tinyxml2::XMLNode* materialNode = e->FirstChildElement("Material");
-				if (materialNode)
+				parseObject(reader, parentNode, geometryFileIdx);
+			}
+			else if (nodeType == "group")
+			{
+				parseGroup(reader, parentNode, geometryFileIdx);
+			}
+			else if (nodeType == "include")
+			{
+				parseInclude(reader, parentNode, geometryFileIdx);
+			}
+			else if (nodeType == "Material")
+			{
+				// Materials only referenced by usemtl records of multi-material OBJ files
+				parseMaterial(reader);
+			}
+			else if (nodeType == "instances")
+			{
+				std::string sFilename = WXmlReader::decode(reader.attribute("mesh"));
+				if (sFilename.empty())
 				{
-					tinyxml2::XMLElement* materialElem = materialNode->ToElement();
-					const char* materialName = materialElem->Attribute("name");
-					std::string sMaterialName(materialName);
-					if (mMaterialItems.find(sMaterialName) == mMaterialItems.end())
-					{
-						// Build new material from XML & append to MaterialBuffer
-						WMaterial tmpMatData;
-						tmpMatData.Name = sMaterialName;
-						tinyxml2::XMLElement* transparentElem = materialNode->FirstChildElement("transparent");
-						if (transparentElem)
-						{
-							float transparentVal = std::stof(transparentElem->GetText());
-							tmpMatData.Transparent = transparentVal;
-						}
-						tinyxml2::XMLElement* smoothnessElem = materialNode->FirstChildElement("smoothness");
-						if (smoothnessElem)
-						{
-							float smoothnessVal = std::stof(smoothnessElem->GetText());
-							tmpMatData.Smoothness = smoothnessVal;
-						}
-						tinyxml2::XMLElement* metallicElem = materialNode->FirstChildElement("metallic");
-						if (metallicElem)
-						{
-							float metallicVal = std::stof(metallicElem->GetText());
-							tmpMatData.Metallic = metallicVal;
-						}
-						tinyxml2::XMLElement* albedoElem = materialNode->FirstChildElement("albedo");
-						if (albedoElem)
-						{
-							DirectX::XMFLOAT4 albedoVal = parseFloat4(albedoElem->GetText());
-							tmpMatData.Albedo = albedoVal;
-						}
-						tinyxml2::XMLElement* transColorElem = materialNode->FirstChildElement("transColor");
-						if (transColorElem)
-						{
-							DirectX::XMFLOAT4 transColorVal = parseFloat4(transColorElem->GetText());
-							tmpMatData.TransColor = transColorVal;
-						}
-						tinyxml2::XMLElement* F0Elem = materialNode->FirstChildElement("F0");
-						if (F0Elem)
-						{
-							DirectX::XMFLOAT3 F0Val = parseFloat3(F0Elem->GetText());
-							tmpMatData.F0 = F0Val;
-						}
-						tinyxml2::XMLElement* kElem = materialNode->FirstChildElement("k");
-						if (kElem)
-						{
-							DirectX::XMFLOAT3 kVal = parseFloat3(kElem->GetText());
-							tmpMatData.k = kVal;
-						}
-						tinyxml2::XMLElement* kdElem = materialNode->FirstChildElement("kd");
-						if (kdElem)
-						{
-							DirectX::XMFLOAT3 kdVal = parseFloat3(kdElem->GetText());
-							tmpMatData.kd = kdVal;
-						}
-						tinyxml2::XMLElement* ksElem = materialNode->FirstChildElement("ks");
-						if (ksElem)
-						{
-							DirectX::XMFLOAT3 ksVal = parseFloat3(ksElem->GetText());
-							tmpMatData.ks = ksVal;
-						}
-						tinyxml2::XMLElement* emissionElem = materialNode->FirstChildElement("emission");
-						if (emissionElem)
-						{
-							DirectX::XMFLOAT3 emissionVal = parseFloat3(emissionElem->GetText());
-							tmpMatData.Emission = emissionVal;
-						}
-						tinyxml2::XMLElement* refractiveIndexElem = materialNode->FirstChildElement("refractiveIndex");
-						if (refractiveIndexElem)
-						{
-							float refractiveIndexVal = std::stof(refractiveIndexElem->GetText());
-							tmpMatData.RefractiveIndex = refractiveIndexVal;
-						}
-						tinyxml2::XMLElement* SigmaElem = materialNode->FirstChildElement("Sigma");
-						if (SigmaElem)
-						{
-							float Sigma = std::stof(SigmaElem->GetText());
-							tmpMatData.Sigma = Sigma;
-						}
-						tinyxml2::XMLElement* ShaderElem = materialNode->FirstChildElement("Shader");
-						if (ShaderElem)
-						{
-							std::string ShaderVal = ShaderElem->GetText();
-							tmpMatData.Shader = ShaderVal;
-						}
-
-						tinyxml2::XMLElement* diffuseMapElem = materialNode->FirstChildElement("diffuseMap");
-						if (diffuseMapElem)
-						{
-							std::string textureName = diffuseMapElem->Attribute("name");
-							std::wstring textureFileName = string2wstring(diffuseMapElem->GetText());
-							tmpMatData.DiffuseMapName = textureName;
-							if (mTextureItems.find(textureName) == mTextureItems.end())
-							{
-								WTextureRecord tmpTextureRecord(textureName, textureFileName, mTextureItems.size());
-								tmpTextureRecord.TextureType = DIFFUSE_MAP;
-								tmpMatData.DiffuseMapIdx = tmpTextureRecord.TextureIdx;
-								mTextureItems[textureName] = std::move(tmpTextureRecord);
-							}
-							else
-							{
-								tmpMatData.DiffuseMapIdx = mTextureItems.at(textureName).TextureIdx;
-							}
-						}
-						tinyxml2::XMLElement* normalMapElem = materialNode->FirstChildElement("normalMap");
-						if (normalMapElem)
-						{
-							std::string textureName = normalMapElem->Attribute("name");
-							std::wstring textureFileName = string2wstring(normalMapElem->GetText());
-							tmpMatData.NormalMapName = textureName;
-							if (mTextureItems.find(textureName) == mTextureItems.end())
-							{
-								WTextureRecord tmpTextureRecord(textureName, textureFileName, mTextureItems.size());
-								tmpTextureRecord.TextureType = NORMAL_MAP;
-								tmpMatData.NormalMapIdx = tmpTextureRecord.TextureIdx;
-								mTextureItems[textureName] = std::move(tmpTextureRecord);
-							}
-							else
-							{
-								tmpMatData.NormalMapIdx = mTextureItems.at(textureName).TextureIdx;
-							}
-						}
-						r.materialName = sMaterialName;
-						r.matIdx = mMaterialItems.size();
-						tmpMatData.MatIdx = mMaterialItems.size();
-						mMaterialItems[sMaterialName] = (std::move(tmpMatData));
-					}
-					else
-					{
-						// Direct use the record in materialMap
-						r.materialName = sMaterialName;
-						r.matIdx = mMaterialItems[sMaterialName].MatIdx;
-					}
+					std::cerr << "WSceneDescParser: " << reader.position() << ": <instances> without a mesh attribute" << std::endl;
+					reader.skip();
+					continue;
 				}
-				tinyxml2::XMLNode* meshNode = e->FirstChildElement("Mesh");
-				if (meshNode)
+				if (parseInstances(reader, sFilename) && geometryFileIdx.find(sFilename) == geometryFileIdx.end())
 				{
-					tinyxml2::XMLElement* geometryElem = meshNode->FirstChildElement("geometry");
-					if (geometryElem)
-					{
-						const char* filename = geometryElem->GetText();
-						std::string sFilename(filename);
-						if (mGeometryMap.find(sFilename) == mGeometryMap.end())
-						{
-							// Load obj with the help of 3rdparty library "tiny_obj_loader"
-							tinyobj::ObjReaderConfig reader_config;
-							reader_config.mtl_search_path = "./"; // Path to material files
-
-							tinyobj::ObjReader reader;
-
-							if (!reader.ParseFromFile(filename, reader_config))
-							{
-								if (!reader.Error().empty()) std::cerr << "TinyObjReader: " << reader.Error();
-								exit(1);
-							}
-
-							if (!reader.Warning().empty()) {
-								std::cout << "TinyObjReader: " << reader.Warning();
-							}
-
-							auto& attrib = reader.GetAttrib();
-							auto& shapes = reader.GetShapes();
-							auto& materials = reader.GetMaterials();
-
-							// Fetch vertex data
-							const auto& vertices = attrib.vertices;
-							const auto& normals = attrib.normals;
-							const auto& texcoords = attrib.texcoords;
-							// Fetch index data
-							std::vector<UINT32> indices;
-							std::vector<INT32> normal_indices;
-							std::vector<INT32> texcoord_indices;
-							getIndicesFromStructShape(shapes, indices, normal_indices, texcoord_indices);
-							// Update vertex buffer
-							r.vertexOffsetInBytes = mVertexBuffer.size() * sizeof(tinyobj::real_t);
-							r.vertexCount = vertices.size() / 3; // One vertex is consist of 3 coordinates
-							mVertexBuffer.insert(mVertexBuffer.end(), vertices.begin(), vertices.end());
-							if (normals.size() > 0)
-							{
-								r.normalOffsetInBytes = mNormalBuffer.size() * sizeof(tinyobj::real_t);
-								mNormalBuffer.insert(mNormalBuffer.end(), normals.begin(), normals.end());
-							}
-							else
-							{
-								r.normalOffsetInBytes = mNormalBuffer.size() * sizeof(tinyobj::real_t);
-								std::vector<tinyobj::real_t> generatedNormals;
-								autoGenerateVertexNormals(vertices, indices, generatedNormals);
-								mNormalBuffer.insert(mNormalBuffer.end(), generatedNormals.begin(), generatedNormals.end());
-							}
-							if (texcoords.size() > 0)
-							{
-								r.texCoordOffsetInBytes = mTexCoordBuffer.size() * sizeof(tinyobj::real_t);
-								mTexCoordBuffer.insert(mTexCoordBuffer.end(), texcoords.begin(), texcoords.end());
-							}
-
-							// Update index buffer
-							r.indexOffsetInBytes = mIndexBuffer.size() * sizeof(UINT32);
-							r.indexCount = indices.size();
-							mIndexBuffer.insert(mIndexBuffer.end(), indices.begin(), indices.end());
-							if(normals.size() > 0)
-								mNormalIndexBuffer.insert(mNormalIndexBuffer.end(), normal_indices.begin(), normal_indices.end());
-							else
-								mNormalIndexBuffer.insert(mNormalIndexBuffer.end(), indices.begin(), indices.end());
-							mTexCoordIndexBuffer.insert(mTexCoordIndexBuffer.end(), texcoord_indices.begin(), texcoord_indices.end());
-
-							// Build temp geometry record & store to mGeometryMap
-							WGeometryRecord tempGeometryRecord;
-							tempGeometryRecord.vertexOffsetInBytes = r.vertexOffsetInBytes;
-							tempGeometryRecord.normalOffsetInBytes = r.normalOffsetInBytes;
-							tempGeometryRecord.texCoordOffsetInBytes = r.texCoordOffsetInBytes;
-							tempGeometryRecord.vertexCount = r.vertexCount;
-							tempGeometryRecord.indexOffsetInBytes = r.indexOffsetInBytes;
-							tempGeometryRecord.indexCount = r.indexCount;
-							mGeometryMap[sFilename] = std::move(tempGeometryRecord);
-							r.geometryName = sFilename;
-						}
-						else
-						{
-							// Direct use the record in mGeometryMap
-							const auto& geometryRecord = mGeometryMap[sFilename];
-							r.vertexOffsetInBytes = geometryRecord.vertexOffsetInBytes;
-							r.normalOffsetInBytes = geometryRecord.normalOffsetInBytes;
-							r.texCoordOffsetInBytes = geometryRecord.texCoordOffsetInBytes;
-							r.vertexCount = geometryRecord.vertexCount;
-							r.indexOffsetInBytes = geometryRecord.indexOffsetInBytes;
-							r.indexCount = geometryRecord.indexCount;
-							r.geometryName = sFilename;
-						}
-					}
-					tinyxml2::XMLElement* transformElem = meshNode->FirstChildElement("transform");
-					if (transformElem)
-					{
-						tinyxml2::XMLElement* transformMatrixElem = transformElem->FirstChildElement("transformMatrix");
-						if (transformMatrixElem)
-						{
-							DirectX::XMFLOAT4X4 transformF4x4 = parseFloat4x4(transformElem->GetText());
-							r.transform = DirectX::XMLoadFloat4x4(&transformF4x4);
-						}
-						else
-						{
-							auto& transformF4x4 = MathHelper::Identity4x4();
-							auto& transformMatrix = DirectX::XMLoadFloat4x4(&transformF4x4);
-							tinyxml2::XMLElement* translationElem = transformElem->FirstChildElement("translation");
-							tinyxml2::XMLElement* rotationElem = transformElem->FirstChildElement("rotation");
-							tinyxml2::XMLElement* scalingElem = transformElem->FirstChildElement("scale");
-							if (translationElem)
-							{
-								auto& transFloat3 = parseFloat3(translationElem->GetText());
-								r.translation = transFloat3;
-								auto& transVector = DirectX::XMLoadFloat3(&transFloat3);
-								auto& T = DirectX::XMMatrixTranslationFromVector(transVector);
-								transformMatrix = DirectX::XMMatrixMultiply(T, transformMatrix);
-							}
-							if (rotationElem)
-							{
-								using DirectX::XM_PI;
-								auto& rotFloat3 = parseFloat3(rotationElem->GetText());
-								r.rotation = rotFloat3;
-								auto& Rx = DirectX::XMMatrixRotationX(rotFloat3.x * XM_PI / 180.0f);
-								transformMatrix = DirectX::XMMatrixMultiply(Rx, transformMatrix);
-								auto& Ry = DirectX::XMMatrixRotationY(rotFloat3.y * XM_PI / 180.0f);
-								transformMatrix = DirectX::XMMatrixMultiply(Ry, transformMatrix);
-								auto& Rz = DirectX::XMMatrixRotationZ(rotFloat3.z * XM_PI / 180.0f);
-								transformMatrix = DirectX::XMMatrixMultiply(Rz, transformMatrix);
-							}
-							if (scalingElem)
-							{
-								auto& scaleFloat3 = parseFloat3(scalingElem->GetText());
-								r.scaling = scaleFloat3;
-								auto& scaleVector = DirectX::XMLoadFloat3(&scaleFloat3);
-								auto& S = DirectX::XMMatrixScalingFromVector(scaleVector);
-								transformMatrix = DirectX::XMMatrixMultiply(S, transformMatrix);
-							}
-							r.transform = transformMatrix;
-						}
-					}
+					geometryFileIdx[sFilename] = mGeometryFiles.size();
+					mGeometryFiles.push_back(sFilename);
 				}
-				r.objIdx = mRenderItems.size();
-				mRenderItems[objectName] = (std::move(r));
 			}
 			else if (nodeType == "light")
 			{
-				ParallelogramLight light;
 				DirectX::XMFLOAT3 corner = { 0.0f, 0.0f, 0.0f };
 				DirectX::XMFLOAT3 v1 = { 0.0f, 0.0f, 0.0f };
 				DirectX::XMFLOAT3 v2 = { 0.0f, 0.0f, 0.0f };
 				DirectX::XMFLOAT3 emission = { 0.0f, 0.0f, 0.0f };
-				tinyxml2::XMLElement* cornerElem = node->FirstChildElement("corner");
-				if (cornerElem)
+				while (reader.nextChild())
+				{
+					std::string_view property = reader.name();
+					if (property == "corner")
+						readFloats(reader, corner);
+					else if (property == "v1")
+						readFloats(reader, v1);
+					else if (property == "v2")
+						readFloats(reader, v2);
+					else if (property == "emission")
+						readFloats(reader, emission);
+					else
+						reader.skip();
+				}
+				mLights.emplace_back(corner, v1, v2, emission);
+			}
+			else if (nodeType == "camera" && mIncludeStack.size() == 1)
+			{
+				while (reader.nextChild())
+				{
+					std::string_view property = reader.name();
+					if (property == "position")
+						readFloats(reader, mCameraConfig.position);
+					else if (property == "direction")
+						readFloats(reader, mCameraConfig.direction);
+					else
+						reader.skip();
+				}
+			}
+			else
+			{
+				reader.skip();
+			}
+		}
+	}
+	if (reader.failed())
+	{
+		std::cerr << "WSceneDescParser: " << sceneFile << ":" << reader.error() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+void WSceneDescParser::parseObject(WXmlReader& reader, INT32 parentNode, std::map<std::string, size_t>& geometryFileIdx)
+{
+	std::string objectName = WXmlReader::decode(reader.attribute("name"));
+	if (objectName.empty() || mRenderItems.find(objectName) != mRenderItems.end())
+	{
+		std::cerr << "WSceneDescParser: " << reader.position() << ": skipping <object> without a unique name" << std::endl;
+		reader.skip();
+		return;
+	}
+	WRenderItem r;
+	r.objName = objectName;
+	r.objIdx = mRenderItems.size();
+	while (reader.nextChild())
+	{
+		std::string_view childType = reader.name();
+		if (childType == "Material")
+		{
+			// Materials are shared by name, the first declaration wins
+			std::string materialName = parseMaterial(reader);
+			if (!materialName.empty())
+			{
+				r.materialName = materialName;
+				r.matIdx = mMaterialItems[r.materialName].MatIdx;
+			}
+		}
+		else if (childType == "Mesh")
+		{
+			while (reader.nextChild())
+			{
+				std::string_view meshProperty = reader.name();
+				if (meshProperty == "geometry")
 				{
-					corner = parseFloat3(cornerElem->GetText());
+					std::string sFilename = readString(reader);
+					if (sFilename.empty())
+						continue;
+					if (geometryFileIdx.find(sFilename) == geometryFileIdx.end())
+					{
+						geometryFileIdx[sFilename] = mGeometryFiles.size();
+						mGeometryFiles.push_back(sFilename);
+					}
+					r.geometryName = sFilename;
 				}
-				tinyxml2::XMLElement* v1Elem = node->FirstChildElement("v1");
-				if (v1Elem)
+				else if (meshProperty == "lod")
 				{
-					v1 = parseFloat3(v1Elem->GetText());
+					// <lod level="2"/> or <lod distances="50 120 300"/>
+					reader.queryUnsignedAttribute("level", r.lodLevel);
+					if (!parseFloatList(reader.attribute("distances"), r.lodDistances))
+						std::cerr << "WSceneDescParser: " << reader.position() << ": malformed lod distances" << std::endl;
+					std::sort(r.lodDistances.begin(), r.lodDistances.end());
+					r.lodLevel = (std::min)(r.lodLevel, WMaxLodLevels);
+					if (r.lodDistances.size() > WMaxLodLevels)
+						r.lodDistances.resize(WMaxLodLevels);
+					reader.skip();
 				}
-				tinyxml2::XMLElement* v2Elem = node->FirstChildElement("v2");
-				if (v2Elem)
+				else if (meshProperty == "transform")
 				{
-					v2 = parseFloat3(v2Elem->GetText());
+					r.transform = parseTransform(reader, r.translation, r.rotation, r.scaling);
 				}
-				tinyxml2::XMLElement* emissionElem = node->FirstChildElement("emission");
-				if (emissionElem)
+				else
 				{
-					emission = parseFloat3(emissionElem->GetText());
+					reader.skip();
 				}
-				mLights.emplace_back(corner, v1, v2, emission);
 			}
-			else if (nodeType == "camera")
+		}
+		else if (childType == "animation")
+		{
+			parseAnimation(reader, static_cast<UINT32>(r.objIdx));
+		}
+		else
+		{
+			reader.skip();
+		}
+	}
+	// Objects inside a <group> are placed relative to it
+	r.transformNode = mTransformHierarchy.addNode(parentNode, static_cast<INT32>(r.objIdx), objectName, r.transform);
+	mRenderItems[objectName] = (std::move(r));
+}
+
+void WSceneDescParser::parseGroup(WXmlReader& reader, INT32 parentNode, std::map<std::string, size_t>& geometryFileIdx)
+{
+	// The node is added before its <transform> is read, children only need its index
+	UINT32 node = mTransformHierarchy.addNode(parentNode, -1, WXmlReader::decode(reader.attribute("name")),
+		DirectX::XMMatrixIdentity());
+	while (reader.nextChild())
+	{
+		std::string_view childType = reader.name();
+		if (childType == "transform")
+		{
+			DirectX::XMFLOAT3 translation = { 0,0,0 }, rotation = { 0,0,0 }, scaling = { 1,1,1 };
+			mTransformHierarchy.setLocal(node, parseTransform(reader, translation, rotation, scaling));
+		}
+		else if (childType == "object")
+		{
+			parseObject(reader, static_cast<INT32>(node), geometryFileIdx);
+		}
+		else if (childType == "group")
+		{
+			parseGroup(reader, static_cast<INT32>(node), geometryFileIdx);
+		}
+		else if (childType == "include")
+		{
+			parseInclude(reader, static_cast<INT32>(node), geometryFileIdx);
+		}
+		else
+		{
+			std::cerr << "WSceneDescParser: " << reader.position() << ": <" << childType << "> is not supported inside <group>" << std::endl;
+			reader.skip();
+		}
+	}
+	mTransformHierarchy.closeNode(node);
+}
+
+void WSceneDescParser::parseInclude(WXmlReader& reader, INT32 parentNode, std::map<std::string, size_t>& geometryFileIdx)
+{
+	std::string sceneFile = WXmlReader::decode(reader.attribute("file"));
+	if (sceneFile.empty())
+	{
+		std::cerr << "WSceneDescParser: " << reader.position() << ": skipping <include> without a file" << std::endl;
+		reader.skip();
+		return;
+	}
+	bool lazy = false;
+	reader.queryBoolAttribute("lazy", lazy);
+	WSubSceneRecord record;
+	record.file = sceneFile;
+	if (reader.hasAttribute("bounds"))
+	{
+		float bounds[6];
+		record.hasBounds = parseFloats(reader.attribute("bounds"), bounds, 6);
+		if (record.hasBounds)
+		{
+			record.boundsMin = DirectX::XMFLOAT3(bounds[0], bounds[1], bounds[2]);
+			record.boundsMax = DirectX::XMFLOAT3(bounds[3], bounds[4], bounds[5]);
+		}
+		else
+			std::cerr << "WSceneDescParser: " << reader.position() << ": expected 6 numbers in the bounds of " << sceneFile << std::endl;
+	}
+
+	// Placed like a <group>, the included scene's top level elements become its children
+	UINT32 node = mTransformHierarchy.addNode(parentNode, -1, sceneFile, DirectX::XMMatrixIdentity());
+	record.transformNode = node;
+	while (reader.nextChild())
+	{
+		if (reader.name() == "transform")
+		{
+			DirectX::XMFLOAT3 translation = { 0,0,0 }, rotation = { 0,0,0 }, scaling = { 1,1,1 };
+			mTransformHierarchy.setLocal(node, parseTransform(reader, translation, rotation, scaling));
+		}
+		else
+		{
+			std::cerr << "WSceneDescParser: " << reader.position() << ": <" << reader.name() << "> is not supported inside <include>" << std::endl;
+			reader.skip();
+		}
+	}
+
+	if (lazy)
+	{
+		mSubScenes.push_back(std::move(record));
+	}
+	else if (std::find(mIncludeStack.begin(), mIncludeStack.end(), sceneFile) != mIncludeStack.end())
+	{
+		std::cerr << "WSceneDescParser: " << sceneFile << " includes itself" << std::endl;
+		mIncludeFailed = true;
+	}
+	else
+	{
+		mIncludeFiles.push_back(sceneFile);
+		mIncludeStack.push_back(sceneFile);
+		if (!parseSceneFile(sceneFile, static_cast<INT32>(node), geometryFileIdx))
+			mIncludeFailed = true;
+		mIncludeStack.pop_back();
+	}
+	mTransformHierarchy.closeNode(node);
+}
+
+void WSceneDescParser::parseAnimation(WXmlReader& reader, UINT32 objIdx)
+{
+	bool loop = false;
+	reader.queryBoolAttribute("loop", loop);
+	while (reader.nextChild())
+	{
+		std::string_view channelName = reader.name();
+		WANIMATION_TARGET target;
+		if (channelName == "translation")
+			target = ANIMATION_TRANSLATION;
+		else if (channelName == "rotation")
+			target = ANIMATION_ROTATION;
+		else if (channelName == "scale")
+			target = ANIMATION_SCALE;
+		else
+		{
+			reader.skip();
+			continue;
+		}
+		WINTERPOLATION interpolation = INTERPOLATION_LINEAR;
+		if (reader.hasAttribute("interpolation"))
+		{
+			std::string_view interpolationName = reader.attribute("interpolation");
+			if (interpolationName == "cubic")
+				interpolation = INTERPOLATION_CUBIC;
+			else if (interpolationName != "linear")
+				std::cerr << "WSceneDescParser: unknown interpolation " << interpolationName << ", using linear" << std::endl;
+		}
+
+		std::vector<std::pair<float, DirectX::XMFLOAT3>> keys;
+		while (reader.nextChild())
+		{
+			if (reader.name() != "key")
+			{
+				reader.skip();
+				continue;
+			}
+			float time = 0.0f;
+			DirectX::XMFLOAT3 value;
+			bool hasTime = reader.queryFloatAttribute("time", time);
+			std::string_view text = reader.readText();
+			if (!hasTime || !parseFloats(text, &value.x, 3))
 			{
-				tinyxml2::XMLElement* positionElem = e->FirstChildElement("position");
-				if (positionElem)
+				if (!reader.failed())
+					std::cerr << "WSceneDescParser: " << reader.position() << ": skipping <key> without time or value" << std::endl;
+				continue;
+			}
+			keys.emplace_back(time, value);
+		}
+		if (keys.empty())
+			continue;
+		std::stable_sort(keys.begin(), keys.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+		std::vector<float> times;
+		std::vector<DirectX::XMFLOAT3> values;
+		for (const auto& key : keys)
+		{
+			times.push_back(key.first);
+			values.push_back(key.second);
+		}
+		mAnimations.addChannel(objIdx, target, interpolation, loop, times, values);
+	}
+}
+
+std::string WSceneDescParser::parseMaterial(WXmlReader& reader)
+{
+	std::string sMaterialName = WXmlReader::decode(reader.attribute("name"));
+	if (sMaterialName.empty())
+	{
+		std::cerr << "WSceneDescParser: " << reader.position() << ": skipping <Material> without a name" << std::endl;
+		reader.skip();
+		return sMaterialName;
+	}
+	if (mMaterialItems.find(sMaterialName) != mMaterialItems.end())
+	{
+		reader.skip();
+		return sMaterialName;
+	}
+
+	// Textures are shared by name like materials
+	auto textureIdx = [this](const std::string& textureName, const std::wstring& textureFileName, WTEXTURE_TYPE type) {
+		auto texture = mTextureItems.find(textureName);
+		if (texture != mTextureItems.end())
+			return static_cast<int>(texture->second.TextureIdx);
+		WTextureRecord tmpTextureRecord(textureName, textureFileName, static_cast<UINT>(mTextureItems.size()));
+		tmpTextureRecord.TextureType = type;
+		int idx = static_cast<int>(tmpTextureRecord.TextureIdx);
+		mTextureItems[textureName] = std::move(tmpTextureRecord);
+		return idx;
+	};
+
+	// Build new material from XML & append to MaterialBuffer
+	WMaterial tmpMatData;
+	tmpMatData.Name = sMaterialName;
+	while (reader.nextChild())
+	{
+		std::string_view property = reader.name();
+		if (property == "transparent")
+			readFloats(reader, tmpMatData.Transparent);
+		else if (property == "smoothness")
+			readFloats(reader, tmpMatData.Smoothness);
+		else if (property == "metallic")
+			readFloats(reader, tmpMatData.Metallic);
+		else if (property == "albedo")
+			readFloats(reader, tmpMatData.Albedo);
+		else if (property == "transColor")
+			readFloats(reader, tmpMatData.TransColor);
+		else if (property == "F0")
+			readFloats(reader, tmpMatData.F0);
+		else if (property == "k")
+			readFloats(reader, tmpMatData.k);
+		else if (property == "kd")
+			readFloats(reader, tmpMatData.kd);
+		else if (property == "ks")
+			readFloats(reader, tmpMatData.ks);
+		else if (property == "emission")
+			readFloats(reader, tmpMatData.Emission);
+		else if (property == "refractiveIndex")
+			readFloats(reader, tmpMatData.RefractiveIndex);
+		else if (property == "Sigma")
+			readFloats(reader, tmpMatData.Sigma);
+		else if (property == "Shader")
+			tmpMatData.Shader = readString(reader);
+		else if (property == "diffuseMap")
+		{
+			tmpMatData.DiffuseMapName = WXmlReader::decode(reader.attribute("name"));
+			tmpMatData.DiffuseMapIdx = textureIdx(tmpMatData.DiffuseMapName, string2wstring(readString(reader)), DIFFUSE_MAP);
+		}
+		else if (property == "normalMap")
+		{
+			tmpMatData.NormalMapName = WXmlReader::decode(reader.attribute("name"));
+			tmpMatData.NormalMapIdx = textureIdx(tmpMatData.NormalMapName, string2wstring(readString(reader)), NORMAL_MAP);
+		}
+		else
+			reader.skip();
+	}
+	tmpMatData.MatIdx = mMaterialItems.size();
+	mMaterialItems[sMaterialName] = (std::move(tmpMatData));
+	return sMaterialName;
+}
+
+bool WSceneDescParser::parseInstances(WXmlReader& reader, const std::string& geometryName)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Attributes first, reading the text consumes the element. Inline values are parsed
+	// straight from the document.
+	std::string materialName = WXmlReader::decode(reader.attribute("material"));
+	std::string_view formatName = reader.attribute("format");
+	std::string sidecarName = WXmlReader::decode(reader.attribute("file"));
+	std::string_view text = reader.readText();
+	if (reader.failed())
+		return false;
+
+	WInstanceBatch batch;
+	batch.geometryName = geometryName;
+	auto material = mMaterialItems.find(materialName);
+	if (material == mMaterialItems.end())
+	{
+		std::cerr << "WSceneDescParser: <instances> of " << geometryName << " needs a material declared earlier" << std::endl;
+		return false;
+	}
+	batch.materialName = material->first;
+	batch.matIdx = material->second.MatIdx;
+
+	WINSTANCE_FORMAT format;
+	if (!parseInstanceFormat(formatName, format))
+	{
+		std::cerr << "WSceneDescParser: unknown instance format " << formatName << std::endl;
+		return false;
+	}
+	const UINT32 stride = instanceFormatStride(format);
+
+	// Sidecar values are used straight from the mapping, inline ones are parsed first
+	WMappedFile sidecar;
+	std::vector<float> inlineValues;
+	const float* values = nullptr;
+	size_t valueCount = 0;
+	if (!sidecarName.empty())
+	{
+		if (!sidecar.Open(sidecarName) || sidecar.size() % (stride * sizeof(float)) != 0)
+		{
+			std::cerr << "WSceneDescParser: cannot read instance file " << sidecarName << std::endl;
+			return false;
+		}
+		values = reinterpret_cast<const float*>(sidecar.data());
+		valueCount = static_cast<size_t>(sidecar.size() / sizeof(float));
+		mInstanceFiles.push_back(sidecarName);
+	}
+	else if (!text.empty())
+	{
+		std::string error;
+		if (!parseInstanceValues(text.data(), text.data() + text.size(), inlineValues, error))
+		{
+			std::cerr << "WSceneDescParser: <instances> of " << geometryName << ": " << error << std::endl;
+			return false;
+		}
+		if (inlineValues.size() % stride != 0)
+		{
+			std::cerr << "WSceneDescParser: <instances> of " << geometryName << " has a partial transform" << std::endl;
+			return false;
+		}
+		values = inlineValues.data();
+		valueCount = inlineValues.size();
+	}
+
+	batch.first = static_cast<UINT32>(mInstanceTable.size());
+	batch.count = static_cast<UINT32>(valueCount / stride);
+	UINT32 batchId = static_cast<UINT32>(mInstanceTable.batches.size());
+	mInstanceTable.batches.push_back(batch);
+	appendInstances(mInstanceTable, batchId, values, batch.count, format);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double bytesPerInstance = static_cast<double>(sizeof(DirectX::XMFLOAT3X4) + sizeof(UINT32));
+	std::cout << "WInstanceTable: " << geometryName << " " << batch.count << " instances in " << seconds << " s ("
+		<< batch.count / (std::max)(seconds, 1e-9) << " instances/s), "
+		<< batch.count * bytesPerInstance / (1024.0 * 1024.0) << " MB (" << bytesPerInstance
+		<< " B/instance, a WRenderItem alone is " << sizeof(WRenderItem) << " B)" << std::endl;
+	return true;
+}
+
+namespace
+{
+	void accumulateStats(WCleanupStats& total, const WCleanupStats& stats)
+	{
+		total.trianglesBefore += stats.trianglesBefore;
+		total.degenerateTriangles += stats.degenerateTriangles;
+		total.duplicateTriangles += stats.duplicateTriangles;
+		total.verticesRemoved += stats.verticesRemoved;
+		total.normalsRemoved += stats.normalsRemoved;
+		total.texCoordsRemoved += stats.texCoordsRemoved;
+		total.bytesBefore += stats.bytesBefore;
+		total.bytesAfter += stats.bytesAfter;
+	}
+
+	void accumulateStats(WLocalityStats& total, const WLocalityStats& stats)
+	{
+		total.fetches += stats.fetches;
+		total.missesBefore += stats.missesBefore;
+		total.missesAfter += stats.missesAfter;
+	}
+
+	void accumulateStats(WQuantizationStats& total, const WQuantizationStats& stats)
+	{
+		total.bytesBefore += stats.bytesBefore;
+		total.bytesAfter += stats.bytesAfter;
+		total.maxNormalError = (std::max)(total.maxNormalError, stats.maxNormalError);
+		total.maxTexCoordError = (std::max)(total.maxTexCoordError, stats.maxTexCoordError);
+		total.withinBounds = total.withinBounds && stats.withinBounds;
+		total.floatTexCoords = total.floatTexCoords || stats.floatTexCoords;
+	}
+
+	// Distance policies count the thresholds the object is beyond, measured from the scene camera
+	UINT32 selectLodLevel(const WRenderItem& r, const DirectX::XMFLOAT3X4& world, const DirectX::XMFLOAT3& cameraPosition)
+	{
+		if (r.lodDistances.empty())
+			return r.lodLevel;
+		float dx = world.m[0][3] - cameraPosition.x;
+		float dy = world.m[1][3] - cameraPosition.y;
+		float dz = world.m[2][3] - cameraPosition.z;
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		return static_cast<UINT32>(std::upper_bound(r.lodDistances.begin(), r.lodDistances.end(), distance) -
+			r.lodDistances.begin());
+	}
+}
+
+bool WSceneDescParser::loadGeometry(WSceneCacheWriter* geometryStream)
+{
+	// Deepest LOD level any render item may pick, per geometry file
+	std::map<std::string, UINT32> lodLevelsByFile;
+	for (const auto& ritem : mRenderItems)
+	{
+		const auto& r = ritem.second;
+		UINT32 levels = (std::max)(r.lodLevel, static_cast<UINT32>(r.lodDistances.size()));
+		auto& fileLevels = lodLevelsByFile[r.geometryName];
+		fileLevels = (std::max)(fileLevels, levels);
+	}
+	std::vector<UINT32> lodLevels(mGeometryFiles.size(), 0);
+	for (size_t i = 0; i < mGeometryFiles.size(); i++)
+	{
+		auto it = lodLevelsByFile.find(mGeometryFiles[i]);
+		if (it != lodLevelsByFile.end())
+			lodLevels[i] = it->second;
+	}
+
+	// Load every referenced mesh concurrently
+	std::vector<WMeshData> meshes(mGeometryFiles.size());
+	std::vector<std::vector<WMeshData>> lods(mGeometryFiles.size());
+	std::vector<std::vector<WSimplifyStats>> lodStats(mGeometryFiles.size());
+	std::vector<std::vector<double>> lodSeconds(mGeometryFiles.size());
+	std::vector<std::string> errors(mGeometryFiles.size());
+	std::vector<char> loaded(mGeometryFiles.size(), 0);
+	std::vector<double> readSeconds(mGeometryFiles.size(), 0.0);
+	std::vector<WCleanupStats> cleanupStats(mGeometryFiles.size());
+	std::vector<WWeldStats> weldStats(mGeometryFiles.size());
+	std::vector<WLocalityStats> localityStats(mGeometryFiles.size());
+	std::vector<WQuantizationStats> quantizationStats(mGeometryFiles.size());
+	auto loadStart = std::chrono::steady_clock::now();
+	WThreadPool::global().parallelFor(mGeometryFiles.size(), [&](size_t i) {
+		auto start = std::chrono::steady_clock::now();
+		loaded[i] = mUseFastObjReader ?
+			readObjFast(mGeometryFiles[i], meshes[i], errors[i]) :
+			loadObjMesh(mGeometryFiles[i], meshes[i], errors[i]);
+		readSeconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		// Before normals are generated, so removed triangles do not contribute to them
+		if (loaded[i] && mCleanupMeshes)
+			cleanupStats[i] = cleanupMesh(meshes[i]);
+		if (loaded[i] && meshes[i].normals.empty())
+		{
+			autoGenerateVertexNormals(meshes[i].vertices, meshes[i].indices, meshes[i].normals);
+			meshes[i].normalIndices.assign(meshes[i].indices.begin(), meshes[i].indices.end());
+		}
+		if (loaded[i] && mWeldVertices)
+			weldStats[i] = weldMeshVertices(meshes[i]);
+		// Every LOD level is simplified from the full mesh, so its error is relative to the source
+		size_t triangles = meshes[i].indices.size() / 3;
+		for (UINT32 level = 1; loaded[i] && level <= lodLevels[i]; level++)
+		{
+			auto lodStart = std::chrono::steady_clock::now();
+			WMeshData lod;
+			size_t target = static_cast<size_t>(triangles * std::pow(static_cast<double>(mLodReduction), level));
+			WSimplifyStats stats = simplifyMesh(meshes[i], target, lod);
+			size_t previous = lods[i].empty() ? triangles : lods[i].back().indices.size() / 3;
+			if (stats.trianglesAfter >= previous)
+				break;
+			lods[i].push_back(std::move(lod));
+			lodStats[i].push_back(stats);
+			lodSeconds[i].push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - lodStart).count());
+		}
+		if (loaded[i] && mReorderForLocality)
+		{
+			localityStats[i] = reorderMeshForLocality(meshes[i]);
+			for (auto& lod : lods[i])
+				accumulateStats(localityStats[i], reorderMeshForLocality(lod));
+		}
+		if (loaded[i] && mQuantizeAttributes)
+		{
+			quantizationStats[i] = quantizeMeshAttributes(meshes[i]);
+			for (auto& lod : lods[i])
+				accumulateStats(quantizationStats[i], quantizeMeshAttributes(lod));
+		}
+	});
+	double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+	const char* readerName = mUseFastObjReader ? "WObjReader" : "TinyObjReader";
+	for (size_t i = 0; i < mGeometryFiles.size(); i++)
+	{
+		if (!loaded[i])
+		{
+			if (!errors[i].empty()) std::cerr << readerName << ": " << errors[i];
+			exit(1);
+		}
+		if (!errors[i].empty()) std::cout << readerName << ": " << errors[i];
+	}
+	double megabytes = 0.0, totalReadSeconds = 0.0;
+	for (size_t i = 0; i < mGeometryFiles.size(); i++)
+	{
+		std::error_code ec;
+		megabytes += std::filesystem::file_size(mGeometryFiles[i], ec) / (1024.0 * 1024.0);
+		totalReadSeconds += readSeconds[i];
+	}
+	std::cout << readerName << ": " << mGeometryFiles.size() << " files, " << megabytes << " MB read in "
+		<< totalReadSeconds << " s (" << megabytes / (std::max)(totalReadSeconds, 1e-9) << " MB/s per thread), "
+		<< loadSeconds << " s for the whole load" << std::endl;
+	if (mCleanupMeshes)
+	{
+		WCleanupStats total;
+		for (size_t i = 0; i < mGeometryFiles.size(); i++)
+		{
+			const auto& stats = cleanupStats[i];
+			if (stats.changed())
+				std::cout << "WMeshOptimizer: " << mGeometryFiles[i] << " removed " << stats.degenerateTriangles
+					<< " degenerate and " << stats.duplicateTriangles << " duplicate of " << stats.trianglesBefore
+					<< " triangles, " << stats.verticesRemoved << " vertices, " << stats.normalsRemoved << " normals, "
+					<< stats.texCoordsRemoved << " texcoords, " << stats.bytesBefore / 1024.0 << " -> "
+					<< stats.bytesAfter / 1024.0 << " KB" << std::endl;
+			accumulateStats(total, stats);
+		}
+		std::cout << "WMeshOptimizer: cleanup removed " << total.degenerateTriangles + total.duplicateTriangles << " of "
+			<< total.trianglesBefore << " triangles (" << total.degenerateTriangles << " degenerate, "
+			<< total.duplicateTriangles << " duplicate) and " << total.verticesRemoved << " vertices, "
+			<< total.bytesBefore / (1024.0 * 1024.0) << " -> " << total.bytesAfter / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+	if (mWeldVertices)
+	{
+		WWeldStats total;
+		for (const auto& stats : weldStats)
+		{
+			total.vertexCountBefore += stats.vertexCountBefore;
+			total.vertexCountAfter += stats.vertexCountAfter;
+			total.bytesBefore += stats.bytesBefore;
+			total.bytesAfter += stats.bytesAfter;
+		}
+		std::cout << "WMeshOptimizer: welded " << total.vertexCountBefore << " -> " << total.vertexCountAfter
+			<< " vertices, " << total.bytesBefore / (1024.0 * 1024.0) << " -> " << total.bytesAfter / (1024.0 * 1024.0)
+			<< " MB" << std::endl;
+	}
+	if (mReorderForLocality)
+	{
+		WLocalityStats total;
+		for (const auto& stats : localityStats)
+			accumulateStats(total, stats);
+		double fetches = static_cast<double>((std::max)(total.fetches, UINT64(1)));
+		std::cout << "WMeshOptimizer: reordered for locality, simulated " << WLocalityCacheLineSize << "B-line LRU misses "
+			<< total.missesBefore << " -> " << total.missesAfter << " (" << total.missesBefore / fetches << " -> "
+			<< total.missesAfter / fetches << " per fetch)" << std::endl;
+	}
+	if (mQuantizeAttributes)
+	{
+		WQuantizationStats total;
+		for (size_t i = 0; i < mGeometryFiles.size(); i++)
+		{
+			const auto& stats = quantizationStats[i];
+			if (!stats.withinBounds)
+				std::cerr << "WMeshOptimizer: " << mGeometryFiles[i] << " exceeds the normal quantization error bound ("
+					<< stats.maxNormalError << " rad)" << std::endl;
+			if (stats.floatTexCoords)
+				std::cout << "WMeshOptimizer: " << mGeometryFiles[i] << " keeps float texcoords, half precision "
+					"cannot hold them within " << WHalfTexCoordMaxAbsoluteError << std::endl;
+			accumulateStats(total, stats);
+		}
+		std::cout << "WMeshOptimizer: quantized normals/texcoords " << total.bytesBefore / (1024.0 * 1024.0) << " -> "
+			<< total.bytesAfter / (1024.0 * 1024.0) << " MB, max normal error " << total.maxNormalError
+			<< " rad, max texcoord error " << total.maxTexCoordError << std::endl;
+	}
+
+	for (size_t i = 0; i < mGeometryFiles.size(); i++)
+	{
+		for (size_t level = 0; level < lodStats[i].size(); level++)
+		{
+			const auto& stats = lodStats[i][level];
+			double seconds = lodSeconds[i][level];
+			std::cout << "WMeshSimplifier: " << lodGeometryName(mGeometryFiles[i], static_cast<UINT32>(level + 1)) << " "
+				<< stats.trianglesBefore << " -> " << stats.trianglesAfter << " triangles in " << seconds << " s ("
+				<< stats.trianglesBefore / (std::max)(seconds, 1e-9) << " triangles/s), max error " << stats.maxError
+				<< " of the bounding box diagonal" << std::endl;
+		}
+		if (lods[i].size() < lodLevels[i])
+			std::cout << "WMeshSimplifier: " << mGeometryFiles[i] << " stops at LOD " << lods[i].size() << " of "
+				<< lodLevels[i] << std::endl;
+	}
+
+	// Each file is followed by its LOD levels
+	std::vector<std::string> names;
+	std::vector<WMeshData> allMeshes;
+	std::map<std::string, UINT32> lodCounts;
+	for (size_t i = 0; i < mGeometryFiles.size(); i++)
+	{
+		names.push_back(mGeometryFiles[i]);
+		allMeshes.push_back(std::move(meshes[i]));
+		for (size_t level = 0; level < lods[i].size(); level++)
+		{
+			names.push_back(lodGeometryName(mGeometryFiles[i], static_cast<UINT32>(level + 1)));
+			allMeshes.push_back(std::move(lods[i][level]));
+		}
+		lodCounts[mGeometryFiles[i]] = static_cast<UINT32>(lods[i].size());
+	}
+
+	// Files with identical content share one slice of the scene buffers (and one BLAS)
+	WDeduplicationStats dedupStats;
+	auto canonical = findDuplicateMeshes(allMeshes, dedupStats);
+	std::vector<std::string> uniqueNames;
+	std::vector<WMeshData> uniqueMeshes;
+	for (size_t i = 0; i < allMeshes.size(); i++)
+	{
+		if (canonical[i] != i)
+			continue;
+		uniqueNames.push_back(names[i]);
+		uniqueMeshes.push_back(std::move(allMeshes[i]));
+	}
+	std::vector<WMeshData>().swap(allMeshes);
+	for (size_t i = 0; i < names.size(); i++)
+		if (canonical[i] != i)
+			std::cout << "WMeshOptimizer: " << names[i] << " duplicates " << names[canonical[i]] << std::endl;
+	std::cout << "WMeshOptimizer: " << dedupStats.uniqueMeshCount << " unique of " << dedupStats.meshCount << " meshes, "
+		<< dedupStats.bytesBefore / (1024.0 * 1024.0) << " -> " << dedupStats.bytesAfter / (1024.0 * 1024.0) << " MB ("
+		<< (dedupStats.bytesBefore - dedupStats.bytesAfter) / (1024.0 * 1024.0) << " MB saved)" << std::endl;
+
+	// Flatten them in first-use order, so offsets match a serial load
+	if (!flattenMeshes(uniqueNames, uniqueMeshes, geometryStream))
+		return false;
+	for (size_t i = 0; i < names.size(); i++)
+		if (canonical[i] != i)
+			mGeometryMap[names[i]] = mGeometryMap[names[canonical[i]]];
+	for (auto& ritem : mRenderItems)
+	{
+		auto& r = ritem.second;
+		if (r.geometryName.empty())
+			continue;
+		r.lodSelected = (std::min)(selectLodLevel(r, mTransformHierarchy.worlds[r.transformNode], mCameraConfig.position),
+			lodCounts[r.geometryName]);
+		const auto& geometryRecord = mGeometryMap[lodGeometryName(r.geometryName, r.lodSelected)];
+		r.vertexOffsetInBytes = geometryRecord.vertexOffsetInBytes;
+		r.normalOffsetInBytes = geometryRecord.normalOffsetInBytes;
+		r.texCoordOffsetInBytes = geometryRecord.texCoordOffsetInBytes;
+		r.vertexCount = geometryRecord.vertexCount;
+		r.indexOffsetInBytes = geometryRecord.indexOffsetInBytes;
+		r.indexCount = geometryRecord.indexCount;
+		r.materialIdOffset = geometryRecord.materialIdOffset;
+		r.floatTexCoords = geometryRecord.floatTexCoords;
+	}
+	return true;
+}
+
+bool WSceneDescParser::flattenMeshes(const std::vector<std::string>& names, std::vector<WMeshData>& meshes,
+	WSceneCacheWriter* geometryStream)
+{
+	// Prefix sums over the mesh sizes give every mesh a fixed slice of the global buffers
+	struct MeshSlice
+	{
+		size_t vertex;
+		size_t normal;
+		size_t texCoord;
+		size_t packedNormal;
+		size_t packedTexCoord;
+		size_t attribute;  // In vertices
+		size_t index;
+
+		MeshSlice operator-(const MeshSlice& rhs) const
+		{
+			return { vertex - rhs.vertex, normal - rhs.normal, texCoord - rhs.texCoord, packedNormal - rhs.packedNormal,
+				packedTexCoord - rhs.packedTexCoord, attribute - rhs.attribute, index - rhs.index };
+		}
+	};
+	const size_t attributeWidth = mQuantizeAttributes ? sizeof(SPackedVertexAttributes) / sizeof(UINT32) :
+		sizeof(SVertexAttributes) / sizeof(tinyobj::real_t);
+	std::vector<MeshSlice> slices(meshes.size() + 1);
+	slices[0] = { mVertexBuffer.size(), mNormalBuffer.size(), mTexCoordBuffer.size(), mPackedNormalBuffer.size(),
+		mPackedTexCoordBuffer.size(),
+		(mQuantizeAttributes ? mPackedVertexAttributeBuffer.size() : mVertexAttributeBuffer.size()) / attributeWidth,
+		mIndexBuffer.size() };
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const auto& mesh = meshes[i];
+		slices[i + 1] = slices[i];
+		slices[i + 1].vertex += mesh.vertices.size();
+		slices[i + 1].index += mesh.indices.size();
+		// Quantized meshes whose texcoords do not fit half keep them as float bits among the packed ones
+		const bool floatTexCoords = mQuantizeAttributes && !mesh.texCoords.empty();
+		if (floatTexCoords)
+			slices[i + 1].packedTexCoord += mesh.texCoords.size();
+		// Welded meshes interleave their normals and texcoords instead
+		if (mWeldVertices)
+		{
+			slices[i + 1].attribute += mesh.vertices.size() / 3;
+			continue;
+		}
+		slices[i + 1].normal += mesh.normals.size();
+		if (!floatTexCoords)
+			slices[i + 1].texCoord += mesh.texCoords.size();
+		slices[i + 1].packedNormal += mesh.packedNormals.size();
+		slices[i + 1].packedTexCoord += mesh.packedTexCoords.size();
+	}
+
+	// Multi-material meshes map their usemtl slots onto the scene's materials
+	const UINT32 bits = getMaterialIdBits();
+	const UINT32 idsPerWord = 32 / bits;
+	const UINT32 objectMaterial = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+	const size_t firstWord = mMaterialIdBuffer.size();
+	std::vector<UINT32> materialIds;
+	std::vector<INT64> materialIdOffsets(meshes.size(), -1);
+	std::set<std::string> undeclaredMaterials;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const auto& mesh = meshes[i];
+		if (!mesh.hasMaterialIds())
+			continue;
+		std::vector<UINT32> slotToMaterial(mesh.materialNames.size(), objectMaterial);
+		for (size_t slot = 0; slot < mesh.materialNames.size(); slot++)
+		{
+			const auto& name = mesh.materialNames[slot];
+			auto material = mMaterialItems.find(name);
+			if (material != mMaterialItems.end())
+				slotToMaterial[slot] = material->second.MatIdx;
+			else if (!name.empty() && undeclaredMaterials.insert(name).second)
+				std::cout << "WSceneDescParser: " << names[i] << " uses material " << name
+					<< " the scene does not declare, its triangles use the object's material" << std::endl;
+		}
+		materialIdOffsets[i] = static_cast<INT64>(firstWord * idsPerWord + materialIds.size());
+		for (UINT32 slot : mesh.materialIds)
+			materialIds.push_back(slotToMaterial[slot]);
+		if (!isLodGeometryName(names[i]))
+			std::cout << "WSceneDescParser: " << names[i] << " keeps " << mesh.materialNames.size() << " materials on "
+				<< mesh.materialIds.size() << " triangles in 1 geometry, BLAS and instance instead of "
+				<< mesh.materialNames.size() << " (" << bits << "-bit material ids, "
+				<< mesh.materialIds.size() * bits / 8 / 1024.0 << " KB)" << std::endl;
+	}
+	mMaterialIdBuffer.resize(firstWord + (materialIds.size() + idsPerWord - 1) / idsPerWord, 0);
+	for (size_t j = 0; j < materialIds.size(); j++)
+		mMaterialIdBuffer[firstWord + j / idsPerWord] |= materialIds[j] << ((j % idsPerWord) * bits);
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const auto& mesh = meshes[i];
+		const auto& slice = slices[i];
+		WGeometryRecord geometryRecord;
+		geometryRecord.materialIdOffset = materialIdOffsets[i];
+		geometryRecord.vertexOffsetInBytes = slice.vertex * sizeof(tinyobj::real_t);
+		if (mWeldVertices)
+		{
+			// Both offsets point at the mesh's first interleaved vertex
+			const size_t stride = mQuantizeAttributes ? sizeof(SPackedVertexAttributes) : sizeof(SVertexAttributes);
+			geometryRecord.normalOffsetInBytes = slice.attribute * stride;
+			if (mesh.hasTexCoords())
+				geometryRecord.texCoordOffsetInBytes = slice.attribute * stride;
+		}
+		else if (mQuantizeAttributes)
+		{
+			geometryRecord.normalOffsetInBytes = slice.packedNormal * sizeof(UINT32);
+			if (mesh.hasTexCoords())
+				geometryRecord.texCoordOffsetInBytes = slice.packedTexCoord * sizeof(UINT32);
+		}
+		else
+		{
+			geometryRecord.normalOffsetInBytes = slice.normal * sizeof(tinyobj::real_t);
+			if (mesh.hasTexCoords())
+				geometryRecord.texCoordOffsetInBytes = slice.texCoord * sizeof(tinyobj::real_t);
+		}
+		if (mQuantizeAttributes && !mesh.texCoords.empty())
+		{
+			geometryRecord.texCoordOffsetInBytes = slice.packedTexCoord * sizeof(UINT32);
+			geometryRecord.floatTexCoords = true;
+		}
+		geometryRecord.vertexCount = static_cast<UINT32>(mesh.vertices.size() / 3); // One vertex is consist of 3 coordinates
+		geometryRecord.indexOffsetInBytes = slice.index * sizeof(UINT32);
+		geometryRecord.indexCount = static_cast<UINT32>(mesh.indices.size());
+		mGeometryMap[names[i]] = std::move(geometryRecord);
+	}
+
+	// Sizes the buffers to hold "extent", which the meshes copied next fill completely
+	auto resizeBuffers = [&](const MeshSlice& extent) {
+		mVertexBuffer.resize(extent.vertex);
+		mNormalBuffer.resize(extent.normal);
+		mTexCoordBuffer.resize(extent.texCoord);
+		mPackedNormalBuffer.resize(extent.packedNormal);
+		mPackedTexCoordBuffer.resize(extent.packedTexCoord);
+		if (mWeldVertices && mQuantizeAttributes)
+			mPackedVertexAttributeBuffer.resize(extent.attribute * attributeWidth);
+		else if (mWeldVertices)
+			mVertexAttributeBuffer.resize(extent.attribute * attributeWidth);
+		mIndexBuffer.resize(extent.index);
+		// Welded meshes address every attribute with mIndexBuffer
+		if (!mWeldVertices)
+		{
+			mNormalIndexBuffer.resize(extent.index);
+			mTexCoordIndexBuffer.resize(extent.index);
+		}
+	};
+	// Copies mesh i to its slice, relative to the buffers starting at slice "base"
+	auto copyMesh = [&](size_t i, const MeshSlice& base) {
+		const auto& mesh = meshes[i];
+		const MeshSlice slice = slices[i] - base;
+		std::copy(mesh.vertices.begin(), mesh.vertices.end(), mVertexBuffer.begin() + slice.vertex);
+		std::copy(mesh.indices.begin(), mesh.indices.end(), mIndexBuffer.begin() + slice.index);
+		const bool floatTexCoords = mQuantizeAttributes && !mesh.texCoords.empty();
+		if (floatTexCoords)
+			memcpy(&mPackedTexCoordBuffer[slice.packedTexCoord], mesh.texCoords.data(), mesh.texCoords.size() * sizeof(UINT32));
+		if (mWeldVertices)
+		{
+			// Meshes without texcoords keep zero UVs, their records mark them as absent
+			const size_t vertexCount = mesh.vertices.size() / 3;
+			const bool hasTexCoords = mesh.hasTexCoords();
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				if (mQuantizeAttributes)
 				{
-					mCameraConfig.position = parseFloat3(positionElem->GetText());
+					UINT32* attributes = &mPackedVertexAttributeBuffer[(slice.attribute + v) * attributeWidth];
+					attributes[0] = mesh.packedNormals[v];
+					attributes[1] = hasTexCoords && !floatTexCoords ? mesh.packedTexCoords[v] : 0;
 				}
-				tinyxml2::XMLElement* directionElem = e->FirstChildElement("direction");
-				if (directionElem)
+				else
 				{
-					mCameraConfig.direction = parseFloat3(directionElem->GetText());
+					tinyobj::real_t* attributes = &mVertexAttributeBuffer[(slice.attribute + v) * attributeWidth];
+					std::copy_n(&mesh.normals[3 * v], 3, attributes);
+					attributes[3] = hasTexCoords ? mesh.texCoords[2 * v] : 0;
+					attributes[4] = hasTexCoords ? mesh.texCoords[2 * v + 1] : 0;
 				}
 			}
+			return;
 		}
+		std::copy(mesh.normals.begin(), mesh.normals.end(), mNormalBuffer.begin() + slice.normal);
+		if (!floatTexCoords)
+			std::copy(mesh.texCoords.begin(), mesh.texCoords.end(), mTexCoordBuffer.begin() + slice.texCoord);
+		std::copy(mesh.packedNormals.begin(), mesh.packedNormals.end(), mPackedNormalBuffer.begin() + slice.packedNormal);
+		std::copy(mesh.packedTexCoords.begin(), mesh.packedTexCoords.end(), mPackedTexCoordBuffer.begin() + slice.packedTexCoord);
+		std::copy(mesh.normalIndices.begin(), mesh.normalIndices.end(), mNormalIndexBuffer.begin() + slice.index);
+		std::copy(mesh.texCoordIndices.begin(), mesh.texCoordIndices.end(), mTexCoordIndexBuffer.begin() + slice.index);
+	};
+
+	if (!geometryStream)
+	{
+		resizeBuffers(slices[meshes.size()]);
+		const MeshSlice origin = {};
+		WThreadPool::global().parallelFor(meshes.size(), [&](size_t i) {
+			copyMesh(i, origin);
+		});
+		return true;
 	}
+
+	// Streamed into the cache: the buffers hold one batch of meshes, at most the paging budget
+	// (or a single larger mesh), and each mesh is released once it is in the file
+	const size_t indexStreams = mWeldVertices ? 1 : 3;
+	auto extentBytes = [&](const MeshSlice& extent) {
+		return static_cast<UINT64>(extent.vertex + extent.normal + extent.texCoord + extent.packedNormal +
+			extent.packedTexCoord + extent.attribute * attributeWidth + extent.index * indexStreams) * sizeof(UINT32);
+	};
+	const MeshSlice total = slices[meshes.size()] - slices[0];
+	const bool packedAttributes = mWeldVertices && mQuantizeAttributes, floatAttributes = mWeldVertices && !mQuantizeAttributes;
+	geometryStream->reserveSection(CACHE_VERTEX_BUFFER, total.vertex * sizeof(tinyobj::real_t));
+	geometryStream->reserveSection(CACHE_NORMAL_BUFFER, total.normal * sizeof(tinyobj::real_t));
+	geometryStream->reserveSection(CACHE_TEXCOORD_BUFFER, total.texCoord * sizeof(tinyobj::real_t));
+	geometryStream->reserveSection(CACHE_PACKED_NORMAL_BUFFER, total.packedNormal * sizeof(UINT32));
+	geometryStream->reserveSection(CACHE_PACKED_TEXCOORD_BUFFER, total.packedTexCoord * sizeof(UINT32));
+	geometryStream->reserveSection(CACHE_VERTEX_ATTRIBUTE_BUFFER,
+		floatAttributes ? total.attribute * attributeWidth * sizeof(tinyobj::real_t) : 0);
+	geometryStream->reserveSection(CACHE_PACKED_VERTEX_ATTRIBUTE_BUFFER,
+		packedAttributes ? total.attribute * attributeWidth * sizeof(UINT32) : 0);
+	geometryStream->reserveSection(CACHE_INDEX_BUFFER, total.index * sizeof(UINT32));
+	geometryStream->reserveSection(CACHE_NORMAL_INDEX_BUFFER, mWeldVertices ? 0 : total.index * sizeof(INT32));
+	geometryStream->reserveSection(CACHE_TEXCOORD_INDEX_BUFFER, mWeldVertices ? 0 : total.index * sizeof(INT32));
+	// Buffers the layout does not use stay empty
+	auto writeBuffer = [&](UINT32 id, size_t first, const auto& buffer) {
+		using T = typename std::decay_t<decltype(buffer)>::value_type;
+		return buffer.empty() || geometryStream->writeReserved(id, first * sizeof(T), buffer.data(), buffer.size() * sizeof(T));
+	};
+	size_t batches = 0;
+	UINT64 largestBatch = 0;
+	for (size_t first = 0; first < meshes.size(); batches++)
+	{
+		size_t last = first + 1;
+		while (last < meshes.size() && extentBytes(slices[last + 1] - slices[first]) <= mPagedGeometryBytes)
+			last++;
+		const MeshSlice extent = slices[last] - slices[first];
+		const MeshSlice offset = slices[first] - slices[0];
+		largestBatch = (std::max)(largestBatch, extentBytes(extent));
+		resizeBuffers(extent);
+		WThreadPool::global().parallelFor(last - first, [&](size_t i) {
+			copyMesh(first + i, slices[first]);
+		});
+		bool written = writeBuffer(CACHE_VERTEX_BUFFER, offset.vertex, mVertexBuffer) &&
+			writeBuffer(CACHE_NORMAL_BUFFER, offset.normal, mNormalBuffer) &&
+			writeBuffer(CACHE_TEXCOORD_BUFFER, offset.texCoord, mTexCoordBuffer) &&
+			writeBuffer(CACHE_PACKED_NORMAL_BUFFER, offset.packedNormal, mPackedNormalBuffer) &&
+			writeBuffer(CACHE_PACKED_TEXCOORD_BUFFER, offset.packedTexCoord, mPackedTexCoordBuffer) &&
+			writeBuffer(CACHE_VERTEX_ATTRIBUTE_BUFFER, offset.attribute * attributeWidth, mVertexAttributeBuffer) &&
+			writeBuffer(CACHE_PACKED_VERTEX_ATTRIBUTE_BUFFER, offset.attribute * attributeWidth, mPackedVertexAttributeBuffer) &&
+			writeBuffer(CACHE_INDEX_BUFFER, offset.index, mIndexBuffer) &&
+			writeBuffer(CACHE_NORMAL_INDEX_BUFFER, offset.index, mNormalIndexBuffer) &&
+			writeBuffer(CACHE_TEXCOORD_INDEX_BUFFER, offset.index, mTexCoordIndexBuffer);
+		if (!written)
+		{
+			std::cerr << "WSceneDescParser: failed to stream geometry into the scene cache" << std::endl;
+			return false;
+		}
+		for (size_t i = first; i < last; i++)
+			meshes[i] = WMeshData();
+		first = last;
+	}
+	resizeBuffers(MeshSlice());
+	std::cout << "WSceneDescParser: streamed " << extentBytes(total) / (1024.0 * 1024.0) << " MB of geometry into the "
+		"scene cache in " << batches << " batches of at most " << largestBatch / (1024.0 * 1024.0) << " MB" << std::endl;
+	return true;
 }
 
-DirectX::XMFLOAT3 parseFloat3(const char* text)
+bool loadObjMesh(const std::string& filename, WMeshData& mesh, std::string& message)
 {
-	std::istringstream tstream(text);
-	std::string tmpVal;
-	DirectX::XMFLOAT3 floatVal;
-	std::getline(tstream, tmpVal, ',');
-	floatVal.x = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.y = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.z = std::stof(tmpVal);
-	return floatVal;
+	// Load obj with the help of 3rdparty library "tiny_obj_loader"
+	tinyobj::ObjReaderConfig reader_config;
+	reader_config.mtl_search_path = "./"; // Path to material files
+
+	tinyobj::ObjReader reader;
+
+	if (!reader.ParseFromFile(filename, reader_config))
+	{
+		message = reader.Error();
+		return false;
+	}
+	message = reader.Warning();
+
+	auto& attrib = reader.GetAttrib();
+	auto& shapes = reader.GetShapes();
+
+	// Fetch vertex data
+	mesh.vertices = attrib.vertices;
+	mesh.normals = attrib.normals;
+	mesh.texCoords = attrib.texcoords;
+	// Fetch index data
+	getIndicesFromStructShape(shapes, mesh.indices, mesh.normalIndices, mesh.texCoordIndices);
+
+	// Per-triangle material slots, slot 0 is for faces without a material
+	const auto& materials = reader.GetMaterials();
+	mesh.materialNames.assign(1, "");
+	for (const auto& material : materials)
+		mesh.materialNames.push_back(material.name);
+	for (const auto& shape : shapes)
+		for (int id : shape.mesh.material_ids)
+			mesh.materialIds.push_back(id < 0 ? 0 : static_cast<UINT32>(id + 1));
+	if (std::adjacent_find(mesh.materialIds.begin(), mesh.materialIds.end(), std::not_equal_to<UINT32>()) ==
+		mesh.materialIds.end())
+	{
+		mesh.materialIds.clear();
+		mesh.materialNames.clear();
+	}
+	return true;
 }
 
-DirectX::XMFLOAT3 parseFloat3(std::string text)
+namespace
 {
-	std::istringstream tstream(text);
-	std::string tmpVal;
-	DirectX::XMFLOAT3 floatVal;
-	std::getline(tstream, tmpVal, ',');
-	floatVal.x = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.y = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.z = std::stof(tmpVal);
-	return floatVal;
+	void writeMaterial(WCacheBlob& blob, const WMaterial& m)
+	{
+		blob.writeString(m.Name);
+		blob.writeString(m.DiffuseMapName);
+		blob.writeString(m.NormalMapName);
+		blob.writeString(m.Shader);
+		blob.writePod(m.MatIdx);
+		blob.writePod(m.Albedo);
+		blob.writePod(m.TransColor);
+		blob.writePod(m.Emission);
+		blob.writePod(m.F0);
+		blob.writePod(m.k);
+		blob.writePod(m.kd);
+		blob.writePod(m.ks);
+		blob.writePod(m.Transparent);
+		blob.writePod(m.Smoothness);
+		blob.writePod(m.Metallic);
+		blob.writePod(m.RefractiveIndex);
+		blob.writePod(m.Sigma);
+		blob.writePod(m.specularTint);
+		blob.writePod(m.anisotropic);
+		blob.writePod(m.sheen);
+		blob.writePod(m.sheenTint);
+		blob.writePod(m.clearcoat);
+		blob.writePod(m.clearcoatGloss);
+		blob.writePod(m.specularTrans);
+		blob.writePod(m.diffuseTrans);
+		blob.writePod(m.DiffuseMapIdx);
+		blob.writePod(m.NormalMapIdx);
+	}
+
+	bool readMaterial(WCacheCursor& cursor, WMaterial& m)
+	{
+		cursor.readString(m.Name);
+		cursor.readString(m.DiffuseMapName);
+		cursor.readString(m.NormalMapName);
+		cursor.readString(m.Shader);
+		cursor.readPod(m.MatIdx);
+		cursor.readPod(m.Albedo);
+		cursor.readPod(m.TransColor);
+		cursor.readPod(m.Emission);
+		cursor.readPod(m.F0);
+		cursor.readPod(m.k);
+		cursor.readPod(m.kd);
+		cursor.readPod(m.ks);
+		cursor.readPod(m.Transparent);
+		cursor.readPod(m.Smoothness);
+		cursor.readPod(m.Metallic);
+		cursor.readPod(m.RefractiveIndex);
+		cursor.readPod(m.Sigma);
+		cursor.readPod(m.specularTint);
+		cursor.readPod(m.anisotropic);
+		cursor.readPod(m.sheen);
+		cursor.readPod(m.sheenTint);
+		cursor.readPod(m.clearcoat);
+		cursor.readPod(m.clearcoatGloss);
+		cursor.readPod(m.specularTrans);
+		cursor.readPod(m.diffuseTrans);
+		cursor.readPod(m.DiffuseMapIdx);
+		return cursor.readPod(m.NormalMapIdx);
+	}
+
+	// Field by field, the struct has padding that must not reach the cache
+	void writeGeometryRecord(WCacheBlob& blob, const WGeometryRecord& g)
+	{
+		blob.writePod(g.vertexOffsetInBytes);
+		blob.writePod(g.normalOffsetInBytes);
+		blob.writePod(g.texCoordOffsetInBytes);
+		blob.writePod(g.vertexCount);
+		blob.writePod(g.indexOffsetInBytes);
+		blob.writePod(g.indexCount);
+		blob.writePod(g.materialIdOffset);
+		blob.writePod(g.floatTexCoords);
+	}
+
+	bool readGeometryRecord(WCacheCursor& cursor, WGeometryRecord& g)
+	{
+		cursor.readPod(g.vertexOffsetInBytes);
+		cursor.readPod(g.normalOffsetInBytes);
+		cursor.readPod(g.texCoordOffsetInBytes);
+		cursor.readPod(g.vertexCount);
+		cursor.readPod(g.indexOffsetInBytes);
+		cursor.readPod(g.indexCount);
+		cursor.readPod(g.materialIdOffset);
+		return cursor.readPod(g.floatTexCoords);
+	}
+
+	void writeRenderItem(WCacheBlob& blob, const WRenderItem& r)
+	{
+		blob.writeString(r.objName);
+		blob.writeString(r.materialName);
+		blob.writeString(r.geometryName);
+		blob.writePod(r.matIdx);
+		blob.writePod(r.objIdx);
+		blob.writePod(r.vertexOffsetInBytes);
+		blob.writePod(r.normalOffsetInBytes);
+		blob.writePod(r.texCoordOffsetInBytes);
+		blob.writePod(r.vertexCount);
+		blob.writePod(r.indexOffsetInBytes);
+		blob.writePod(r.indexCount);
+		blob.writePod(r.materialIdOffset);
+		blob.writePod(r.floatTexCoords);
+		blob.writePod(r.lodLevel);
+		blob.writePod(static_cast<UINT32>(r.lodDistances.size()));
+		for (float distance : r.lodDistances)
+			blob.writePod(distance);
+		blob.writePod(r.lodSelected);
+		DirectX::XMFLOAT4X4 transform;
+		DirectX::XMStoreFloat4x4(&transform, r.transform);
+		blob.writePod(transform);
+		blob.writePod(r.translation);
+		blob.writePod(r.rotation);
+		blob.writePod(r.scaling);
+		blob.writePod(r.transformNode);
+	}
+
+	bool readRenderItem(WCacheCursor& cursor, WRenderItem& r)
+	{
+		cursor.readString(r.objName);
+		cursor.readString(r.materialName);
+		cursor.readString(r.geometryName);
+		cursor.readPod(r.matIdx);
+		cursor.readPod(r.objIdx);
+		cursor.readPod(r.vertexOffsetInBytes);
+		cursor.readPod(r.normalOffsetInBytes);
+		cursor.readPod(r.texCoordOffsetInBytes);
+		cursor.readPod(r.vertexCount);
+		cursor.readPod(r.indexOffsetInBytes);
+		cursor.readPod(r.indexCount);
+		cursor.readPod(r.materialIdOffset);
+		cursor.readPod(r.floatTexCoords);
+		cursor.readPod(r.lodLevel);
+		UINT32 lodDistanceCount = 0;
+		cursor.readPod(lodDistanceCount);
+		if (lodDistanceCount > WMaxLodLevels)
+			return false;
+		r.lodDistances.resize(lodDistanceCount);
+		for (auto& distance : r.lodDistances)
+			cursor.readPod(distance);
+		cursor.readPod(r.lodSelected);
+		DirectX::XMFLOAT4X4 transform;
+		cursor.readPod(transform);
+		r.transform = DirectX::XMLoadFloat4x4(&transform);
+		cursor.readPod(r.translation);
+		cursor.readPod(r.rotation);
+		cursor.readPod(r.scaling);
+		return cursor.readPod(r.transformNode);
+	}
 }
 
-DirectX::XMFLOAT4 parseFloat4(const char* text)
+void WSceneDescParser::bindBufferViews()
 {
-	std::istringstream tstream(text);
-	std::string tmpVal;
-	DirectX::XMFLOAT4 floatVal;
-	std::getline(tstream, tmpVal, ',');
-	floatVal.x = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.y = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.z = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.w = std::stof(tmpVal);
-	return floatVal;
+	mVertexView = WBufferView<tinyobj::real_t>(mVertexBuffer);
+	mNormalView = WBufferView<tinyobj::real_t>(mNormalBuffer);
+	mTexCoordView = WBufferView<tinyobj::real_t>(mTexCoordBuffer);
+	mPackedNormalView = WBufferView<UINT32>(mPackedNormalBuffer);
+	mPackedTexCoordView = WBufferView<UINT32>(mPackedTexCoordBuffer);
+	mVertexAttributeView = WBufferView<tinyobj::real_t>(mVertexAttributeBuffer);
+	mPackedVertexAttributeView = WBufferView<UINT32>(mPackedVertexAttributeBuffer);
+	mIndexView = WBufferView<UINT32>(mIndexBuffer);
+	mNormalIndexView = WBufferView<INT32>(mNormalIndexBuffer);
+	mTexCoordIndexView = WBufferView<INT32>(mTexCoordIndexBuffer);
+	mMaterialIdView = WBufferView<UINT32>(mMaterialIdBuffer);
 }
 
-DirectX::XMFLOAT4 parseFloat4(std::string text)
+bool WSceneDescParser::loadSceneCache(const std::string& cacheFilename, UINT64 sceneHash)
+{
+	if (!mSceneCache.Open(cacheFilename))
+		return false;
+	if (mSceneCache.sceneHash() != sceneHash)
+	{
+		mSceneCache.Close();
+		return false;
+	}
+
+	// Every referenced OBJ must still have the content it had when the cache was written
+	WCacheCursor dependencies = mSceneCache.cursor(CACHE_DEPENDENCIES);
+	UINT32 dependencyCount = 0;
+	dependencies.readPod(dependencyCount);
+	for (UINT32 i = 0; i < dependencyCount && dependencies.valid(); i++)
+	{
+		std::string filename;
+		UINT64 cachedHash = 0, currentHash = 0;
+		dependencies.readString(filename);
+		if (dependencies.readPod(cachedHash) &&
+			(!hashFileContent(filename, currentHash) || currentHash != cachedHash))
+		{
+			mSceneCache.Close();
+			return false;
+		}
+	}
+
+	bool valid = dependencies.valid();
+	UINT32 count = 0;
+	WCacheCursor geometries = mSceneCache.cursor(CACHE_GEOMETRY_RECORDS);
+	geometries.readPod(count);
+	for (UINT32 i = 0; i < count && geometries.valid(); i++)
+	{
+		std::string name;
+		WGeometryRecord record = {};
+		geometries.readString(name);
+		if (readGeometryRecord(geometries, record))
+			mGeometryMap[name] = record;
+	}
+	valid = valid && geometries.valid();
+
+	WCacheCursor materials = mSceneCache.cursor(CACHE_MATERIAL_RECORDS);
+	materials.readPod(count);
+	for (UINT32 i = 0; i < count && materials.valid(); i++)
+	{
+		WMaterial material;
+		if (readMaterial(materials, material))
+			mMaterialItems[material.Name] = std::move(material);
+	}
+	valid = valid && materials.valid();
+
+	WCacheCursor textures = mSceneCache.cursor(CACHE_TEXTURE_RECORDS);
+	textures.readPod(count);
+	for (UINT32 i = 0; i < count && textures.valid(); i++)
+	{
+		WTextureRecord texture;
+		textures.readString(texture.Name);
+		textures.readWString(texture.Filename);
+		textures.readPod(texture.TextureIdx);
+		if (textures.readPod(texture.TextureType))
+			mTextureItems[texture.Name] = std::move(texture);
+	}
+	valid = valid && textures.valid();
+
+	WCacheCursor renderItems = mSceneCache.cursor(CACHE_RENDER_ITEMS);
+	renderItems.readPod(count);
+	for (UINT32 i = 0; i < count && renderItems.valid(); i++)
+	{
+		WRenderItem r;
+		if (readRenderItem(renderItems, r))
+			mRenderItems[r.objName] = std::move(r);
+	}
+	valid = valid && renderItems.valid();
+
+	WCacheCursor transformNodes = mSceneCache.cursor(CACHE_TRANSFORM_NODES);
+	transformNodes.readPod(count);
+	for (UINT32 i = 0; i < count && transformNodes.valid(); i++)
+	{
+		INT32 parent = -1, object = -1;
+		UINT32 subtreeEnd = 0;
+		std::string name;
+		DirectX::XMFLOAT3X4 local;
+		transformNodes.readPod(parent);
+		transformNodes.readPod(subtreeEnd);
+		transformNodes.readPod(object);
+		transformNodes.readString(name);
+		if (transformNodes.readPod(local))
+		{
+			mTransformHierarchy.addNode(parent, object, name, DirectX::XMLoadFloat3x4(&local));
+			mTransformHierarchy.subtreeEnd.back() = subtreeEnd;
+		}
+	}
+	valid = valid && transformNodes.valid() && mTransformHierarchy.size() >= mRenderItems.size();
+	if (valid)
+		mTransformHierarchy.update();
+
+	WCacheCursor animations = mSceneCache.cursor(CACHE_ANIMATIONS);
+	animations.readPod(count);
+	for (UINT32 i = 0; i < count && animations.valid(); i++)
+	{
+		UINT32 objIdx = 0, target = 0, interpolation = 0, keyCount = 0;
+		UINT8 loop = 0;
+		animations.readPod(objIdx);
+		animations.readPod(target);
+		animations.readPod(interpolation);
+		animations.readPod(loop);
+		animations.readPod(keyCount);
+		std::vector<float> times(keyCount);
+		std::vector<DirectX::XMFLOAT3> values(keyCount);
+		for (UINT32 k = 0; k < keyCount && animations.valid(); k++)
+		{
+			animations.readPod(times[k]);
+			animations.readPod(values[k]);
+		}
+		if (animations.valid() && keyCount > 0 && target <= ANIMATION_SCALE && objIdx < mRenderItems.size())
+			mAnimations.addChannel(objIdx, static_cast<WANIMATION_TARGET>(target),
+				static_cast<WINTERPOLATION>(interpolation), loop != 0, times, values);
+	}
+	valid = valid && animations.valid() && mAnimations.size() == count;
+
+	WCacheCursor camera = mSceneCache.cursor(CACHE_CAMERA);
+	valid = valid && camera.readPod(mCameraConfig);
+
+	WCacheCursor includes = mSceneCache.cursor(CACHE_INCLUDES);
+	includes.readPod(count);
+	for (UINT32 i = 0; i < count && includes.valid(); i++)
+	{
+		std::string file;
+		if (includes.readString(file))
+			mIncludeFiles.push_back(std::move(file));
+	}
+	includes.readPod(count);
+	for (UINT32 i = 0; i < count && includes.valid(); i++)
+	{
+		WSubSceneRecord record;
+		UINT8 hasBounds = 0;
+		includes.readString(record.file);
+		includes.readPod(record.transformNode);
+		includes.readPod(hasBounds);
+		includes.readPod(record.boundsMin);
+		record.hasBounds = hasBounds != 0;
+		if (includes.readPod(record.boundsMax) && record.transformNode < mTransformHierarchy.size())
+			mSubScenes.push_back(std::move(record));
+	}
+	valid = valid && includes.valid() && mSubScenes.size() == count;
+
+	WCacheCursor instanceBatches = mSceneCache.cursor(CACHE_INSTANCE_BATCHES);
+	instanceBatches.readPod(count);
+	for (UINT32 i = 0; i < count && instanceBatches.valid(); i++)
+	{
+		WInstanceBatch batch;
+		instanceBatches.readString(batch.geometryName);
+		instanceBatches.readString(batch.materialName);
+		instanceBatches.readPod(batch.matIdx);
+		instanceBatches.readPod(batch.first);
+		if (instanceBatches.readPod(batch.count))
+			mInstanceTable.batches.push_back(std::move(batch));
+	}
+	instanceBatches.readPod(count);
+	for (UINT32 i = 0; i < count && instanceBatches.valid(); i++)
+	{
+		std::string file;
+		if (instanceBatches.readString(file))
+			mInstanceFiles.push_back(std::move(file));
+	}
+	valid = valid && instanceBatches.valid();
+	auto instanceTransforms = mSceneCache.view<DirectX::XMFLOAT3X4>(CACHE_INSTANCE_TRANSFORMS);
+	auto instanceBatchIds = mSceneCache.view<UINT32>(CACHE_INSTANCE_BATCH_IDS);
+	valid = valid && instanceTransforms.size() == instanceBatchIds.size();
+	if (valid)
+	{
+		mInstanceTable.transforms.assign(instanceTransforms.begin(), instanceTransforms.end());
+		mInstanceTable.batchIds.assign(instanceBatchIds.begin(), instanceBatchIds.end());
+	}
+
+	if (!valid)
+	{
+		mGeometryMap.clear();
+		mMaterialItems.clear();
+		mTextureItems.clear();
+		mRenderItems.clear();
+		mTransformHierarchy.clear();
+		mAnimations.clear();
+		mCameraConfig = WCamereConfig();
+		mInstanceTable.clear();
+		mInstanceFiles.clear();
+		mIncludeFiles.clear();
+		mSubScenes.clear();
+		mSceneCache.Close();
+		return false;
+	}
+
+	auto lights = mSceneCache.view<ParallelogramLight>(CACHE_LIGHTS);
+	mLights.assign(lights.begin(), lights.end());
+
+	mVertexView = mSceneCache.view<tinyobj::real_t>(CACHE_VERTEX_BUFFER);
+	mNormalView = mSceneCache.view<tinyobj::real_t>(CACHE_NORMAL_BUFFER);
+	mTexCoordView = mSceneCache.view<tinyobj::real_t>(CACHE_TEXCOORD_BUFFER);
+	mPackedNormalView = mSceneCache.view<UINT32>(CACHE_PACKED_NORMAL_BUFFER);
+	mPackedTexCoordView = mSceneCache.view<UINT32>(CACHE_PACKED_TEXCOORD_BUFFER);
+	mVertexAttributeView = mSceneCache.view<tinyobj::real_t>(CACHE_VERTEX_ATTRIBUTE_BUFFER);
+	mPackedVertexAttributeView = mSceneCache.view<UINT32>(CACHE_PACKED_VERTEX_ATTRIBUTE_BUFFER);
+	mIndexView = mSceneCache.view<UINT32>(CACHE_INDEX_BUFFER);
+	mNormalIndexView = mSceneCache.view<INT32>(CACHE_NORMAL_INDEX_BUFFER);
+	mTexCoordIndexView = mSceneCache.view<INT32>(CACHE_TEXCOORD_INDEX_BUFFER);
+	mMaterialIdView = mSceneCache.view<UINT32>(CACHE_MATERIAL_ID_BUFFER);
+	return true;
+}
+
+bool WSceneDescParser::saveSceneCache(WSceneCacheWriter& writer, const std::string& cacheFilename, UINT64 sceneHash)
+{
+	std::vector<std::string> dependencyFiles = mInstanceFiles;
+	dependencyFiles.insert(dependencyFiles.end(), mIncludeFiles.begin(), mIncludeFiles.end());
+	for (const auto& gItem : mGeometryMap)
+		if (!isLodGeometryName(gItem.first))
+			dependencyFiles.push_back(gItem.first);
+	WCacheBlob& dependencies = writer.addBlob(CACHE_DEPENDENCIES);
+	dependencies.writePod(static_cast<UINT32>(dependencyFiles.size()));
+	for (const auto& file : dependencyFiles)
+	{
+		UINT64 hash = 0;
+		if (!hashFileContent(file, hash))
+			return false;
+		dependencies.writeString(file);
+		dependencies.writePod(hash);
+	}
+
+	// Streamed geometry is in the file already
+	if (!writer.isStreaming())
+	{
+		writer.addSection(CACHE_VERTEX_BUFFER, mVertexBuffer);
+		writer.addSection(CACHE_NORMAL_BUFFER, mNormalBuffer);
+		writer.addSection(CACHE_TEXCOORD_BUFFER, mTexCoordBuffer);
+		writer.addSection(CACHE_PACKED_NORMAL_BUFFER, mPackedNormalBuffer);
+		writer.addSection(CACHE_PACKED_TEXCOORD_BUFFER, mPackedTexCoordBuffer);
+		writer.addSection(CACHE_VERTEX_ATTRIBUTE_BUFFER, mVertexAttributeBuffer);
+		writer.addSection(CACHE_PACKED_VERTEX_ATTRIBUTE_BUFFER, mPackedVertexAttributeBuffer);
+		writer.addSection(CACHE_INDEX_BUFFER, mIndexBuffer);
+		writer.addSection(CACHE_NORMAL_INDEX_BUFFER, mNormalIndexBuffer);
+		writer.addSection(CACHE_TEXCOORD_INDEX_BUFFER, mTexCoordIndexBuffer);
+	}
+	writer.addSection(CACHE_MATERIAL_ID_BUFFER, mMaterialIdBuffer);
+	writer.addSection(CACHE_LIGHTS, mLights);
+
+	WCacheBlob& geometries = writer.addBlob(CACHE_GEOMETRY_RECORDS);
+	geometries.writePod(static_cast<UINT32>(mGeometryMap.size()));
+	for (const auto& gItem : mGeometryMap)
+	{
+		geometries.writeString(gItem.first);
+		writeGeometryRecord(geometries, gItem.second);
+	}
+
+	WCacheBlob& materials = writer.addBlob(CACHE_MATERIAL_RECORDS);
+	materials.writePod(static_cast<UINT32>(mMaterialItems.size()));
+	for (const auto& mItem : mMaterialItems)
+		writeMaterial(materials, mItem.second);
+
+	WCacheBlob& textures = writer.addBlob(CACHE_TEXTURE_RECORDS);
+	textures.writePod(static_cast<UINT32>(mTextureItems.size()));
+	for (const auto& tItem : mTextureItems)
+	{
+		const auto& t = tItem.second;
+		textures.writeString(t.Name);
+		textures.writeWString(t.Filename);
+		textures.writePod(t.TextureIdx);
+		textures.writePod(t.TextureType);
+	}
+
+	WCacheBlob& renderItems = writer.addBlob(CACHE_RENDER_ITEMS);
+	renderItems.writePod(static_cast<UINT32>(mRenderItems.size()));
+	for (const auto& rItem : mRenderItems)
+		writeRenderItem(renderItems, rItem.second);
+
+	WCacheBlob& transformNodes = writer.addBlob(CACHE_TRANSFORM_NODES);
+	transformNodes.writePod(static_cast<UINT32>(mTransformHierarchy.size()));
+	for (size_t i = 0; i < mTransformHierarchy.size(); i++)
+	{
+		transformNodes.writePod(mTransformHierarchy.parents[i]);
+		transformNodes.writePod(mTransformHierarchy.subtreeEnd[i]);
+		transformNodes.writePod(mTransformHierarchy.objects[i]);
+		transformNodes.writeString(mTransformHierarchy.names[i]);
+		transformNodes.writePod(mTransformHierarchy.locals[i]);
+	}
+
+	WCacheBlob& animations = writer.addBlob(CACHE_ANIMATIONS);
+	animations.writePod(static_cast<UINT32>(mAnimations.size()));
+	for (size_t c = 0; c < mAnimations.size(); c++)
+	{
+		animations.writePod(mAnimations.objIdx[c]);
+		animations.writePod(mAnimations.targets[c]);
+		animations.writePod(mAnimations.interpolations[c]);
+		animations.writePod(mAnimations.loops[c]);
+		animations.writePod(mAnimations.keyCounts[c]);
+		for (UINT32 k = mAnimations.firstKeys[c]; k < mAnimations.firstKeys[c] + mAnimations.keyCounts[c]; k++)
+		{
+			animations.writePod(mAnimations.keyTimes[k]);
+			animations.writePod(mAnimations.keyValues[k]);
+		}
+	}
+
+	writer.addBlob(CACHE_CAMERA).writePod(mCameraConfig);
+
+	// Lazy sub-scenes have caches of their own
+	WCacheBlob& includes = writer.addBlob(CACHE_INCLUDES);
+	includes.writePod(static_cast<UINT32>(mIncludeFiles.size()));
+	for (const auto& file : mIncludeFiles)
+		includes.writeString(file);
+	includes.writePod(static_cast<UINT32>(mSubScenes.size()));
+	for (const auto& record : mSubScenes)
+	{
+		includes.writeString(record.file);
+		includes.writePod(record.transformNode);
+		includes.writePod(static_cast<UINT8>(record.hasBounds ? 1 : 0));
+		includes.writePod(record.boundsMin);
+		includes.writePod(record.boundsMax);
+	}
+
+	WCacheBlob& instanceBatches = writer.addBlob(CACHE_INSTANCE_BATCHES);
+	instanceBatches.writePod(static_cast<UINT32>(mInstanceTable.batches.size()));
+	for (const auto& batch : mInstanceTable.batches)
+	{
+		instanceBatches.writeString(batch.geometryName);
+		instanceBatches.writeString(batch.materialName);
+		instanceBatches.writePod(batch.matIdx);
+		instanceBatches.writePod(batch.first);
+		instanceBatches.writePod(batch.count);
+	}
+	instanceBatches.writePod(static_cast<UINT32>(mInstanceFiles.size()));
+	for (const auto& file : mInstanceFiles)
+		instanceBatches.writeString(file);
+	writer.addSection(CACHE_INSTANCE_TRANSFORMS, mInstanceTable.transforms);
+	writer.addSection(CACHE_INSTANCE_BATCH_IDS, mInstanceTable.batchIds);
+
+	return writer.Write(cacheFilename, sceneHash);
+}
+
+namespace
+{
+	// Zeros unless "text" holds exactly the expected number of values
+	template<typename T>
+	T parseFloatsOrZero(const char* text)
+	{
+		T value;
+		if (!text || !parseFloats(text, reinterpret_cast<float*>(&value), sizeof(T) / sizeof(float)))
+			memset(&value, 0, sizeof(value));
+		return value;
+	}
+}
+
+DirectX::XMFLOAT3 parseFloat3(const char* text)
+{
+	return parseFloatsOrZero<DirectX::XMFLOAT3>(text);
+}
+
+DirectX::XMFLOAT4 parseFloat4(const char* text)
 {
-	std::istringstream tstream(text);
-	std::string tmpVal;
-	DirectX::XMFLOAT4 floatVal;
-	std::getline(tstream, tmpVal, ',');
-	floatVal.x = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.y = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.z = std::stof(tmpVal);
-	std::getline(tstream, tmpVal, ',');
-	floatVal.w = std::stof(tmpVal);
-	return floatVal;
+	return parseFloatsOrZero<DirectX::XMFLOAT4>(text);
 }
 
+// Rows are separated by ';'
 DirectX::XMFLOAT4X4 parseFloat4x4(const char* text)
 {
-	DirectX::XMFLOAT4X4 xMatrix;
-	DirectX::XMFLOAT4 r0;
-	DirectX::XMFLOAT4 r1;
-	DirectX::XMFLOAT4 r2;
-	DirectX::XMFLOAT4 r3;
-	std::istringstream tsream(text);
-	std::string tmpRow;
-	// Parse 4 rows
-	std::getline(tsream, tmpRow, ';');
-	r0 = parseFloat4(tmpRow);
-	std::getline(tsream, tmpRow, ';');
-	r1 = parseFloat4(tmpRow);
-	std::getline(tsream, tmpRow, ';');
-	r2 = parseFloat4(tmpRow);
-	std::getline(tsream, tmpRow, ';');
-	r3 = parseFloat4(tmpRow);
-	// Store to Matrix
-	xMatrix(0, 0) = r0.x;
-	xMatrix(0, 1) = r0.y;
-	xMatrix(0, 2) = r0.z;
-	xMatrix(0, 3) = r0.w;
-
-	xMatrix(1, 0) = r1.x;
-	xMatrix(1, 1) = r1.y;
-	xMatrix(1, 2) = r1.z;
-	xMatrix(1, 3) = r1.w;
-
-	xMatrix(2, 0) = r2.x;
-	xMatrix(2, 1) = r2.y;
-	xMatrix(2, 2) = r2.z;
-	xMatrix(2, 3) = r2.w;
-
-	xMatrix(3, 0) = r3.x;
-	xMatrix(3, 1) = r3.y;
-	xMatrix(3, 2) = r3.z;
-	xMatrix(3, 3) = r3.w;
-
-	return xMatrix;
+	return parseFloatsOrZero<DirectX::XMFLOAT4X4>(text);
 }
 
 void getIndicesFromStructShape(
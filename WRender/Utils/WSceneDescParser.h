@@ -5,18 +5,23 @@
 #include <map>
 #include <DirectXMath.h>
 #include <../FrameResource.h>
-#include <../Include/tinyxml2.h>
 #include <../Include/tiny_obj_loader.h>
+#include "WSceneCache.h"
+#include "WMeshData.h"
+#include "WInstanceTable.h"
+#include "WTransformHierarchy.h"
+#include "WAnimation.h"
+#include "WThreadPool.h"
+#include "WXmlReader.h"
+#include "WSubSceneStreamer.h"
+#include "WGeometryPageStore.h"
 
 using Microsoft::WRL::ComPtr;
 
-#pragma comment(lib, "tinyxml2.lib")
-
 // Some useful help functions
+// Comma separated values, malformed text gives zeros
 DirectX::XMFLOAT3 parseFloat3(const char* text);
-DirectX::XMFLOAT3 parseFloat3(std::string text);
 DirectX::XMFLOAT4 parseFloat4(const char* text);
-DirectX::XMFLOAT4 parseFloat4(std::string text);
 DirectX::XMFLOAT4X4 parseFloat4x4(const char* text);
 void getIndicesFromStructShape(
 	const std::vector<tinyobj::shape_t>& p_shapes,
@@ -25,6 +30,8 @@ void getIndicesFromStructShape(
 void getIndicesFromStructIndex(const std::vector<tinyobj::index_t>& p_indices, std::vector<UINT32>& s_indices);
 void getNormalIndicesFromStructIndex(const std::vector<tinyobj::index_t>& p_indices, std::vector<INT32>& n_indices);
 void getTexCoordIndicesFromStructIndex(const std::vector<tinyobj::index_t>& p_indices, std::vector<INT32>& t_indices);
+// Thread-safe, "message" receives the loader error or warnings. Missing normals are left empty.
+bool loadObjMesh(const std::string& filename, WMeshData& mesh, std::string& message);
 void autoGenerateVertexNormals(const std::vector<tinyobj::real_t>& vertices, const std::vector<UINT32>& indices, std::vector<tinyobj::real_t>& normals);
 std::wstring string2wstring(const std::string& str);
 
@@ -34,38 +41,183 @@ struct WCamereConfig
 	DirectX::XMFLOAT3 direction = { 0.0f, 0.0f, 1.0f };
 };
 
+// LOD levels live in the geometry map next to their source file, level 0 is the file itself
+const UINT32 WMaxLodLevels = 8;
+
+inline std::string lodGeometryName(const std::string& geometryName, UINT32 level)
+{
+	return level == 0 ? geometryName : geometryName + "|lod" + std::to_string(level);
+}
+
+inline bool isLodGeometryName(const std::string& name)
+{
+	return name.find("|lod") != std::string::npos;
+}
+
+// Per-triangle material ids are packed as narrow as the material count allows.
+// The all-ones value of a width means "use the object's material".
+inline UINT32 materialIdBits(size_t materialCount)
+{
+	return materialCount < 0xFF ? 8 : materialCount < 0xFFFF ? 16 : 32;
+}
+
 class WSceneDescParser
 {
 public:
 	WSceneDescParser() = default;
-	void Parse(const char* xmlDoc);
+	// Returns false if the XML cannot be parsed
+	bool Parse(const char* xmlDoc);
+	// Walks the scene XML without loading any geometry, used for hot-reload diffs.
+	// Returns false if the XML cannot be parsed.
+	bool ParseDescription(const char* xmlDoc);
+	// The binary cache is written next to the scene file as "<scene>.xml.wcache"
+	void setUseSceneCache(bool useSceneCache) { mUseSceneCache = useSceneCache; }
+	bool isLoadedFromCache() const { return mLoadedFromCache; }
+	// The parallel WObjReader is used by default, tiny_obj_loader stays available for comparison
+	void setUseFastObjReader(bool useFastObjReader) { mUseFastObjReader = useFastObjReader; }
+	// Removes degenerate and duplicate triangles and unreferenced vertices right after loading
+	void setCleanupMeshes(bool cleanupMeshes) { mCleanupMeshes = cleanupMeshes; }
+	// Welded scenes have one index stream for all attributes. Their normals and texcoords are
+	// interleaved per vertex in the vertex attribute buffers, the separate normal and texcoord
+	// buffers and their index buffers stay empty.
+	void setWeldVertices(bool weldVertices) { mWeldVertices = weldVertices; }
+	bool isWelded() const { return mWeldVertices; }
+	// Sorts every mesh's triangles spatially and renumbers its vertices in first-use order
+	void setReorderForLocality(bool reorderForLocality) { mReorderForLocality = reorderForLocality; }
+	// Quantized scenes keep normals and texcoords only in the packed buffers (see WVertexCodec.h)
+	void setQuantizeAttributes(bool quantizeAttributes) { mQuantizeAttributes = quantizeAttributes; }
+	bool isQuantized() const { return mQuantizeAttributes; }
+	// Triangle count ratio between consecutive LOD levels requested by <lod> policies
+	void setLodReduction(float lodReduction) { mLodReduction = lodReduction; }
+	// Leaves the geometry buffers in the scene cache and reads them through a WGeometryPageStore
+	// holding at most "residentBytes", 0 keeps them in memory. Needs the scene cache, a scene
+	// whose cache cannot be created keeps its geometry in memory. On a cache miss the meshes are
+	// flattened into the cache a batch of at most "residentBytes" at a time, the buffers are never
+	// built in memory; the loaded meshes themselves are released as their batches are written.
+	void setPagedGeometry(UINT64 residentBytes) { mPagedGeometryBytes = residentBytes; }
+	bool isGeometryPaged() const { return mGeometryPages.isOpen(); }
 public:
 	std::map<std::string, WGeometryRecord>& getGeometryMap() { return mGeometryMap; };
+	const std::map<std::string, WGeometryRecord>& getGeometryMap() const { return mGeometryMap; };
+	// Referenced OBJ files, in first-use order after a fresh parse. LOD levels are not listed.
+	const std::vector<std::string>& getGeometryFiles() const { return mGeometryFiles; }
 	std::map<std::string, WRenderItem>& getRenderItems() { return mRenderItems; };
+	const std::map<std::string, WRenderItem>& getRenderItems() const { return mRenderItems; };
 	std::map<std::string, WMaterial>& getMaterialItems() { return mMaterialItems; };
+	const std::map<std::string, WMaterial>& getMaterialItems() const { return mMaterialItems; };
 	std::map<std::string, WTextureRecord>& getTextureItems() { return mTextureItems; };
-	std::vector<tinyobj::real_t>& getVertexBuffer() { return mVertexBuffer; };
-	std::vector<tinyobj::real_t>& getNormalBuffer() { return mNormalBuffer; };
-	std::vector<tinyobj::real_t>& getTexCoordBuffer() { return mTexCoordBuffer; };
-	std::vector<UINT32>& getIndexBuffer() { return mIndexBuffer; };
-	std::vector<INT32>& getNormalIndexBuffer() { return mNormalIndexBuffer; };
-	std::vector<INT32>& getTexCoordIndexBuffer() { return mTexCoordIndexBuffer; };
+	const std::map<std::string, WTextureRecord>& getTextureItems() const { return mTextureItems; };
+	// Buffers are either owned by the parser or zero-copy views into the mapped scene cache
+	WBufferView<tinyobj::real_t> getVertexBuffer() const { return mVertexView; };
+	WBufferView<tinyobj::real_t> getNormalBuffer() const { return mNormalView; };
+	WBufferView<tinyobj::real_t> getTexCoordBuffer() const { return mTexCoordView; };
+	WBufferView<UINT32> getPackedNormalBuffer() const { return mPackedNormalView; };
+	WBufferView<UINT32> getPackedTexCoordBuffer() const { return mPackedTexCoordView; };
+	// SVertexAttributes of welded scenes, SPackedVertexAttributes when they are also quantized
+	WBufferView<tinyobj::real_t> getVertexAttributeBuffer() const { return mVertexAttributeView; };
+	WBufferView<UINT32> getPackedVertexAttributeBuffer() const { return mPackedVertexAttributeView; };
+	WBufferView<UINT32> getIndexBuffer() const { return mIndexView; };
+	WBufferView<INT32> getNormalIndexBuffer() const { return mNormalIndexView; };
+	WBufferView<INT32> getTexCoordIndexBuffer() const { return mTexCoordIndexView; };
+	// Per-triangle material ids of multi-material OBJ files, packed materialIdBits() wide into 32-bit words
+	WBufferView<UINT32> getMaterialIdBuffer() const { return mMaterialIdView; };
+	// The buffer getters above return empty views for paged geometry, read the CACHE_*_BUFFER
+	// sections from here instead
+	WGeometryPageStore& getGeometryPages() { return mGeometryPages; }
+	UINT32 getMaterialIdBits() const { return materialIdBits(mMaterialItems.size()); }
+	const WInstanceTable& getInstanceTable() const { return mInstanceTable; }
+	// Every render item has a node (WRenderItem::transformNode), <group> elements add the inner nodes
+	const WTransformHierarchy& getTransformHierarchy() const { return mTransformHierarchy; }
+	// Keyframe tracks of <animation> elements, targeting render items by objIdx
+	const WAnimationSet& getAnimations() const { return mAnimations; }
+	// Binary sidecar files referenced by <instances file="...">
+	const std::vector<std::string>& getInstanceFiles() const { return mInstanceFiles; }
+	// Scene files pulled in by <include> elements without lazy="true"
+	const std::vector<std::string>& getIncludeFiles() const { return mIncludeFiles; }
+	// <include lazy="true"> elements, left to WSubSceneStreamer. A streamed sub-scene does not
+	// stream lazy includes of its own.
+	const std::vector<WSubSceneRecord>& getSubScenes() const { return mSubScenes; }
+	// Geometry and instance data of the scene, owned or mapped from the cache. Paged geometry
+	// counts with its resident pages.
+	UINT64 memoryBytes() const;
 	WCamereConfig& getCameraConfig() { return mCameraConfig; };
 	std::vector<ParallelogramLight>& getLights() { return mLights; }
 private:
-	tinyxml2::XMLDocument mXMLParser;
+	bool parseSceneXML(const char* xmlDoc);
+	// Walks the <scene> of one file, its top level elements are children of "parentNode"
+	bool parseSceneFile(const std::string& sceneFile, INT32 parentNode, std::map<std::string, size_t>& geometryFileIdx);
+	// The handlers below consume the element the reader stands on
+	bool parseInstances(WXmlReader& reader, const std::string& geometryName);
+	// "parentNode" is the hierarchy node of the enclosing <group>, -1 at the top level
+	void parseObject(WXmlReader& reader, INT32 parentNode, std::map<std::string, size_t>& geometryFileIdx);
+	void parseGroup(WXmlReader& reader, INT32 parentNode, std::map<std::string, size_t>& geometryFileIdx);
+	// Eager includes are parsed in place, cameras of included files are ignored
+	void parseInclude(WXmlReader& reader, INT32 parentNode, std::map<std::string, size_t>& geometryFileIdx);
+	void parseAnimation(WXmlReader& reader, UINT32 objIdx);
+	// Adds the material unless one with the same name exists, returns its name
+	std::string parseMaterial(WXmlReader& reader);
+	// With "geometryStream" the geometry buffers go to the cache being written instead of memory,
+	// false when that fails
+	bool loadGeometry(WSceneCacheWriter* geometryStream);
+	bool flattenMeshes(const std::vector<std::string>& names, std::vector<WMeshData>& meshes,
+		WSceneCacheWriter* geometryStream);
+	void bindBufferViews();
+	bool loadSceneCache(const std::string& cacheFilename, UINT64 sceneHash);
+	bool saveSceneCache(WSceneCacheWriter& writer, const std::string& cacheFilename, UINT64 sceneHash);
+	// Drops the geometry buffers in favour of pages of the cache file
+	bool pageGeometry(const std::string& cacheFilename);
+private:
 	std::map<std::string, WGeometryRecord> mGeometryMap;
+	std::vector<std::string> mGeometryFiles;
 	std::map<std::string, WRenderItem> mRenderItems;
 	std::map<std::string, WMaterial> mMaterialItems;
 	std::map<std::string, WTextureRecord> mTextureItems;
 	std::vector<tinyobj::real_t> mVertexBuffer;
 	std::vector<tinyobj::real_t> mNormalBuffer;
 	std::vector<tinyobj::real_t> mTexCoordBuffer;
+	std::vector<UINT32> mPackedNormalBuffer;
+	std::vector<UINT32> mPackedTexCoordBuffer;
+	std::vector<tinyobj::real_t> mVertexAttributeBuffer;
+	std::vector<UINT32> mPackedVertexAttributeBuffer;
 	std::vector<UINT32> mIndexBuffer;
 	std::vector<INT32> mNormalIndexBuffer;
 	std::vector<INT32> mTexCoordIndexBuffer;
+	std::vector<UINT32> mMaterialIdBuffer;
 	std::vector<ParallelogramLight> mLights;
 	WCamereConfig mCameraConfig;
+	WInstanceTable mInstanceTable;
+	std::vector<std::string> mInstanceFiles;
+	std::vector<std::string> mIncludeFiles;
+	std::vector<WSubSceneRecord> mSubScenes;
+	// Files being parsed, to catch include cycles
+	std::vector<std::string> mIncludeStack;
+	bool mIncludeFailed = false;
+	WTransformHierarchy mTransformHierarchy;
+	WAnimationSet mAnimations;
+
+	WBufferView<tinyobj::real_t> mVertexView;
+	WBufferView<tinyobj::real_t> mNormalView;
+	WBufferView<tinyobj::real_t> mTexCoordView;
+	WBufferView<UINT32> mPackedNormalView;
+	WBufferView<UINT32> mPackedTexCoordView;
+	WBufferView<tinyobj::real_t> mVertexAttributeView;
+	WBufferView<UINT32> mPackedVertexAttributeView;
+	WBufferView<UINT32> mIndexView;
+	WBufferView<INT32> mNormalIndexView;
+	WBufferView<INT32> mTexCoordIndexView;
+	WBufferView<UINT32> mMaterialIdView;
+
+	bool mUseSceneCache = true;
+	bool mUseFastObjReader = true;
+	bool mCleanupMeshes = false;
+	bool mWeldVertices = false;
+	bool mReorderForLocality = false;
+	bool mQuantizeAttributes = false;
+	float mLodReduction = 0.5f;
+	bool mLoadedFromCache = false;
+	WSceneCacheReader mSceneCache;
+	UINT64 mPagedGeometryBytes = 0;
+	WGeometryPageStore mGeometryPages;
 };
 
 
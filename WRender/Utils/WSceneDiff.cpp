@@ -0,0 +1,216 @@
+#include "WSceneDiff.h"
+#include <set>
+#include <cstring>
+
+namespace
+{
+	template<typename T>
+	inline bool sameBits(const T& a, const T& b)
+	{
+		return memcmp(&a, &b, sizeof(T)) == 0;
+	}
+
+	// Objects given a <transformMatrix> have identity TRS
+	bool sameTransform(const WRenderItem& a, const WRenderItem& b)
+	{
+		return sameBits(a.transform, b.transform) && sameBits(a.translation, b.translation) &&
+			sameBits(a.rotation, b.rotation) && sameBits(a.scaling, b.scaling);
+	}
+
+	// Parameters that only live in the material buffer
+	bool sameMaterialParameters(const WMaterial& a, const WMaterial& b)
+	{
+		return sameBits(a.Albedo, b.Albedo) && sameBits(a.TransColor, b.TransColor) &&
+			sameBits(a.Emission, b.Emission) && sameBits(a.F0, b.F0) &&
+			sameBits(a.k, b.k) && sameBits(a.kd, b.kd) && sameBits(a.ks, b.ks) &&
+			a.Transparent == b.Transparent && a.Smoothness == b.Smoothness && a.Metallic == b.Metallic &&
+			a.RefractiveIndex == b.RefractiveIndex && a.Sigma == b.Sigma && a.specularTint == b.specularTint &&
+			a.anisotropic == b.anisotropic && a.sheen == b.sheen && a.sheenTint == b.sheenTint &&
+			a.clearcoat == b.clearcoat && a.clearcoatGloss == b.clearcoatGloss &&
+			a.specularTrans == b.specularTrans && a.diffuseTrans == b.diffuseTrans;
+	}
+
+	// Properties baked into the SBT, the texture heap or the buffer layout
+	bool sameMaterialLayout(const WMaterial& a, const WMaterial& b)
+	{
+		return a.MatIdx == b.MatIdx && a.Shader == b.Shader &&
+			a.DiffuseMapIdx == b.DiffuseMapIdx && a.NormalMapIdx == b.NormalMapIdx;
+	}
+
+	bool sameLight(const ParallelogramLight& a, const ParallelogramLight& b)
+	{
+		return sameBits(a.corner, b.corner) && sameBits(a.v1, b.v1) && sameBits(a.v2, b.v2) &&
+			sameBits(a.emission, b.emission);
+	}
+
+	// Instances are packed into the object buffer and the TLAS at startup
+	bool sameInstances(const WInstanceTable& a, const WInstanceTable& b)
+	{
+		if (a.batches.size() != b.batches.size() || a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.batches.size(); i++)
+		{
+			const auto& x = a.batches[i];
+			const auto& y = b.batches[i];
+			if (x.geometryName != y.geometryName || x.materialName != y.materialName || x.count != y.count)
+				return false;
+		}
+		return a.empty() || memcmp(a.transforms.data(), b.transforms.data(),
+			a.transforms.size() * sizeof(a.transforms[0])) == 0;
+	}
+
+	// The streamer is set up with these at startup
+	bool sameSubScenes(const std::vector<WSubSceneRecord>& a, const std::vector<WSubSceneRecord>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].file != b[i].file || a[i].transformNode != b[i].transformNode || a[i].hasBounds != b[i].hasBounds ||
+				!sameBits(a[i].boundsMin, b[i].boundsMin) || !sameBits(a[i].boundsMax, b[i].boundsMax))
+				return false;
+		}
+		return true;
+	}
+
+	// Same groups with the same members, locals may differ
+	bool sameHierarchy(const WTransformHierarchy& a, const WTransformHierarchy& b)
+	{
+		return a.parents == b.parents && a.subtreeEnd == b.subtreeEnd && a.objects == b.objects && a.names == b.names;
+	}
+
+	template<typename Map>
+	bool sameKeys(const Map& a, const Map& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib)
+			if (ia->first != ib->first)
+				return false;
+		return true;
+	}
+
+	template<typename T>
+	bool sameNames(const WSceneRegistry<T>& registry, const std::map<std::string, T>& items)
+	{
+		if (registry.size() != items.size())
+			return false;
+		for (const auto& item : items)
+			if (!registry.contains(item.first))
+				return false;
+		return true;
+	}
+}
+
+WSceneChangeSet diffScenes(
+	const WSceneRegistry<WRenderItem>& renderItems,
+	const WSceneRegistry<WMaterial>& materials,
+	const std::map<std::string, WGeometryRecord>& geometryMap,
+	const std::map<std::string, WTextureRecord>& textures,
+	const std::vector<ParallelogramLight>& lights,
+	const WInstanceTable& instances,
+	const WTransformHierarchy& hierarchy,
+	const WAnimationSet& animations,
+	const std::vector<WSubSceneRecord>& subScenes,
+	WSceneDescParser& snapshot,
+	const std::vector<std::string>& modifiedFiles)
+{
+	WSceneChangeSet changes;
+
+	// Meshes
+	std::set<std::string> newMeshes(snapshot.getGeometryFiles().begin(), snapshot.getGeometryFiles().end());
+	for (const auto& mesh : newMeshes)
+		if (geometryMap.find(mesh) == geometryMap.end())
+			changes.meshesAdded.push_back(mesh);
+	for (const auto& gItem : geometryMap)
+		if (!isLodGeometryName(gItem.first) && newMeshes.find(gItem.first) == newMeshes.end())
+			changes.meshesRemoved.push_back(gItem.first);
+	for (const auto& file : modifiedFiles)
+		if (newMeshes.find(file) != newMeshes.end() && geometryMap.find(file) != geometryMap.end())
+			changes.meshesModified.push_back(file);
+	if (!changes.meshesAdded.empty() || !changes.meshesRemoved.empty() || !changes.meshesModified.empty())
+		changes.rebuildReasons.push_back("geometry changed");
+
+	// Materials
+	const auto& newMaterials = snapshot.getMaterialItems();
+	if (!sameNames(materials, newMaterials))
+		changes.rebuildReasons.push_back("material set changed");
+	else
+	{
+		for (const auto& mItem : newMaterials)
+		{
+			const auto& current = materials.at(mItem.first);
+			if (!sameMaterialLayout(current, mItem.second))
+				changes.rebuildReasons.push_back("material " + mItem.first + " changed shader, textures or index");
+			else if (!sameMaterialParameters(current, mItem.second))
+				changes.materialsChanged.push_back(mItem.first);
+		}
+	}
+
+	// Render items
+	const auto& newItems = snapshot.getRenderItems();
+	if (!sameNames(renderItems, newItems))
+		changes.rebuildReasons.push_back("object set changed");
+	else
+	{
+		for (const auto& rItem : newItems)
+		{
+			const auto& current = renderItems.at(rItem.first);
+			const auto& updated = rItem.second;
+			if (current.geometryName != updated.geometryName)
+				changes.rebuildReasons.push_back("object " + rItem.first + " changed geometry");
+			if (current.lodLevel != updated.lodLevel || current.lodDistances != updated.lodDistances)
+				changes.rebuildReasons.push_back("object " + rItem.first + " changed LOD policy");
+			if (current.materialName != updated.materialName)
+			{
+				// A different material is fine as long as the hit group stays the same
+				auto from = materials.find(current.materialName);
+				auto to = materials.find(updated.materialName);
+				if (!from || !to || from->Shader != to->Shader)
+					changes.rebuildReasons.push_back("object " + rItem.first + " changed hit group");
+				else
+					changes.materialAssignmentsChanged.push_back(rItem.first);
+			}
+			if (!sameTransform(current, updated))
+				changes.transformsChanged.push_back(rItem.first);
+		}
+		// Tracks address render items by objIdx, which only holds while the object set is the same
+		changes.animationsChanged = !animations.sameTracks(snapshot.getAnimations());
+	}
+
+	// Groups and includes, objects are covered by their transform above
+	const auto& newHierarchy = snapshot.getTransformHierarchy();
+	if (!sameHierarchy(hierarchy, newHierarchy))
+		changes.rebuildReasons.push_back("group hierarchy changed");
+	else
+	{
+		for (UINT32 node = 0; node < hierarchy.size(); node++)
+			if (hierarchy.objects[node] < 0 && !sameBits(hierarchy.locals[node], newHierarchy.locals[node]))
+				changes.groupsMoved.push_back(node);
+	}
+
+	if (!sameInstances(instances, snapshot.getInstanceTable()))
+		changes.rebuildReasons.push_back("instances changed");
+	if (!sameSubScenes(subScenes, snapshot.getSubScenes()))
+		changes.rebuildReasons.push_back("lazy includes changed");
+
+	// Textures and lights are uploaded once
+	const auto& newTextures = snapshot.getTextureItems();
+	bool sameTextures = sameKeys(textures, newTextures);
+	for (auto it = textures.begin(); sameTextures && it != textures.end(); ++it)
+	{
+		const auto& updated = newTextures.at(it->first);
+		sameTextures = it->second.Filename == updated.Filename && it->second.TextureIdx == updated.TextureIdx;
+	}
+	if (!sameTextures)
+		changes.rebuildReasons.push_back("textures changed");
+
+	const auto& newLights = snapshot.getLights();
+	bool sameLights = lights.size() == newLights.size();
+	for (size_t i = 0; sameLights && i < lights.size(); i++)
+		sameLights = sameLight(lights[i], newLights[i]);
+	if (!sameLights)
+		changes.rebuildReasons.push_back("lights changed");
+
+	return changes;
+}
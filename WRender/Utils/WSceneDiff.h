@@ -0,0 +1,41 @@
+#pragma once
+#include "WSceneDescParser.h"
+#include "WSceneRegistry.h"
+
+// Difference between the running scene and a re-parsed scene description.
+// Transform and material parameter changes can be applied in place; anything that
+// changes the GPU layout (geometry, render item or material sets, instance tables,
+// textures, lights, hit groups) is reported as needing a rebuild.
+struct WSceneChangeSet
+{
+	std::vector<std::string> transformsChanged;          // Render items
+	std::vector<UINT32> groupsMoved;                     // Transform nodes of <group> elements
+	bool animationsChanged = false;                      // Keyframe tracks, replaced as a whole
+	std::vector<std::string> materialsChanged;           // Materials whose parameters changed
+	std::vector<std::string> materialAssignmentsChanged; // Render items now using another existing material
+	std::vector<std::string> meshesAdded;                // Geometry files only the new scene references
+	std::vector<std::string> meshesRemoved;              // Geometry files only the running scene references
+	std::vector<std::string> meshesModified;             // Geometry files changed on disk
+	std::vector<std::string> rebuildReasons;
+
+	bool needsRebuild() const { return !rebuildReasons.empty(); }
+	bool empty() const
+	{
+		return transformsChanged.empty() && groupsMoved.empty() && !animationsChanged && materialsChanged.empty() && materialAssignmentsChanged.empty() &&
+			!needsRebuild();
+	}
+};
+
+// "snapshot" only needs ParseDescription, "modifiedFiles" are the files the watcher reported
+WSceneChangeSet diffScenes(
+	const WSceneRegistry<WRenderItem>& renderItems,
+	const WSceneRegistry<WMaterial>& materials,
+	const std::map<std::string, WGeometryRecord>& geometryMap,
+	const std::map<std::string, WTextureRecord>& textures,
+	const std::vector<ParallelogramLight>& lights,
+	const WInstanceTable& instances,
+	const WTransformHierarchy& hierarchy,
+	const WAnimationSet& animations,
+	const std::vector<WSubSceneRecord>& subScenes,
+	WSceneDescParser& snapshot,
+	const std::vector<std::string>& modifiedFiles);
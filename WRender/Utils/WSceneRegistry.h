@@ -0,0 +1,89 @@
+#pragma once
+#include <windows.h>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Scene objects stored densely by their GPU index (WRenderItem::objIdx, WMaterial::MatIdx),
+// so per-frame updates walk a vector and index lookups are O(1).
+// Names are interned once into a table that is only used to resolve an index, e.g. by
+// the GUI, hot reload and references between scene elements.
+template<typename T>
+class WSceneRegistry
+{
+public:
+	typedef typename std::vector<T>::iterator iterator;
+	typedef typename std::vector<T>::const_iterator const_iterator;
+
+	// "indexOf" must map the items onto 0..n-1, which is how the parser numbers them
+	template<typename IndexOf>
+	void assign(const std::map<std::string, T>& items, IndexOf indexOf)
+	{
+		mItems.assign(items.size(), T());
+		mNames.assign(items.size(), std::string());
+		for (const auto& item : items)
+		{
+			size_t idx = static_cast<size_t>(indexOf(item.second));
+			if (idx >= items.size() || !mNames[idx].empty())
+				throw std::invalid_argument("WSceneRegistry: " + item.first + " has an out of range or duplicate index");
+			mItems[idx] = item.second;
+			mNames[idx] = item.first;
+		}
+		// Views into mNames stay valid until the next assign
+		mIndices.clear();
+		mIndices.reserve(mNames.size());
+		for (size_t i = 0; i < mNames.size(); i++)
+			mIndices.emplace(mNames[i], static_cast<UINT32>(i));
+	}
+
+	size_t size() const { return mItems.size(); }
+	bool empty() const { return mItems.empty(); }
+	T& operator[](size_t idx) { return mItems[idx]; }
+	const T& operator[](size_t idx) const { return mItems[idx]; }
+	iterator begin() { return mItems.begin(); }
+	iterator end() { return mItems.end(); }
+	const_iterator begin() const { return mItems.begin(); }
+	const_iterator end() const { return mItems.end(); }
+
+	const std::string& name(size_t idx) const { return mNames[idx]; }
+
+	// -1 when the name is unknown
+	INT64 indexOf(std::string_view name) const
+	{
+		auto it = mIndices.find(name);
+		return it == mIndices.end() ? -1 : static_cast<INT64>(it->second);
+	}
+	bool contains(std::string_view name) const { return mIndices.find(name) != mIndices.end(); }
+	T* find(std::string_view name)
+	{
+		INT64 idx = indexOf(name);
+		return idx < 0 ? nullptr : &mItems[idx];
+	}
+	const T* find(std::string_view name) const
+	{
+		INT64 idx = indexOf(name);
+		return idx < 0 ? nullptr : &mItems[idx];
+	}
+	T& at(std::string_view name)
+	{
+		T* item = find(name);
+		if (!item)
+			throw std::out_of_range("WSceneRegistry: unknown name " + std::string(name));
+		return *item;
+	}
+	const T& at(std::string_view name) const
+	{
+		const T* item = find(name);
+		if (!item)
+			throw std::out_of_range("WSceneRegistry: unknown name " + std::string(name));
+		return *item;
+	}
+
+private:
+	std::vector<T> mItems;
+	std::vector<std::string> mNames;
+	std::unordered_map<std::string_view, UINT32> mIndices;
+};
@@ -0,0 +1,214 @@
+#include "WSubSceneStreamer.h"
+#include "WSceneDescParser.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// Frustum planes of a row-vector view-projection (D3D clip space, 0 <= z <= w), a point p
+	// is inside when dot(plane, (p, 1)) >= 0 for all six
+	void frustumPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6])
+	{
+		using namespace DirectX;
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4(&m, viewProj);
+		auto column = [&](int j) { return XMFLOAT4(m(0, j), m(1, j), m(2, j), m(3, j)); };
+		XMFLOAT4 x = column(0), y = column(1), z = column(2), w = column(3);
+		planes[0] = XMFLOAT4(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w);
+		planes[1] = XMFLOAT4(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w);
+		planes[2] = XMFLOAT4(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w);
+		planes[3] = XMFLOAT4(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w);
+		planes[4] = z;
+		planes[5] = XMFLOAT4(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w);
+	}
+
+	// Box given in the space of "world" (XMFLOAT3X4 rows are the world x, y and z rows)
+	bool boxIntersectsFrustum(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax,
+		const DirectX::XMFLOAT3X4& world, const DirectX::XMFLOAT4 planes[6])
+	{
+		const float c[3] = { (boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f };
+		const float e[3] = { (boundsMax.x - boundsMin.x) * 0.5f, (boundsMax.y - boundsMin.y) * 0.5f, (boundsMax.z - boundsMin.z) * 0.5f };
+		float center[3], extent[3];
+		for (int i = 0; i < 3; i++)
+		{
+			center[i] = world.m[i][3];
+			extent[i] = 0.0f;
+			for (int j = 0; j < 3; j++)
+			{
+				center[i] += world.m[i][j] * c[j];
+				extent[i] += std::fabs(world.m[i][j]) * e[j];
+			}
+		}
+		for (int p = 0; p < 6; p++)
+		{
+			const auto& plane = planes[p];
+			float distance = plane.x * center[0] + plane.y * center[1] + plane.z * center[2] + plane.w;
+			float radius = std::fabs(plane.x) * extent[0] + std::fabs(plane.y) * extent[1] + std::fabs(plane.z) * extent[2];
+			if (distance + radius < 0.0f)
+				return false;
+		}
+		return true;
+	}
+}
+
+WSubSceneStreamer::WSubSceneStreamer()
+{
+	mLoader = std::thread([this] { loaderLoop(); });
+}
+
+WSubSceneStreamer::~WSubSceneStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+		mQueue.clear();
+	}
+	mLoadQueued.notify_all();
+	mLoader.join();
+}
+
+void WSubSceneStreamer::reset(const std::vector<WSubSceneRecord>& records, std::function<void(WSceneDescParser&)> configure)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueue.clear();
+		mFinished.clear();
+		mConfigure = std::move(configure);
+		++mGeneration;
+	}
+	mEntries.clear();
+	mEntries.resize(records.size());
+	for (size_t i = 0; i < records.size(); i++)
+		mEntries[i].record = records[i];
+	mStats = WSubSceneStats();
+}
+
+size_t WSubSceneStreamer::requestVisible(DirectX::FXMMATRIX viewProj, const WTransformHierarchy& hierarchy, UINT64 frame)
+{
+	DirectX::XMFLOAT4 planes[6];
+	frustumPlanes(viewProj, planes);
+	size_t requested = 0;
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		const auto& record = mEntries[i].record;
+		if (record.hasBounds &&
+			!boxIntersectsFrustum(record.boundsMin, record.boundsMax, hierarchy.worlds[record.transformNode], planes))
+			continue;
+		request(i, frame);
+		++requested;
+	}
+	return requested;
+}
+
+void WSubSceneStreamer::request(size_t index, UINT64 frame)
+{
+	auto& entry = mEntries[index];
+	entry.lastRequested = frame;
+	if (entry.state != SUBSCENE_UNLOADED)
+		return;
+	entry.state = SUBSCENE_LOADING;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueue.emplace_back(index, entry.record.file);
+	}
+	mLoadQueued.notify_one();
+}
+
+void WSubSceneStreamer::update(UINT64 frame, std::vector<size_t>* changed)
+{
+	std::vector<LoadResult> finished;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		finished.swap(mFinished);
+	}
+	for (auto& result : finished)
+	{
+		if (result.generation != mGeneration)
+			continue;
+		auto& entry = mEntries[result.index];
+		if (!result.scene)
+		{
+			entry.state = SUBSCENE_FAILED;
+			++mStats.failures;
+			continue;
+		}
+		entry.state = SUBSCENE_RESIDENT;
+		entry.bytes = result.scene->memoryBytes();
+		entry.scene = std::move(result.scene);
+		++mStats.loads;
+		mStats.loadSeconds += result.seconds;
+		if (changed)
+			changed->push_back(result.index);
+	}
+
+	// Least recently requested first, whatever was asked for this frame stays
+	std::vector<size_t> resident;
+	UINT64 residentBytes = 0;
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		if (mEntries[i].state != SUBSCENE_RESIDENT)
+			continue;
+		resident.push_back(i);
+		residentBytes += mEntries[i].bytes;
+	}
+	std::sort(resident.begin(), resident.end(),
+		[&](size_t a, size_t b) { return mEntries[a].lastRequested < mEntries[b].lastRequested; });
+	for (size_t k = 0; k < resident.size() && residentBytes > mBudgetBytes; k++)
+	{
+		auto& entry = mEntries[resident[k]];
+		if (entry.lastRequested >= frame)
+			break;
+		residentBytes -= entry.bytes;
+		entry.scene.reset();
+		entry.bytes = 0;
+		entry.state = SUBSCENE_UNLOADED;
+		++mStats.evictions;
+		if (changed)
+			changed->push_back(resident[k]);
+	}
+
+	mStats.resident = 0;
+	mStats.loading = 0;
+	for (const auto& entry : mEntries)
+	{
+		mStats.resident += entry.state == SUBSCENE_RESIDENT ? 1 : 0;
+		mStats.loading += entry.state == SUBSCENE_LOADING ? 1 : 0;
+	}
+	mStats.residentBytes = residentBytes;
+	mStats.budgetBytes = mBudgetBytes;
+}
+
+void WSubSceneStreamer::loaderLoop()
+{
+	for (;;)
+	{
+		LoadResult result;
+		std::string file;
+		std::function<void(WSceneDescParser&)> configure;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mLoadQueued.wait(lock, [this] { return mStop || !mQueue.empty(); });
+			if (mStop)
+				return;
+			result.index = mQueue.front().first;
+			file = std::move(mQueue.front().second);
+			mQueue.pop_front();
+			result.generation = mGeneration;
+			configure = mConfigure;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		auto scene = std::make_unique<WSceneDescParser>();
+		if (configure)
+			configure(*scene);
+		if (scene->Parse(file.c_str()))
+			result.scene = std::move(scene);
+		else
+			std::cerr << "WSubSceneStreamer: cannot load " << file << std::endl;
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFinished.push_back(std::move(result));
+	}
+}
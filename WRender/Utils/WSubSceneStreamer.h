@@ -0,0 +1,120 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <DirectXMath.h>
+
+class WSceneDescParser;
+struct WTransformHierarchy;
+
+// A sub-scene referenced with <include file="..." lazy="true">. Only this record is kept at
+// startup; the file is parsed and its geometry loaded when a visibility query first asks for it.
+//
+// <include file="district_04.xml" lazy="true" bounds="-50,0,-50, 50,30,50">
+//   <transform> ... </transform>
+// </include>
+//
+// "bounds" are the min and max corners in the sub-scene's own space, placed by the include's
+// hierarchy node like a <group>. Includes without bounds are visible to every query.
+struct WSubSceneRecord
+{
+	std::string file;
+	UINT32 transformNode = 0;
+	bool hasBounds = false;
+	DirectX::XMFLOAT3 boundsMin = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 boundsMax = { 0.0f, 0.0f, 0.0f };
+};
+
+enum WSUBSCENE_STATE : UINT32
+{
+	SUBSCENE_UNLOADED = 0,
+	SUBSCENE_LOADING,
+	SUBSCENE_RESIDENT,
+	SUBSCENE_FAILED
+};
+
+struct WSubSceneStats
+{
+	UINT32 resident = 0;
+	UINT32 loading = 0;
+	UINT64 residentBytes = 0;
+	UINT64 budgetBytes = 0;
+	// Since reset()
+	UINT32 loads = 0;
+	UINT32 evictions = 0;
+	UINT32 failures = 0;
+	double loadSeconds = 0.0;
+};
+
+// Loads lazy sub-scenes on a background thread and keeps the resident ones within a memory
+// budget, evicting the least recently requested first. Sub-scenes requested in the current
+// frame are never evicted, the budget is exceeded while more than it holds is in view.
+// Everything except the loads themselves runs on the calling thread.
+class WSubSceneStreamer
+{
+public:
+	static const UINT64 DefaultBudgetBytes = 512ull * 1024 * 1024;
+
+	WSubSceneStreamer();
+	WSubSceneStreamer(const WSubSceneStreamer& rhs) = delete;
+	WSubSceneStreamer& operator=(const WSubSceneStreamer& rhs) = delete;
+	// Waits for a load in progress
+	~WSubSceneStreamer();
+
+	// Drops every loaded sub-scene. "configure" sets the options of the parser of each load.
+	void reset(const std::vector<WSubSceneRecord>& records, std::function<void(WSceneDescParser&)> configure);
+	void setBudget(UINT64 budgetBytes) { mBudgetBytes = budgetBytes; }
+
+	// Requests every sub-scene whose bounds, placed by "hierarchy", intersect the view frustum
+	// of "viewProj". Returns the number of sub-scenes requested.
+	size_t requestVisible(DirectX::FXMMATRIX viewProj, const WTransformHierarchy& hierarchy, UINT64 frame);
+	void request(size_t index, UINT64 frame);
+	// Takes over finished loads, then evicts over budget. "changed" receives the sub-scenes
+	// that became resident or were evicted.
+	void update(UINT64 frame, std::vector<size_t>* changed = nullptr);
+
+	size_t size() const { return mEntries.size(); }
+	const WSubSceneRecord& record(size_t index) const { return mEntries[index].record; }
+	WSUBSCENE_STATE state(size_t index) const { return mEntries[index].state; }
+	// nullptr unless resident, valid until the next update() or reset()
+	const WSceneDescParser* residentScene(size_t index) const { return mEntries[index].scene.get(); }
+	const WSubSceneStats& stats() const { return mStats; }
+private:
+	struct Entry
+	{
+		WSubSceneRecord record;
+		WSUBSCENE_STATE state = SUBSCENE_UNLOADED;
+		UINT64 lastRequested = 0;
+		UINT64 bytes = 0;
+		std::unique_ptr<WSceneDescParser> scene;
+	};
+	struct LoadResult
+	{
+		size_t index = 0;
+		// Tells results of loads queued before a reset() apart
+		UINT64 generation = 0;
+		std::unique_ptr<WSceneDescParser> scene;
+		double seconds = 0.0;
+	};
+	void loaderLoop();
+private:
+	std::vector<Entry> mEntries;
+	WSubSceneStats mStats;
+	UINT64 mBudgetBytes = DefaultBudgetBytes;
+
+	// Shared with the loader thread
+	std::mutex mMutex;
+	std::condition_variable mLoadQueued;
+	std::deque<std::pair<size_t, std::string>> mQueue;
+	std::vector<LoadResult> mFinished;
+	std::function<void(WSceneDescParser&)> mConfigure;
+	UINT64 mGeneration = 0;
+	bool mStop = false;
+	std::thread mLoader;
+};
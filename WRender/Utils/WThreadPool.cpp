@@ -0,0 +1,94 @@
+#include "WThreadPool.h"
+#include <algorithm>
+
+WThreadPool::WThreadPool(UINT numThreads)
+{
+	if (numThreads == 0)
+	{
+		UINT hardwareThreads = std::thread::hardware_concurrency();
+		numThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+	mWorkers.reserve(numThreads);
+	for (UINT i = 0; i < numThreads; i++)
+		mWorkers.emplace_back(&WThreadPool::workerLoop, this);
+}
+
+WThreadPool::~WThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mJobAvailable.notify_all();
+	for (auto& worker : mWorkers)
+		worker.join();
+}
+
+WThreadPool& WThreadPool::global()
+{
+	static WThreadPool pool;
+	return pool;
+}
+
+void WThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+	if (count == 0)
+		return;
+	if (count == 1 || mWorkers.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+			task(i);
+		return;
+	}
+
+	auto job = std::make_shared<Job>();
+	job->task = &task;
+	job->count = count;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(job);
+	}
+	mJobAvailable.notify_all();
+
+	runJob(*job);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mJobFinished.wait(lock, [&job]() { return job->done.load() == job->count; });
+}
+
+void WThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobAvailable.wait(lock, [this]() { return mStop || !mJobs.empty(); });
+			if (mStop)
+				return;
+			job = mJobs.front();
+		}
+		runJob(*job);
+	}
+}
+
+void WThreadPool::runJob(Job& job)
+{
+	size_t i;
+	while ((i = job.next.fetch_add(1)) < job.count)
+	{
+		(*job.task)(i);
+		if (job.done.fetch_add(1) + 1 == job.count)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mJobFinished.notify_all();
+		}
+	}
+
+	// All tasks are handed out, nobody else needs to pick this job up
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto iter = std::find_if(mJobs.begin(), mJobs.end(),
+		[&job](const std::shared_ptr<Job>& queued) { return queued.get() == &job; });
+	if (iter != mJobs.end())
+		mJobs.erase(iter);
+}
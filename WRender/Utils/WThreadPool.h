@@ -0,0 +1,46 @@
+#pragma once
+#include <windows.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Fixed-size pool of worker threads.
+// parallelFor() blocks until every task has run; the calling thread works on its own
+// job as well, so parallelFor() may be called from inside a task without deadlocking.
+class WThreadPool
+{
+public:
+	// 0 means one worker per hardware thread (minus the calling thread)
+	explicit WThreadPool(UINT numThreads = 0);
+	WThreadPool(const WThreadPool& rhs) = delete;
+	WThreadPool& operator=(const WThreadPool& rhs) = delete;
+	~WThreadPool();
+
+	void parallelFor(size_t count, const std::function<void(size_t)>& task);
+	UINT size() const { return static_cast<UINT>(mWorkers.size()); }
+
+	// Shared pool used by the scene pipeline
+	static WThreadPool& global();
+private:
+	struct Job
+	{
+		const std::function<void(size_t)>* task = nullptr;
+		size_t count = 0;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+	};
+	void workerLoop();
+	void runJob(Job& job);
+private:
+	std::vector<std::thread> mWorkers;
+	std::deque<std::shared_ptr<Job>> mJobs;
+	std::mutex mMutex;
+	std::condition_variable mJobAvailable;
+	std::condition_variable mJobFinished;
+	bool mStop = false;
+};
@@ -0,0 +1,326 @@
+#include "WTopLevelBvh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// Inverse of an affine 3x4 transform, false when it is singular
+	bool invertAffine(const DirectX::XMFLOAT3X4& m, DirectX::XMFLOAT3X4& inverse)
+	{
+		const float c00 = m.m[1][1] * m.m[2][2] - m.m[1][2] * m.m[2][1];
+		const float c01 = m.m[1][2] * m.m[2][0] - m.m[1][0] * m.m[2][2];
+		const float c02 = m.m[1][0] * m.m[2][1] - m.m[1][1] * m.m[2][0];
+		const float det = m.m[0][0] * c00 + m.m[0][1] * c01 + m.m[0][2] * c02;
+		if (!(std::fabs(det) > 1e-30f))
+			return false;
+		const float invDet = 1.0f / det;
+		inverse.m[0][0] = c00 * invDet;
+		inverse.m[0][1] = (m.m[0][2] * m.m[2][1] - m.m[0][1] * m.m[2][2]) * invDet;
+		inverse.m[0][2] = (m.m[0][1] * m.m[1][2] - m.m[0][2] * m.m[1][1]) * invDet;
+		inverse.m[1][0] = c01 * invDet;
+		inverse.m[1][1] = (m.m[0][0] * m.m[2][2] - m.m[0][2] * m.m[2][0]) * invDet;
+		inverse.m[1][2] = (m.m[0][2] * m.m[1][0] - m.m[0][0] * m.m[1][2]) * invDet;
+		inverse.m[2][0] = c02 * invDet;
+		inverse.m[2][1] = (m.m[0][1] * m.m[2][0] - m.m[0][0] * m.m[2][1]) * invDet;
+		inverse.m[2][2] = (m.m[0][0] * m.m[1][1] - m.m[0][1] * m.m[1][0]) * invDet;
+		for (int i = 0; i < 3; i++)
+		{
+			inverse.m[i][3] = -(inverse.m[i][0] * m.m[0][3] + inverse.m[i][1] * m.m[1][3] + inverse.m[i][2] * m.m[2][3]);
+		}
+		return true;
+	}
+
+	// Direction without the translation, not normalized so that t stays the same
+	WRay transformRay(const DirectX::XMFLOAT3X4& m, const WRay& ray)
+	{
+		WRay transformed = ray;
+		const float* o = &ray.origin.x;
+		const float* d = &ray.direction.x;
+		float* origin = &transformed.origin.x;
+		float* direction = &transformed.direction.x;
+		for (int i = 0; i < 3; i++)
+		{
+			origin[i] = m.m[i][0] * o[0] + m.m[i][1] * o[1] + m.m[i][2] * o[2] + m.m[i][3];
+			direction[i] = m.m[i][0] * d[0] + m.m[i][1] * d[1] + m.m[i][2] * d[2];
+		}
+		return transformed;
+	}
+
+	bool isEmpty(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax)
+	{
+		return boundsMin.x > boundsMax.x;
+	}
+
+	void grow(DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax, const DirectX::XMFLOAT3& otherMin, const DirectX::XMFLOAT3& otherMax)
+	{
+		boundsMin = DirectX::XMFLOAT3((std::min)(boundsMin.x, otherMin.x), (std::min)(boundsMin.y, otherMin.y), (std::min)(boundsMin.z, otherMin.z));
+		boundsMax = DirectX::XMFLOAT3((std::max)(boundsMax.x, otherMax.x), (std::max)(boundsMax.y, otherMax.y), (std::max)(boundsMax.z, otherMax.z));
+	}
+}
+
+UINT32 WTopLevelBvh::addBlas(const WBvh8* blas)
+{
+	DirectX::XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	DirectX::XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	if (blas && !blas->empty())
+	{
+		const WBvh8Node& root = blas->nodes()[0];
+		for (UINT32 i = 0; i < WBvh8::Width; i++)
+		{
+			if (root.child[i] == WBvh8::EmptySlot)
+				continue;
+			grow(boundsMin, boundsMax, DirectX::XMFLOAT3(root.bounds[0][i], root.bounds[2][i], root.bounds[4][i]),
+				DirectX::XMFLOAT3(root.bounds[1][i], root.bounds[3][i], root.bounds[5][i]));
+		}
+	}
+	mBlases.push_back(blas);
+	mBlasMin.push_back(boundsMin);
+	mBlasMax.push_back(boundsMax);
+	return static_cast<UINT32>(mBlases.size() - 1);
+}
+
+UINT32 WTopLevelBvh::addInstance(UINT32 blas, const DirectX::XMFLOAT3X4& objectToWorld, UINT32 instanceID,
+	UINT32 hitGroupIndex, UINT8 mask)
+{
+	WBvhInstance instance;
+	instance.objectToWorld = objectToWorld;
+	instance.blas = blas;
+	instance.instanceID = instanceID;
+	instance.hitGroupIndex = hitGroupIndex;
+	instance.mask = mask;
+	// A singular transform keeps the instance out of the tree
+	if (!invertAffine(objectToWorld, instance.worldToObject))
+		instance.mask = 0;
+	mInstances.push_back(instance);
+	return static_cast<UINT32>(mInstances.size() - 1);
+}
+
+void WTopLevelBvh::clear()
+{
+	mBlases.clear();
+	mBlasMin.clear();
+	mBlasMax.clear();
+	mInstances.clear();
+	mNodes.clear();
+	mItems.clear();
+	mStats = WTopLevelBvhStats();
+}
+
+void WTopLevelBvh::instanceBounds(std::vector<DirectX::XMFLOAT3>& boundsMin, std::vector<DirectX::XMFLOAT3>& boundsMax) const
+{
+	boundsMin.assign(mInstances.size(), DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+	boundsMax.assign(mInstances.size(), DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	for (size_t i = 0; i < mInstances.size(); i++)
+	{
+		const WBvhInstance& instance = mInstances[i];
+		if (instance.mask == 0 || instance.blas >= mBlases.size() || isEmpty(mBlasMin[instance.blas], mBlasMax[instance.blas]))
+			continue;
+		// Center and half extent of the object box, the world extent sums the absolute rows
+		const float* lower = &mBlasMin[instance.blas].x;
+		const float* upper = &mBlasMax[instance.blas].x;
+		float* worldMin = &boundsMin[i].x;
+		float* worldMax = &boundsMax[i].x;
+		const auto& m = instance.objectToWorld.m;
+		for (int row = 0; row < 3; row++)
+		{
+			float center = m[row][3], extent = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				center += m[row][axis] * 0.5f * (lower[axis] + upper[axis]);
+				extent += std::fabs(m[row][axis]) * 0.5f * (upper[axis] - lower[axis]);
+			}
+			worldMin[row] = center - extent;
+			worldMax[row] = center + extent;
+		}
+	}
+}
+
+void WTopLevelBvh::build(const WBvhBuildOptions& options)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::vector<DirectX::XMFLOAT3> boundsMin, boundsMax;
+	instanceBounds(boundsMin, boundsMax);
+
+	// Only instances with bounds enter the tree
+	std::vector<UINT32> traceable;
+	std::vector<DirectX::XMFLOAT3> traceableMin, traceableMax;
+	for (UINT32 i = 0; i < static_cast<UINT32>(mInstances.size()); i++)
+	{
+		if (isEmpty(boundsMin[i], boundsMax[i]))
+			continue;
+		traceable.push_back(i);
+		traceableMin.push_back(boundsMin[i]);
+		traceableMax.push_back(boundsMax[i]);
+	}
+	WBvhBuildOptions treeOptions = options;
+	treeOptions.spatialSplits = false;
+	WBvhStats treeStats;
+	buildBoxBvh(traceableMin, traceableMax, treeOptions, mNodes, mItems, treeStats);
+	for (auto& item : mItems)
+		item = traceable[item];
+
+	mStats.instances = mInstances.size();
+	mStats.traceableInstances = traceable.size();
+	mStats.blases = mBlases.size();
+	mStats.nodes = mNodes.size();
+	mStats.maxDepth = treeStats.maxDepth;
+	mStats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void WTopLevelBvh::update(const std::vector<DirectX::XMFLOAT3X4>& objectToWorld)
+{
+	const size_t count = (std::min)(objectToWorld.size(), mInstances.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		WBvhInstance& instance = mInstances[i];
+		instance.objectToWorld = objectToWorld[i];
+		// Instances left out of the tree stay out until the next build
+		if (instance.mask != 0 && !invertAffine(instance.objectToWorld, instance.worldToObject))
+			instance.mask = 0;
+	}
+	std::vector<DirectX::XMFLOAT3> boundsMin, boundsMax;
+	instanceBounds(boundsMin, boundsMax);
+
+	// Children follow their parent in depth-first order, so a backward pass refits bottom-up
+	for (size_t index = mNodes.size(); index-- > 0;)
+	{
+		WBvhNode& node = mNodes[index];
+		DirectX::XMFLOAT3 nodeMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		DirectX::XMFLOAT3 nodeMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		if (node.isLeaf())
+		{
+			for (UINT32 k = 0; k < node.count; k++)
+			{
+				const UINT32 instance = mItems[node.firstOrRight + k];
+				if (!isEmpty(boundsMin[instance], boundsMax[instance]))
+					grow(nodeMin, nodeMax, boundsMin[instance], boundsMax[instance]);
+			}
+		}
+		else
+		{
+			const WBvhNode& left = mNodes[index + 1];
+			const WBvhNode& right = mNodes[node.firstOrRight];
+			grow(nodeMin, nodeMax, left.boundsMin, left.boundsMax);
+			grow(nodeMin, nodeMax, right.boundsMin, right.boundsMax);
+		}
+		node.boundsMin = nodeMin;
+		node.boundsMax = nodeMax;
+	}
+}
+
+bool WTopLevelBvh::intersect(const WRay& ray, WInstanceHit& hit, UINT8 instanceMask) const
+{
+	if (mNodes.empty())
+		return false;
+	const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const float invDirection[3] = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+	WInstanceHit closest;
+	closest.t = ray.tMax;
+
+	UINT32 stack[WBvh::StackSize];
+	UINT32 stackSize = 0;
+	UINT32 index = 0;
+	if (intersectBox(mNodes[0], origin, invDirection, ray.tMin, closest.t) == FLT_MAX)
+		return false;
+	for (;;)
+	{
+		const WBvhNode& node = mNodes[index];
+		if (node.isLeaf())
+		{
+			for (UINT32 k = 0; k < node.count; k++)
+			{
+				const UINT32 instanceIndex = mItems[node.firstOrRight + k];
+				const WBvhInstance& instance = mInstances[instanceIndex];
+				if (!(instance.mask & instanceMask))
+					continue;
+				WRay objectRay = transformRay(instance.worldToObject, ray);
+				objectRay.tMax = closest.t;
+				WRayHit objectHit;
+				if (!mBlases[instance.blas]->intersect(objectRay, objectHit))
+					continue;
+				closest.t = objectHit.t;
+				closest.triangle = objectHit.triangle;
+				closest.u = objectHit.u;
+				closest.v = objectHit.v;
+				closest.instanceIndex = instanceIndex;
+				closest.instanceID = instance.instanceID;
+				closest.hitGroupIndex = instance.hitGroupIndex;
+			}
+		}
+		else
+		{
+			const UINT32 left = index + 1;
+			const UINT32 right = node.firstOrRight;
+			float tLeft = intersectBox(mNodes[left], origin, invDirection, ray.tMin, closest.t);
+			float tRight = intersectBox(mNodes[right], origin, invDirection, ray.tMin, closest.t);
+			if (tLeft != FLT_MAX && tRight != FLT_MAX)
+			{
+				index = tLeft <= tRight ? left : right;
+				stack[stackSize++] = tLeft <= tRight ? right : left;
+				continue;
+			}
+			if (tLeft != FLT_MAX || tRight != FLT_MAX)
+			{
+				index = tLeft != FLT_MAX ? left : right;
+				continue;
+			}
+		}
+		if (stackSize == 0)
+			break;
+		index = stack[--stackSize];
+	}
+	if (!closest.hit())
+		return false;
+	hit = closest;
+	return true;
+}
+
+bool WTopLevelBvh::occluded(const WRay& ray, UINT8 instanceMask) const
+{
+	if (mNodes.empty())
+		return false;
+	const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const float invDirection[3] = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+
+	UINT32 stack[WBvh::StackSize];
+	UINT32 stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const WBvhNode& node = mNodes[stack[--stackSize]];
+		if (intersectBox(node, origin, invDirection, ray.tMin, ray.tMax) == FLT_MAX)
+			continue;
+		if (!node.isLeaf())
+		{
+			stack[stackSize++] = node.firstOrRight;
+			stack[stackSize++] = static_cast<UINT32>(&node - mNodes.data()) + 1;
+			continue;
+		}
+		for (UINT32 k = 0; k < node.count; k++)
+		{
+			const WBvhInstance& instance = mInstances[mItems[node.firstOrRight + k]];
+			if ((instance.mask & instanceMask) && mBlases[instance.blas]->occluded(transformRay(instance.worldToObject, ray)))
+				return true;
+		}
+	}
+	return false;
+}
+
+UINT64 WTopLevelBvh::memoryBytes() const
+{
+	return mNodes.size() * sizeof(WBvhNode) + mItems.size() * sizeof(UINT32) + mInstances.size() * sizeof(WBvhInstance) +
+		mBlases.size() * (sizeof(const WBvh8*) + 2 * sizeof(DirectX::XMFLOAT3));
+}
+
+UINT64 WTopLevelBvh::blasMemoryBytes() const
+{
+	// Several slots may hold the same BLAS
+	std::vector<const WBvh8*> unique(mBlases);
+	std::sort(unique.begin(), unique.end());
+	unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+	UINT64 bytes = 0;
+	for (const WBvh8* blas : unique)
+		bytes += blas ? blas->memoryBytes() : 0;
+	return bytes;
+}
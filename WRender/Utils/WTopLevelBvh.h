@@ -0,0 +1,99 @@
+#pragma once
+#include <windows.h>
+#include <vector>
+#include <DirectXMath.h>
+#include "WBvh8.h"
+
+// CPU counterpart of the DXR acceleration structures: a top-level BVH over instances of
+// shared bottom-level BVHs. Rays are moved into object space at the instance boundary, so
+// memory grows with the unique geometry, instances only add their transforms.
+
+struct WBvhInstance
+{
+	// 3x4 layout of D3D12_RAYTRACING_INSTANCE_DESC, and its inverse
+	DirectX::XMFLOAT3X4 objectToWorld;
+	DirectX::XMFLOAT3X4 worldToObject;
+	UINT32 blas;
+	// InstanceID()
+	UINT32 instanceID;
+	// InstanceContributionToHitGroupIndex
+	UINT32 hitGroupIndex;
+	// InstanceMask, the instance is skipped when it shares no bit with the ray's mask
+	UINT8 mask;
+};
+
+struct WInstanceHit
+{
+	float t = FLT_MAX;             // RayTCurrent(), the same in world and object space
+	UINT32 triangle = ~0u;         // PrimitiveIndex(), ~0u on a miss
+	float u = 0.0f;                // Barycentrics of the second and third vertex
+	float v = 0.0f;
+	UINT32 instanceIndex = ~0u;    // InstanceIndex(), the order of addInstance()
+	UINT32 instanceID = 0;
+	// Instance contribution only. Each BLAS holds one geometry, so the hit group record is
+	// this plus the ray type.
+	UINT32 hitGroupIndex = 0;
+
+	bool hit() const { return triangle != ~0u; }
+};
+
+struct WTopLevelBvhStats
+{
+	size_t instances = 0;
+	// Instances in the tree, the others have an empty BLAS or a singular transform
+	size_t traceableInstances = 0;
+	size_t blases = 0;
+	size_t nodes = 0;
+	UINT32 maxDepth = 0;
+	double buildSeconds = 0.0;
+};
+
+class WTopLevelBvh
+{
+public:
+	WTopLevelBvh() = default;
+	WTopLevelBvh(const WTopLevelBvh& rhs) = delete;
+	WTopLevelBvh& operator=(const WTopLevelBvh& rhs) = delete;
+
+	// The BLAS is referenced and must outlive the top-level BVH. Returns its index for
+	// addInstance(), null leaves the instances of the slot out.
+	UINT32 addBlas(const WBvh8* blas);
+	// Same arguments as TopLevelASGenerator::AddInstance
+	UINT32 addInstance(UINT32 blas, const DirectX::XMFLOAT3X4& objectToWorld, UINT32 instanceID, UINT32 hitGroupIndex,
+		UINT8 mask = 0xFF);
+	void clear();
+
+	// Builds the tree over the instance bounds. Instances are leaf items like triangles for
+	// the SAH.
+	void build(const WBvhBuildOptions& options = WBvhBuildOptions());
+	// The counterpart of a TLAS update: new transforms for all instances, the tree keeps its
+	// topology and only refits its boxes
+	void update(const std::vector<DirectX::XMFLOAT3X4>& objectToWorld);
+
+	// Closest hit over the instances whose mask shares a bit with "instanceMask", "hit" is
+	// left untouched on a miss
+	bool intersect(const WRay& ray, WInstanceHit& hit, UINT8 instanceMask = 0xFF) const;
+	bool occluded(const WRay& ray, UINT8 instanceMask = 0xFF) const;
+
+	bool empty() const { return mNodes.empty(); }
+	const std::vector<WBvhInstance>& instances() const { return mInstances; }
+	const std::vector<const WBvh8*>& blases() const { return mBlases; }
+	const WTopLevelBvhStats& stats() const { return mStats; }
+	// Tree and instances, the BLASes are counted separately
+	UINT64 memoryBytes() const;
+	// Each shared BLAS once
+	UINT64 blasMemoryBytes() const;
+private:
+	// World bounds of the instances, empty when left out of the tree
+	void instanceBounds(std::vector<DirectX::XMFLOAT3>& boundsMin, std::vector<DirectX::XMFLOAT3>& boundsMax) const;
+
+	std::vector<const WBvh8*> mBlases;
+	// Object space bounds of each BLAS
+	std::vector<DirectX::XMFLOAT3> mBlasMin;
+	std::vector<DirectX::XMFLOAT3> mBlasMax;
+	std::vector<WBvhInstance> mInstances;
+	std::vector<WBvhNode> mNodes;
+	// Instance indices in leaf order
+	std::vector<UINT32> mItems;
+	WTopLevelBvhStats mStats;
+};
@@ -0,0 +1,252 @@
+#include "WTransformBatch.h"
+#include <immintrin.h>
+#include <cstring>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	const float DegToRad = DirectX::XM_PI / 180.0f;
+
+	WSIMD_PATH gPath = cpuSupportsAvx2() ? SIMD_PATH_AVX2 : SIMD_PATH_SCALAR;
+
+	// One lane per instance, composeLanes is written once for float and for 8 floats in a register
+	struct WFloat8
+	{
+		__m256 v;
+		WFloat8() = default;
+		WFloat8(__m256 x) : v(x) {}
+		explicit WFloat8(float x) : v(_mm256_set1_ps(x)) {}
+	};
+	inline WFloat8 operator+(WFloat8 a, WFloat8 b) { return _mm256_add_ps(a.v, b.v); }
+	inline WFloat8 operator-(WFloat8 a, WFloat8 b) { return _mm256_sub_ps(a.v, b.v); }
+	inline WFloat8 operator*(WFloat8 a, WFloat8 b) { return _mm256_mul_ps(a.v, b.v); }
+	inline WFloat8 operator-(WFloat8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+
+	// 3x4 layout of D3D12_RAYTRACING_INSTANCE_DESC: x[4 * j + i] is row i, column j of the
+	// row vector matrix S * Rz * Ry * Rx, x[4 * j + 3] the translation
+	template<typename T>
+	void composeLanes(const T t[3], const T sinR[3], const T cosR[3], const T s[3], T x[12])
+	{
+		const T& sx = sinR[0]; const T& cx = cosR[0];
+		const T& sy = sinR[1]; const T& cy = cosR[1];
+		const T& sz = sinR[2]; const T& cz = cosR[2];
+		const T sysx = sy * sx;
+		const T sycx = sy * cx;
+		// Rows of Rz * Ry * Rx
+		const T r[3][3] = {
+			{ cz * cy, cz * sysx + sz * cx, sz * sx - cz * sycx },
+			{ -(sz * cy), cz * cx - sz * sysx, sz * sycx + cz * sx },
+			{ sy, -(cy * sx), cy * cx } };
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				x[4 * j + i] = s[i] * r[i][j];
+		for (int j = 0; j < 3; j++)
+			x[4 * j + 3] = t[j];
+	}
+
+	// ObjectToWorld is the transposed row vector matrix M, so the 3x4 rows and (0, 0, 0, 1)
+	inline void objectToWorldRows(const DirectX::XMFLOAT3X4& x, DirectX::XMFLOAT4X4& objectToWorld)
+	{
+		memcpy(&objectToWorld, &x, sizeof(x));
+		objectToWorld.m[3][0] = 0.0f; objectToWorld.m[3][1] = 0.0f; objectToWorld.m[3][2] = 0.0f; objectToWorld.m[3][3] = 1.0f;
+	}
+
+	// InvTranspose = transpose(inverse(M^T)) = inverse(M), row-major 4x4 like XMStoreFloat4x4.
+	// Stays scalar: with 3x4 in and 4x4 out per instance the AVX2 transposes cost more than
+	// the arithmetic they save. An 8-lane version of this function measured 0.6x the scalar
+	// loop with transposed loads and 0.9x with gathers on 20k instances, its loads and stores
+	// alone ran at 62 M/s against 47 M/s for the whole scalar loop. WBench transforms keeps
+	// track of the scalar throughput and its error against XMMatrixInverse.
+	void invTransposeRows(const float x[12], float invTranspose[16])
+	{
+		// M = [L 0; t 1], inverse(M) = [inverse(L) 0; -t * inverse(L) 1]
+		float L[3][3];
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				L[i][j] = x[4 * j + i];
+		const float c00 = L[1][1] * L[2][2] - L[1][2] * L[2][1];
+		const float c01 = L[1][2] * L[2][0] - L[1][0] * L[2][2];
+		const float c02 = L[1][0] * L[2][1] - L[1][1] * L[2][0];
+		const float invDet = 1.0f / (L[0][0] * c00 + L[0][1] * c01 + L[0][2] * c02);
+		const float inv[3][3] = {
+			{ c00 * invDet, (L[0][2] * L[2][1] - L[0][1] * L[2][2]) * invDet, (L[0][1] * L[1][2] - L[0][2] * L[1][1]) * invDet },
+			{ c01 * invDet, (L[0][0] * L[2][2] - L[0][2] * L[2][0]) * invDet, (L[0][2] * L[1][0] - L[0][0] * L[1][2]) * invDet },
+			{ c02 * invDet, (L[0][1] * L[2][0] - L[0][0] * L[2][1]) * invDet, (L[0][0] * L[1][1] - L[0][1] * L[1][0]) * invDet } };
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				invTranspose[4 * i + j] = inv[i][j];
+			invTranspose[4 * i + 3] = 0.0f;
+		}
+		for (int j = 0; j < 3; j++)
+			invTranspose[12 + j] = -(x[3] * inv[0][j] + x[7] * inv[1][j] + x[11] * inv[2][j]);
+		invTranspose[15] = 1.0f;
+	}
+
+	inline void sinCos(float angle, float& s, float& c)
+	{
+		DirectX::XMScalarSinCos(&s, &c, angle);
+	}
+
+	// Quadrant reduction with a three part pi/2 and minimax polynomials on [-pi/4, pi/4]
+	inline void sinCos(WFloat8 angle, WFloat8& s, WFloat8& c)
+	{
+		const __m256 q = _mm256_round_ps(_mm256_mul_ps(angle.v, _mm256_set1_ps(0.636619772f)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		const __m256i quadrant = _mm256_cvtps_epi32(q);
+		WFloat8 qf(q);
+		WFloat8 y = angle - qf * WFloat8(1.5703125f) - qf * WFloat8(4.837512969970703125e-4f) -
+			qf * WFloat8(7.54978995489188216e-8f);
+		WFloat8 z = y * y;
+		WFloat8 sinY = y + y * z * (WFloat8(-1.6666654611e-1f) + z * (WFloat8(8.3321608736e-3f) + z * WFloat8(-1.9515295891e-4f)));
+		WFloat8 cosY = WFloat8(1.0f) - WFloat8(0.5f) * z +
+			z * z * (WFloat8(4.166664568298827e-2f) + z * (WFloat8(-1.388731625493765e-3f) + z * WFloat8(2.443315711809948e-5f)));
+
+		// Odd quadrants swap sine and cosine, signs follow bit 1 of q and of q + 1
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i two = _mm256_set1_epi32(2);
+		const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+		const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+		const __m256 cosSign = _mm256_castsi256_ps(
+			_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+		s = _mm256_xor_ps(_mm256_blendv_ps(sinY.v, cosY.v, swap), sinSign);
+		c = _mm256_xor_ps(_mm256_blendv_ps(cosY.v, sinY.v, swap), cosSign);
+	}
+
+	// rows[k] holds one component for 8 instances, afterwards 8 components of instance k
+	inline void transpose8(__m256 rows[8])
+	{
+		__m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+		__m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+		__m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+		__m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+		__m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+		__m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+		__m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+		__m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+		__m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+		rows[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+		rows[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+		rows[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+		rows[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+		rows[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+		rows[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+		rows[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+		rows[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+	}
+
+	// Writes components [first, first + 8) of 8 instances, each instance "stride" floats apart
+	inline void storeLanes(const WFloat8* lanes, int first, float* out, size_t stride)
+	{
+		__m256 rows[8];
+		for (int k = 0; k < 8; k++)
+			rows[k] = lanes[first + k].v;
+		transpose8(rows);
+		for (int k = 0; k < 8; k++)
+			_mm256_storeu_ps(out + k * stride + first, rows[k]);
+	}
+
+	inline __m256i laneIndices(const UINT32* indices, size_t k)
+	{
+		return indices ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + k)) :
+			_mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(k)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	}
+
+	size_t composeTRSAvx2(const float* translations, const float* rotations, const float* scalings, UINT32 stride,
+		const UINT32* indices, size_t count, DirectX::XMFLOAT3X4* transforms)
+	{
+		const size_t batched = count & ~size_t(7);
+		for (size_t k = 0; k < batched; k += 8)
+		{
+			const __m256i offsets = _mm256_mullo_epi32(laneIndices(indices, k), _mm256_set1_epi32(static_cast<int>(stride)));
+			WFloat8 t[3], sinR[3], cosR[3], s[3];
+			for (int c = 0; c < 3; c++)
+			{
+				t[c] = _mm256_i32gather_ps(translations + c, offsets, 4);
+				s[c] = _mm256_i32gather_ps(scalings + c, offsets, 4);
+				sinCos(WFloat8(_mm256_i32gather_ps(rotations + c, offsets, 4)) * WFloat8(DegToRad), sinR[c], cosR[c]);
+			}
+			WFloat8 x[12];
+			composeLanes(t, sinR, cosR, s, x);
+			// 12 floats per instance, the second transpose rewrites components 4..7
+			float* out = &transforms[k].m[0][0];
+			storeLanes(x, 0, out, 12);
+			storeLanes(x, 4, out, 12);
+		}
+		return batched;
+	}
+}
+
+bool cpuSupportsAvx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	// The OS has to save the YMM registers on context switches
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+WSIMD_PATH transformBatchPath()
+{
+	return gPath;
+}
+
+void setTransformBatchPath(WSIMD_PATH path)
+{
+	gPath = path == SIMD_PATH_AVX2 && cpuSupportsAvx2() ? SIMD_PATH_AVX2 : SIMD_PATH_SCALAR;
+}
+
+const char* simdPathName(WSIMD_PATH path)
+{
+	return path == SIMD_PATH_AVX2 ? "AVX2" : path == SIMD_PATH_SSE ? "SSE" : "scalar";
+}
+
+void composeTRSBatch(const float* translations, const float* rotations, const float* scalings, UINT32 stride,
+	const UINT32* indices, size_t count, DirectX::XMFLOAT3X4* transforms)
+{
+	size_t k = gPath == SIMD_PATH_AVX2 ?
+		composeTRSAvx2(translations, rotations, scalings, stride, indices, count, transforms) : 0;
+	for (; k < count; k++)
+	{
+		const size_t offset = (indices ? indices[k] : k) * stride;
+		float t[3], sinR[3], cosR[3], s[3];
+		for (int c = 0; c < 3; c++)
+		{
+			t[c] = translations[offset + c];
+			s[c] = scalings[offset + c];
+			sinCos(rotations[offset + c] * DegToRad, sinR[c], cosR[c]);
+		}
+		composeLanes(t, sinR, cosR, s, &transforms[k].m[0][0]);
+	}
+}
+
+void objectMatricesBatch(const DirectX::XMFLOAT3X4* transforms, const UINT32* indices, size_t count,
+	DirectX::XMFLOAT4X4* objectToWorld, DirectX::XMFLOAT4X4* invTranspose)
+{
+	for (size_t k = 0; k < count; k++)
+	{
+		const auto& x = transforms[indices ? indices[k] : k];
+		objectToWorldRows(x, objectToWorld[k]);
+		invTransposeRows(&x.m[0][0], &invTranspose[k].m[0][0]);
+	}
+}
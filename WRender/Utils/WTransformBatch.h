@@ -0,0 +1,44 @@
+#pragma once
+#include <windows.h>
+#include <vector>
+#include <DirectXMath.h>
+
+// Batched matrix work of the per-frame instance update. TRS composition has an AVX2 path
+// for 8 instances per iteration, picked at startup when the CPU supports it; the scalar
+// path takes the remainder of a batch and CPUs without AVX2. Both compose
+// S * Rz * Ry * Rx * T like composeTRS, the AVX2 sine and cosine differ from DirectXMath
+// by a few ulp.
+
+enum WSIMD_PATH : UINT32
+{
+	SIMD_PATH_SCALAR = 0,
+	// 4 lanes, baseline on x64. Kernels without an SSE variant run scalar.
+	SIMD_PATH_SSE,
+	SIMD_PATH_AVX2
+};
+
+// CPU and OS support for AVX2 (YMM state saved on context switches)
+bool cpuSupportsAvx2();
+
+WSIMD_PATH transformBatchPath();
+// Stays scalar when the CPU lacks AVX2, SSE runs scalar
+void setTransformBatchPath(WSIMD_PATH path);
+const char* simdPathName(WSIMD_PATH path);
+
+// transforms[k] = TRS of element indices[k] (k without indices), rotation in degrees.
+// Element i reads 3 floats at translations/rotations/scalings + i * stride.
+void composeTRSBatch(const float* translations, const float* rotations, const float* scalings, UINT32 stride,
+	const UINT32* indices, size_t count, DirectX::XMFLOAT3X4* transforms);
+
+// ObjectToWorld and InvTranspose of WObjectConstants for transforms[indices[k]] (k without indices)
+void objectMatricesBatch(const DirectX::XMFLOAT3X4* transforms, const UINT32* indices, size_t count,
+	DirectX::XMFLOAT4X4* objectToWorld, DirectX::XMFLOAT4X4* invTranspose);
+
+// Scratch of one update, kept between frames to avoid reallocating
+struct WTransformBatch
+{
+	std::vector<UINT32> indices;
+	std::vector<DirectX::XMFLOAT3X4> transforms;
+	std::vector<DirectX::XMFLOAT4X4> objectToWorld;
+	std::vector<DirectX::XMFLOAT4X4> invTranspose;
+};
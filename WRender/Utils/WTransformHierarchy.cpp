@@ -0,0 +1,73 @@
+#include "WTransformHierarchy.h"
+#include <algorithm>
+
+void WTransformHierarchy::clear()
+{
+	parents.clear();
+	subtreeEnd.clear();
+	objects.clear();
+	names.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	pending.clear();
+}
+
+UINT32 WTransformHierarchy::addNode(INT32 parent, INT32 object, const std::string& name, DirectX::FXMMATRIX local)
+{
+	UINT32 node = static_cast<UINT32>(size());
+	parents.push_back(parent);
+	subtreeEnd.push_back(node + 1);
+	objects.push_back(object);
+	names.push_back(name);
+	locals.emplace_back();
+	DirectX::XMStoreFloat3x4(&locals.back(), local);
+	worlds.push_back(locals.back());
+	dirty.push_back(1);
+	pending.push_back(node);
+	return node;
+}
+
+void WTransformHierarchy::setLocal(UINT32 node, DirectX::FXMMATRIX local)
+{
+	DirectX::XMFLOAT3X4 stored;
+	DirectX::XMStoreFloat3x4(&stored, local);
+	setLocal(node, stored);
+}
+
+void WTransformHierarchy::setLocal(UINT32 node, const DirectX::XMFLOAT3X4& local)
+{
+	locals[node] = local;
+	if (!dirty[node])
+	{
+		dirty[node] = 1;
+		pending.push_back(node);
+	}
+}
+
+size_t WTransformHierarchy::update(std::vector<UINT32>* changed)
+{
+	// Sorted, a dirty node inside a subtree recomputed before it is already clean
+	std::sort(pending.begin(), pending.end());
+	size_t updated = 0;
+	for (UINT32 node : pending)
+	{
+		if (!dirty[node])
+			continue;
+		// Parents precede their children, so each world matrix below is computed from a fresh one
+		const UINT32 end = subtreeEnd[node];
+		for (UINT32 i = node; i < end; i++)
+		{
+			DirectX::XMMATRIX local = DirectX::XMLoadFloat3x4(&locals[i]);
+			if (parents[i] >= 0)
+				local = DirectX::XMMatrixMultiply(local, DirectX::XMLoadFloat3x4(&worlds[parents[i]]));
+			DirectX::XMStoreFloat3x4(&worlds[i], local);
+			dirty[i] = 0;
+			if (changed)
+				changed->push_back(i);
+		}
+		updated += end - node;
+	}
+	pending.clear();
+	return updated;
+}
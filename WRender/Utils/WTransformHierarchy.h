@@ -0,0 +1,38 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+// Parent/child transforms of <group> elements and the objects inside them.
+// Nodes are stored depth first: a parent comes before its children and every subtree
+// occupies the contiguous range [node, subtreeEnd[node]). World matrices are cached,
+// moving a node queues it and update() recomputes only the queued subtrees, so the cost
+// follows the number of moved nodes rather than the size of the scene.
+struct WTransformHierarchy
+{
+	std::vector<INT32> parents;         // -1 for roots
+	std::vector<UINT32> subtreeEnd;
+	std::vector<INT32> objects;         // objIdx of the render item, -1 for groups
+	std::vector<std::string> names;
+	// Affine transforms in the 3x4 layout of D3D12_RAYTRACING_INSTANCE_DESC
+	std::vector<DirectX::XMFLOAT3X4> locals;
+	std::vector<DirectX::XMFLOAT3X4> worlds;
+	std::vector<UINT8> dirty;
+	std::vector<UINT32> pending;        // Dirty nodes in the order they were marked
+
+	size_t size() const { return parents.size(); }
+	bool empty() const { return parents.empty(); }
+	void clear();
+
+	// Children have to be added before closeNode is called on their parent
+	UINT32 addNode(INT32 parent, INT32 object, const std::string& name, DirectX::FXMMATRIX local);
+	void closeNode(UINT32 node) { subtreeEnd[node] = static_cast<UINT32>(size()); }
+
+	void setLocal(UINT32 node, DirectX::FXMMATRIX local);
+	void setLocal(UINT32 node, const DirectX::XMFLOAT3X4& local);
+	DirectX::XMMATRIX world(UINT32 node) const { return DirectX::XMLoadFloat3x4(&worlds[node]); }
+
+	// Returns the number of nodes whose world matrix was recomputed, "changed" receives them in order
+	size_t update(std::vector<UINT32>* changed = nullptr);
+};
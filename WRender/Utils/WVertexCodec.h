@@ -0,0 +1,114 @@
+#pragma once
+#include <windows.h>
+#include <cmath>
+#include <cstring>
+
+// Compact vertex attribute encodings, decoded by the matching functions in HitCommon.hlsl
+// when the hit shaders are compiled with PACKED_ATTRIBUTES.
+// Normals are octahedral-mapped to 2 x 16-bit SNORM, texcoords are stored as 2 x half.
+// Both pack into one UINT32 with the first component in the low 16 bits.
+
+// Worst-case errors of the encodings, checked when a mesh is quantized
+const double WOctNormalMaxAngularError = 1e-4;        // Radians
+// A quarter texel of a 1024 texture. Half keeps it for texcoords in [-1, 1], tiled texcoords
+// further out do not fit and their mesh keeps float texcoords.
+const double WHalfTexCoordMaxAbsoluteError = 1.0 / 4096.0;
+
+inline UINT16 floatToHalf(float value)
+{
+	UINT32 f;
+	memcpy(&f, &value, sizeof(f));
+	UINT32 sign = (f >> 16) & 0x8000;
+	UINT32 absBits = f & 0x7FFFFFFF;
+	if (absBits >= 0x7F800000) // Inf or NaN
+		return static_cast<UINT16>(sign | 0x7C00 | (absBits > 0x7F800000 ? 0x200 : 0));
+	if (absBits >= 0x477FF000) // Rounds to a value above the half range
+		return static_cast<UINT16>(sign | 0x7C00);
+	if (absBits < 0x38800000) // Subnormal half, round to a multiple of 2^-24
+	{
+		float absValue;
+		memcpy(&absValue, &absBits, sizeof(absValue));
+		return static_cast<UINT16>(sign | static_cast<UINT32>(std::nearbyint(absValue * 16777216.0f)));
+	}
+	// Round to nearest even on the 13 dropped mantissa bits
+	UINT32 rounded = absBits + 0xFFF + ((absBits >> 13) & 1);
+	return static_cast<UINT16>(sign | ((rounded - 0x38000000) >> 13));
+}
+
+inline float halfToFloat(UINT16 value)
+{
+	UINT32 sign = static_cast<UINT32>(value & 0x8000) << 16;
+	UINT32 exponent = (value >> 10) & 0x1F;
+	UINT32 mantissa = value & 0x3FF;
+	float result;
+	if (exponent == 0)
+		result = mantissa * (1.0f / 16777216.0f);
+	else if (exponent == 31)
+	{
+		UINT32 bits = 0x7F800000 | (mantissa << 13);
+		memcpy(&result, &bits, sizeof(result));
+	}
+	else
+	{
+		UINT32 bits = ((exponent + 112) << 23) | (mantissa << 13);
+		memcpy(&result, &bits, sizeof(result));
+	}
+	return sign ? -result : result;
+}
+
+inline INT16 floatToSnorm16(float value)
+{
+	value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return static_cast<INT16>(std::lround(value * 32767.0f));
+}
+
+inline float snorm16ToFloat(INT16 value)
+{
+	float f = value / 32767.0f;
+	return f < -1.0f ? -1.0f : f;
+}
+
+inline UINT32 encodeOctahedralNormal(float x, float y, float z)
+{
+	float l1 = std::fabs(x) + std::fabs(y) + std::fabs(z);
+	if (l1 == 0.0f)
+		return 0;
+	float u = x / l1, v = y / l1;
+	if (z < 0.0f)
+	{
+		// Fold the lower hemisphere over the diagonals
+		float foldedU = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		float foldedV = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		u = foldedU;
+		v = foldedV;
+	}
+	return static_cast<UINT16>(floatToSnorm16(u)) | (static_cast<UINT32>(static_cast<UINT16>(floatToSnorm16(v))) << 16);
+}
+
+inline void decodeOctahedralNormal(UINT32 packed, float& x, float& y, float& z)
+{
+	x = snorm16ToFloat(static_cast<INT16>(packed & 0xFFFF));
+	y = snorm16ToFloat(static_cast<INT16>(packed >> 16));
+	z = 1.0f - std::fabs(x) - std::fabs(y);
+	float t = z < 0.0f ? -z : 0.0f;
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+	float length = std::sqrt(x * x + y * y + z * z);
+	if (length > 0.0f)
+	{
+		x /= length;
+		y /= length;
+		z /= length;
+	}
+}
+
+inline UINT32 encodeHalfTexCoord(float u, float v)
+{
+	return floatToHalf(u) | (static_cast<UINT32>(floatToHalf(v)) << 16);
+}
+
+inline void decodeHalfTexCoord(UINT32 packed, float& u, float& v)
+{
+	u = halfToFloat(static_cast<UINT16>(packed & 0xFFFF));
+	v = halfToFloat(static_cast<UINT16>(packed >> 16));
+}
@@ -0,0 +1,456 @@
+#include "WXmlReader.h"
+#include <charconv>
+#include <cstring>
+
+namespace
+{
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	inline bool isSeparator(char c)
+	{
+		return isSpace(c) || c == ',' || c == ';';
+	}
+
+	inline bool isNameEnd(char c)
+	{
+		return isSpace(c) || c == '/' || c == '>' || c == '=';
+	}
+
+	std::string_view trim(std::string_view text)
+	{
+		while (!text.empty() && isSpace(text.front()))
+			text.remove_prefix(1);
+		while (!text.empty() && isSpace(text.back()))
+			text.remove_suffix(1);
+		return text;
+	}
+
+	// from_chars rejects a leading '+'
+	const char* parseFloat(const char* p, const char* end, float& value)
+	{
+		if (p < end && *p == '+')
+			++p;
+		auto result = std::from_chars(p, end, value);
+		return result.ec == std::errc() ? result.ptr : nullptr;
+	}
+
+	void appendUtf8(std::string& out, UINT32 code)
+	{
+		if (code < 0x80)
+			out += static_cast<char>(code);
+		else if (code < 0x800)
+		{
+			out += static_cast<char>(0xC0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			out += static_cast<char>(0xE0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+}
+
+WXmlReader::WXmlReader(const char* data, size_t size)
+	: mBegin(data), mEnd(data + size), mPos(data)
+{
+	// UTF-8 byte order mark
+	if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+		mPos += 3;
+}
+
+bool WXmlReader::nextChild()
+{
+	if (mFailed)
+		return false;
+	if (mPendingEmpty)
+	{
+		mPendingEmpty = false;
+		return false;
+	}
+	for (;;)
+	{
+		const char* lt = static_cast<const char*>(memchr(mPos, '<', mEnd - mPos));
+		if (!lt)
+		{
+			mPos = mEnd;
+			if (mDepth > 0)
+				fail(mEnd, "unexpected end of document, <" + std::string(mStack[mDepth - 1]) + "> is not closed");
+			return false;
+		}
+		mPos = lt;
+		if (mPos + 1 < mEnd && (mPos[1] == '!' || mPos[1] == '?'))
+		{
+			if (!skipMarkup(nullptr))
+				return false;
+		}
+		else if (mPos + 1 < mEnd && mPos[1] == '/')
+		{
+			readEndTag();
+			return false;
+		}
+		else
+			return readStartTag();
+	}
+}
+
+std::string_view WXmlReader::readText()
+{
+	if (mFailed)
+		return {};
+	if (mPendingEmpty)
+	{
+		mPendingEmpty = false;
+		return {};
+	}
+	std::string_view text;
+	for (;;)
+	{
+		const char* lt = static_cast<const char*>(memchr(mPos, '<', mEnd - mPos));
+		if (!lt)
+		{
+			fail(mEnd, "unexpected end of document, <" + std::string(mStack[mDepth - 1]) + "> is not closed");
+			return {};
+		}
+		// The first non-blank run of text wins
+		if (text.empty())
+			text = trim(std::string_view(mPos, lt - mPos));
+		mPos = lt;
+		if (mPos + 1 < mEnd && (mPos[1] == '!' || mPos[1] == '?'))
+		{
+			std::string_view cdata;
+			if (!skipMarkup(&cdata))
+				return {};
+			if (text.empty())
+				text = cdata;
+		}
+		else if (mPos + 1 < mEnd && mPos[1] == '/')
+		{
+			if (!readEndTag())
+				return {};
+			return text;
+		}
+		else
+		{
+			if (!readStartTag())
+				return {};
+			skip();
+			if (mFailed)
+				return {};
+		}
+	}
+}
+
+void WXmlReader::skip()
+{
+	while (nextChild())
+		skip();
+}
+
+bool WXmlReader::hasAttribute(std::string_view name) const
+{
+	for (UINT32 i = 0; i < mAttributeCount; i++)
+		if (mAttributeNames[i] == name)
+			return true;
+	return false;
+}
+
+std::string_view WXmlReader::attribute(std::string_view name) const
+{
+	for (UINT32 i = 0; i < mAttributeCount; i++)
+		if (mAttributeNames[i] == name)
+			return mAttributeValues[i];
+	return {};
+}
+
+bool WXmlReader::queryFloatAttribute(std::string_view name, float& value) const
+{
+	std::string_view text = trim(attribute(name));
+	const char* end = text.data() + text.size();
+	float parsed;
+	if (text.empty() || parseFloat(text.data(), end, parsed) != end)
+		return false;
+	value = parsed;
+	return true;
+}
+
+bool WXmlReader::queryUnsignedAttribute(std::string_view name, UINT32& value) const
+{
+	std::string_view text = trim(attribute(name));
+	const char* end = text.data() + text.size();
+	UINT32 parsed;
+	auto result = std::from_chars(text.data(), end, parsed);
+	if (text.empty() || result.ec != std::errc() || result.ptr != end)
+		return false;
+	value = parsed;
+	return true;
+}
+
+bool WXmlReader::queryBoolAttribute(std::string_view name, bool& value) const
+{
+	std::string_view text = trim(attribute(name));
+	if (text == "true" || text == "True" || text == "TRUE" || text == "1")
+		value = true;
+	else if (text == "false" || text == "False" || text == "FALSE" || text == "0")
+		value = false;
+	else
+		return false;
+	return true;
+}
+
+std::string WXmlReader::position() const
+{
+	return lineColumn(mElementStart ? mElementStart : mPos);
+}
+
+std::string WXmlReader::decode(std::string_view text)
+{
+	std::string out;
+	out.reserve(text.size());
+	size_t i = 0;
+	while (i < text.size())
+	{
+		size_t amp = text.find('&', i);
+		size_t semicolon = amp == std::string_view::npos ? amp : text.find(';', amp);
+		if (semicolon == std::string_view::npos)
+		{
+			out.append(text.substr(i));
+			break;
+		}
+		out.append(text.substr(i, amp - i));
+		std::string_view entity = text.substr(amp + 1, semicolon - amp - 1);
+		UINT32 code = 0;
+		bool isCharacter = entity.size() > 1 && entity[0] == '#';
+		if (isCharacter)
+		{
+			bool hex = entity[1] == 'x' || entity[1] == 'X';
+			const char* first = entity.data() + (hex ? 2 : 1);
+			const char* last = entity.data() + entity.size();
+			auto result = std::from_chars(first, last, code, hex ? 16 : 10);
+			isCharacter = result.ec == std::errc() && result.ptr == last && code <= 0x10FFFF;
+		}
+		if (isCharacter)
+			appendUtf8(out, code);
+		else if (entity == "lt")
+			out += '<';
+		else if (entity == "gt")
+			out += '>';
+		else if (entity == "amp")
+			out += '&';
+		else if (entity == "quot")
+			out += '"';
+		else if (entity == "apos")
+			out += '\'';
+		else
+			out.append(text.substr(amp, semicolon - amp + 1));
+		i = semicolon + 1;
+	}
+	return out;
+}
+
+bool WXmlReader::startsWith(const char* prefix) const
+{
+	size_t length = strlen(prefix);
+	return static_cast<size_t>(mEnd - mPos) >= length && memcmp(mPos, prefix, length) == 0;
+}
+
+bool WXmlReader::skipPast(const char* terminator)
+{
+	std::string_view rest(mPos, mEnd - mPos);
+	size_t found = rest.find(terminator);
+	if (found == std::string_view::npos)
+		return fail(mPos, std::string("unterminated markup, missing ") + terminator);
+	mPos += found + strlen(terminator);
+	return true;
+}
+
+bool WXmlReader::skipMarkup(std::string_view* cdata)
+{
+	if (startsWith("<!--"))
+		return skipPast("-->");
+	if (startsWith("<?"))
+		return skipPast("?>");
+	if (startsWith("<![CDATA["))
+	{
+		const char* content = mPos + 9;
+		if (!skipPast("]]>"))
+			return false;
+		if (cdata)
+			*cdata = std::string_view(content, mPos - 3 - content);
+		return true;
+	}
+	// <!DOCTYPE ...>, an internal subset in brackets may hold '>'
+	const char* p = mPos + 2;
+	int brackets = 0;
+	for (; p < mEnd; ++p)
+	{
+		if (*p == '[')
+			++brackets;
+		else if (*p == ']')
+			--brackets;
+		else if (*p == '>' && brackets <= 0)
+			break;
+	}
+	if (p == mEnd)
+		return fail(mPos, "unterminated <! declaration");
+	mPos = p + 1;
+	return true;
+}
+
+bool WXmlReader::readStartTag()
+{
+	mElementStart = mPos;
+	mAttributeCount = 0;
+	const char* p = mPos + 1;
+	const char* nameStart = p;
+	while (p < mEnd && !isNameEnd(*p))
+		++p;
+	if (p == nameStart)
+		return fail(mElementStart, "expected an element name after '<'");
+	mName = std::string_view(nameStart, p - nameStart);
+
+	for (;;)
+	{
+		while (p < mEnd && isSpace(*p))
+			++p;
+		if (p == mEnd)
+			return fail(mElementStart, "unterminated start tag <" + std::string(mName) + ">");
+		if (*p == '>')
+		{
+			if (mDepth == MaxDepth)
+				return fail(mElementStart, "elements nested deeper than " + std::to_string(MaxDepth));
+			mStack[mDepth++] = mName;
+			mPendingEmpty = false;
+			mPos = p + 1;
+			return true;
+		}
+		if (*p == '/')
+		{
+			if (p + 1 == mEnd || p[1] != '>')
+				return fail(p, "expected '>' after '/' in <" + std::string(mName) + ">");
+			mPendingEmpty = true;
+			mPos = p + 2;
+			return true;
+		}
+
+		const char* attributeStart = p;
+		while (p < mEnd && !isNameEnd(*p))
+			++p;
+		if (p == attributeStart)
+			return fail(p, "expected an attribute name in <" + std::string(mName) + ">");
+		std::string_view attributeName(attributeStart, p - attributeStart);
+		while (p < mEnd && isSpace(*p))
+			++p;
+		if (p == mEnd || *p != '=')
+			return fail(p, "expected '=' after attribute " + std::string(attributeName));
+		++p;
+		while (p < mEnd && isSpace(*p))
+			++p;
+		if (p == mEnd || (*p != '"' && *p != '\''))
+			return fail(p, "expected a quoted value for attribute " + std::string(attributeName));
+		const char quote = *p++;
+		const char* valueEnd = static_cast<const char*>(memchr(p, quote, mEnd - p));
+		if (!valueEnd)
+			return fail(attributeStart, "unterminated value of attribute " + std::string(attributeName));
+		if (mAttributeCount == MaxAttributes)
+			return fail(attributeStart, "more than " + std::to_string(MaxAttributes) + " attributes in <" + std::string(mName) + ">");
+		mAttributeNames[mAttributeCount] = attributeName;
+		mAttributeValues[mAttributeCount] = std::string_view(p, valueEnd - p);
+		++mAttributeCount;
+		p = valueEnd + 1;
+	}
+}
+
+bool WXmlReader::readEndTag()
+{
+	const char* tagStart = mPos;
+	const char* p = mPos + 2;
+	const char* nameStart = p;
+	while (p < mEnd && !isNameEnd(*p))
+		++p;
+	std::string_view closed(nameStart, p - nameStart);
+	while (p < mEnd && isSpace(*p))
+		++p;
+	if (p == mEnd || *p != '>')
+		return fail(tagStart, "unterminated end tag </" + std::string(closed) + ">");
+	if (mDepth == 0)
+		return fail(tagStart, "unexpected end tag </" + std::string(closed) + ">");
+	if (closed != mStack[mDepth - 1])
+		return fail(tagStart, "end tag </" + std::string(closed) + "> does not match <" + std::string(mStack[mDepth - 1]) + ">");
+	--mDepth;
+	mPos = p + 1;
+	return true;
+}
+
+bool WXmlReader::fail(const char* at, const std::string& message)
+{
+	if (!mFailed)
+	{
+		mFailed = true;
+		mError = lineColumn(at) + ": " + message;
+	}
+	// Nothing after the first error is read
+	mPos = mEnd;
+	mDepth = 0;
+	mPendingEmpty = false;
+	return false;
+}
+
+std::string WXmlReader::lineColumn(const char* at) const
+{
+	size_t line = 1;
+	const char* lineStart = mBegin;
+	for (const char* p = mBegin; p < at; ++p)
+	{
+		if (*p == '\n')
+		{
+			++line;
+			lineStart = p + 1;
+		}
+	}
+	return std::to_string(line) + ":" + std::to_string(at - lineStart + 1);
+}
+
+bool parseFloats(std::string_view text, float* values, size_t count)
+{
+	const char* p = text.data();
+	const char* end = p + text.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		while (p < end && isSeparator(*p))
+			++p;
+		if (!(p = parseFloat(p, end, values[i])))
+			return false;
+	}
+	while (p < end && isSeparator(*p))
+		++p;
+	return p == end;
+}
+
+bool parseFloatList(std::string_view text, std::vector<float>& values)
+{
+	const char* p = text.data();
+	const char* end = p + text.size();
+	for (;;)
+	{
+		while (p < end && isSeparator(*p))
+			++p;
+		if (p == end)
+			return true;
+		float value;
+		if (!(p = parseFloat(p, end, value)))
+			return false;
+		values.push_back(value);
+	}
+}
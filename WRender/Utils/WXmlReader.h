@@ -0,0 +1,95 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Forward-only reader for the scene XML, walking a buffer in place (usually a WMappedFile)
+// instead of building a DOM. Names, attribute values and text are views into the buffer,
+// reading allocates nothing.
+//
+// Every element nextChild() stops at is consumed by exactly one of: nextChild() until it
+// returns false, readText() or skip():
+//
+//   while (reader.nextChild())
+//   {
+//       if (reader.name() == "object")
+//           parseObject(reader);
+//       else
+//           reader.skip();
+//   }
+//
+// Comments, processing instructions and the DOCTYPE are skipped, text between child
+// elements is ignored. Entities are left as written in the views, decode() expands them.
+// The first error stops the reader, error() reports it with its line and column.
+class WXmlReader
+{
+public:
+	static const UINT32 MaxDepth = 64;
+	static const UINT32 MaxAttributes = 16;
+
+	WXmlReader(const char* data, size_t size);
+	WXmlReader(const WXmlReader& rhs) = delete;
+	WXmlReader& operator=(const WXmlReader& rhs) = delete;
+
+	// Moves to the next child element of the current one, the document root at first.
+	// Returns false once the end tag of the current element is consumed, or on an error.
+	bool nextChild();
+	// Text content of the current element with surrounding whitespace trimmed, consumes the
+	// element. CDATA is returned as is, child elements are skipped.
+	std::string_view readText();
+	void skip();
+
+	// Name and attributes of the element last returned by nextChild()
+	std::string_view name() const { return mName; }
+	bool hasAttribute(std::string_view name) const;
+	// Empty when the attribute is missing
+	std::string_view attribute(std::string_view name) const;
+	// Return false when the attribute is missing or malformed, "value" is left untouched then
+	bool queryFloatAttribute(std::string_view name, float& value) const;
+	bool queryUnsignedAttribute(std::string_view name, UINT32& value) const;
+	bool queryBoolAttribute(std::string_view name, bool& value) const;
+
+	bool failed() const { return mFailed; }
+	// "line:column: message" of the first error
+	const std::string& error() const { return mError; }
+	// "line:column" of the element last returned by nextChild(), for diagnostics
+	std::string position() const;
+
+	// Expands the five predefined entities and character references
+	static std::string decode(std::string_view text);
+private:
+	bool startsWith(const char* prefix) const;
+	bool skipPast(const char* terminator);
+	// Skips a comment, processing instruction, DOCTYPE or CDATA section at mPos.
+	// "cdata" receives the contents of a CDATA section.
+	bool skipMarkup(std::string_view* cdata);
+	bool readStartTag();
+	bool readEndTag();
+	bool fail(const char* at, const std::string& message);
+	std::string lineColumn(const char* at) const;
+
+	const char* mBegin;
+	const char* mEnd;
+	const char* mPos;
+	bool mFailed = false;
+	std::string mError;
+
+	// Open elements
+	std::string_view mStack[MaxDepth];
+	UINT32 mDepth = 0;
+
+	// Element last returned by nextChild()
+	const char* mElementStart = nullptr;
+	std::string_view mName;
+	std::string_view mAttributeNames[MaxAttributes];
+	std::string_view mAttributeValues[MaxAttributes];
+	UINT32 mAttributeCount = 0;
+	// <element/> was returned and not consumed yet
+	bool mPendingEmpty = false;
+};
+
+// Parses exactly "count" floats separated by commas, semicolons or whitespace
+bool parseFloats(std::string_view text, float* values, size_t count);
+// Appends every float of a separated list
+bool parseFloatList(std::string_view text, std::vector<float>& values);
@@ -55,6 +55,14 @@ buffer needs to be kept until the command list execution is finished.
 namespace nv_helpers_dx12
 {
 
+//--------------------------------------------------------------------------------------------------
+//
+// Remove all the instances, so that the acceleration structure can be rebuilt from a new set
+void TopLevelASGenerator::Reset()
+{
+  m_instances.clear();
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 // Add an instance to the top-level acceleration structure. The instance is
@@ -64,7 +72,7 @@ namespace nv_helpers_dx12
 void TopLevelASGenerator::AddInstance(
     ID3D12Resource* bottomLevelAS,      // Bottom-level acceleration structure containing the
                                         // actual geometric data of the instance
-    const DirectX::XMMATRIX& transform, // Transform matrix to apply to the instance, allowing the
+    const DirectX::XMFLOAT3X4& transform, // Transform matrix to apply to the instance, allowing the
                                         // same bottom-level AS to be used at several world-space
                                         // positions
     UINT instanceID,                    // Instance ID, which can be used in the shaders to
@@ -186,10 +194,8 @@ void TopLevelASGenerator::Generate(
     // Instance flags, including backface culling, winding, etc - TODO: should
     // be accessible from outside
     instanceDescs[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-    // Instance transform matrix
-    DirectX::XMMATRIX m = XMMatrixTranspose(
-        m_instances[i].transform); // GLM is column major, the INSTANCE_DESC is row major
-    memcpy(instanceDescs[i].Transform, &m, sizeof(instanceDescs[i].Transform));
+    // Instance transform matrix, XMFLOAT3X4 already has the 3x4 row major layout of the INSTANCE_DESC
+    memcpy(instanceDescs[i].Transform, &m_instances[i].transform, sizeof(instanceDescs[i].Transform));
     // Get access to the bottom level
     instanceDescs[i].AccelerationStructure = m_instances[i].bottomLevelAS->GetGPUVirtualAddress();
     // Visibility mask, always visible here - TODO: should be accessible from
@@ -251,7 +257,7 @@ void TopLevelASGenerator::Generate(
 //--------------------------------------------------------------------------------------------------
 //
 //
-TopLevelASGenerator::Instance::Instance(ID3D12Resource* blAS, const DirectX::XMMATRIX& tr, UINT iID,
+TopLevelASGenerator::Instance::Instance(ID3D12Resource* blAS, const DirectX::XMFLOAT3X4& tr, UINT iID,
                                         UINT hgId)
     : bottomLevelAS(blAS), transform(tr), instanceID(iID), hitGroupIndex(hgId)
 {
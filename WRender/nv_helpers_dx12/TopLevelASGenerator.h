@@ -90,9 +90,10 @@ public:
   void
   AddInstance(ID3D12Resource* bottomLevelAS, /// Bottom-level acceleration structure containing the
                                              /// actual geometric data of the instance
-              const DirectX::XMMATRIX& transform, /// Transform matrix to apply to the instance,
-                                                  /// allowing the same bottom-level AS to be used
-                                                  /// at several world-space positions
+              const DirectX::XMFLOAT3X4& transform, /// Transform matrix to apply to the instance,
+                                                    /// allowing the same bottom-level AS to be used
+                                                    /// at several world-space positions. Read
+                                                    /// again by every Generate call
               UINT instanceID,   /// Instance ID, which can be used in the shaders to
                                  /// identify this specific instance
               UINT hitGroupIndex /// Hit group index, corresponding the the index of the
@@ -100,6 +101,10 @@ public:
                                  /// invocated upon hitting the geometry
   );
 
+  /// Removes all the instances, so that the acceleration structure can be
+  /// rebuilt from a new set
+  void Reset();
+
   /// Compute the size of the scratch space required to build the acceleration
   /// structure, as well as the size of the resulting structure. The allocation
   /// of the buffers is then left to the application
@@ -137,11 +142,11 @@ private:
   /// Helper struct storing the instance data
   struct Instance
   {
-    Instance(ID3D12Resource* blAS, const DirectX::XMMATRIX& tr, UINT iID, UINT hgId);
+    Instance(ID3D12Resource* blAS, const DirectX::XMFLOAT3X4& tr, UINT iID, UINT hgId);
     /// Bottom-level AS
     ID3D12Resource* bottomLevelAS;
     /// Transform matrix
-    const DirectX::XMMATRIX& transform;
+    const DirectX::XMFLOAT3X4& transform;
     /// Instance ID visible in the shader
     UINT instanceID;
     /// Hit group index used to fetch the shaders from the SBT